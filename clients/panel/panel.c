@@ -23,6 +23,7 @@
 #include <uuid/uuid.h>
 
 #include "lash/lash.h"
+#include "lash/glib.h"
 #include <gtk/gtk.h>
 
 #include "panel.h"
@@ -386,6 +387,7 @@ panel_create(lash_client_t * lash_client)
 	GtkWidget *about_menu_item = NULL;
 
 	guint status_context;
+	GSource *lash_source;
 
 	panel = malloc(sizeof(panel_t));
 	panel->lash_client = lash_client;
@@ -482,7 +484,13 @@ panel_create(lash_client_t * lash_client)
 									   lash_get_server_name(lash_client)));
 	gtk_box_pack_start(GTK_BOX(main_box), panel->status_bar, FALSE, TRUE, 0);
 
-	gtk_timeout_add(1000, idle_cb, panel);
+	/* Dispatch LASH messages as they arrive, or poll for them if
+	   the LASH main loop source isn't supported */
+	if ((lash_source = lash_gsource_new(lash_client))) {
+		g_source_attach(lash_source, NULL);
+		g_source_unref(lash_source);
+	} else
+		gtk_timeout_add(1000, idle_cb, panel);
 	gtk_widget_show(panel->window);
 
 	return panel;
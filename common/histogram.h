@@ -0,0 +1,102 @@
+/*
+ *   LASH
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __LASH_HISTOGRAM_H__
+#define __LASH_HISTOGRAM_H__
+
+#include <stdint.h>
+#include <string.h>
+#include <time.h>
+
+/* Values are counted in log-linear buckets: every power of two is split
+   into HISTOGRAM_SUB_BUCKETS linear ranges, so a bucket's lower bound is
+   within 25% of any value counted in it. 128 buckets cover values up to
+   2^33, which as microseconds is over two hours. */
+#define HISTOGRAM_SUB_BITS     2
+#define HISTOGRAM_SUB_BUCKETS  (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_BUCKETS      128
+
+struct histogram
+{
+	uint64_t count;
+	uint64_t total;
+	uint64_t max;
+	uint64_t buckets[HISTOGRAM_BUCKETS];
+};
+
+static __inline__ unsigned int
+histogram_bucket(uint64_t value)
+{
+	unsigned int exp, index;
+
+	if (value < HISTOGRAM_SUB_BUCKETS)
+		return (unsigned int) value;
+
+	exp = 63 - __builtin_clzll(value);
+	index = (exp - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_BUCKETS
+	        + ((value >> (exp - HISTOGRAM_SUB_BITS)) & (HISTOGRAM_SUB_BUCKETS - 1));
+
+	return index < HISTOGRAM_BUCKETS ? index : HISTOGRAM_BUCKETS - 1;
+}
+
+/* Smallest value counted in bucket number index */
+static __inline__ uint64_t
+histogram_bucket_min(unsigned int index)
+{
+	unsigned int exp;
+
+	if (index < HISTOGRAM_SUB_BUCKETS)
+		return index;
+
+	exp = index / HISTOGRAM_SUB_BUCKETS + HISTOGRAM_SUB_BITS - 1;
+
+	return ((uint64_t) (HISTOGRAM_SUB_BUCKETS + index % HISTOGRAM_SUB_BUCKETS))
+	       << (exp - HISTOGRAM_SUB_BITS);
+}
+
+/* Count a value. Histograms are only written from one thread, so plain
+   increments are enough and readers see at worst a slightly stale copy. */
+static __inline__ void
+histogram_record(struct histogram *histogram,
+                 uint64_t          value)
+{
+	++histogram->count;
+	histogram->total += value;
+	if (value > histogram->max)
+		histogram->max = value;
+	++histogram->buckets[histogram_bucket(value)];
+}
+
+static __inline__ void
+histogram_reset(struct histogram *histogram)
+{
+	memset(histogram, 0, sizeof(struct histogram));
+}
+
+/* Monotonic time in microseconds, for measuring what goes into a histogram */
+static __inline__ uint64_t
+histogram_now_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+#endif /* __LASH_HISTOGRAM_H__ */
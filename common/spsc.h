@@ -0,0 +1,85 @@
+/*
+ *   LASH
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __LASH_SPSC_H__
+#define __LASH_SPSC_H__
+
+#include <stdbool.h>
+#include <string.h>
+
+/* A wait-free queue of fixed-size elements for exactly one producer
+   thread and one consumer thread. The storage is supplied by the caller,
+   so pushing and popping never allocate. Head and tail run freely and
+   are reduced modulo the capacity, which must be a power of two. */
+struct spsc
+{
+	char         *buf;
+	unsigned int  elem_size;
+	unsigned int  mask;
+	unsigned int  head;  /* Written by the producer only */
+	unsigned int  tail;  /* Written by the consumer only */
+};
+
+static __inline__ void
+spsc_init(struct spsc  *queue,
+          void         *buf,
+          unsigned int  capacity,
+          unsigned int  elem_size)
+{
+	queue->buf = buf;
+	queue->elem_size = elem_size;
+	queue->mask = capacity - 1;
+	queue->head = 0;
+	queue->tail = 0;
+}
+
+/* Copy an element into the queue. Returns false if the queue is full. */
+static __inline__ bool
+spsc_push(struct spsc *queue,
+          const void  *elem)
+{
+	unsigned int head = queue->head;
+
+	if (head - __atomic_load_n(&queue->tail, __ATOMIC_ACQUIRE) > queue->mask)
+		return false;
+
+	memcpy(queue->buf + (head & queue->mask) * queue->elem_size,
+	       elem, queue->elem_size);
+	__atomic_store_n(&queue->head, head + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+/* Copy the oldest element out of the queue. Returns false if it's empty. */
+static __inline__ bool
+spsc_pop(struct spsc *queue,
+         void        *elem)
+{
+	unsigned int tail = queue->tail;
+
+	if (__atomic_load_n(&queue->head, __ATOMIC_ACQUIRE) == tail)
+		return false;
+
+	memcpy(elem, queue->buf + (tail & queue->mask) * queue->elem_size,
+	       queue->elem_size);
+	__atomic_store_n(&queue->tail, tail + 1, __ATOMIC_RELEASE);
+
+	return true;
+}
+
+#endif /* __LASH_SPSC_H__ */
@@ -34,6 +34,7 @@
 #define LASH_DBUS_ERROR_INVALID_CLIENT_ID   "org.nongnu.LASH.Error.InvalidClientId"
 #define LASH_DBUS_ERROR_UNFINISHED_TASK     "org.nongnu.LASH.Error.UnfinishedTask"
 #define LASH_DBUS_ERROR_INVALID_TASK        "org.nongnu.LASH.Error.InvalidTask"
+#define LASH_DBUS_ERROR_UNKNOWN_SCENE       "org.nongnu.LASH.Error.UnknownScene"
 
 void
 lash_dbus_error(method_call_t *call_ptr,
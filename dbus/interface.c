@@ -19,52 +19,149 @@
  *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <stdlib.h>
 #include <string.h>
 
+#include "common/safety.h"
 #include "common/debug.h"
 
 #include "dbus/interface.h"
 #include "dbus/error.h"
 
+static int
+interface_method_compare(const void *a,
+                         const void *b)
+{
+	return strcmp(((const struct _interface_method *) a)->method->name,
+	              ((const struct _interface_method *) b)->method->name);
+}
+
+static int
+interface_method_compare_name(const void *key,
+                              const void *entry)
+{
+	return strcmp((const char *) key,
+	              ((const struct _interface_method *) entry)->method->name);
+}
+
+/* Concatenate the types of a method's input arguments */
+static char *
+interface_method_signature(const method_t *method)
+{
+	const method_arg_t *arg;
+	size_t len = 1;
+	char *signature;
+
+	for (arg = method->args; arg && arg->name; ++arg)
+		if (arg->direction == DIRECTION_IN)
+			len += strlen(arg->type);
+
+	signature = lash_malloc(1, len);
+	signature[0] = '\0';
+
+	for (arg = method->args; arg && arg->name; ++arg)
+		if (arg->direction == DIRECTION_IN)
+			strcat(signature, arg->type);
+
+	return signature;
+}
+
+/* Sort the interface's methods by name so that they can be looked up
+   with a binary search, and cache each method's input signature */
+static void
+interface_build_index(const interface_t *interface)
+{
+	struct _interface_index *index = interface->index;
+	const method_t *ptr;
+	size_t i = 0;
+
+	for (ptr = interface->methods; ptr && ptr->name; ++ptr)
+		++index->num_methods;
+
+	if (!index->num_methods)
+		return;
+
+	index->methods = lash_malloc(index->num_methods,
+	                             sizeof(struct _interface_method));
+
+	for (ptr = interface->methods; ptr->name; ++ptr, ++i) {
+		index->methods[i].method = ptr;
+		index->methods[i].signature = interface_method_signature(ptr);
+	}
+
+	qsort(index->methods, index->num_methods,
+	      sizeof(struct _interface_method), interface_method_compare);
+}
+
+struct _interface_index *
+interface_get_index(const interface_t *interface)
+{
+	struct _interface_index *index = interface->index;
+
+	if (index && !index->methods && !index->num_methods)
+		interface_build_index(interface);
+
+	return index;
+}
+
+const struct _interface_method *
+interface_find_method(const interface_t *interface,
+                      const char        *name)
+{
+	struct _interface_index *index = interface_get_index(interface);
+
+	if (!index || !index->num_methods)
+		return NULL;
+
+	return bsearch(name, index->methods, index->num_methods,
+	               sizeof(struct _interface_method),
+	               interface_method_compare_name);
+}
+
 /*
  * Execute a method's function if the method specified in the method call
- * object exists in the method array. Return true if the method was found,
- * false otherwise.
- * TODO: rewrite description ^
+ * object exists in the interface. Return true if the method was found,
+ * false otherwise. If the method call's signature doesn't match the
+ * method's input arguments an error return is constructed instead, so
+ * handlers can rely on the argument types being correct.
  */
 bool
 interface_default_handler(const interface_t *interface,
                           method_call_t     *call)
 {
-	const method_t *ptr;
+	const struct _interface_method *entry;
+	const char *signature;
+
+	if (!(entry = interface_find_method(interface, call->method_name)))
+		/* Didn't find method */
+		return false;
+
+	call->interface = interface;
+
+	signature = dbus_message_get_signature(call->message);
+
+	if (strcmp(signature, entry->signature) != 0) {
+		lash_dbus_error(call, LASH_DBUS_ERROR_INVALID_ARGS,
+		                "Invalid arguments to method \"%s\": "
+		                "Expected signature \"%s\", got \"%s\"",
+		                call->method_name, entry->signature, signature);
+	} else if (entry->method->handler) {
+		entry->method->handler(call);
 
-	for (ptr = (const method_t *) interface->methods;
-	     ptr && ptr->name;
-	     ++ptr) {
-		if (strcmp(call->method_name, ptr->name) == 0) {
-			if (ptr->handler) {
-				call->interface = interface;
-				ptr->handler(call);
-
-				/* If the method handler didn't construct a return
-				   message create a void one here */
-				// TODO: Also handle cases where the sender doesn't need a reply
-				if (!call->reply
-				    && !(call->reply = dbus_message_new_method_return(call->message))) {
-					lash_error("Failed to construct void method return");
-				}
-			} else {
-				lash_dbus_error(call, LASH_DBUS_ERROR_GENERIC,
-				                "Handler for method \"%s\" is NULL", ptr->name);
-			}
-
-			/* Found method */
-			return true;
+		/* If the method handler didn't construct a return
+		   message create a void one here */
+		// TODO: Also handle cases where the sender doesn't need a reply
+		if (!call->reply
+		    && !(call->reply = dbus_message_new_method_return(call->message))) {
+			lash_error("Failed to construct void method return");
 		}
+	} else {
+		lash_dbus_error(call, LASH_DBUS_ERROR_GENERIC,
+		                "Handler for method \"%s\" is NULL", call->method_name);
 	}
 
-	/* Didn't find method */
-	return false;
+	/* Found method */
+	return true;
 }
 
 /* EOF */
@@ -28,22 +28,56 @@
 #include "dbus/method.h"
 #include "dbus/signal.h"
 
+struct _interface_method
+{
+	const method_t *method;
+	char           *signature;  /* Signature of the method's input arguments */
+};
+
+/* Index of an interface's methods, sorted by name and built on first use */
+struct _interface_index
+{
+	struct _interface_method *methods;
+	size_t                    num_methods;
+};
+
 struct _interface
 {
 	const char                *name;
 	const interface_handler_t  handler;
 	const method_t            *methods;
 	const signal_t            *signals;
+	struct _interface_index   *index;
 };
 
 bool
 interface_default_handler(const interface_t *interface,
                           method_call_t     *call);
 
+/** Get the method index of @a interface, building it if necessary.
+ * @param interface Interface whose index to get.
+ * @return The index, or NULL if the interface has none.
+ */
+struct _interface_index *
+interface_get_index(const interface_t *interface);
+
+/** Find a method of @a interface by name.
+ * @param interface Interface to search.
+ * @param name Method name.
+ * @return The method's index entry, or NULL if the interface
+ *         has no method called @a name.
+ */
+const struct _interface_method *
+interface_find_method(const interface_t *interface,
+                      const char        *name);
+
 #define INTERFACE_BEGIN(iface_var, iface_name) \
+static struct _interface_index                 \
+  iface_var ## _index;                         \
 const struct _interface iface_var =            \
 {                                              \
-        .name = iface_name,
+        .name = iface_name,                    \
+        .index = &iface_var ## _index,
 
 #define INTERFACE_DEFAULT_HANDLER              \
         .handler = interface_default_handler,
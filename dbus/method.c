@@ -19,6 +19,8 @@
  *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#include <stdint.h>
+
 #include "common/safety.h"
 #include "common/debug.h"
 
@@ -175,6 +177,15 @@ method_send(method_msg_t *call,
 void
 method_return_send(method_call_t *call)
 {
+	/* Don't send returns which the caller doesn't want */
+	if (dbus_message_get_no_reply(call->message)) {
+		if (call->reply) {
+			dbus_message_unref(call->reply);
+			call->reply = NULL;
+		}
+		return;
+	}
+
 	if (call->reply) {
 	retry_send:
 		if (!dbus_connection_send(call->connection, call->reply, NULL))
@@ -257,25 +268,34 @@ method_iter_append_variant(DBusMessageIter *iter,
 	return true;
 }
 
-static __inline__ bool
-method_iter_append_variant_raw(DBusMessageIter *iter,
-                               const void      *buf,
-                               int              len)
+/* Append a variant containing an array of fixed-size elements of
+   type element_type; buf_ptr points to the pointer to the elements */
+static bool
+method_iter_append_variant_array(DBusMessageIter *iter,
+                                 int              element_type,
+                                 const void      *buf_ptr,
+                                 int              count)
 {
 	DBusMessageIter variant_iter, array_iter;
+	char s[3];
+
+	s[0] = DBUS_TYPE_ARRAY;
+	s[1] = (char) element_type;
+	s[2] = '\0';
 
 	/* Open a variant container. */
 	if (!dbus_message_iter_open_container(iter, DBUS_TYPE_VARIANT,
-	                                      "ay", &variant_iter))
+	                                      s, &variant_iter))
 		return false;
 
 	/* Open an array container. */
 	if (!dbus_message_iter_open_container(&variant_iter, DBUS_TYPE_ARRAY,
-	                                      "y", &array_iter))
+	                                      s + 1, &array_iter))
 		goto fail;
 
 	/* Append the supplied data. */
-	if (!dbus_message_iter_append_fixed_array(&array_iter, DBUS_TYPE_BYTE, buf, len)) {
+	if (!dbus_message_iter_append_fixed_array(&array_iter, element_type,
+	                                          buf_ptr, count)) {
 		dbus_message_iter_close_container(&variant_iter, &array_iter);
 		goto fail;
 	}
@@ -293,6 +313,73 @@ fail:
 	return false;
 }
 
+/* Append a variant containing a (yay) struct of a block's tag and data */
+static bool
+method_iter_append_variant_block(DBusMessageIter *iter,
+                                 unsigned char    tag,
+                                 const void      *buf,
+                                 int              len)
+{
+	DBusMessageIter variant_iter, struct_iter, array_iter;
+
+	if (!dbus_message_iter_open_container(iter, DBUS_TYPE_VARIANT,
+	                                      "(yay)", &variant_iter))
+		return false;
+
+	if (!dbus_message_iter_open_container(&variant_iter, DBUS_TYPE_STRUCT,
+	                                      NULL, &struct_iter))
+		goto fail;
+
+	if (!dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_BYTE, &tag)
+	    || !dbus_message_iter_open_container(&struct_iter, DBUS_TYPE_ARRAY,
+	                                         "y", &array_iter))
+		goto fail_struct;
+
+	if (!dbus_message_iter_append_fixed_array(&array_iter, DBUS_TYPE_BYTE,
+	                                          &buf, len)) {
+		dbus_message_iter_close_container(&struct_iter, &array_iter);
+		goto fail_struct;
+	}
+
+	if (!dbus_message_iter_close_container(&struct_iter, &array_iter))
+		goto fail_struct;
+	else if (!dbus_message_iter_close_container(&variant_iter, &struct_iter))
+		goto fail;
+	else if (!dbus_message_iter_close_container(iter, &variant_iter))
+		return false;
+
+	return true;
+
+fail_struct:
+	dbus_message_iter_close_container(&variant_iter, &struct_iter);
+fail:
+	dbus_message_iter_close_container(iter, &variant_iter);
+	return false;
+}
+
+/* Get the D-Bus element type and size of a config array type */
+static int
+method_array_element_type(int  type,
+                          int *size_ptr)
+{
+	switch (type) {
+	case '-':
+		*size_ptr = 1;
+		return DBUS_TYPE_BYTE;
+	case 'D':
+		*size_ptr = sizeof(double);
+		return DBUS_TYPE_DOUBLE;
+	case 'I':
+		*size_ptr = sizeof(int32_t);
+		return DBUS_TYPE_INT32;
+	case 'F':
+		*size_ptr = sizeof(float);
+		return DBUS_TYPE_UINT32;
+	default:
+		return DBUS_TYPE_INVALID;
+	}
+}
+
 bool
 method_iter_append_dict_entry(DBusMessageIter *iter,
                               int              type,
@@ -301,6 +388,7 @@ method_iter_append_dict_entry(DBusMessageIter *iter,
                               int              length)
 {
 	DBusMessageIter dict_iter;
+	int element_type, element_size;
 
 	if (!dbus_message_iter_open_container(iter, DBUS_TYPE_DICT_ENTRY,
 	                                      NULL, &dict_iter))
@@ -309,8 +397,19 @@ method_iter_append_dict_entry(DBusMessageIter *iter,
 	if (!dbus_message_iter_append_basic(&dict_iter, DBUS_TYPE_STRING, &key))
 		goto fail;
 
-	if (type == '-') {
-		if (!method_iter_append_variant_raw(&dict_iter, value, length))
+	if (type == 'B') {
+		const unsigned char *block = *((const unsigned char * const *) value);
+
+		if (length < 1
+		    || !method_iter_append_variant_block(&dict_iter, block[0],
+		                                         block + 1, length - 1))
+			goto fail;
+	} else if ((element_type = method_array_element_type(type, &element_size))
+	           != DBUS_TYPE_INVALID) {
+		if (length % element_size != 0
+		    || !method_iter_append_variant_array(&dict_iter, element_type,
+		                                         value,
+		                                         length / element_size))
 			goto fail;
 	} else if (!method_iter_append_variant(&dict_iter, type, value))
 		goto fail;
@@ -325,6 +424,119 @@ fail:
 	return false;
 }
 
+bool
+method_iter_append_dict_entry_block(DBusMessageIter *iter,
+                                    const char      *key,
+                                    unsigned char    tag,
+                                    const void      *buf,
+                                    int              length)
+{
+	DBusMessageIter dict_iter;
+
+	if (!dbus_message_iter_open_container(iter, DBUS_TYPE_DICT_ENTRY,
+	                                      NULL, &dict_iter))
+		return false;
+
+	if (!dbus_message_iter_append_basic(&dict_iter, DBUS_TYPE_STRING, &key)
+	    || !method_iter_append_variant_block(&dict_iter, tag, buf, length)) {
+		dbus_message_iter_close_container(iter, &dict_iter);
+		return false;
+	}
+
+	return dbus_message_iter_close_container(iter, &dict_iter);
+}
+
+/* Read an unsigned integer member of any width */
+static uint64_t
+method_dict_field_get_integer(const void *ptr,
+                              size_t      size)
+{
+	switch (size) {
+	case sizeof(uint8_t):
+		return *((const uint8_t *) ptr);
+	case sizeof(uint16_t):
+		return *((const uint16_t *) ptr);
+	case sizeof(uint32_t):
+		return *((const uint32_t *) ptr);
+	default:
+		return *((const uint64_t *) ptr);
+	}
+}
+
+bool
+method_iter_append_dict(DBusMessageIter           *iter,
+                        const method_dict_field_t *fields,
+                        const void                *object)
+{
+	DBusMessageIter dict_iter;
+	const method_dict_field_t *field;
+	const void *member;
+	union {
+		const char    *s;
+		dbus_uint32_t  u;
+		dbus_bool_t    b;
+	} value;
+
+	if (!dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
+	                                      "{sv}", &dict_iter))
+		return false;
+
+	for (field = fields; field->key; ++field) {
+		member = (const char *) object + field->offset;
+
+		if (field->type == DBUS_TYPE_STRING) {
+			value.s = *((const char * const *) member);
+			if (!value.s)
+				continue;
+		} else if (field->type == DBUS_TYPE_BOOLEAN) {
+			value.b = method_dict_field_get_integer(member, field->size) != 0;
+			if (!value.b && field->optional)
+				continue;
+		} else {
+			value.u = (dbus_uint32_t) method_dict_field_get_integer(member, field->size);
+			if (!value.u && field->optional)
+				continue;
+		}
+
+		if (!method_iter_append_dict_entry(&dict_iter, field->type,
+		                                   field->key, &value, 0))
+			goto fail;
+	}
+
+	if (!dbus_message_iter_close_container(iter, &dict_iter))
+		return false;
+
+	return true;
+
+fail:
+	dbus_message_iter_close_container(iter, &dict_iter);
+	return false;
+}
+
+bool
+method_iter_append_named_dict(DBusMessageIter           *iter,
+                              const char                *name,
+                              const method_dict_field_t *fields,
+                              const void                *object)
+{
+	DBusMessageIter struct_iter;
+
+	if (!dbus_message_iter_open_container(iter, DBUS_TYPE_STRUCT,
+	                                      NULL, &struct_iter))
+		return false;
+
+	if (!dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &name)
+	    || !method_iter_append_dict(&struct_iter, fields, object)) {
+		dbus_message_iter_close_container(iter, &struct_iter);
+		return false;
+	}
+
+	if (!dbus_message_iter_close_container(iter, &struct_iter))
+		return false;
+
+	return true;
+}
+
 void
 method_default_handler(DBusPendingCall *pending,
                        void            *data)
@@ -529,7 +741,8 @@ method_iter_get_dict_entry(DBusMessageIter  *iter,
                            const char      **key_ptr,
                            void             *value_ptr,
                            int              *type_ptr,
-                           int              *size_ptr)
+                           int              *size_ptr,
+                           unsigned char    *tag_ptr)
 {
 	if (!iter || !key_ptr || !value_ptr || !type_ptr) {
 		lash_error("Invalid arguments");
@@ -568,18 +781,60 @@ method_iter_get_dict_entry(DBusMessageIter  *iter,
 
 	if (*type_ptr == DBUS_TYPE_ARRAY) {
 		DBusMessageIter array_iter;
+		int n, element_size;
+
+		switch (dbus_message_iter_get_element_type(&variant_iter)) {
+		case DBUS_TYPE_BYTE:
+			*type_ptr = '-';
+			break;
+		case DBUS_TYPE_DOUBLE:
+			*type_ptr = 'D';
+			break;
+		case DBUS_TYPE_INT32:
+			*type_ptr = 'I';
+			break;
+		case DBUS_TYPE_UINT32:
+			*type_ptr = 'F';
+			break;
+		default:
+			lash_error("Dict entry value is an array of unsupported type");
+			return false;
+		}
+		method_array_element_type(*type_ptr, &element_size);
+
+		/* The elements are not copied; the pointer refers to the
+		   message, which keeps them aligned */
+		dbus_message_iter_recurse(&variant_iter, &array_iter);
+		dbus_message_iter_get_fixed_array(&array_iter, value_ptr, &n);
+
+		if (size_ptr)
+			*size_ptr = n * element_size;
+	} else if (*type_ptr == DBUS_TYPE_STRUCT) {
+		DBusMessageIter struct_iter, array_iter;
+		unsigned char tag;
 		int n;
 
-		if (dbus_message_iter_get_element_type(&variant_iter)
-		    != DBUS_TYPE_BYTE) {
-			lash_error("Dict entry value is a non-byte array");
+		dbus_message_iter_recurse(&variant_iter, &struct_iter);
+		if (dbus_message_iter_get_arg_type(&struct_iter) != DBUS_TYPE_BYTE) {
+			lash_error("Dict entry value is an unsupported struct");
 			return false;
 		}
-		*type_ptr = '-';
+		dbus_message_iter_get_basic(&struct_iter, &tag);
 
-		dbus_message_iter_recurse(&variant_iter, &array_iter);
+		if (!dbus_message_iter_next(&struct_iter)
+		    || dbus_message_iter_get_arg_type(&struct_iter) != DBUS_TYPE_ARRAY
+		    || dbus_message_iter_get_element_type(&struct_iter)
+		       != DBUS_TYPE_BYTE) {
+			lash_error("Dict entry value is an unsupported struct");
+			return false;
+		}
+		*type_ptr = 'B';
+
+		dbus_message_iter_recurse(&struct_iter, &array_iter);
 		dbus_message_iter_get_fixed_array(&array_iter, value_ptr, &n);
 
+		if (tag_ptr)
+			*tag_ptr = tag;
 		if (size_ptr)
 			*size_ptr = n;
 	} else
@@ -23,6 +23,7 @@
 #define __LASH_DBUS_METHOD_H__
 
 #include <stdbool.h>
+#include <stddef.h>
 #include <dbus/dbus.h>
 
 #include "dbus/types.h"
@@ -63,6 +64,16 @@ struct _method
 	const method_arg_t     *args;
 };
 
+/* A struct member which is appended to an a{sv} dictionary */
+struct _method_dict_field
+{
+	const char *key;
+	int         type;     /* DBUS_TYPE_STRING, DBUS_TYPE_BOOLEAN or DBUS_TYPE_UINT32 */
+	size_t      offset;   /* Offset of the member in the struct */
+	size_t      size;     /* Size of the member, for integer types */
+	bool        optional; /* Omit the entry if the member is NULL or 0 */
+};
+
 void
 method_return_new_void(method_call_t *call);
 
@@ -85,6 +96,12 @@ method_iter_append_variant(DBusMessageIter *iter,
                            int              type,
                            const void      *arg);
 
+/** Append a config as an {sv} dict entry.
+ * Numbers and strings are passed by value in @a value. For raw data and
+ * the 'D', 'F' and 'I' array types @a value points to the pointer to the
+ * data, and for a 'B' block to the pointer to its tag byte followed by
+ * its data. @a length is the size of such data in bytes.
+ */
 bool
 method_iter_append_dict_entry(DBusMessageIter *iter,
                               int              type,
@@ -92,6 +109,16 @@ method_iter_append_dict_entry(DBusMessageIter *iter,
                               const void      *value,
                               int              length);
 
+/** Append a 'B' block config as an {sv} dict entry holding a (yay)
+ * struct of @a tag and the @a length bytes at @a buf.
+ */
+bool
+method_iter_append_dict_entry_block(DBusMessageIter *iter,
+                                    const char      *key,
+                                    unsigned char    tag,
+                                    const void      *buf,
+                                    int              length);
+
 bool
 method_send(method_msg_t *call,
             bool          will_block);
@@ -151,12 +178,39 @@ bool
 method_iter_get_args(DBusMessageIter *iter,
                                       ...);
 
+/** Read a config from an {sv} dict entry.
+ * Arrays and block data are not copied; @a value_ptr receives a pointer
+ * into the message, @a size_ptr their size in bytes, and for a 'B' block
+ * @a tag_ptr its tag. @a size_ptr and @a tag_ptr may be NULL.
+ */
 bool
 method_iter_get_dict_entry(DBusMessageIter  *iter,
                            const char      **key_ptr,
                            void             *value_ptr,
                            int              *type_ptr,
-                           int              *size_ptr);
+                           int              *size_ptr,
+                           unsigned char    *tag_ptr);
+
+/** Append the members of @a object described by @a fields
+ * to a D-Bus message as an a{sv} dictionary.
+ * @param iter Iterator to append the dictionary to.
+ * @param fields Field table declared with METHOD_DICT_BEGIN.
+ * @param object Struct to read the members from.
+ * @return True on success, false if memory ran out.
+ */
+bool
+method_iter_append_dict(DBusMessageIter           *iter,
+                        const method_dict_field_t *fields,
+                        const void                *object);
+
+/** Same as \ref method_iter_append_dict, but append a (sa{sv})
+ * struct in which the dictionary is preceded by @a name.
+ */
+bool
+method_iter_append_named_dict(DBusMessageIter           *iter,
+                              const char                *name,
+                              const method_dict_field_t *fields,
+                              const void                *object);
 
 #define METHOD_ARGS_BEGIN(method_name)                          \
 static const struct _method_arg method_name ## _args_dtor[] =   \
@@ -196,4 +250,28 @@ static const struct _method methods_dtor[] =                    \
         }                                                       \
 };
 
+#define METHOD_DICT_BEGIN(dict_name)                            \
+static const struct _method_dict_field dict_name ## _dict_dtor[] = \
+{
+
+#define METHOD_DICT_FIELD(key_name, dbus_type, struct_type,     \
+                          member, is_optional)                  \
+        {                                                       \
+                .key = key_name,                                \
+                .type = dbus_type,                              \
+                .offset = offsetof(struct_type, member),        \
+                .size = sizeof(((struct_type *) 0)->member),    \
+                .optional = is_optional                         \
+        },
+
+#define METHOD_DICT_END                                         \
+        {                                                       \
+                .key = NULL,                                    \
+                .type = DBUS_TYPE_INVALID,                      \
+                .offset = 0,                                    \
+                .size = 0,                                      \
+                .optional = false                               \
+        }                                                       \
+};
+
 #endif /* __LASH_DBUS_METHOD_H__ */
@@ -38,6 +38,22 @@ static void
 object_path_handler_unregister(DBusConnection *conn,
                                void           *data);
 
+static int
+object_path_interface_compare(const void *a,
+                              const void *b)
+{
+	return strcmp((*(const interface_t * const *) a)->name,
+	              (*(const interface_t * const *) b)->name);
+}
+
+static int
+object_path_interface_compare_name(const void *key,
+                                   const void *iface)
+{
+	return strcmp((const char *) key,
+	              (*(const interface_t * const *) iface)->name);
+}
+
 object_path_t *
 object_path_new(const char *name,
                 void       *context,
@@ -69,6 +85,14 @@ object_path_new(const char *name,
 
 	va_end(argp);
 
+	path->num_interfaces = iface_pptr - path->interfaces;
+	path->sorted_interfaces = lash_malloc(path->num_interfaces,
+	                                      sizeof(interface_t *));
+	memcpy(path->sorted_interfaces, path->interfaces,
+	       path->num_interfaces * sizeof(interface_t *));
+	qsort(path->sorted_interfaces, path->num_interfaces,
+	      sizeof(interface_t *), object_path_interface_compare);
+
 	if ((path->introspection = introspection_new(path))) {
 		path->context = context;
 		return path;
@@ -118,6 +142,10 @@ object_path_destroy(object_path_t *path)
 			free(path->interfaces);
 			path->interfaces = NULL;
 		}
+		if (path->sorted_interfaces) {
+			free(path->sorted_interfaces);
+			path->sorted_interfaces = NULL;
+		}
 		introspection_destroy(path);
 		free(path);
 		path = NULL;
@@ -135,6 +163,7 @@ object_path_handler(DBusConnection *connection,
                     void           *data)
 {
 	const char *interface_name;
+	object_path_t *path = data;
 	const interface_t **iface_pptr;
 	method_call_t call;
 
@@ -159,16 +188,11 @@ object_path_handler(DBusConnection *connection,
 
 	/* Check if there's an interface specified for this method call. */
 	if ((interface_name = dbus_message_get_interface(message))) {
-		for (iface_pptr = (const interface_t **) ((object_path_t *) data)->interfaces;
-		     iface_pptr && *iface_pptr;
-		     ++iface_pptr) {
-			if (strcmp(interface_name, (*iface_pptr)->name) == 0) {
-				if ((*iface_pptr)->handler(*iface_pptr, &call)) {
-					goto send_return;
-				}
-
-				break;
-			}
+		iface_pptr = bsearch(interface_name, path->sorted_interfaces,
+		                     path->num_interfaces, sizeof(interface_t *),
+		                     object_path_interface_compare_name);
+		if (iface_pptr && (*iface_pptr)->handler(*iface_pptr, &call)) {
+			goto send_return;
 		}
 	}
 	else
@@ -178,7 +202,7 @@ object_path_handler(DBusConnection *connection,
 		* omitting the interface must never be rejected.
 		*/
 
-		for (iface_pptr = (const interface_t **) ((object_path_t *) data)->interfaces;
+		for (iface_pptr = path->interfaces;
 		     iface_pptr && *iface_pptr;
 		     ++iface_pptr) {
 			if ((*iface_pptr)->handler(*iface_pptr, &call)) {
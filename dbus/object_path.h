@@ -36,6 +36,8 @@ struct _object_path
 	void               *context;
 	DBusMessage        *introspection;
 	const interface_t **interfaces;
+	const interface_t **sorted_interfaces; /* Sorted by name for lookups */
+	size_t              num_interfaces;
 };
 
 object_path_t *
@@ -30,6 +30,7 @@
 service_t *
 service_new(const char *service_name,
             bool       *quit,
+            bool        is_private,
             int         num_paths,
                         ...)
 {
@@ -52,7 +53,10 @@ service_new(const char *service_name,
 
 	dbus_error_init(&err);
 
-	service->connection = dbus_bus_get(DBUS_BUS_SESSION, &err);
+	service->is_private = is_private;
+	service->connection = (is_private
+	                       ? dbus_bus_get_private(DBUS_BUS_SESSION, &err)
+	                       : dbus_bus_get(DBUS_BUS_SESSION, &err));
 	if (dbus_error_is_set(&err)) {
 		lash_error("Failed to get bus: %s", err.message);
 		goto fail_free_err;
@@ -124,6 +128,8 @@ service_destroy(service_t *service)
 	if (service) {
 		/* cut the bus connection */
 		if (service->connection) {
+			if (service->is_private)
+				dbus_connection_close(service->connection);
 			dbus_connection_unref(service->connection);
 			service->connection = NULL;
 		}
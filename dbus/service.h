@@ -33,11 +33,17 @@ struct _service
 	DBusConnection  *connection;
 	object_path_t  **object_paths;
 	bool            *quit;
+	bool             is_private; /* Connection isn't shared with others */
 };
 
+/* Connect to the session bus and register the given object paths.
+   With is_private the service gets a connection of its own, which is
+   closed when the service is destroyed; otherwise the process's shared
+   connection is used. */
 service_t *
 service_new(const char *service_name,
             bool       *quit,
+            bool        is_private,
             int         num_paths,
                         ...);
 
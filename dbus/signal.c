@@ -27,6 +27,9 @@
 static void
 signal_send(signal_msg_t *signal);
 
+static void
+signal_queue(signal_msg_t *signal);
+
 void
 signal_new_single(service_t  *service,
                   const char *path,
@@ -90,13 +93,54 @@ signal_new_valist (service_t  *service,
 	lash_error("Ran out of memory trying to create new signal");
 }
 
+void
+signal_new_unicast_valist(service_t  *service,
+                          const char *destination,
+                          const char *path,
+                          const char *interface,
+                          const char *name,
+                          int         type,
+                                      ...)
+{
+	signal_msg_t signal;
+	va_list argp;
+
+	lash_debug("Sending signal %s.%s from %s to %s", interface, name,
+	           path, destination);
+
+	if ((signal.message = dbus_message_new_signal(path, interface, name))) {
+		va_start(argp, type);
+		if (!dbus_message_set_destination(signal.message, destination)) {
+			lash_error("Ran out of memory trying to set signal destination");
+		} else if (dbus_message_append_args_valist(signal.message, type, argp)) {
+			signal.connection = service->connection;
+			signal_queue(&signal);
+		} else {
+			lash_error("Ran out of memory trying to append signal argument(s)");
+		}
+		va_end(argp);
+
+		dbus_message_unref(signal.message);
+		signal.message = NULL;
+
+		return;
+	}
+
+	lash_error("Ran out of memory trying to create new signal");
+}
+
 static void
-signal_send(signal_msg_t *signal)
+signal_queue(signal_msg_t *signal)
 {
 	if (!dbus_connection_send(signal->connection, signal->message, NULL)) {
 		lash_error("Ran out of memory trying to queue signal");
 	}
+}
 
+static void
+signal_send(signal_msg_t *signal)
+{
+	signal_queue(signal);
 	dbus_connection_flush(signal->connection);
 }
 
@@ -60,6 +60,21 @@ signal_new_valist(service_t  *service,
                   int         type,
                               ...);
 
+/** Queue a signal addressed to a single connection. Only @a destination
+ * receives it, so the signal doesn't wake up other listeners. The signal is
+ * not flushed, which lets the caller send a batch of them and flush once.
+ * @param service Service to send the signal from.
+ * @param destination Unique or well-known bus name of the recipient.
+ */
+void
+signal_new_unicast_valist(service_t  *service,
+                          const char *destination,
+                          const char *path,
+                          const char *interface,
+                          const char *name,
+                          int         type,
+                                      ...);
+
 #define SIGNAL_ARGS_BEGIN(signal_name)                         \
 static const struct _signal_arg signal_name ## _args_dtor[] =  \
 {
@@ -33,6 +33,7 @@ typedef struct _method_msg  method_msg_t;
 typedef struct _method_call method_call_t;
 typedef struct _method_arg  method_arg_t;
 typedef struct _method      method_t;
+typedef struct _method_dict_field method_dict_field_t;
 typedef void (*method_handler_t) (method_call_t *call);
 
 /* interface types */
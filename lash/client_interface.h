@@ -69,7 +69,8 @@ lash_get_pending_event_count(lash_client_t *client);
 
 /**
  * Retrieve an event.
- * The event must be freed using lash_event_destroy.
+ * The event must be freed using lash_event_destroy, which returns it to
+ * the client for reuse, so do that from the thread which uses the client.
  * Returns NULL if there are no events pending.
  */
 lash_event_t *
@@ -83,7 +84,8 @@ lash_get_pending_config_count(lash_client_t *client);
 
 /**
  * Retrieve a config.
- * The config must be freed using lash_config_destroy.
+ * The config must be freed using lash_config_destroy, which returns it to
+ * the client for reuse, so do that from the thread which uses the client.
  * Returns NULL if there are no configs pending.
  */
 lash_config_t *
@@ -116,10 +116,183 @@ lash_dispatch(lash_client_t *client);
 bool
 lash_dispatch_once(lash_client_t *client);
 
+struct pollfd;
+
+/**
+ * Get the file descriptors which must be watched to keep the client's
+ * connection to the server going, for integrating liblash into an
+ * application's main loop. Call \ref lash_handle_events when poll()
+ * returns or the timeout expires.
+ *
+ * @param client The client.
+ * @param fds Array to fill in with descriptors and the events to wait for.
+ * @param max_fds Size of @a fds.
+ * @param timeout Pointer to the number of milliseconds to wait at most,
+ *        set to -1 if there is nothing to wait for but the descriptors.
+ *        May be NULL.
+ * @return The number of descriptors needed, which may be more than
+ *         @a max_fds, or -1 on failure.
+ */
+int
+lash_get_pollfds(lash_client_t *client,
+                 struct pollfd *fds,
+                 int            max_fds,
+                 int           *timeout);
+
+/**
+ * Handle the events poll() returned for the descriptors from
+ * \ref lash_get_pollfds, run any expired timeouts, and dispatch the
+ * messages which have arrived, calling the client's callbacks.
+ */
+void
+lash_handle_events(lash_client_t       *client,
+                   const struct pollfd *fds,
+                   int                  num_fds);
+
+/**
+ * Get a single descriptor which becomes readable whenever the client
+ * needs attention, for adding to an epoll set, a GLib main loop, or
+ * any other loop which can watch a descriptor. Call
+ * \ref lash_handle_epoll_events when it does.
+ *
+ * @return The descriptor, owned by liblash, or -1 if epoll is not
+ *         supported or creating the descriptor failed.
+ */
+int
+lash_get_epoll_fd(lash_client_t *client);
+
+/**
+ * Handle whatever made the descriptor from \ref lash_get_epoll_fd
+ * readable. Never blocks.
+ */
+void
+lash_handle_epoll_events(lash_client_t *client);
+
+/**
+ * Defer a save. Call this from the SaveDataSet callback to keep writing
+ * the data set through @a config_handle after the callback has returned,
+ * for example on a worker thread. The handle stays valid, and configs
+ * written to it are streamed to the server in chunks as usual, until
+ * \ref lash_save_complete is called. Progress can be reported with
+ * \ref lash_notify_progress meanwhile.
+ *
+ * The callback's return value is ignored once the save is deferred.
+ * Only one save can be deferred at a time; the server is told that
+ * saving failed if another is requested before it completes. A token
+ * which hasn't been completed is freed along with the client.
+ *
+ * @param config_handle The config handle passed to the callback.
+ * @return A token for \ref lash_save_complete, or NULL if
+ *         @a config_handle doesn't belong to a running save callback.
+ */
+lash_save_token_t *
+lash_save_defer(lash_config_handle_t *config_handle);
+
+/**
+ * Finish a deferred save: send the rest of the data set to the server,
+ * or tell the server that saving failed. The token and its config
+ * handle are freed.
+ *
+ * This may be called from any thread. It only hands the token back, and
+ * the save is finished by the thread dispatching the client's messages
+ * the next time it does so; the descriptors from \ref lash_get_pollfds
+ * and \ref lash_get_epoll_fd become readable for that. The token must
+ * not be completed after the client has been closed.
+ *
+ * @param token Token from \ref lash_save_defer.
+ * @param success Whether the data set was written successfully.
+ */
+void
+lash_save_complete(lash_save_token_t *token,
+                   bool               success);
+
+/**
+ * Start a thread which does all of the client's D-Bus input and output.
+ *
+ * Incoming messages are then only dispatched, and callbacks only run,
+ * when the application calls \ref lash_dispatch (or one of the main
+ * loop integration functions), so it can choose a safe point to do so.
+ * \ref lash_notify_progress, \ref lash_jack_client_name and
+ * \ref lash_alsa_client_id only queue their calls for the thread to
+ * send, without allocating or locking, which makes them safe to call
+ * from near a realtime thread. They must not be called from more than
+ * one thread at a time. A call which doesn't fit in the queue is dropped
+ * and counted rather than logged.
+ *
+ * If the thread stops because of an error or a lost connection, the
+ * descriptor returned by \ref lash_get_pollfds or \ref lash_get_epoll_fd
+ * stays readable and \ref lash_dispatch goes back to reading the
+ * connection itself.
+ *
+ * Must be called before \ref lash_get_epoll_fd, if at all.
+ *
+ * @param client The client.
+ * @return True if the thread is running, false otherwise.
+ */
+bool
+lash_start_io_thread(lash_client_t *client);
+
+/**
+ * Report the progress of the task the client is working on.
+ *
+ * Reports are coalesced so that this can be called from a tight loop:
+ * a change is sent at once if it is big enough, and otherwise held back
+ * until the minimum interval set with \ref lash_set_progress_coalescing
+ * has passed. A held back report is sent at the latest when the task
+ * ends. Never blocks.
+ *
+ * Once the interval has passed, a held back report is sent by the I/O
+ * thread if one is running, and otherwise the next time the client's
+ * messages are dispatched. This may be called from any one thread, such
+ * as a worker writing a deferred save; task results are sent separately
+ * by the thread dispatching the client's messages.
+ *
+ * @param client The client.
+ * @param percentage The progress, from 1 to 99.
+ */
 void
 lash_notify_progress(lash_client_t *client,
                      uint8_t        percentage);
 
+/**
+ * Set how \ref lash_notify_progress coalesces progress reports. The
+ * defaults are 5 percentage points and 100 milliseconds.
+ *
+ * @param client The client.
+ * @param step The change in percentage points which is reported at once;
+ *        0 or 1 reports every change.
+ * @param min_interval The time in milliseconds after which a smaller
+ *        change is reported.
+ */
+void
+lash_set_progress_coalescing(lash_client_t *client,
+                             uint8_t        step,
+                             unsigned int   min_interval);
+
+/**
+ * Fetch configs from the client's data set on the server. Blocks until
+ * the server replies. Keys which are not in the data set are skipped.
+ *
+ * @param client The client.
+ * @param keys The keys of the configs to fetch.
+ * @param num_keys The number of keys.
+ * @return A config handle to read the configs from with
+ *         \ref lash_config_read, to be freed with
+ *         \ref lash_config_handle_free, or NULL on failure.
+ */
+lash_config_handle_t *
+lash_get_configs(lash_client_t      *client,
+                 const char * const *keys,
+                 int                 num_keys);
+
+/**
+ * Fetch all configs whose keys begin with @a prefix from the client's
+ * data set on the server. Otherwise the same as \ref lash_get_configs.
+ */
+lash_config_handle_t *
+lash_get_configs_by_prefix(lash_client_t *client,
+                           const char    *prefix);
+
 lash_client_t *
 lash_client_open_controller(void);
 
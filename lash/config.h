@@ -63,6 +63,89 @@ lash_config_write_raw(lash_config_handle_t *handle,
                       const void           *buf,
                       int                   size);
 
+/**
+ * Append a key-value pair of an array of numbers to a config message.
+ *
+ * The array is sent and stored as a single value in the host's byte
+ * order, which is far cheaper than writing each element as a separate
+ * config.
+ *
+ * @param handle An opaque config message handle passed
+ *        to the callback function by liblash.
+ * @param key The key string pointer.
+ * @param type The element type. Must be one out of
+ *        \ref LASH_TYPE_DOUBLE_ARRAY (double), \ref LASH_TYPE_FLOAT_ARRAY
+ *        (float), and \ref LASH_TYPE_INT_ARRAY (int32_t).
+ * @param elements The pointer to the first element.
+ * @param count The number of elements, at least 1.
+ * @return True if writing succeeded, false otherwise.
+ */
+bool
+lash_config_write_array(lash_config_handle_t *handle,
+                        const char           *key,
+                        int                   type,
+                        const void           *elements,
+                        int                   count);
+
+/**
+ * Append a key-value pair of raw data with a type tag to a config message.
+ *
+ * The value has the type \ref LASH_TYPE_BLOCK. The tag is not interpreted
+ * by LASH; clients can use it to tell apart the formats of their blocks,
+ * e.g. a wavetable from a parameter snapshot. Use
+ * \ref lash_config_read_view to read the tag back.
+ *
+ * @param handle An opaque config message handle passed
+ *        to the callback function by liblash.
+ * @param key The key string pointer.
+ * @param tag The type tag.
+ * @param buf The data buffer pointer.
+ * @param size The size of the data buffer in bytes.
+ * @return True if writing succeeded, false otherwise.
+ */
+bool
+lash_config_write_block(lash_config_handle_t *handle,
+                        const char           *key,
+                        unsigned char         tag,
+                        const void           *buf,
+                        int                   size);
+
+/**
+ * Mark a config as changed or removed since the client's last save.
+ *
+ * A client which keeps track of its changes this way can send only
+ * those when it is saved, see \ref lash_config_commit_delta. Call this
+ * from the thread which dispatches the client's callbacks, and not
+ * while a deferred delta save is being written.
+ *
+ * @param client The client.
+ * @param key The key of the config which changed or was removed.
+ */
+void
+lash_config_mark_dirty(lash_client_t *client,
+                       const char    *key);
+
+/**
+ * Turn a save into a delta save.
+ *
+ * Call this from the SaveDataSet callback before writing any configs.
+ * The client then only writes the configs it has changed since its last
+ * save, and the server merges them into the stored data set, leaving
+ * the other configs as they were. Configs marked with
+ * \ref lash_config_mark_dirty which are not written during the save
+ * are removed from the stored data set. The dirty keys are forgotten
+ * once the server has merged the delta. If it fails to, they are kept
+ * and the next save has to send all configs.
+ *
+ * @param config_handle The config handle passed to the callback.
+ * @return True if the save is a delta save, false if configs have
+ *         already been written, @a config_handle doesn't belong to
+ *         a save, or the previous delta hasn't been merged. In that
+ *         case the client should write all configs.
+ */
+bool
+lash_config_commit_delta(lash_config_handle_t *config_handle);
+
 /**
  * Read a key-value pair of data from a config message.
  *
@@ -76,8 +159,14 @@ lash_config_write_raw(lash_config_handle_t *handle,
  *        save the value type.
  * @return If reading succeeds the return value will be equal to the
  *         config value's size in bytes (for strings this includes the
- *         terminating NUL). If no data remains in the message the return
- *         value will 0, and -1 if an error occurred during reading.
+ *         terminating NUL), or for arrays to the number of elements.
+ *         If no data remains in the message the return value will 0,
+ *         and -1 if an error occurred during reading.
+ *
+ * For strings, raw data, arrays and blocks the value pointer points
+ * to the data in the config message, which is not copied and stays
+ * valid until the callback returns. Array elements are suitably
+ * aligned to be accessed in place.
  */
 int
 lash_config_read(lash_config_handle_t  *handle,
@@ -85,6 +174,68 @@ lash_config_read(lash_config_handle_t  *handle,
                  void                  *value_ptr,
                  int                   *type_ptr);
 
+/** A view of a config value returned by \ref lash_config_read_view */
+typedef struct
+{
+	const void    *elements; /**< The value, see \ref lash_config_read */
+	int            count;    /**< Number of elements, bytes for raw data, blocks and strings, and 1 for numbers */
+	unsigned char  tag;      /**< Tag of a \ref LASH_TYPE_BLOCK, otherwise 0 */
+} lash_config_view_t;
+
+/**
+ * Read a key-value pair of data from a config message as a view.
+ *
+ * This works like \ref lash_config_read, but gives all types of values
+ * by pointer and also returns the tag of a block. The number of a
+ * \ref LASH_TYPE_DOUBLE or \ref LASH_TYPE_INTEGER config is only valid
+ * until the next read.
+ *
+ * @param handle An opaque config message handle passed
+ *        to the callback function by liblash.
+ * @param key_ptr A pointer to the memory location in which to
+ *        save the key pointer.
+ * @param view A pointer to the view to fill in.
+ * @param type_ptr A pointer to the memory location in which to
+ *        save the value type.
+ * @return The same as \ref lash_config_read.
+ */
+int
+lash_config_read_view(lash_config_handle_t  *handle,
+                      const char           **key_ptr,
+                      lash_config_view_t    *view,
+                      int                   *type_ptr);
+
+/**
+ * Read the key of the next config from a config message.
+ *
+ * If the client was restored with \ref LASH_Lazy_Data_Set the config
+ * message passed to its LoadDataSet callback contains only keys, and
+ * this is the only way of reading it; the values can then be fetched
+ * with \ref lash_get_configs or \ref lash_get_configs_by_prefix. With
+ * any other config message the value of the config is skipped.
+ *
+ * @param handle An opaque config message handle passed
+ *        to the callback function by liblash.
+ * @param key_ptr A pointer to the memory location in which to
+ *        save the key pointer.
+ * @param type_ptr A pointer to the memory location in which to
+ *        save the value type.
+ * @return The same as \ref lash_config_read.
+ */
+int
+lash_config_read_key(lash_config_handle_t  *handle,
+                     const char           **key_ptr,
+                     int                   *type_ptr);
+
+/**
+ * Free a config handle returned by \ref lash_get_configs or
+ * \ref lash_get_configs_by_prefix.
+ *
+ * @param handle The config handle.
+ */
+void
+lash_config_handle_free(lash_config_handle_t *handle);
+
 /* Begin old API */
 
 #include <stdint.h>
@@ -111,6 +262,10 @@ lash_config_get_value(const lash_config_t *config);
 size_t
 lash_config_get_value_size(const lash_config_t *config);
 
+/* LASH_TYPE_RAW, or the array type set with lash_config_set_value_array */
+int
+lash_config_get_value_type(const lash_config_t *config);
+
 void
 lash_config_set_key(lash_config_t *config,
                     const char    *key);
@@ -153,6 +308,17 @@ void
 lash_config_set_value_string(lash_config_t *config,
                              const char    *value);
 
+/*
+ * Set the value to a copy of an array of count elements. The type is
+ * one of LASH_TYPE_DOUBLE_ARRAY, LASH_TYPE_FLOAT_ARRAY and
+ * LASH_TYPE_INT_ARRAY, see lash_config_write_array.
+ */
+void
+lash_config_set_value_array(lash_config_t *config,
+                            int            type,
+                            const void    *elements,
+                            size_t         count);
+
 /* End old API */
 
 #ifdef __cplusplus
@@ -0,0 +1,47 @@
+/*
+ *   LASH
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __LASH_GLIB_H__
+#define __LASH_GLIB_H__
+
+#include <glib.h>
+#include <lash/lash.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/**
+ * Create a GLib main loop source which dispatches @a client 's
+ * messages as they arrive. The source watches the descriptor from
+ * lash_get_epoll_fd(), so an idle client causes no main loop wakeups.
+ * This is provided by the liblash-glib library (pkg-config package
+ * lash-glib-1.0), which is built when GLib is found.
+ *
+ * @param client The client.
+ * @return A new source to be attached with g_source_attach(),
+ *         or NULL if epoll is not supported.
+ */
+GSource *
+lash_gsource_new(lash_client_t *client);
+
+#ifdef __cplusplus
+}
+#endif
+
+#endif /* __LASH_GLIB_H__ */
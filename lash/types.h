@@ -36,6 +36,12 @@ enum
 	LASH_TYPE_INTEGER = 'u',
 	LASH_TYPE_STRING  = 's',
 	LASH_TYPE_RAW     = '-',
+
+	/* Bulk values, see lash_config_write_array and lash_config_write_block */
+	LASH_TYPE_DOUBLE_ARRAY = 'D',
+	LASH_TYPE_FLOAT_ARRAY  = 'F',
+	LASH_TYPE_INT_ARRAY    = 'I',
+	LASH_TYPE_BLOCK        = 'B',
 };
 
 
@@ -49,7 +55,9 @@ enum LASH_Client_Flag
   LASH_Terminal           =  0x00000010,   /* runs in a terminal */
 
   LASH_No_Start_Server    =  0x00000020,  /* do not attempt to automatically start server */
-  LASH_Restored           =  0x00000040   /* server adds this flag if the client is being restored */
+  LASH_Restored           =  0x00000040,  /* server adds this flag if the client is being restored */
+  LASH_Data_Set_Fd        =  0x00000080,  /* data sets are passed as file descriptors (set by liblash and lashd) */
+  LASH_Lazy_Data_Set      =  0x00000100   /* only send the data set's keys at restore, values are fetched on demand */
 };
 
 
@@ -90,6 +98,10 @@ typedef struct _lash_client lash_client_t;
     parameter of a \ref LashConfigCallback function. */
 typedef struct _lash_config_handle lash_config_handle_t;
 
+/** Handle of a save whose data set the client finishes writing after
+    its \ref LashConfigCallback has returned, see \ref lash_save_defer */
+typedef struct _lash_save_token lash_save_token_t;
+
 /** Client event callback function */
 typedef bool (*LashEventCallback) (void *user_data);
 
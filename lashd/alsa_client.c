@@ -27,6 +27,7 @@
 # include <stdlib.h>
 
 # include "alsa_patch.h"
+# include "patch_snapshot.h"
 # include "common/safety.h"
 # include "common/debug.h"
 
@@ -36,12 +37,13 @@ alsa_client_init(alsa_client_t * client)
 	client->client_id = 0;
 	INIT_LIST_HEAD(&client->patches);
 	INIT_LIST_HEAD(&client->old_patches);
-	INIT_LIST_HEAD(&client->backup_patches);
+	client->backup_patches = NULL;
+	client->patches_changed = 0;
 
 	uuid_clear(client->id);
 }
 
-static void
+void
 alsa_client_free_patch_list(struct list_head * list)
 {
 	struct list_head *node, *next;
@@ -61,10 +63,18 @@ alsa_client_free_patches(alsa_client_t * client)
 void
 alsa_client_free_backup_patches(alsa_client_t * client)
 {
-	if (list_empty(&client->backup_patches))
-		return;
+	patch_snapshot_unref(client->backup_patches);
+	client->backup_patches = NULL;
+}
 
-	alsa_client_free_patch_list(&client->backup_patches);
+/* the contents of patches are moved into the new backup */
+void
+alsa_client_set_backup_patches(alsa_client_t * client, struct list_head * patches)
+{
+	patch_snapshot_unref(client->backup_patches);
+	client->backup_patches =
+		patch_snapshot_new(patches, alsa_client_free_patch_list,
+		                   alsa_client_dup_patch_list);
 }
 
 static void
@@ -111,17 +121,23 @@ alsa_client_set_client_id(alsa_client_t * client, unsigned char id)
 }
 
 void
-alsa_client_dup_patches(const alsa_client_t * client, struct list_head * dest)
+alsa_client_dup_patch_list(struct list_head * src, struct list_head * dest)
 {
 	struct list_head *node;
 	alsa_patch_t *patch;
 
-	list_for_each (node, &client->patches) {
+	list_for_each (node, src) {
 		patch = alsa_patch_dup(list_entry(node, alsa_patch_t, siblings));
 		list_add_tail(&patch->siblings, dest);
 	}
 }
 
+void
+alsa_client_dup_patches(const alsa_client_t * client, struct list_head * dest)
+{
+	alsa_client_dup_patch_list((struct list_head *) &client->patches, dest);
+}
+
 struct list_head *
 alsa_client_get_patches(alsa_client_t * client)
 {
@@ -37,7 +37,8 @@ struct _alsa_client
   uuid_t          id;
   struct list_head patches;
   struct list_head old_patches;
-  struct list_head backup_patches;
+  patch_snapshot_t * backup_patches;  /* last known patches, or NULL */
+  int             patches_changed;    /* patches differ from the backup */
 };
 
 alsa_client_t * alsa_client_new ();
@@ -47,6 +48,9 @@ void alsa_client_set_id          (alsa_client_t * client, uuid_t id);
 void alsa_client_set_client_id   (alsa_client_t * client, unsigned char client_id);
 
 void               alsa_client_dup_patches     (const alsa_client_t * client, struct list_head * dest);
+void               alsa_client_dup_patch_list  (struct list_head * src, struct list_head * dest);
+void               alsa_client_free_patch_list (struct list_head * list);
+void               alsa_client_set_backup_patches (alsa_client_t * client, struct list_head * patches);
 struct list_head * alsa_client_get_patches     (alsa_client_t * client);
 unsigned char alsa_client_get_client_id   (const alsa_client_t * client);
 void          alsa_client_get_id          (const alsa_client_t * client, uuid_t id);
@@ -19,6 +19,7 @@
  */
 
 #include "alsa_mgr.h"
+#include "stats.h"
 
 #ifdef HAVE_ALSA
 
@@ -27,18 +28,24 @@
 # include <string.h>
 # include <errno.h>
 # include <sys/poll.h>
-# include <time.h>
 # include <alloca.h>
 
 # include "alsa_client.h"
 # include "alsa_patch.h"
 # include "alsa_fport.h"
+# include "patch_snapshot.h"
 # include "common/safety.h"
 # include "common/debug.h"
 
-# define BACKUP_TIMEOUT ((time_t)(30))
+/* how long to wait for more sequencer events before backing up patches */
+# define EVENT_COALESCE_MSEC 20
+
+/* most sequencer events handled before the patches are backed up */
+# define EVENT_BATCH_SIZE 64
 
 static void *alsa_mgr_event_run(void *data);
+static void alsa_mgr_redo_client_patches(alsa_mgr_t * alsa_mgr,
+                                         alsa_client_t * client);
 static void alsa_mgr_new_client_port(alsa_mgr_t * alsa_mgr, uuid_t client_id,
 									 unsigned char port);
 
@@ -210,6 +217,48 @@ alsa_mgr_check_client_fports(alsa_mgr_t * alsa_mgr, uuid_t client_id)
 	lash_debug("end");
 }
 
+/* backups refer to other clients by uuid, so the ones which mention a
+   client must be redone when it comes or goes */
+static void
+alsa_mgr_invalidate_backups(alsa_mgr_t * alsa_mgr, unsigned char alsa_client_id)
+{
+	struct list_head *node, *node2;
+	alsa_client_t *client;
+	alsa_patch_t *patch;
+
+	list_for_each (node, &alsa_mgr->clients) {
+		client = list_entry(node, alsa_client_t, siblings);
+
+		list_for_each (node2, &client->patches) {
+			patch = list_entry(node2, alsa_patch_t, siblings);
+
+			if (alsa_patch_get_src_client(patch) == alsa_client_id
+			    || alsa_patch_get_dest_client(patch) == alsa_client_id) {
+				client->patches_changed = 1;
+				break;
+			}
+		}
+	}
+}
+
+/* replace the client's backup with its current patches */
+static void
+alsa_mgr_backup_client_patches(alsa_mgr_t * alsa_mgr, alsa_client_t * client)
+{
+	struct list_head *node;
+
+	LIST_HEAD(patches);
+
+	alsa_client_dup_patches(client, &patches);
+
+	list_for_each (node, &patches)
+		alsa_patch_set(list_entry(node, alsa_patch_t, siblings),
+		               &alsa_mgr->clients);
+
+	alsa_client_set_backup_patches(client, &patches);
+	client->patches_changed = 0;
+}
+
 void
 alsa_mgr_add_client(alsa_mgr_t * alsa_mgr, uuid_t id,
                     unsigned char alsa_client_id, struct list_head * alsa_patches)
@@ -224,6 +273,10 @@ alsa_mgr_add_client(alsa_mgr_t * alsa_mgr, uuid_t id,
 	list_splice_init(alsa_patches, &client->old_patches);
 
 	list_add_tail(&client->siblings, &alsa_mgr->clients);
+	alsa_mgr_invalidate_backups(alsa_mgr, alsa_client_id);
+
+	/* from here on the client's subscriptions are tracked from events */
+	alsa_mgr_redo_client_patches(alsa_mgr, client);
 
 # ifdef LASH_DEBUG
 	{
@@ -258,44 +311,31 @@ alsa_mgr_remove_client(alsa_mgr_t * alsa_mgr, uuid_t id,
 	lash_debug("removed client with alsa client id %d",
 	           client->client_id);
 
-	if (backup_patches)
-		list_splice(&client->backup_patches, backup_patches);
+	alsa_mgr_invalidate_backups(alsa_mgr, client->client_id);
+
+	if (backup_patches) {
+		patch_snapshot_release(client->backup_patches, backup_patches);
+		client->backup_patches = NULL;
+	}
 
 	alsa_client_destroy(client);
 }
 
-void
-alsa_mgr_get_client_patches(alsa_mgr_t * alsa_mgr, uuid_t id, struct list_head * dest)
+patch_snapshot_t *
+alsa_mgr_get_client_patches(alsa_mgr_t * alsa_mgr, uuid_t id)
 {
 	alsa_client_t *client;
-	struct list_head *node, *next, *node2;
-	alsa_patch_t *patch;
-
-	LIST_HEAD(patches);
 
 	client = alsa_mgr_get_client(alsa_mgr, id);
 	if (!client) {
 		lash_debug("couldn't get patches for unknown unknown client");
-		return;
+		return NULL;
 	}
 
-	alsa_client_dup_patches(client, &patches);
+	if (client->patches_changed)
+		alsa_mgr_backup_client_patches(alsa_mgr, client);
 
-	list_for_each_safe (node, next, &patches) {
-		patch = list_entry(node, alsa_patch_t, siblings);
-		alsa_patch_set(patch, &alsa_mgr->clients);
-
-		list_for_each (node2, dest) {
-			if (alsa_patch_compare(patch, list_entry(node2, alsa_patch_t, siblings)) == 0) {
-				alsa_patch_destroy(patch);
-				goto loop;
-			}
-		}
-
-		list_add_tail(&patch->siblings, dest);
-	loop:
-		continue; /* fix "label at end of compound statement" */
-	}
+	return patch_snapshot_ref(client->backup_patches);
 }
 
 static int
@@ -426,7 +466,7 @@ alsa_mgr_port_removed(alsa_mgr_t * alsa_mgr, unsigned char client,
 	}
 }
 
-void
+static void
 alsa_mgr_get_alsa_patches_with_port(alsa_mgr_t * alsa_mgr,
 									alsa_client_t * client,
 									snd_seq_port_info_t * port_info, int type)
@@ -452,7 +492,7 @@ alsa_mgr_get_alsa_patches_with_port(alsa_mgr_t * alsa_mgr,
 	}
 }
 
-void
+static void
 alsa_mgr_redo_client_patches(alsa_mgr_t * alsa_mgr, alsa_client_t * client)
 {
 	snd_seq_port_info_t *port_info;
@@ -492,90 +532,236 @@ alsa_mgr_redo_client_patches(alsa_mgr_t * alsa_mgr, alsa_client_t * client)
 # endif
 }
 
-void
-alsa_mgr_redo_patches(alsa_mgr_t * alsa_mgr)
+static alsa_client_t *
+alsa_mgr_get_client_by_alsa_id(alsa_mgr_t * alsa_mgr, unsigned char alsa_id)
 {
 	struct list_head *node;
 	alsa_client_t *client;
 
-	lash_debug("start");
-
 	list_for_each (node, &alsa_mgr->clients) {
-		lash_debug("node: %p", (void *)node);
 		client = list_entry(node, alsa_client_t, siblings);
 
-		alsa_client_free_patches(client);
-		INIT_LIST_HEAD(&client->patches);
-		alsa_mgr_redo_client_patches(alsa_mgr, client);
+		if (alsa_client_get_client_id(client) == alsa_id)
+			return client;
 	}
-	lash_debug("end");
+
+	return NULL;
+}
+
+static int
+alsa_mgr_addr_equal(const snd_seq_addr_t * a, const snd_seq_addr_t * b)
+{
+	return a->client == b->client && a->port == b->port;
+}
+
+/* remove the client's patches matching sender and dest; a NULL address
+   matches any. returns the number of patches removed */
+static int
+alsa_mgr_client_remove_patches(alsa_client_t * client,
+                               const snd_seq_addr_t * sender,
+                               const snd_seq_addr_t * dest)
+{
+	struct list_head *node, *next;
+	alsa_patch_t *patch;
+	const snd_seq_port_subscribe_t *sub;
+	int removed = 0;
+
+	list_for_each_safe (node, next, &client->patches) {
+		patch = list_entry(node, alsa_patch_t, siblings);
+		sub = patch->sub;
+
+		if ((sender && !alsa_mgr_addr_equal(sender, snd_seq_port_subscribe_get_sender(sub)))
+		    || (dest && !alsa_mgr_addr_equal(dest, snd_seq_port_subscribe_get_dest(sub))))
+			continue;
+
+		list_del(&patch->siblings);
+		alsa_patch_destroy(patch);
+		++removed;
+	}
+
+	return removed;
 }
 
 static void
-alsa_mgr_backup_patches(alsa_mgr_t * alsa_mgr)
+alsa_mgr_client_add_patch(alsa_client_t * client,
+                          const snd_seq_port_subscribe_t * sub)
 {
-	static time_t last_backup = 0;
-	time_t now;
-	struct list_head *node, *node2;
-	alsa_client_t *client;
+	struct list_head *node;
+	alsa_patch_t *patch;
 
-	now = time(NULL);
+	patch = alsa_patch_new_with_sub(sub);
 
-	if (now - last_backup < BACKUP_TIMEOUT)
-		return;
+	list_for_each (node, &client->patches) {
+		if (alsa_patch_compare(patch, list_entry(node, alsa_patch_t, siblings)) == 0) {
+			alsa_patch_destroy(patch);
+			return;
+		}
+	}
+
+	list_add_tail(&patch->siblings, &client->patches);
+	client->patches_changed = 1;
+
+	lash_debug("added alsa patch %s for client with alsa client id %d",
+	           alsa_patch_get_desc(patch), client->client_id);
+}
+
+/* update the patches of the clients at either end of a subscription
+   instead of rescanning every port of every client */
+static int
+alsa_mgr_subscription_changed(alsa_mgr_t * alsa_mgr,
+                              const snd_seq_connect_t * connect,
+                              int subscribed)
+{
+	alsa_client_t *clients[2];
+	snd_seq_port_subscribe_t *sub;
+	int i;
+
+	clients[0] = alsa_mgr_get_client_by_alsa_id(alsa_mgr, connect->sender.client);
+	clients[1] = alsa_mgr_get_client_by_alsa_id(alsa_mgr, connect->dest.client);
+	if (clients[1] == clients[0])
+		clients[1] = NULL;
+
+	if (!clients[0] && !clients[1])
+		return 0;
+
+	if (!subscribed) {
+		for (i = 0; i < 2; i++)
+			if (clients[i] && alsa_mgr_client_remove_patches(clients[i],
+			                                                 &connect->sender,
+			                                                 &connect->dest))
+				clients[i]->patches_changed = 1;
+		return 1;
+	}
+
+	/* the event doesn't carry the subscription's parameters */
+	snd_seq_port_subscribe_alloca(&sub);
+	snd_seq_port_subscribe_set_sender(sub, &connect->sender);
+	snd_seq_port_subscribe_set_dest(sub, &connect->dest);
+	if (snd_seq_get_port_subscription(alsa_mgr->seq, sub) < 0) {
+		lash_debug("subscription %d:%d -> %d:%d is already gone",
+		           connect->sender.client, connect->sender.port,
+		           connect->dest.client, connect->dest.port);
+		return 0;
+	}
+
+	for (i = 0; i < 2; i++)
+		if (clients[i])
+			alsa_mgr_client_add_patch(clients[i], sub);
+
+	return 1;
+}
+
+/* drop the patches of a port which has gone away, in case its
+   unsubscription events haven't been seen */
+static int
+alsa_mgr_client_port_exited(alsa_mgr_t * alsa_mgr, const snd_seq_addr_t * addr)
+{
+	struct list_head *node;
+	alsa_client_t *client;
+	int changed = 0;
 
 	list_for_each (node, &alsa_mgr->clients) {
 		client = list_entry(node, alsa_client_t, siblings);
 
-		alsa_client_free_backup_patches(client);
-		INIT_LIST_HEAD(&client->backup_patches);
-		alsa_client_dup_patches(client, &client->backup_patches);
-
-		list_for_each (node2, &client->backup_patches)
-			alsa_patch_set(list_entry(node2, alsa_patch_t, siblings),
-			               &alsa_mgr->clients);
+		if (alsa_mgr_client_remove_patches(client, addr, NULL)
+		    + alsa_mgr_client_remove_patches(client, NULL, addr)) {
+			client->patches_changed = 1;
+			changed = 1;
+		}
 	}
 
-	last_backup = now;
+	return changed;
 }
 
 static void
-alsa_mgr_receive_event(alsa_mgr_t * alsa_mgr)
+alsa_mgr_backup_patches(alsa_mgr_t * alsa_mgr)
 {
-	snd_seq_event_t *ev;
-	int err, backup;
+	struct list_head *node;
+	alsa_client_t *client;
 
-	err = snd_seq_event_input(alsa_mgr->seq, &ev);
-	if (err < 0)
-		return;
+	/* only clients whose patches have changed get a new snapshot */
+	list_for_each (node, &alsa_mgr->clients) {
+		client = list_entry(node, alsa_client_t, siblings);
 
-	pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
-	alsa_mgr_lock(alsa_mgr);
+		if (client->patches_changed)
+			alsa_mgr_backup_client_patches(alsa_mgr, client);
+	}
+}
+
+/* returns non-zero if the event may have changed any patches */
+static int
+alsa_mgr_handle_event(alsa_mgr_t * alsa_mgr, snd_seq_event_t * ev)
+{
+	stats_count(STATS_ALSA_EVENTS);
 
-	backup = 1;
 	switch (ev->type) {
 	case SND_SEQ_EVENT_PORT_START:
 		lash_debug("new port");
 		alsa_mgr_new_port(alsa_mgr, ev->data.addr.client, ev->data.addr.port);
-		break;
+		return 1;
 	case SND_SEQ_EVENT_PORT_EXIT:
 		alsa_mgr_port_removed(alsa_mgr, ev->data.addr.client,
 							  ev->data.addr.port);
-		break;
+		return alsa_mgr_client_port_exited(alsa_mgr, &ev->data.addr);
 	case SND_SEQ_EVENT_PORT_SUBSCRIBED:
+		return alsa_mgr_subscription_changed(alsa_mgr, &ev->data.connect, 1);
 	case SND_SEQ_EVENT_PORT_UNSUBSCRIBED:
-		alsa_mgr_redo_patches(alsa_mgr);
-		break;
+		return alsa_mgr_subscription_changed(alsa_mgr, &ev->data.connect, 0);
 	default:
-		backup = 0;
 		lash_debug("unhandled ev->type=%u", ev->type);
-		break;
+		return 0;
 	}
-	if (backup)
-		alsa_mgr_backup_patches(alsa_mgr);
+}
+
+/* wait up to msec milliseconds for another event; returns non-zero if
+   one is ready to be read */
+static int
+alsa_mgr_wait_event(alsa_mgr_t * alsa_mgr, int msec)
+{
+	struct pollfd *pfds;
+	int count;
+
+	if (snd_seq_event_input_pending(alsa_mgr->seq, 0) > 0)
+		return 1;
+
+	count = snd_seq_poll_descriptors_count(alsa_mgr->seq, POLLIN);
+	pfds = alloca(sizeof(struct pollfd) * count);
+	snd_seq_poll_descriptors(alsa_mgr->seq, pfds, count, POLLIN);
+
+	return poll(pfds, count, msec) > 0;
+}
+
+/* handle a burst of up to EVENT_BATCH_SIZE events, then back up the
+   patches once; a longer burst is handled in several batches */
+static void
+alsa_mgr_receive_events(alsa_mgr_t * alsa_mgr)
+{
+	snd_seq_event_t *ev;
+	int err, changed = 0, count = 0;
 
-	alsa_mgr_unlock(alsa_mgr);
-	pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+	err = snd_seq_event_input(alsa_mgr->seq, &ev);
+
+	while (err >= 0) {
+		pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+		alsa_mgr_lock(alsa_mgr);
+		changed |= alsa_mgr_handle_event(alsa_mgr, ev);
+		alsa_mgr_unlock(alsa_mgr);
+		pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+
+		if (++count == EVENT_BATCH_SIZE
+		    || !alsa_mgr_wait_event(alsa_mgr, EVENT_COALESCE_MSEC))
+			break;
+
+		err = snd_seq_event_input(alsa_mgr->seq, &ev);
+	}
+
+	if (changed) {
+		pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, NULL);
+		alsa_mgr_lock(alsa_mgr);
+		alsa_mgr_backup_patches(alsa_mgr);
+		alsa_mgr_unlock(alsa_mgr);
+		pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, NULL);
+	}
 }
 
 static void *
@@ -584,7 +770,7 @@ alsa_mgr_event_run(void *data)
 	alsa_mgr_t *alsa_mgr = (alsa_mgr_t *)data;
 
 	while (1)
-		alsa_mgr_receive_event(alsa_mgr);
+		alsa_mgr_receive_events(alsa_mgr);
 
 	lash_debug("finished");
 	return NULL;
@@ -53,8 +53,10 @@ void         alsa_mgr_add_client         (alsa_mgr_t * alsa_mgr,
                                           struct list_head * alsa_patches);
 void         alsa_mgr_remove_client      (alsa_mgr_t * alsa_mgr, uuid_t id,
                                           struct list_head * backup_patches);
-void         alsa_mgr_get_client_patches (alsa_mgr_t * alsa_mgr, uuid_t id,
-                                          struct list_head * dest);
+/* returns a reference to the client's patch snapshot, rebuilt first if
+   the patches have changed; release it with patch_snapshot_unref and copy
+   it before modifying the patches.  caller must hold the lock */
+patch_snapshot_t * alsa_mgr_get_client_patches (alsa_mgr_t * alsa_mgr, uuid_t id);
 
 void alsa_mgr_lock (alsa_mgr_t * alsa_mgr);
 void alsa_mgr_unlock (alsa_mgr_t * alsa_mgr);
@@ -528,4 +528,20 @@ alsa_patch_compare(alsa_patch_t * a, alsa_patch_t * b)
 	return 0;
 }
 
+int
+alsa_patch_list_compare(struct list_head * a, struct list_head * b)
+{
+	struct list_head *node_a, *node_b;
+
+	for (node_a = a->next, node_b = b->next;
+	     node_a != a && node_b != b;
+	     node_a = node_a->next, node_b = node_b->next) {
+		if (alsa_patch_compare(list_entry(node_a, alsa_patch_t, siblings),
+		                       list_entry(node_b, alsa_patch_t, siblings)) != 0)
+			return 1;
+	}
+
+	return (node_a == a && node_b == b) ? 0 : 1;
+}
+
 #endif /* HAVE_ALSA */
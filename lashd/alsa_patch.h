@@ -65,6 +65,9 @@ const snd_seq_port_subscribe_t * query_to_sub (const snd_seq_query_subscribe_t *
 /* this isn't ordered; 0 == same; 1 == different */
 int  alsa_patch_compare (alsa_patch_t * a, alsa_patch_t * b);
 
+/* compares element by element; 0 == same; 1 == different */
+int  alsa_patch_list_compare (struct list_head * a, struct list_head * b);
+
 void alsa_patch_switch_clients (alsa_patch_t * patch);
 
 void alsa_patch_create_xml (alsa_patch_t * patch, xmlNodePtr parent);
@@ -44,6 +44,7 @@ client_new(void)
 
 	client = lash_calloc(1, sizeof(struct lash_client));
 
+	INIT_LIST_HEAD(&client->siblings_pid);
 	INIT_LIST_HEAD(&client->jack_patches);
 	INIT_LIST_HEAD(&client->alsa_patches);
 	INIT_LIST_HEAD(&client->dependencies);
@@ -56,6 +57,8 @@ void
 client_destroy(struct lash_client *client)
 {
 	if (client) {
+		watchdog_client_reset(client);
+		list_del(&client->siblings_pid);
 		lash_free(&client->name);
 		lash_free(&client->jack_client_name);
 		lash_free(&client->class);
@@ -78,6 +81,8 @@ client_disconnected(struct lash_client *client)
 
 	lash_debug("Client '%s' disconnected", client_get_identity(client));
 
+	watchdog_client_reset(client);
+
 	list_del(&client->siblings);
 
 	if (client->project) {
@@ -228,6 +233,7 @@ end:
 	client->pending_task = 0;
 	client->task_type = 0;
 	client->task_progress = 0;
+	client->streaming_data_set = false;
 }
 
 void
@@ -398,6 +404,7 @@ client_resume_project(struct lash_client *client)
 
 	/* Unlink client from project's lost_clients list */
 	list_del(&client->siblings);
+	client->lost = false;
 
 	stateless_client = false;
 
@@ -34,10 +34,12 @@
 #include "lash/types.h"
 
 #include "types.h"
+#include "watchdog.h"
 
 struct lash_client
 {
 	struct list_head        siblings;
+	struct list_head        siblings_pid; /* link in the server's PID index */
 
 	uuid_t                  id;
 	char                    id_str[37];
@@ -56,6 +58,7 @@ struct lash_client
 	dbus_uint64_t           pending_task;
 	enum LASH_Event_Type    task_type;
 	uint8_t                 task_progress;
+	bool                    streaming_data_set; /* data set is arriving in chunks */
 
 	char                   *jack_client_name;
 	struct list_head        jack_patches;
@@ -66,6 +69,9 @@ struct lash_client
 	struct list_head        unsatisfied_deps;
 
 	project_t              *project;
+	bool                    lost; /* in project->lost_clients rather than project->clients */
+
+	struct _watchdog        watchdog;
 };
 
 enum
@@ -73,6 +79,10 @@ enum
 	LASH_Saved = 0x01000000  /* Client has been saved */
 };
 
+/* Flags which describe the client's connection rather than the client,
+   and are taken from the connection when a client is resumed */
+#define CLIENT_CONNECTION_FLAGS      (LASH_Data_Set_Fd | LASH_Lazy_Data_Set)
+
 #define CLIENT_CONFIG_DATA_SET(x)    (((x)->flags) & LASH_Config_Data_Set)
 #define CLIENT_CONFIG_FILE(x)        (((x)->flags) & LASH_Config_File)
 #define CLIENT_HAS_INTERNAL_STATE(x) (((x)->flags) & (LASH_Config_Data_Set | LASH_Config_File))
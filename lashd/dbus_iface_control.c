@@ -21,6 +21,8 @@
 
 #include "config.h"
 
+#include <string.h>
+
 #include "common/safety.h"
 #include "common/debug.h"
 #include "common/klist.h"
@@ -29,96 +31,256 @@
 #include "dbus/error.h"
 
 #include "server.h"
+#include "journal.h"
 #include "project.h"
 #include "client.h"
 #include "client_dependency.h"
+#include "scene.h"
 #include "appdb.h"
+#include "dbus_iface_stats.h"
 
 #define INTERFACE_NAME "org.nongnu.LASH.Control"
 
-static bool
-maybe_add_dict_entry_string(DBusMessageIter *dict_iter_ptr,
-                            const char      *key,
-                            const char      *value)
+/* Dictionaries of project and application properties */
+
+METHOD_DICT_BEGIN(ProjectAvailable)
+  METHOD_DICT_FIELD("Description", DBUS_TYPE_STRING, project_t, description, true)
+  METHOD_DICT_FIELD("Modification Time", DBUS_TYPE_UINT32, project_t, last_modify_time, true)
+METHOD_DICT_END
+
+METHOD_DICT_BEGIN(ProjectProperties)
+  METHOD_DICT_FIELD("Description", DBUS_TYPE_STRING, project_t, description, true)
+  METHOD_DICT_FIELD("Notes", DBUS_TYPE_STRING, project_t, notes, true)
+  METHOD_DICT_FIELD("Modified Status", DBUS_TYPE_BOOLEAN, project_t, modified_status, false)
+METHOD_DICT_END
+
+METHOD_DICT_BEGIN(Application)
+  METHOD_DICT_FIELD("GenericName", DBUS_TYPE_STRING, struct lash_appdb_entry, generic_name, true)
+  METHOD_DICT_FIELD("Comment", DBUS_TYPE_STRING, struct lash_appdb_entry, comment, true)
+  METHOD_DICT_FIELD("Icon", DBUS_TYPE_STRING, struct lash_appdb_entry, icon, true)
+METHOD_DICT_END
+
+static void
+lashd_dbus_projects_get_available(method_call_t *call)
 {
-	DBusMessageIter dict_entry_iter;
+	DBusMessageIter iter, array_iter;
+	struct list_head * node_ptr;
+	project_t * project_ptr;
 
-	if (!value)
-		return true;
+	call->reply = dbus_message_new_method_return(call->message);
+	if (!call->reply)
+		goto fail;
 
-	if (!dbus_message_iter_open_container(dict_iter_ptr, DBUS_TYPE_DICT_ENTRY, NULL, &dict_entry_iter))
-		return false;
+	dbus_message_iter_init_append(call->reply, &iter);
 
-	if (!dbus_message_iter_append_basic(&dict_entry_iter, DBUS_TYPE_STRING, (const void *) &key)) {
-		dbus_message_iter_close_container(dict_iter_ptr, &dict_entry_iter);
-		return false;
+	if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "(sa{sv})", &array_iter))
+		goto fail_unref;
+
+	list_for_each (node_ptr, &g_server->all_projects) {
+		project_ptr = list_entry(node_ptr, project_t, siblings_all);
+
+		if (!method_iter_append_named_dict(&array_iter, project_ptr->name,
+		                                   ProjectAvailable_dict_dtor,
+		                                   project_ptr)) {
+			dbus_message_iter_close_container(&iter, &array_iter);
+			goto fail_unref;
+		}
 	}
 
-	method_iter_append_variant(&dict_entry_iter, DBUS_TYPE_STRING, &value);
+	if (!dbus_message_iter_close_container(&iter, &array_iter))
+		goto fail_unref;
 
-	if (!dbus_message_iter_close_container(dict_iter_ptr, &dict_entry_iter))
-		return false;
+	return;
 
-	return true;
+fail_unref:
+	dbus_message_unref(call->reply);
+	call->reply = NULL;
+
+fail:
+	lash_error("Ran out of memory trying to construct method return");
 }
 
-static bool
-add_dict_entry_uint32(
-	DBusMessageIter * dict_iter_ptr,
-	const char * key,
-	dbus_uint32_t value)
+/* A paged and filtered ProjectsGetAvailable. If known_generation equals
+   the current generation of the projects list nothing has changed since
+   the caller's previous query, and an empty page is returned */
+static void
+lashd_dbus_projects_query(method_call_t *call)
 {
-	DBusMessageIter dict_entry_iter;
+	DBusMessageIter iter, array_iter;
+	DBusError err;
+	dbus_uint64_t known_generation;
+	const char *filter, *order_name;
+	dbus_uint32_t offset, limit, total = 0;
+	project_t **projects = NULL;
+	size_t num_projects = 0, i;
+	int order;
 
-	if (!value)
-		return true;
+	dbus_error_init(&err);
 
-	if (!dbus_message_iter_open_container(dict_iter_ptr, DBUS_TYPE_DICT_ENTRY, NULL, &dict_entry_iter))
-		return false;
+	if (!dbus_message_get_args(call->message, &err,
+	                           DBUS_TYPE_UINT64, &known_generation,
+	                           DBUS_TYPE_STRING, &filter,
+	                           DBUS_TYPE_STRING, &order_name,
+	                           DBUS_TYPE_UINT32, &offset,
+	                           DBUS_TYPE_UINT32, &limit,
+	                           DBUS_TYPE_INVALID)) {
+		lash_dbus_error(call, LASH_DBUS_ERROR_INVALID_ARGS,
+		                "Invalid arguments to method \"%s\": %s",
+		                call->method_name, err.message);
+		dbus_error_free(&err);
+		return;
+	}
 
-	if (!dbus_message_iter_append_basic(&dict_entry_iter, DBUS_TYPE_STRING, (const void *) &key)) {
-		dbus_message_iter_close_container(dict_iter_ptr, &dict_entry_iter);
-		return false;
+	if (strcmp(order_name, "name") == 0)
+		order = SERVER_PROJECTS_BY_NAME;
+	else if (strcmp(order_name, "mtime") == 0)
+		order = SERVER_PROJECTS_BY_MTIME;
+	else {
+		lash_dbus_error(call, LASH_DBUS_ERROR_INVALID_ARGS,
+		                "Invalid arguments to method \"%s\": "
+		                "Unknown sort order \"%s\"",
+		                call->method_name, order_name);
+		return;
 	}
 
-	method_iter_append_variant(&dict_entry_iter, DBUS_TYPE_UINT32, &value);
+	if (known_generation != g_server->projects_generation)
+		projects = server_get_sorted_projects(order, &num_projects);
 
-	if (!dbus_message_iter_close_container(dict_iter_ptr, &dict_entry_iter))
-		return false;
+	call->reply = dbus_message_new_method_return(call->message);
+	if (!call->reply)
+		goto fail;
 
-	return true;
+	dbus_message_iter_init_append(call->reply, &iter);
+
+	if (!dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT64,
+	                                    &g_server->projects_generation))
+		goto fail_unref;
+
+	if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "(sa{sv})", &array_iter))
+		goto fail_unref;
+
+	for (i = 0; i < num_projects; ++i) {
+		if (!server_project_matches(projects[i], filter))
+			continue;
+
+		/* Only the page is serialised, the rest are just counted */
+		if (total++ < offset || (limit && total > offset + limit))
+			continue;
+
+		if (!method_iter_append_named_dict(&array_iter, projects[i]->name,
+		                                   ProjectAvailable_dict_dtor,
+		                                   projects[i])) {
+			dbus_message_iter_close_container(&iter, &array_iter);
+			goto fail_unref;
+		}
+	}
+
+	if (!dbus_message_iter_close_container(&iter, &array_iter))
+		goto fail_unref;
+
+	if (!dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT32, &total))
+		goto fail_unref;
+
+	return;
+
+fail_unref:
+	dbus_message_unref(call->reply);
+	call->reply = NULL;
+
+fail:
+	lash_error("Ran out of memory trying to construct method return");
 }
 
+/* Append journal entries which recreate the loaded projects, their notes
+   and their running and lost clients */
 static bool
-add_dict_entry_bool(
-	DBusMessageIter * dict_iter_ptr,
-	const char * key,
-	dbus_bool_t value)
+lashd_dbus_append_snapshot(DBusMessageIter *iter)
 {
-	DBusMessageIter dict_entry_iter;
+	struct list_head *node, *client_node;
+	project_t *project;
+	struct lash_client *client;
+	dbus_uint64_t seq = g_server->journal->seq;
+	const char *args[JOURNAL_MAX_ARGS + 1] = { NULL };
 
-	if (!dbus_message_iter_open_container(dict_iter_ptr, DBUS_TYPE_DICT_ENTRY, NULL, &dict_entry_iter))
-		return false;
+	list_for_each (node, &g_server->loaded_projects) {
+		project = list_entry(node, project_t, siblings_loaded);
 
-	if (!dbus_message_iter_append_basic(&dict_entry_iter, DBUS_TYPE_STRING, (const void *) &key)) {
-		dbus_message_iter_close_container(dict_iter_ptr, &dict_entry_iter);
-		return false;
-	}
+		args[0] = project->name;
+		args[1] = project->directory;
+		if (!journal_append_entry(iter, seq, "ProjectAppeared", args))
+			return false;
 
-	method_iter_append_variant(&dict_entry_iter, DBUS_TYPE_BOOLEAN, &value);
+		args[1] = project->modified_status ? "true" : "false";
+		if (!journal_append_entry(iter, seq, "ProjectModifiedStatusChanged", args))
+			return false;
 
-	if (!dbus_message_iter_close_container(dict_iter_ptr, &dict_entry_iter))
-		return false;
+		if (project->description) {
+			args[1] = project->description;
+			if (!journal_append_entry(iter, seq, "ProjectDescriptionChanged", args))
+				return false;
+		}
+
+		if (project->notes) {
+			args[1] = project->notes;
+			if (!journal_append_entry(iter, seq, "ProjectNotesChanged", args))
+				return false;
+		}
+
+		list_for_each (client_node, &project->clients) {
+			client = list_entry(client_node, struct lash_client, siblings);
+
+			args[0] = client->id_str;
+			args[1] = project->name;
+			args[2] = client->name ? client->name : "";
+			if (!journal_append_entry(iter, seq, "ClientAppeared", args))
+				return false;
+		}
+
+		/* Lost clients have no signal of their own, a snapshot lists
+		   them as ClientLost entries with the same arguments */
+		list_for_each (client_node, &project->lost_clients) {
+			client = list_entry(client_node, struct lash_client, siblings);
+
+			args[0] = client->id_str;
+			args[1] = project->name;
+			args[2] = client->name ? client->name : "";
+			if (!journal_append_entry(iter, seq, "ClientLost", args))
+				return false;
+		}
+
+		args[2] = NULL;
+	}
 
 	return true;
 }
 
+/* Bring a controller up to date. If the journal still holds every change
+   after since_seq the missing changes are returned, otherwise a snapshot
+   of the loaded projects and their clients in the same form. Each of the
+   journaled signals emitted after the reply advances the sequence number
+   by one, so a controller can keep count and resubscribe after a restart */
 static void
-lashd_dbus_projects_get_available(method_call_t *call)
+lashd_dbus_subscribe(method_call_t *call)
 {
-	DBusMessageIter iter, array_iter, struct_iter, dict_iter;
-	struct list_head * node_ptr;
-	project_t * project_ptr;
+	DBusMessageIter iter, array_iter;
+	DBusError err;
+	dbus_uint64_t since_seq;
+	dbus_bool_t is_snapshot;
+	bool ok;
+
+	dbus_error_init(&err);
+
+	if (!dbus_message_get_args(call->message, &err,
+	                           DBUS_TYPE_UINT64, &since_seq,
+	                           DBUS_TYPE_INVALID)) {
+		lash_dbus_error(call, LASH_DBUS_ERROR_INVALID_ARGS,
+		                "Invalid arguments to method \"%s\": %s",
+		                call->method_name, err.message);
+		dbus_error_free(&err);
+		return;
+	}
+
+	is_snapshot = !journal_covers(g_server->journal, since_seq);
 
 	call->reply = dbus_message_new_method_return(call->message);
 	if (!call->reply)
@@ -126,34 +288,19 @@ lashd_dbus_projects_get_available(method_call_t *call)
 
 	dbus_message_iter_init_append(call->reply, &iter);
 
-	if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "(sa{sv})", &array_iter))
+	if (!dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT64, &g_server->journal->seq)
+	    || !dbus_message_iter_append_basic(&iter, DBUS_TYPE_BOOLEAN, &is_snapshot)
+	    || !dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "(tsas)", &array_iter))
 		goto fail_unref;
 
-	list_for_each (node_ptr, &g_server->all_projects) {
-		project_ptr = list_entry(node_ptr, project_t, siblings_all);
-
-		if (!dbus_message_iter_open_container(&array_iter, DBUS_TYPE_STRUCT, NULL, &struct_iter))
-			goto fail_unref;
-
-		if (!dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &project_ptr->name)) {
-			dbus_message_iter_close_container(&iter, &array_iter);
-			goto fail_unref;
-		}
-
-		if (!dbus_message_iter_open_container(&struct_iter, DBUS_TYPE_ARRAY, "{sv}", &dict_iter))
-			goto fail_unref;
-
-		if (!maybe_add_dict_entry_string(&dict_iter, "Description", project_ptr->description))
-			goto fail_unref;
-
-		if (!add_dict_entry_uint32(&dict_iter, "Modification Time", project_ptr->last_modify_time))
-			goto fail_unref;
-
-		if (!dbus_message_iter_close_container(&struct_iter, &dict_iter))
-			goto fail_unref;
+	if (is_snapshot)
+		ok = lashd_dbus_append_snapshot(&array_iter);
+	else
+		ok = journal_append_since(g_server->journal, &array_iter, since_seq);
 
-		if (!dbus_message_iter_close_container(&array_iter, &struct_iter))
-			goto fail_unref;
+	if (!ok) {
+		dbus_message_iter_close_container(&iter, &array_iter);
+		goto fail_unref;
 	}
 
 	if (!dbus_message_iter_close_container(&iter, &array_iter))
@@ -236,7 +383,7 @@ void
 lashd_dbus_project_get_properties(
 	method_call_t * call)
 {
-	DBusMessageIter iter, dict_iter;
+	DBusMessageIter iter;
 	project_t * project_ptr;
 
 	DBusError error;
@@ -276,19 +423,7 @@ lashd_dbus_project_get_properties(
 
 	dbus_message_iter_init_append(call->reply, &iter);
 
-	if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "{sv}", &dict_iter))
-		goto fail_unref;
-
-	if (!maybe_add_dict_entry_string(&dict_iter, "Description", project_ptr->description))
-		goto fail_unref;
-
-	if (!maybe_add_dict_entry_string(&dict_iter, "Notes", project_ptr->notes))
-		goto fail_unref;
-
-	if (!add_dict_entry_bool(&dict_iter, "Modified Status", project_ptr->modified_status))
-		goto fail_unref;
-
-	if (!dbus_message_iter_close_container(&iter, &dict_iter))
+	if (!method_iter_append_dict(&iter, ProjectProperties_dict_dtor, project_ptr))
 		goto fail_unref;
 
 	return;
@@ -485,7 +620,7 @@ lashd_dbus_project_get_lost_clients(method_call_t *call)
 static void
 lashd_dbus_applications_get(method_call_t *call)
 {
-	DBusMessageIter iter, array_iter, struct_iter, dict_iter;
+	DBusMessageIter iter, array_iter;
 	struct list_head *node_ptr;
 	struct lash_appdb_entry *entry_ptr;
 
@@ -503,31 +638,12 @@ lashd_dbus_applications_get(method_call_t *call)
 	list_for_each(node_ptr, &g_server->appdb) {
 		entry_ptr = list_entry(node_ptr, struct lash_appdb_entry, siblings);
 
-		if (!dbus_message_iter_open_container(&array_iter, DBUS_TYPE_STRUCT, NULL, &struct_iter))
-			goto fail_unref;
-
-		if (!dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, (const void *) &entry_ptr->name)) {
+		if (!method_iter_append_named_dict(&array_iter, entry_ptr->name,
+		                                   Application_dict_dtor,
+		                                   entry_ptr)) {
 			dbus_message_iter_close_container(&iter, &array_iter);
 			goto fail_unref;
 		}
-
-		if (!dbus_message_iter_open_container(&struct_iter, DBUS_TYPE_ARRAY, "{sv}", &dict_iter))
-			goto fail_unref;
-
-		if (!maybe_add_dict_entry_string(&dict_iter, "GenericName", entry_ptr->generic_name))
-			goto fail_unref;
-
-		if (!maybe_add_dict_entry_string(&dict_iter, "Comment", entry_ptr->comment))
-			goto fail_unref;
-
-		if (!maybe_add_dict_entry_string(&dict_iter, "Icon", entry_ptr->icon))
-			goto fail_unref;
-
-		if (!dbus_message_iter_close_container(&struct_iter, &dict_iter))
-			goto fail_unref;
-
-		if (!dbus_message_iter_close_container(&array_iter, &struct_iter))
-			goto fail_unref;
 	}
 
 	if (!dbus_message_iter_close_container(&iter, &array_iter))
@@ -924,6 +1040,163 @@ lashd_dbus_project_close(method_call_t *call)
 	}
 }
 
+static void
+lashd_dbus_project_get_scenes(method_call_t *call)
+{
+	DBusError err;
+	const char *project_name;
+	project_t *project;
+	struct list_head *node;
+	scene_t *scene;
+	DBusMessageIter iter, sub_iter;
+
+	dbus_error_init(&err);
+
+	if (!dbus_message_get_args(call->message, &err,
+	                           DBUS_TYPE_STRING, &project_name,
+	                           DBUS_TYPE_INVALID)) {
+		lash_dbus_error(call, LASH_DBUS_ERROR_INVALID_ARGS,
+		                "Invalid arguments to method \"%s\"",
+		                call->method_name);
+		dbus_error_free(&err);
+		return;
+	}
+
+	if (!(project = server_find_project_by_name(project_name))) {
+		lash_dbus_error(call, LASH_DBUS_ERROR_UNKNOWN_PROJECT,
+		                "Cannot find project \"%s\"", project_name);
+		return;
+	}
+
+	call->reply = dbus_message_new_method_return(call->message);
+	if (!call->reply)
+		goto fail;
+
+	dbus_message_iter_init_append(call->reply, &iter);
+
+	if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "s", &sub_iter))
+		goto fail_unref;
+
+	list_for_each (node, &project->scenes) {
+		scene = list_entry(node, scene_t, siblings);
+		if (!dbus_message_iter_append_basic(&sub_iter, DBUS_TYPE_STRING, &scene->name)) {
+			dbus_message_iter_close_container(&iter, &sub_iter);
+			goto fail_unref;
+		}
+	}
+
+	if (!dbus_message_iter_close_container(&iter, &sub_iter))
+		goto fail_unref;
+
+	return;
+
+fail_unref:
+	dbus_message_unref(call->reply);
+	call->reply = NULL;
+
+fail:
+	lash_error("Ran out of memory trying to construct method return");
+}
+
+/** Read the project name and scene name arguments of a scene method call.
+ * On failure an error is set as @a call 's reply.
+ * @param call Method call to read.
+ * @param project Pointer to where to store the project.
+ * @param scene_name Pointer to where to store the scene name.
+ * @return True on success, false otherwise.
+ */
+static bool
+lashd_dbus_get_scene_args(method_call_t  *call,
+                          project_t     **project,
+                          const char    **scene_name)
+{
+	DBusError err;
+	const char *project_name;
+
+	dbus_error_init(&err);
+
+	if (!dbus_message_get_args(call->message, &err,
+	                           DBUS_TYPE_STRING, &project_name,
+	                           DBUS_TYPE_STRING, scene_name,
+	                           DBUS_TYPE_INVALID)) {
+		lash_dbus_error(call, LASH_DBUS_ERROR_INVALID_ARGS,
+		                "Invalid arguments to method \"%s\"",
+		                call->method_name);
+		dbus_error_free(&err);
+		return false;
+	}
+
+	if (!(*project = server_find_project_by_name(project_name))) {
+		lash_dbus_error(call, LASH_DBUS_ERROR_UNKNOWN_PROJECT,
+		                "Cannot find project \"%s\"", project_name);
+		return false;
+	}
+
+	return true;
+}
+
+static void
+lashd_dbus_project_save_scene(method_call_t *call)
+{
+	project_t *project;
+	const char *scene_name;
+
+	if (!lashd_dbus_get_scene_args(call, &project, &scene_name))
+		return;
+
+	if (!scene_name[0]) {
+		lash_dbus_error(call, LASH_DBUS_ERROR_INVALID_ARGS,
+		                "Scene name cannot be empty");
+		return;
+	}
+
+	if (!project_save_scene(project, scene_name)) {
+		lash_dbus_error(call, LASH_DBUS_ERROR_GENERIC,
+		                "Saving scene \"%s\" failed", scene_name);
+	}
+}
+
+static void
+lashd_dbus_project_switch_scene(method_call_t *call)
+{
+	project_t *project;
+	const char *scene_name;
+	scene_t *scene;
+
+	if (!lashd_dbus_get_scene_args(call, &project, &scene_name))
+		return;
+
+	if (!(scene = scene_find_by_name(&project->scenes, scene_name))) {
+		lash_dbus_error(call, LASH_DBUS_ERROR_UNKNOWN_SCENE,
+		                "Cannot find scene \"%s\"", scene_name);
+		return;
+	}
+
+	if (!project_switch_scene(project, scene)) {
+		lash_dbus_error(call, LASH_DBUS_ERROR_GENERIC,
+		                "Switching to scene \"%s\" failed", scene_name);
+	}
+}
+
+static void
+lashd_dbus_project_remove_scene(method_call_t *call)
+{
+	project_t *project;
+	const char *scene_name;
+	scene_t *scene;
+
+	if (!lashd_dbus_get_scene_args(call, &project, &scene_name))
+		return;
+
+	if (!(scene = scene_find_by_name(&project->scenes, scene_name))) {
+		lash_dbus_error(call, LASH_DBUS_ERROR_UNKNOWN_SCENE,
+		                "Cannot find scene \"%s\"", scene_name);
+		return;
+	}
+
+	project_remove_scene(project, scene);
+}
+
 static void
 lashd_dbus_projects_save_all(method_call_t *call)
 {
@@ -950,6 +1223,9 @@ void
 lashd_dbus_signal_emit_project_appeared(const char *project_name,
                                         const char *project_path)
 {
+	journal_record(g_server->journal, "ProjectAppeared", 2,
+	               project_name, project_path);
+
 	signal_new_valist(g_server->dbus_service,
 	                  "/", INTERFACE_NAME, "ProjectAppeared",
 	                  DBUS_TYPE_STRING, &project_name,
@@ -960,6 +1236,9 @@ lashd_dbus_signal_emit_project_appeared(const char *project_name,
 void
 lashd_dbus_signal_emit_project_disappeared(const char *project_name)
 {
+	journal_record(g_server->journal, "ProjectDisappeared", 1,
+	               project_name);
+
 	signal_new_single(g_server->dbus_service,
 	                  "/", INTERFACE_NAME, "ProjectDisappeared",
 	                  DBUS_TYPE_STRING, &project_name);
@@ -969,6 +1248,9 @@ void
 lashd_dbus_signal_emit_project_name_changed(const char *old_name,
                                             const char *new_name)
 {
+	journal_record(g_server->journal, "ProjectNameChanged", 2,
+	               old_name, new_name);
+
 	signal_new_valist(g_server->dbus_service,
 	                  "/", INTERFACE_NAME, "ProjectNameChanged",
 	                  DBUS_TYPE_STRING, &old_name,
@@ -980,6 +1262,9 @@ void
 lashd_dbus_signal_emit_project_path_changed(const char *project_name,
                                             const char *new_path)
 {
+	journal_record(g_server->journal, "ProjectPathChanged", 2,
+	               project_name, new_path);
+
 	signal_new_valist(g_server->dbus_service,
 	                  "/", INTERFACE_NAME, "ProjectPathChanged",
 	                  DBUS_TYPE_STRING, &project_name,
@@ -991,6 +1276,9 @@ void
 lashd_dbus_signal_emit_project_description_changed(const char *project_name,
                                                    const char *description)
 {
+	journal_record(g_server->journal, "ProjectDescriptionChanged", 2,
+	               project_name, description);
+
 	signal_new_valist(g_server->dbus_service,
 	                  "/", INTERFACE_NAME, "ProjectDescriptionChanged",
 	                  DBUS_TYPE_STRING, &project_name,
@@ -1002,6 +1290,9 @@ void
 lashd_dbus_signal_emit_project_notes_changed(const char *project_name,
                                              const char *notes)
 {
+	journal_record(g_server->journal, "ProjectNotesChanged", 2,
+	               project_name, notes);
+
 	signal_new_valist(g_server->dbus_service,
 	                  "/", INTERFACE_NAME, "ProjectNotesChanged",
 	                  DBUS_TYPE_STRING, &project_name,
@@ -1012,6 +1303,9 @@ lashd_dbus_signal_emit_project_notes_changed(const char *project_name,
 void
 lashd_dbus_signal_emit_project_saved(const char *project_name)
 {
+	journal_record(g_server->journal, "ProjectSaved", 1,
+	               project_name);
+
 	signal_new_single(g_server->dbus_service,
 	                  "/", INTERFACE_NAME, "ProjectSaved",
 	                  DBUS_TYPE_STRING, &project_name);
@@ -1020,6 +1314,9 @@ lashd_dbus_signal_emit_project_saved(const char *project_name)
 void
 lashd_dbus_signal_emit_project_loaded(const char *project_name)
 {
+	journal_record(g_server->journal, "ProjectLoaded", 1,
+	               project_name);
+
 	signal_new_single(g_server->dbus_service,
 	                  "/", INTERFACE_NAME, "ProjectLoaded",
 	                  DBUS_TYPE_STRING, &project_name);
@@ -1030,6 +1327,9 @@ lashd_dbus_signal_emit_client_appeared(const char *client_id,
                                        const char *project_name,
                                        const char *client_name)
 {
+	journal_record(g_server->journal, "ClientAppeared", 3,
+	               client_id, project_name, client_name);
+
 	signal_new_valist(g_server->dbus_service,
 	                  "/", INTERFACE_NAME, "ClientAppeared",
 	                  DBUS_TYPE_STRING, &client_id,
@@ -1042,6 +1342,9 @@ void
 lashd_dbus_signal_emit_client_disappeared(const char *client_id,
                                           const char *project_name)
 {
+	journal_record(g_server->journal, "ClientDisappeared", 2,
+	               client_id, project_name);
+
 	signal_new_valist(g_server->dbus_service,
 	                  "/", INTERFACE_NAME, "ClientDisappeared",
 	                  DBUS_TYPE_STRING, &client_id,
@@ -1053,6 +1356,9 @@ void
 lashd_dbus_signal_emit_client_name_changed(const char *client_id,
                                            const char *new_client_name)
 {
+	journal_record(g_server->journal, "ClientNameChanged", 2,
+	               client_id, new_client_name);
+
 	signal_new_valist(g_server->dbus_service,
 	                  "/", INTERFACE_NAME, "ClientNameChanged",
 	                  DBUS_TYPE_STRING, &client_id,
@@ -1061,8 +1367,20 @@ lashd_dbus_signal_emit_client_name_changed(const char *client_id,
 }
 
 void
-lashd_dbus_signal_emit_progress(uint8_t percentage)
+lashd_dbus_signal_emit_project_progress(const char *project_name,
+                                        uint64_t    task_id,
+                                        uint8_t     percentage)
 {
+	dbus_uint64_t id = task_id;
+
+	signal_new_valist(g_server->dbus_service,
+	                  "/", INTERFACE_NAME, "ProjectProgress",
+	                  DBUS_TYPE_STRING, &project_name,
+	                  DBUS_TYPE_UINT64, &id,
+	                  DBUS_TYPE_BYTE, &percentage,
+	                  DBUS_TYPE_INVALID);
+
+	/* Deprecated, carries no project or task */
 	signal_new_single(g_server->dbus_service,
 	                  "/", INTERFACE_NAME, "Progress",
 	                  DBUS_TYPE_BYTE, &percentage);
@@ -1072,6 +1390,24 @@ METHOD_ARGS_BEGIN(ProjectsGetAvailable)
   METHOD_ARG_DESCRIBE("projects_list", "a(sa{sv})", DIRECTION_OUT)
 METHOD_ARGS_END
 
+METHOD_ARGS_BEGIN(ProjectsQuery)
+  METHOD_ARG_DESCRIBE("known_generation", "t", DIRECTION_IN)
+  METHOD_ARG_DESCRIBE("filter", "s", DIRECTION_IN)
+  METHOD_ARG_DESCRIBE("sort", "s", DIRECTION_IN)
+  METHOD_ARG_DESCRIBE("offset", "u", DIRECTION_IN)
+  METHOD_ARG_DESCRIBE("limit", "u", DIRECTION_IN)
+  METHOD_ARG_DESCRIBE("generation", "t", DIRECTION_OUT)
+  METHOD_ARG_DESCRIBE("projects_list", "a(sa{sv})", DIRECTION_OUT)
+  METHOD_ARG_DESCRIBE("total", "u", DIRECTION_OUT)
+METHOD_ARGS_END
+
+METHOD_ARGS_BEGIN(Subscribe)
+  METHOD_ARG_DESCRIBE("since_seq", "t", DIRECTION_IN)
+  METHOD_ARG_DESCRIBE("seq", "t", DIRECTION_OUT)
+  METHOD_ARG_DESCRIBE("is_snapshot", "b", DIRECTION_OUT)
+  METHOD_ARG_DESCRIBE("changes", "a(tsas)", DIRECTION_OUT)
+METHOD_ARGS_END
+
 METHOD_ARGS_BEGIN(ProjectOpen)
   METHOD_ARG_DESCRIBE("project_name", "s", DIRECTION_IN)
   METHOD_ARG_DESCRIBE("options", "a{sv}", DIRECTION_IN)
@@ -1082,6 +1418,7 @@ METHOD_ARGS_BEGIN(ProjectsGet)
 METHOD_ARGS_END
 
 METHOD_ARGS_BEGIN(ProjectGetProperties)
+  METHOD_ARG_DESCRIBE("project_name", "s", DIRECTION_IN)
   METHOD_ARG_DESCRIBE("properties", "a{sv}", DIRECTION_OUT)
 METHOD_ARGS_END
 
@@ -1155,6 +1492,26 @@ METHOD_ARGS_BEGIN(ProjectClose)
   METHOD_ARG_DESCRIBE("project_name", "s", DIRECTION_IN)
 METHOD_ARGS_END
 
+METHOD_ARGS_BEGIN(ProjectGetScenes)
+  METHOD_ARG_DESCRIBE("project_name", "s", DIRECTION_IN)
+  METHOD_ARG_DESCRIBE("scenes", "as", DIRECTION_OUT)
+METHOD_ARGS_END
+
+METHOD_ARGS_BEGIN(ProjectSaveScene)
+  METHOD_ARG_DESCRIBE("project_name", "s", DIRECTION_IN)
+  METHOD_ARG_DESCRIBE("scene_name", "s", DIRECTION_IN)
+METHOD_ARGS_END
+
+METHOD_ARGS_BEGIN(ProjectSwitchScene)
+  METHOD_ARG_DESCRIBE("project_name", "s", DIRECTION_IN)
+  METHOD_ARG_DESCRIBE("scene_name", "s", DIRECTION_IN)
+METHOD_ARGS_END
+
+METHOD_ARGS_BEGIN(ProjectRemoveScene)
+  METHOD_ARG_DESCRIBE("project_name", "s", DIRECTION_IN)
+  METHOD_ARG_DESCRIBE("scene_name", "s", DIRECTION_IN)
+METHOD_ARGS_END
+
 METHOD_ARGS_BEGIN(ProjectsSaveAll)
 METHOD_ARGS_END
 
@@ -1166,6 +1523,8 @@ METHOD_ARGS_END
 
 METHODS_BEGIN
   METHOD_DESCRIBE(ProjectsGetAvailable, lashd_dbus_projects_get_available)
+  METHOD_DESCRIBE(ProjectsQuery, lashd_dbus_projects_query)
+  METHOD_DESCRIBE(Subscribe, lashd_dbus_subscribe)
   METHOD_DESCRIBE(ProjectOpen, lashd_dbus_project_open)
   METHOD_DESCRIBE(ProjectsGet, lashd_dbus_projects_get)
   METHOD_DESCRIBE(ProjectGetProperties, lashd_dbus_project_get_properties)
@@ -1183,6 +1542,10 @@ METHODS_BEGIN
   METHOD_DESCRIBE(ProjectRename, lashd_dbus_project_rename)
   METHOD_DESCRIBE(ProjectSave, lashd_dbus_project_save)
   METHOD_DESCRIBE(ProjectClose, lashd_dbus_project_close)
+  METHOD_DESCRIBE(ProjectGetScenes, lashd_dbus_project_get_scenes)
+  METHOD_DESCRIBE(ProjectSaveScene, lashd_dbus_project_save_scene)
+  METHOD_DESCRIBE(ProjectSwitchScene, lashd_dbus_project_switch_scene)
+  METHOD_DESCRIBE(ProjectRemoveScene, lashd_dbus_project_remove_scene)
   METHOD_DESCRIBE(ProjectsSaveAll, lashd_dbus_projects_save_all)
   METHOD_DESCRIBE(ProjectsCloseAll, lashd_dbus_projects_close_all)
   METHOD_DESCRIBE(Exit, lashd_dbus_exit)
@@ -1260,6 +1623,12 @@ SIGNAL_ARGS_BEGIN(ClientAlsaIdChanged)
   SIGNAL_ARG_DESCRIBE("alsa_id", "y")
 SIGNAL_ARGS_END
 
+SIGNAL_ARGS_BEGIN(ProjectProgress)
+  SIGNAL_ARG_DESCRIBE("project_name", "s")
+  SIGNAL_ARG_DESCRIBE("task_id", "t")
+  SIGNAL_ARG_DESCRIBE("percentage", "y")
+SIGNAL_ARGS_END
+
 SIGNAL_ARGS_BEGIN(Progress)
   SIGNAL_ARG_DESCRIBE("percentage", "y")
 SIGNAL_ARGS_END
@@ -1279,6 +1648,7 @@ SIGNALS_BEGIN
   SIGNAL_DESCRIBE(ClientNameChanged)
   SIGNAL_DESCRIBE(ClientJackNameChanged)
   SIGNAL_DESCRIBE(ClientAlsaIdChanged)
+  SIGNAL_DESCRIBE(ProjectProgress)
   SIGNAL_DESCRIBE(Progress)
 SIGNALS_END
 
@@ -1287,7 +1657,7 @@ SIGNALS_END
  */
 
 INTERFACE_BEGIN(g_lashd_interface_control, INTERFACE_NAME)
-  INTERFACE_DEFAULT_HANDLER
+  INTERFACE_HANDLER(lashd_dbus_timed_handler)
   INTERFACE_EXPOSE_METHODS
   INTERFACE_EXPOSE_SIGNALS
 INTERFACE_END
@@ -69,7 +69,12 @@ void
 lashd_dbus_signal_emit_client_name_changed(const char *client_id,
                                            const char *new_client_name);
 
+/** Emit a ProjectProgress signal, and a Progress signal
+ * for controllers which only know the old one.
+ */
 void
-lashd_dbus_signal_emit_progress(uint8_t percentage);
+lashd_dbus_signal_emit_project_progress(const char *project_name,
+                                        uint64_t    task_id,
+                                        uint8_t     percentage);
 
 #endif /* __LASHD_DBUS_IFACE_CONTROL_H__ */
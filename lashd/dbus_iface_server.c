@@ -37,6 +37,7 @@
 #include "dbus/error.h"
 #include "lash/types.h"
 #include "store.h"
+#include "dbus_iface_stats.h"
 
 static void
 lashd_dbus_ping(method_call_t *call)
@@ -419,6 +420,7 @@ get_and_set_config(store_t         *store,
 {
 	const char *key;
 	int type, size;
+	unsigned char tag;
 
 	union {
 		double      d;
@@ -427,7 +429,7 @@ get_and_set_config(store_t         *store,
 		const void *v;
 	} value;
 
-	if (!method_iter_get_dict_entry(iter, &key, &value, &type, &size)) {
+	if (!method_iter_get_dict_entry(iter, &key, &value, &type, &size, &tag)) {
 		lash_error("Cannot get dict entry from config message");
 		return false;
 	}
@@ -438,14 +440,34 @@ get_and_set_config(store_t         *store,
 		return store_set_config(store, key, &value, sizeof(uint32_t), type);
 	} else if (type == LASH_TYPE_STRING) {
 		return store_set_config(store, key, value.s, strlen(value.s) + 1, type);
-	} else if (type == LASH_TYPE_RAW) {
+	} else if (type == LASH_TYPE_RAW || type == LASH_TYPE_DOUBLE_ARRAY
+	           || type == LASH_TYPE_FLOAT_ARRAY || type == LASH_TYPE_INT_ARRAY) {
 		return store_set_config(store, key, value.v, size, type);
+	} else if (type == LASH_TYPE_BLOCK) {
+		return store_set_config_block(store, key, tag, value.v, size);
 	} else {
 		lash_error("Unsupported config type '%c'", (char) type);
 		return false;
 	}
 }
 
+/* Commit all the configs in a config array to the store */
+static bool
+get_and_set_configs(method_call_t   *call,
+                    store_t         *store,
+                    DBusMessageIter *array_iter)
+{
+	do {
+		if (!get_and_set_config(store, array_iter)) {
+			lash_dbus_error(call, LASH_DBUS_ERROR_GENERIC,
+			                "Config data is corrupt");
+			return false;
+		}
+	} while (dbus_message_iter_next(array_iter));
+
+	return true;
+}
+
 /* The CommitDataSet method is used by the client to deliver its data set
    to the server. The client will never call this method unless requested
    to do so by LASH. */
@@ -483,26 +505,307 @@ lashd_dbus_commit_data_set(method_call_t *call)
 
 	dbus_message_iter_recurse(&iter, &array_iter);
 
+	/* The last chunk of a streamed data set may be empty */
 	if (dbus_message_iter_get_arg_type(&array_iter) == DBUS_TYPE_INVALID) {
+		if (!client->streaming_data_set) {
+			lash_dbus_error(call, LASH_DBUS_ERROR_GENERIC,
+			                "Message contains no configs");
+			return;
+		}
+	} else
+		was_successful = get_and_set_configs(call, client->store,
+		                                     &array_iter);
+
+	/* Sending a valid data set implies task completion */
+	client_task_completed(client, was_successful);
+}
+
+/* The CommitDataSetDelta method is the same as CommitDataSet, except that
+   the client only sends the configs which have changed since its last
+   save, and the keys of the configs it has removed. The configs are
+   merged into the client's store, so untouched values stay as they are.
+   A delta may be the last chunk of a data set begun with BeginDataSet. */
+static void
+lashd_dbus_commit_data_set_delta(method_call_t *call)
+{
+	lash_debug("CommitDataSetDelta");
+
+	const char *sender, *key;
+	struct lash_client *client;
+	DBusMessageIter iter, array_iter;
+	bool was_successful = true;
+
+	if (!get_message_sender(call, &sender, &client))
+		return;
+
+	if (!check_tasks(call, client, &iter))
+		return;
+
+	if (!client->store) {
 		lash_dbus_error(call, LASH_DBUS_ERROR_GENERIC,
-		                "Message contains no configs");
+		                "Client's store pointer is NULL");
 		return;
 	}
 
-	/* Loop through the configs and commit them to the store */
-	do {
-		if (!get_and_set_config(client->store, &array_iter)) {
-			lash_dbus_error(call, LASH_DBUS_ERROR_GENERIC,
-			                "Config data is corrupt");
-			was_successful = false;
-			break;
+	/* Unlike a full data set, a delta may be empty */
+	dbus_message_iter_recurse(&iter, &array_iter);
+	if (dbus_message_iter_get_arg_type(&array_iter) != DBUS_TYPE_INVALID)
+		was_successful = get_and_set_configs(call, client->store,
+		                                     &array_iter);
+
+	if (was_successful) {
+		dbus_message_iter_next(&iter);
+		dbus_message_iter_recurse(&iter, &array_iter);
+
+		while (dbus_message_iter_get_arg_type(&array_iter)
+		       == DBUS_TYPE_STRING) {
+			dbus_message_iter_get_basic(&array_iter, &key);
+			store_remove_config(client->store, key);
+			dbus_message_iter_next(&array_iter);
 		}
-	} while (dbus_message_iter_next(&array_iter));
+	}
+
+	lash_debug("Merged data set delta from client '%s'",
+	           client_get_identity(client));
 
-	/* Sending a valid data set implies task completion */
 	client_task_completed(client, was_successful);
 }
 
+/* The BeginDataSet method tells the server that the client's data set
+   will be delivered in chunks with AppendDataSet, the last one of which
+   is sent with CommitDataSet. */
+static void
+lashd_dbus_begin_data_set(method_call_t *call)
+{
+	lash_debug("BeginDataSet");
+
+	const char *sender;
+	struct lash_client *client;
+
+	if (!get_message_sender(call, &sender, &client))
+		return;
+
+	if (!check_tasks(call, client, NULL))
+		return;
+
+	if (!client->store) {
+		lash_dbus_error(call, LASH_DBUS_ERROR_GENERIC,
+		                "Client's store pointer is NULL");
+		return;
+	}
+
+	lash_debug("Receiving data set from client '%s' in chunks",
+	           client_get_identity(client));
+
+	client->streaming_data_set = true;
+}
+
+static void
+lashd_dbus_append_data_set(method_call_t *call)
+{
+	lash_debug("AppendDataSet");
+
+	const char *sender;
+	struct lash_client *client;
+	DBusMessageIter iter, array_iter;
+	uint8_t percentage;
+
+	if (!get_message_sender(call, &sender, &client))
+		return;
+
+	if (!check_tasks(call, client, &iter))
+		return;
+
+	if (!client->streaming_data_set) {
+		lash_dbus_error(call, LASH_DBUS_ERROR_INVALID_TASK,
+		                "Client '%s' has not begun a data set",
+		                client_get_identity(client));
+		return;
+	}
+
+	if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY) {
+		lash_dbus_error(call, LASH_DBUS_ERROR_INVALID_ARGS,
+		                "Invalid arguments to method \"%s\"",
+		                call->method_name);
+		return;
+	}
+
+	dbus_message_iter_recurse(&iter, &array_iter);
+
+	if (dbus_message_iter_get_arg_type(&array_iter) != DBUS_TYPE_INVALID
+	    && !get_and_set_configs(call, client->store, &array_iter)) {
+		client_task_completed(client, false);
+		return;
+	}
+
+	/* A percentage of 0 means that the client can't estimate it */
+	if (dbus_message_iter_next(&iter)
+	    && dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_BYTE) {
+		dbus_message_iter_get_basic(&iter, &percentage);
+		if (percentage > 0 && percentage < 100)
+			client_task_progressed(client, percentage);
+	}
+}
+
+#ifdef HAVE_DATA_SET_FD
+/* The CommitDataSetFd method is the same as CommitDataSet, except that
+   the configs are delivered in a sealed memfd. This is used by clients
+   whose connection flags include LASH_Data_Set_Fd. */
+static void
+lashd_dbus_commit_data_set_fd(method_call_t *call)
+{
+	lash_debug("CommitDataSetFd");
+
+	const char *sender;
+	struct lash_client *client;
+	DBusMessageIter iter;
+	int fd;
+
+	if (!get_message_sender(call, &sender, &client))
+		return;
+
+	lash_debug("Received data set fd from client '%s'",
+	           client_get_identity(client));
+
+	if (!check_tasks(call, client, &iter))
+		return;
+
+	if (!client->store) {
+		lash_dbus_error(call, LASH_DBUS_ERROR_GENERIC,
+		                "Client's store pointer is NULL");
+		return;
+	}
+
+	if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_UNIX_FD) {
+		lash_dbus_error(call, LASH_DBUS_ERROR_INVALID_ARGS,
+		                "Invalid arguments to method \"%s\"",
+		                call->method_name);
+		return;
+	}
+
+	/* The store takes ownership of the fd */
+	dbus_message_iter_get_basic(&iter, &fd);
+
+	client_task_completed(client,
+	                      store_set_configs_from_fd(client->store, fd));
+}
+#endif
+
+/* Reply to a GetConfig or GetConfigsByPrefix method call with the
+   requested configs; keys is NULL when fetching by prefix */
+static void
+lashd_dbus_reply_configs(method_call_t       *call,
+                         struct lash_client  *client,
+                         const char         **keys,
+                         int                  num_keys,
+                         const char          *prefix)
+{
+	DBusMessageIter iter, array_iter;
+	bool ok;
+
+	if (!client->store) {
+		lash_dbus_error(call, LASH_DBUS_ERROR_GENERIC,
+		                "Client '%s' has no data set",
+		                client_get_identity(client));
+		return;
+	}
+
+	call->reply = dbus_message_new_method_return(call->message);
+	if (!call->reply)
+		goto fail;
+
+	dbus_message_iter_init_append(call->reply, &iter);
+
+	if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "{sv}", &array_iter))
+		goto fail_unref;
+
+	if (keys)
+		ok = store_create_config_array_for_keys(client->store, &array_iter,
+		                                        keys, num_keys);
+	else
+		ok = store_create_config_array_by_prefix(client->store, &array_iter,
+		                                         prefix);
+
+	if (!ok) {
+		dbus_message_iter_close_container(&iter, &array_iter);
+		goto fail_unref;
+	}
+
+	if (!dbus_message_iter_close_container(&iter, &array_iter))
+		goto fail_unref;
+
+	return;
+
+fail_unref:
+	dbus_message_unref(call->reply);
+	call->reply = NULL;
+
+fail:
+	lash_error("Ran out of memory trying to construct method return");
+}
+
+/* The GetConfig method lets a client fetch some of its configs on demand,
+   typically after receiving only the keys of its data set at restore */
+static void
+lashd_dbus_get_config(method_call_t *call)
+{
+	lash_debug("GetConfig");
+
+	const char *sender;
+	struct lash_client *client;
+	DBusError err;
+	char **keys;
+	int num_keys;
+
+	if (!get_message_sender(call, &sender, &client))
+		return;
+
+	dbus_error_init(&err);
+
+	if (!dbus_message_get_args(call->message, &err,
+	                           DBUS_TYPE_ARRAY, DBUS_TYPE_STRING,
+	                           &keys, &num_keys,
+	                           DBUS_TYPE_INVALID)) {
+		lash_dbus_error(call, LASH_DBUS_ERROR_INVALID_ARGS,
+		                "Invalid arguments to method \"%s\": %s",
+		                call->method_name, err.message);
+		dbus_error_free(&err);
+		return;
+	}
+
+	lashd_dbus_reply_configs(call, client, (const char **) keys,
+	                         num_keys, NULL);
+
+	dbus_free_string_array(keys);
+}
+
+static void
+lashd_dbus_get_configs_by_prefix(method_call_t *call)
+{
+	lash_debug("GetConfigsByPrefix");
+
+	const char *sender, *prefix;
+	struct lash_client *client;
+	DBusError err;
+
+	if (!get_message_sender(call, &sender, &client))
+		return;
+
+	dbus_error_init(&err);
+
+	if (!dbus_message_get_args(call->message, &err,
+	                           DBUS_TYPE_STRING, &prefix,
+	                           DBUS_TYPE_INVALID)) {
+		lash_dbus_error(call, LASH_DBUS_ERROR_INVALID_ARGS,
+		                "Invalid arguments to method \"%s\": %s",
+		                call->method_name, err.message);
+		dbus_error_free(&err);
+		return;
+	}
+
+	lashd_dbus_reply_configs(call, client, NULL, 0, prefix);
+}
+
 /*
  * Interface methods.
  */
@@ -560,6 +863,39 @@ METHOD_ARGS_BEGIN(CommitDataSet)
   METHOD_ARG_DESCRIBE("configs", "a{sv}", DIRECTION_IN)
 METHOD_ARGS_END
 
+METHOD_ARGS_BEGIN(CommitDataSetDelta)
+  METHOD_ARG_DESCRIBE("task_id", "t", DIRECTION_IN)
+  METHOD_ARG_DESCRIBE("configs", "a{sv}", DIRECTION_IN)
+  METHOD_ARG_DESCRIBE("removed_keys", "as", DIRECTION_IN)
+METHOD_ARGS_END
+
+#ifdef HAVE_DATA_SET_FD
+METHOD_ARGS_BEGIN(CommitDataSetFd)
+  METHOD_ARG_DESCRIBE("task_id", "t", DIRECTION_IN)
+  METHOD_ARG_DESCRIBE("configs_fd", "h", DIRECTION_IN)
+METHOD_ARGS_END
+#endif
+
+METHOD_ARGS_BEGIN(BeginDataSet)
+  METHOD_ARG_DESCRIBE("task_id", "t", DIRECTION_IN)
+METHOD_ARGS_END
+
+METHOD_ARGS_BEGIN(AppendDataSet)
+  METHOD_ARG_DESCRIBE("task_id", "t", DIRECTION_IN)
+  METHOD_ARG_DESCRIBE("configs", "a{sv}", DIRECTION_IN)
+  METHOD_ARG_DESCRIBE("percentage", "y", DIRECTION_IN)
+METHOD_ARGS_END
+
+METHOD_ARGS_BEGIN(GetConfig)
+  METHOD_ARG_DESCRIBE("keys", "as", DIRECTION_IN)
+  METHOD_ARG_DESCRIBE("configs", "a{sv}", DIRECTION_OUT)
+METHOD_ARGS_END
+
+METHOD_ARGS_BEGIN(GetConfigsByPrefix)
+  METHOD_ARG_DESCRIBE("prefix", "s", DIRECTION_IN)
+  METHOD_ARG_DESCRIBE("configs", "a{sv}", DIRECTION_OUT)
+METHOD_ARGS_END
+
 METHOD_ARGS_BEGIN(CommitPathChange)
 METHOD_ARGS_END
 
@@ -573,6 +909,14 @@ METHODS_BEGIN
   METHOD_DESCRIBE(GetAlsaId, lashd_dbus_get_alsa_id)
   METHOD_DESCRIBE(Progress, lashd_dbus_progress)
   METHOD_DESCRIBE(CommitDataSet, lashd_dbus_commit_data_set)
+  METHOD_DESCRIBE(CommitDataSetDelta, lashd_dbus_commit_data_set_delta)
+  METHOD_DESCRIBE(BeginDataSet, lashd_dbus_begin_data_set)
+  METHOD_DESCRIBE(AppendDataSet, lashd_dbus_append_data_set)
+  METHOD_DESCRIBE(GetConfig, lashd_dbus_get_config)
+  METHOD_DESCRIBE(GetConfigsByPrefix, lashd_dbus_get_configs_by_prefix)
+#ifdef HAVE_DATA_SET_FD
+  METHOD_DESCRIBE(CommitDataSetFd, lashd_dbus_commit_data_set_fd)
+#endif
   METHOD_DESCRIBE(CommitPathChange, lashd_dbus_commit_path_change)
 METHODS_END
 
@@ -604,7 +948,7 @@ SIGNALS_END
  */
 
 INTERFACE_BEGIN(g_lashd_interface_server, "org.nongnu.LASH.Server")
-  INTERFACE_DEFAULT_HANDLER
+  INTERFACE_HANDLER(lashd_dbus_timed_handler)
   INTERFACE_EXPOSE_METHODS
   INTERFACE_EXPOSE_SIGNALS
 INTERFACE_END
@@ -0,0 +1,445 @@
+/*
+ *   LASH
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "config.h"
+
+#include <stdint.h>
+#ifdef HAVE_MALLINFO2
+# include <malloc.h>
+#endif
+
+#include "common/safety.h"
+#include "common/debug.h"
+#include "common/klist.h"
+#include "common/histogram.h"
+#include "dbus/interface.h"
+#include "server.h"
+#include "project.h"
+#include "client.h"
+#include "stats.h"
+#include "watchdog.h"
+#include "dbus_iface_server.h"
+#include "dbus_iface_control.h"
+#include "dbus_iface_stats.h"
+
+#define INTERFACE_NAME "org.nongnu.LASH.Stats"
+
+/* The interfaces whose method latencies are reported */
+static const interface_t *const stats_interfaces[] = {
+	&g_lashd_interface_server,
+	&g_lashd_interface_control,
+	&g_lashd_interface_stats,
+	NULL
+};
+
+#define NUM_STATS_INTERFACES \
+	(sizeof(stats_interfaces) / sizeof(stats_interfaces[0]) - 1)
+
+/* Handler run times in microseconds, one per entry of each interface's
+   method index, allocated when the interface's first method is called */
+static struct histogram *method_latency[NUM_STATS_INTERFACES];
+
+/* Get the latency histogram of the method at index position i, or NULL */
+static struct histogram *
+lashd_dbus_method_latency(const interface_t *interface,
+                          size_t             i)
+{
+	struct _interface_index *index;
+	unsigned int n;
+
+	for (n = 0; n < NUM_STATS_INTERFACES; ++n)
+		if (stats_interfaces[n] == interface)
+			break;
+
+	if (n == NUM_STATS_INTERFACES
+	    || !(index = interface_get_index(interface))
+	    || i >= index->num_methods)
+		return NULL;
+
+	if (!method_latency[n])
+		method_latency[n] = lash_calloc(index->num_methods,
+		                                sizeof(struct histogram));
+
+	return &method_latency[n][i];
+}
+
+bool
+lashd_dbus_timed_handler(const interface_t *interface,
+                         method_call_t     *call)
+{
+	const struct _interface_method *entry;
+	struct histogram *latency;
+	uint64_t start;
+
+	if (!(entry = interface_find_method(interface, call->method_name)))
+		return false;
+
+	start = histogram_now_usec();
+	interface_default_handler(interface, call);
+
+	latency = lashd_dbus_method_latency(interface,
+	                                    entry - interface->index->methods);
+	if (latency)
+		histogram_record(latency, histogram_now_usec() - start);
+
+	return true;
+}
+
+/* Append a histogram's count, total and maximum followed by an array of
+   its non-empty buckets as (lower bound, count) structs */
+static bool
+lashd_dbus_append_histogram(DBusMessageIter        *iter,
+                            const struct histogram *histogram)
+{
+	DBusMessageIter array_iter, struct_iter;
+	dbus_uint64_t lower;
+	unsigned int i;
+
+	if (!dbus_message_iter_append_basic(iter, DBUS_TYPE_UINT64, &histogram->count)
+	    || !dbus_message_iter_append_basic(iter, DBUS_TYPE_UINT64, &histogram->total)
+	    || !dbus_message_iter_append_basic(iter, DBUS_TYPE_UINT64, &histogram->max)
+	    || !dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY, "(tt)", &array_iter))
+		return false;
+
+	for (i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+		if (!histogram->buckets[i])
+			continue;
+
+		lower = histogram_bucket_min(i);
+
+		if (!dbus_message_iter_open_container(&array_iter, DBUS_TYPE_STRUCT, NULL, &struct_iter))
+			goto fail;
+
+		if (!dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &lower)
+		    || !dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &histogram->buckets[i])) {
+			dbus_message_iter_close_container(&array_iter, &struct_iter);
+			goto fail;
+		}
+
+		if (!dbus_message_iter_close_container(&array_iter, &struct_iter))
+			goto fail;
+	}
+
+	return dbus_message_iter_close_container(iter, &array_iter);
+
+fail:
+	dbus_message_iter_close_container(iter, &array_iter);
+	return false;
+}
+
+static bool
+lashd_dbus_append_counter(DBusMessageIter *iter,
+                          const char      *name,
+                          dbus_uint64_t    value)
+{
+	DBusMessageIter dict_iter;
+
+	if (!dbus_message_iter_open_container(iter, DBUS_TYPE_DICT_ENTRY, NULL, &dict_iter))
+		return false;
+
+	if (!dbus_message_iter_append_basic(&dict_iter, DBUS_TYPE_STRING, &name)
+	    || !dbus_message_iter_append_basic(&dict_iter, DBUS_TYPE_UINT64, &value)) {
+		dbus_message_iter_close_container(iter, &dict_iter);
+		return false;
+	}
+
+	return dbus_message_iter_close_container(iter, &dict_iter);
+}
+
+static void
+lashd_dbus_get_method_stats(method_call_t *call)
+{
+	DBusMessageIter iter, array_iter, struct_iter;
+	const interface_t *const *interface;
+	struct _interface_index *index;
+	struct _interface_method *entry;
+	struct histogram *latency, empty;
+	size_t i;
+
+	histogram_reset(&empty);
+
+	call->reply = dbus_message_new_method_return(call->message);
+	if (!call->reply)
+		goto fail;
+
+	dbus_message_iter_init_append(call->reply, &iter);
+
+	if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "(ssttta(tt))", &array_iter))
+		goto fail_unref;
+
+	for (interface = stats_interfaces; *interface; ++interface) {
+		if (!(index = interface_get_index(*interface)))
+			continue;
+
+		for (i = 0; i < index->num_methods; ++i) {
+			entry = &index->methods[i];
+			if (!(latency = method_latency[interface - stats_interfaces]))
+				latency = &empty;
+			else
+				latency += i;
+
+			if (!dbus_message_iter_open_container(&array_iter, DBUS_TYPE_STRUCT, NULL, &struct_iter))
+				goto fail_close;
+
+			if (!dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &(*interface)->name)
+			    || !dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &entry->method->name)
+			    || !lashd_dbus_append_histogram(&struct_iter, latency)) {
+				dbus_message_iter_close_container(&array_iter, &struct_iter);
+				goto fail_close;
+			}
+
+			if (!dbus_message_iter_close_container(&array_iter, &struct_iter))
+				goto fail_close;
+		}
+	}
+
+	if (!dbus_message_iter_close_container(&iter, &array_iter))
+		goto fail_unref;
+
+	return;
+
+fail_close:
+	dbus_message_iter_close_container(&iter, &array_iter);
+
+fail_unref:
+	dbus_message_unref(call->reply);
+	call->reply = NULL;
+
+fail:
+	lash_error("Ran out of memory trying to construct method return");
+}
+
+static void
+lashd_dbus_get_main_loop_stats(method_call_t *call)
+{
+	DBusMessageIter iter;
+
+	call->reply = dbus_message_new_method_return(call->message);
+	if (!call->reply)
+		goto fail;
+
+	dbus_message_iter_init_append(call->reply, &iter);
+
+	if (!lashd_dbus_append_histogram(&iter, &g_stats.main_loop))
+		goto fail_unref;
+
+	return;
+
+fail_unref:
+	dbus_message_unref(call->reply);
+	call->reply = NULL;
+
+fail:
+	lash_error("Ran out of memory trying to construct method return");
+}
+
+static void
+lashd_dbus_get_client_stats(method_call_t *call)
+{
+	DBusMessageIter iter, array_iter, struct_iter;
+	struct list_head *pnode, *cnode;
+	project_t *project;
+	struct lash_client *client;
+	const char *id, *name;
+	dbus_bool_t unresponsive;
+
+	call->reply = dbus_message_new_method_return(call->message);
+	if (!call->reply)
+		goto fail;
+
+	dbus_message_iter_init_append(call->reply, &iter);
+
+	if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "(ssbtttta(tt))", &array_iter))
+		goto fail_unref;
+
+	list_for_each (pnode, &g_server->loaded_projects) {
+		project = list_entry(pnode, project_t, siblings_loaded);
+
+		list_for_each (cnode, &project->clients) {
+			client = list_entry(cnode, struct lash_client, siblings);
+			id = client->id_str;
+			name = client->name ? client->name : "";
+			unresponsive = client->watchdog.unresponsive;
+
+			if (!dbus_message_iter_open_container(&array_iter, DBUS_TYPE_STRUCT, NULL, &struct_iter))
+				goto fail_close;
+
+			if (!dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &id)
+			    || !dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &name)
+			    || !dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_BOOLEAN, &unresponsive)
+			    || !dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &client->watchdog.overruns)
+			    || !lashd_dbus_append_histogram(&struct_iter, &client->watchdog.latency)) {
+				dbus_message_iter_close_container(&array_iter, &struct_iter);
+				goto fail_close;
+			}
+
+			if (!dbus_message_iter_close_container(&array_iter, &struct_iter))
+				goto fail_close;
+		}
+	}
+
+	if (!dbus_message_iter_close_container(&iter, &array_iter))
+		goto fail_unref;
+
+	return;
+
+fail_close:
+	dbus_message_iter_close_container(&iter, &array_iter);
+
+fail_unref:
+	dbus_message_unref(call->reply);
+	call->reply = NULL;
+
+fail:
+	lash_error("Ran out of memory trying to construct method return");
+}
+
+static void
+lashd_dbus_get_counters(method_call_t *call)
+{
+	DBusMessageIter iter, array_iter;
+	struct list_head *node, *cnode;
+	project_t *project;
+	dbus_uint64_t loaded_projects = 0, tasks_pending = 0, patches_pending = 0;
+	dbus_uint64_t unresponsive_clients = 0;
+	unsigned int i;
+#ifdef HAVE_MALLINFO2
+	struct mallinfo2 heap = mallinfo2();
+#endif
+
+	list_for_each (node, &g_server->loaded_projects) {
+		project = list_entry(node, project_t, siblings_loaded);
+		++loaded_projects;
+		tasks_pending += project->client_tasks_pending;
+		patches_pending += project->patches_pending;
+
+		list_for_each (cnode, &project->clients)
+			if (list_entry(cnode, struct lash_client, siblings)->watchdog.unresponsive)
+				++unresponsive_clients;
+	}
+
+	call->reply = dbus_message_new_method_return(call->message);
+	if (!call->reply)
+		goto fail;
+
+	dbus_message_iter_init_append(call->reply, &iter);
+
+	if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "{st}", &array_iter))
+		goto fail_unref;
+
+	for (i = 0; i < STATS_NUM_COUNTERS; ++i)
+		if (!lashd_dbus_append_counter(&array_iter, g_stats_counter_names[i],
+		                               stats_get(i)))
+			goto fail_close;
+
+	if (!lashd_dbus_append_counter(&array_iter, "loaded_projects", loaded_projects)
+	    || !lashd_dbus_append_counter(&array_iter, "client_tasks_pending", tasks_pending)
+	    || !lashd_dbus_append_counter(&array_iter, "patches_pending", patches_pending)
+	    || !lashd_dbus_append_counter(&array_iter, "unresponsive_clients", unresponsive_clients)
+	    || !lashd_dbus_append_counter(&array_iter, "dbus_outgoing_bytes",
+	                                  dbus_connection_get_outgoing_size(g_server->dbus_service->connection))
+#ifdef HAVE_MALLINFO2
+	    || !lashd_dbus_append_counter(&array_iter, "heap_in_use_bytes", heap.uordblks)
+	    || !lashd_dbus_append_counter(&array_iter, "heap_free_bytes", heap.fordblks)
+	    || !lashd_dbus_append_counter(&array_iter, "heap_mmap_bytes", heap.hblkhd)
+#endif
+	   )
+		goto fail_close;
+
+	if (!dbus_message_iter_close_container(&iter, &array_iter))
+		goto fail_unref;
+
+	return;
+
+fail_close:
+	dbus_message_iter_close_container(&iter, &array_iter);
+
+fail_unref:
+	dbus_message_unref(call->reply);
+	call->reply = NULL;
+
+fail:
+	lash_error("Ran out of memory trying to construct method return");
+}
+
+static void
+lashd_dbus_reset(method_call_t *call)
+{
+	struct _interface_index *index;
+	unsigned int n;
+	size_t i;
+
+	for (n = 0; n < NUM_STATS_INTERFACES; ++n) {
+		if (!method_latency[n])
+			continue;
+
+		index = interface_get_index(stats_interfaces[n]);
+		for (i = 0; i < index->num_methods; ++i)
+			histogram_reset(&method_latency[n][i]);
+	}
+
+	stats_reset();
+	watchdog_reset_stats();
+
+	lash_debug("Statistics reset");
+}
+
+/*
+ * Interface methods.
+ */
+
+METHOD_ARGS_BEGIN(GetMethodStats)
+  METHOD_ARG_DESCRIBE("methods", "a(ssttta(tt))", DIRECTION_OUT)
+METHOD_ARGS_END
+
+METHOD_ARGS_BEGIN(GetMainLoopStats)
+  METHOD_ARG_DESCRIBE("iterations", "t", DIRECTION_OUT)
+  METHOD_ARG_DESCRIBE("total_usec", "t", DIRECTION_OUT)
+  METHOD_ARG_DESCRIBE("max_usec", "t", DIRECTION_OUT)
+  METHOD_ARG_DESCRIBE("buckets", "a(tt)", DIRECTION_OUT)
+METHOD_ARGS_END
+
+METHOD_ARGS_BEGIN(GetClientStats)
+  METHOD_ARG_DESCRIBE("clients", "a(ssbtttta(tt))", DIRECTION_OUT)
+METHOD_ARGS_END
+
+METHOD_ARGS_BEGIN(GetCounters)
+  METHOD_ARG_DESCRIBE("counters", "a{st}", DIRECTION_OUT)
+METHOD_ARGS_END
+
+METHOD_ARGS_BEGIN(Reset)
+METHOD_ARGS_END
+
+METHODS_BEGIN
+  METHOD_DESCRIBE(GetMethodStats, lashd_dbus_get_method_stats)
+  METHOD_DESCRIBE(GetMainLoopStats, lashd_dbus_get_main_loop_stats)
+  METHOD_DESCRIBE(GetClientStats, lashd_dbus_get_client_stats)
+  METHOD_DESCRIBE(GetCounters, lashd_dbus_get_counters)
+  METHOD_DESCRIBE(Reset, lashd_dbus_reset)
+METHODS_END
+
+/*
+ * Interface description.
+ */
+
+INTERFACE_BEGIN(g_lashd_interface_stats, INTERFACE_NAME)
+  INTERFACE_HANDLER(lashd_dbus_timed_handler)
+  INTERFACE_EXPOSE_METHODS
+INTERFACE_END
+
+/* EOF */
@@ -0,0 +1,34 @@
+/*
+ *   LASH
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __LASHD_DBUS_IFACE_STATS_H__
+#define __LASHD_DBUS_IFACE_STATS_H__
+
+#include "dbus/interface.h"
+
+extern const interface_t g_lashd_interface_stats;
+
+/** Interface handler of lashd's own interfaces. It runs
+ * interface_default_handler() and records how long the method took for
+ * the Stats interface's GetMethodStats.
+ */
+bool
+lashd_dbus_timed_handler(const interface_t *interface,
+                         method_call_t     *call);
+
+#endif /* __LASHD_DBUS_IFACE_STATS_H__ */
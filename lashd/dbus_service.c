@@ -28,6 +28,7 @@
 #include "server.h"
 #include "dbus_iface_server.h"
 #include "dbus_iface_control.h"
+#include "dbus_iface_stats.h"
 #include "common/debug.h"
 #include "dbus/object_path.h"
 #include "client.h"
@@ -46,10 +47,11 @@ lashd_dbus_service_new(void)
 
 	                   // TODO: move service name into public header
 	service = service_new("org.nongnu.LASH", &g_server->quit,
-	                      1,
-	                      object_path_new("/", NULL, 2,
+	                      false, 1,
+	                      object_path_new("/", NULL, 3,
 	                                      &g_lashd_interface_server,
 	                                      &g_lashd_interface_control,
+	                                      &g_lashd_interface_stats,
 	                                      NULL),
 	                      NULL);
 	if (!service) {
@@ -28,6 +28,7 @@
 #include <errno.h>
 #include <unistd.h>
 #include <time.h>
+#include <sys/time.h>
 #include <string.h>
 #include <stdarg.h>
 #include <jack/jack.h>
@@ -40,9 +41,28 @@
 #include "server.h"
 #include "jack_fport.h"
 #include "jack_patch.h"
+#include "patch_snapshot.h"
+#include "stats.h"
 
 #define BACKUP_INTERVAL ((time_t)(30))
 
+/* A failed patch connection is retried this many times before the patch is
+   handed back to its client's old patches to wait for another port */
+#define CONNECT_MAX_ATTEMPTS 4
+/* Delay before the first retry, doubled for each subsequent one */
+#define CONNECT_RETRY_MSEC   100
+
+/* A patch waiting in jack_mgr->connect_queue */
+struct jack_mgr_connect
+{
+	struct list_head  siblings;
+	uuid_t            owner_id;  /* client whose old patch this is */
+	jack_patch_t     *old_patch; /* unlinked from the owner's old_patches */
+	jack_patch_t     *patch;     /* old_patch with client names resolved */
+	unsigned int      attempts;
+	struct timeval    retry_time;
+};
+
 static void *
 jack_mgr_callback_run(void *data);
 
@@ -51,6 +71,12 @@ jack_mgr_new_client_port(jack_mgr_t        *jack_mgr,
                          const char        *port_name_port,
                          jack_mgr_client_t *client);
 
+static void
+jack_mgr_connect_queued(jack_mgr_t *jack_mgr);
+
+static void
+jack_mgr_connect_clear(jack_mgr_t *jack_mgr);
+
 static void
 jack_mgr_jack_error(const char *message)
 {
@@ -73,6 +99,8 @@ jack_mgr_port_registration_cb(jack_port_id_t  port_id,
 	char port_notify = 1, reg = (char) registered;
 	int sock = jack_mgr->callback_write_socket;
 
+	stats_count(STATS_JACK_EVENTS);
+
 	if (write(sock, &port_notify, 1) == -1
 	    || write(sock, &port_id, sizeof(jack_port_id_t)) == -1
 	    || write(sock, &reg, 1) == -1) {
@@ -88,6 +116,8 @@ jack_mgr_graph_reorder_cb(void *data)
 	jack_mgr_t *jack_mgr = (jack_mgr_t *) data;
 	char port_notify = 0;
 
+	stats_count(STATS_JACK_EVENTS);
+
 	if (write(jack_mgr->callback_write_socket, &port_notify, 1) == -1) {
 		lash_error("Could not send data to JACK manager callback, "
 		           "aborting: %s", strerror(errno));
@@ -144,6 +174,7 @@ jack_mgr_new(void)
 	jack_mgr->quit = 0;
 	INIT_LIST_HEAD(&jack_mgr->clients);
 	INIT_LIST_HEAD(&jack_mgr->foreign_ports);
+	INIT_LIST_HEAD(&jack_mgr->connect_queue);
 
 	pthread_mutex_init(&jack_mgr->lock, NULL);
 
@@ -193,6 +224,8 @@ jack_mgr_destroy(jack_mgr_t *jack_mgr)
 
 	jack_client_close(jack_mgr->jack_client);
 
+	jack_mgr_connect_clear(jack_mgr);
+
 /* FIXME: free all the data */
 
 	free(jack_mgr);
@@ -233,6 +266,45 @@ jack_mgr_check_client_ports(jack_mgr_t        *jack_mgr,
 	}
 }
 
+/* Backups refer to other clients by UUID, so the ones which mention a
+   client must be redone when it comes or goes */
+static void
+jack_mgr_invalidate_backups(jack_mgr_t *jack_mgr,
+                            const char *client_name)
+{
+	struct list_head *node;
+	jack_mgr_client_t *client;
+
+	list_for_each (node, &jack_mgr->clients) {
+		client = list_entry(node, jack_mgr_client_t, siblings);
+
+		if (jack_mgr_client_patch_list_refers_to(&client->patches,
+		                                         client_name))
+			client->patches_changed = true;
+	}
+}
+
+/* Replace the client's backup with its current patches; caller must hold
+   client lock */
+static void
+jack_mgr_backup_client_patches(jack_mgr_t        *jack_mgr,
+                               jack_mgr_client_t *client)
+{
+	struct list_head *node;
+
+	LIST_HEAD(patches);
+
+	jack_mgr_client_dup_patch_list(&client->patches, &patches);
+
+	list_for_each (node, &patches) {
+		jack_patch_set(list_entry(node, jack_patch_t, siblings),
+		               &jack_mgr->clients);
+	}
+
+	jack_mgr_client_set_backup_patches(client, &patches);
+	client->patches_changed = false;
+}
+
 void
 jack_mgr_add_client(jack_mgr_t       *jack_mgr,
                     uuid_t            id,
@@ -249,9 +321,11 @@ jack_mgr_add_client(jack_mgr_t       *jack_mgr,
 		list_splice_init(jack_patches, &client->old_patches);
 
 		list_add_tail(&client->siblings, &jack_mgr->clients);
+		jack_mgr_invalidate_backups(jack_mgr, client->name);
 
 		/* check if it's registered some ports already */
 		jack_mgr_check_client_ports(jack_mgr, client);
+		jack_mgr_connect_queued(jack_mgr);
 		lash_debug("Client added");
 	}
 	else
@@ -277,19 +351,34 @@ jack_mgr_remove_client(jack_mgr_t       *jack_mgr,
 
 	lash_debug("Removed client '%s'", client->name);
 
-	if (backup_patches)
-		list_splice(&client->backup_patches, backup_patches);
+	jack_mgr_invalidate_backups(jack_mgr, client->name);
+
+	if (backup_patches) {
+		patch_snapshot_release(client->backup_patches, backup_patches);
+		client->backup_patches = NULL;
+	}
 
 	jack_mgr_client_destroy(client);
 }
 
-/* Return a list of the given client's patches. */
-void
-jack_mgr_get_client_patches(jack_mgr_t       *jack_mgr,
-                            uuid_t            id,
-                            struct list_head *dest)
+/* Return a reference to the given client's patches; caller must hold
+   client lock */
+patch_snapshot_t *
+jack_mgr_get_client_patches(jack_mgr_t *jack_mgr,
+                            uuid_t      id)
 {
-	jack_mgr_client_dup_uniq_patches(&jack_mgr->clients, id, dest);
+	jack_mgr_client_t *client;
+
+	client = jack_mgr_client_find_by_id(&jack_mgr->clients, id);
+	if (!client) {
+		lash_error("Unknown client");
+		return NULL;
+	}
+
+	if (client->patches_changed)
+		jack_mgr_backup_client_patches(jack_mgr, client);
+
+	return patch_snapshot_ref(client->backup_patches);
 }
 
 /* caller must hold client lock */
@@ -332,10 +421,165 @@ jack_mgr_resume_patch(jack_mgr_t   *jack_mgr,
 	return true;
 }
 
+static void
+jack_mgr_connect_destroy(struct jack_mgr_connect *connect)
+{
+	if (connect->old_patch)
+		jack_patch_destroy(connect->old_patch);
+	jack_patch_destroy(connect->patch);
+	free(connect);
+}
+
+/*
+ * Queue a resolved patch for connection. The old patch is moved out of
+ * the owner's old_patches and into the queue entry. Returns false if an
+ * identical connection is already queued, in which case the caller keeps
+ * ownership of both patches.
+ */
+static bool
+jack_mgr_queue_patch(jack_mgr_t        *jack_mgr,
+                     jack_mgr_client_t *owner,
+                     jack_patch_t      *old_patch,
+                     jack_patch_t      *patch)
+{
+	struct list_head *node;
+	struct jack_mgr_connect *connect;
+
+	list_for_each (node, &jack_mgr->connect_queue) {
+		connect = list_entry(node, struct jack_mgr_connect, siblings);
+
+		if (strcmp(connect->patch->src_desc, patch->src_desc) == 0
+		    && strcmp(connect->patch->dest_desc, patch->dest_desc) == 0)
+			return false;
+	}
+
+	connect = lash_calloc(1, sizeof(struct jack_mgr_connect));
+	uuid_copy(connect->owner_id, owner->id);
+	list_del(&old_patch->siblings);
+	connect->old_patch = old_patch;
+	connect->patch = patch;
+
+	list_add_tail(&connect->siblings, &jack_mgr->connect_queue);
+
+	return true;
+}
+
+/*
+ * Connect all queued patches whose retry delay has expired in one pass.
+ * Failed connections are retried with exponential backoff; once they run
+ * out of attempts their old patch goes back to the owning client, to be
+ * tried again when another of the involved ports appears.
+ */
+static void
+jack_mgr_connect_queued(jack_mgr_t *jack_mgr)
+{
+	struct list_head *node, *next;
+	struct jack_mgr_connect *connect;
+	jack_mgr_client_t *owner;
+	struct timeval start, now;
+	unsigned int connected = 0, failed = 0;
+	long delay;
+
+	if (list_empty(&jack_mgr->connect_queue))
+		return;
+
+	gettimeofday(&start, NULL);
+
+	list_for_each_safe (node, next, &jack_mgr->connect_queue) {
+		connect = list_entry(node, struct jack_mgr_connect, siblings);
+
+		if (timercmp(&connect->retry_time, &start, >))
+			continue;
+
+		if (jack_mgr_resume_patch(jack_mgr, connect->patch)) {
+			list_del(&connect->siblings);
+			jack_mgr_connect_destroy(connect);
+			++connected;
+			continue;
+		}
+
+		if (++connect->attempts < CONNECT_MAX_ATTEMPTS) {
+			delay = CONNECT_RETRY_MSEC << (connect->attempts - 1);
+			connect->retry_time.tv_sec = start.tv_sec + delay / 1000;
+			connect->retry_time.tv_usec = start.tv_usec + (delay % 1000) * 1000;
+			if (connect->retry_time.tv_usec >= 1000000) {
+				++connect->retry_time.tv_sec;
+				connect->retry_time.tv_usec -= 1000000;
+			}
+			continue;
+		}
+
+		list_del(&connect->siblings);
+		++failed;
+
+		owner = jack_mgr_client_find_by_id(&jack_mgr->clients,
+		                                   connect->owner_id);
+		if (owner) {
+			list_add_tail(&connect->old_patch->siblings,
+			              &owner->old_patches);
+			connect->old_patch = NULL;
+		}
+
+		jack_mgr_connect_destroy(connect);
+	}
+
+	if (connected || failed) {
+		gettimeofday(&now, NULL);
+		lash_info("Resumed %u JACK patches (%u deferred) in %ld us",
+		          connected, failed,
+		          (long)((now.tv_sec - start.tv_sec) * 1000000
+		                 + (now.tv_usec - start.tv_usec)));
+	}
+}
+
+/*
+ * Set timeout to the time left until the earliest retry of a queued
+ * patch is due, or to the backup interval if no patches are waiting.
+ */
+static void
+jack_mgr_connect_timeout(jack_mgr_t     *jack_mgr,
+                         struct timeval *timeout)
+{
+	struct list_head *node;
+	struct jack_mgr_connect *connect;
+	struct timeval now, next;
+
+	timeout->tv_sec = BACKUP_INTERVAL;
+	timeout->tv_usec = 0;
+
+	if (list_empty(&jack_mgr->connect_queue))
+		return;
+
+	gettimeofday(&now, NULL);
+	timeradd(&now, timeout, &next);
+
+	list_for_each (node, &jack_mgr->connect_queue) {
+		connect = list_entry(node, struct jack_mgr_connect, siblings);
+		if (timercmp(&connect->retry_time, &next, <))
+			next = connect->retry_time;
+	}
+
+	if (timercmp(&next, &now, >))
+		timersub(&next, &now, timeout);
+	else
+		timerclear(timeout);
+}
+
+static void
+jack_mgr_connect_clear(jack_mgr_t *jack_mgr)
+{
+	struct list_head *node, *next;
+
+	list_for_each_safe (node, next, &jack_mgr->connect_queue) {
+		list_del(node);
+		jack_mgr_connect_destroy(list_entry(node, struct jack_mgr_connect, siblings));
+	}
+}
+
 /*
  * Here we have to go through each patch, see if it's the specified port,
- * unset it, see if we can connect it, and remove it.  Other clients will
- * have connections for this one if they're not registered yet.
+ * unset it, and queue it for connection.  Other clients will have
+ * connections for this one if they're not registered yet.
  */
 static void
 jack_mgr_new_client_port(jack_mgr_t        *jack_mgr,
@@ -367,13 +611,11 @@ jack_mgr_new_client_port(jack_mgr_t        *jack_mgr,
 		     && strcmp(port, unset_patch->src_port) == 0)
 		    || (strcmp(client->name, unset_patch->dest_client) == 0
 		        && strcmp(port, unset_patch->dest_port) == 0)) {
-			lash_debug("Attempting to resume patch '%s' -> '%s'",
+			lash_debug("Queueing patch '%s' -> '%s' for resuming",
 			           unset_patch->src_desc,
 			           unset_patch->dest_desc);
-			if (jack_mgr_resume_patch(jack_mgr, unset_patch)) {
-				list_del(&patch->siblings);
-				jack_patch_destroy(patch);
-			}
+			if (jack_mgr_queue_patch(jack_mgr, client, patch, unset_patch))
+				continue;
 		}
 
 		jack_patch_destroy(unset_patch);
@@ -484,24 +726,30 @@ jack_mgr_get_patches(jack_mgr_t        *jack_mgr,
                      jack_mgr_client_t *client)
 {
 	LIST_HEAD(patches);
+	LIST_HEAD(input_patches);
 
 	jack_mgr_get_patches_with_type(client->name,
 	                               jack_mgr->jack_client,
 	                               JackPortIsOutput,
 	                               &patches);
 
-	if (!list_empty(&client->patches)) {
-		jack_mgr_client_free_patch_list(&client->patches);
-		INIT_LIST_HEAD(&client->patches);
-	}
-	list_splice_init(&patches, &client->patches);
-
 	jack_mgr_get_patches_with_type(client->name,
 	                               jack_mgr->jack_client,
 	                               JackPortIsInput,
-	                               &patches);
+	                               &input_patches);
+
+	list_splice(&input_patches, &patches);
 
+	/* Most graph reorders don't touch most clients */
+	if (jack_mgr_client_patch_lists_equal(&patches, &client->patches)) {
+		jack_mgr_client_free_patch_list(&patches);
+		return;
+	}
+
+	jack_mgr_client_free_patch_list(&client->patches);
+	INIT_LIST_HEAD(&client->patches);
 	list_splice(&patches, &client->patches);
+	client->patches_changed = true;
 }
 
 static void
@@ -580,7 +828,7 @@ jack_mgr_backup_patches(jack_mgr_t *jack_mgr)
 {
 	static time_t last_backup = 0;
 	time_t now;
-	struct list_head *node, *node2;
+	struct list_head *node;
 	jack_mgr_client_t *client;
 
 	now = time(NULL);
@@ -588,17 +836,12 @@ jack_mgr_backup_patches(jack_mgr_t *jack_mgr)
 	if (now - last_backup < BACKUP_INTERVAL)
 		return;
 
+	/* Only clients whose patches have changed get a new snapshot */
 	list_for_each (node, &jack_mgr->clients) {
 		client = list_entry(node, jack_mgr_client_t, siblings);
 
-		jack_mgr_client_free_patch_list(&client->backup_patches);
-		INIT_LIST_HEAD(&client->backup_patches);
-		jack_mgr_client_dup_patch_list(&client->patches, &client->backup_patches);
-
-		list_for_each (node2, &client->backup_patches) {
-			jack_patch_set(list_entry(node2, jack_patch_t, siblings),
-			               &jack_mgr->clients);
-		}
+		if (client->patches_changed)
+			jack_mgr_backup_client_patches(jack_mgr, client);
 	}
 
 	last_backup = now;
@@ -616,9 +859,10 @@ jack_mgr_callback_run(void *data)
 	FD_SET(sock, &socket_set);
 
 	while (!jack_mgr->quit) {
-		/* backup timeout */
-		timeout.tv_sec = BACKUP_INTERVAL;
-		timeout.tv_usec = 0;
+		/* backup timeout, or retry timeout if patches are waiting */
+		jack_mgr_lock(jack_mgr);
+		jack_mgr_connect_timeout(jack_mgr, &timeout);
+		jack_mgr_unlock(jack_mgr);
 
 		select_set = socket_set;
 
@@ -635,9 +879,20 @@ jack_mgr_callback_run(void *data)
 
 		jack_mgr_lock(jack_mgr);
 
-		if (FD_ISSET(sock, &select_set))
+		/* Handle all pending notifications before connecting anything,
+		   so that a burst of port registrations becomes one batch */
+		while (FD_ISSET(sock, &select_set) && !jack_mgr->quit) {
 			jack_mgr_read_callback(jack_mgr);
 
+			select_set = socket_set;
+			timeout.tv_sec = 0;
+			timeout.tv_usec = 0;
+			if (select(sock + 1, &select_set, NULL, NULL, &timeout) <= 0)
+				break;
+		}
+
+		jack_mgr_connect_queued(jack_mgr);
+
 		jack_mgr_backup_patches(jack_mgr);
 
 		jack_mgr_unlock(jack_mgr);
@@ -39,6 +39,7 @@ struct _jack_mgr
 	int              callback_read_socket;
 	struct list_head clients;
 	struct list_head foreign_ports;
+	struct list_head connect_queue; /* patches waiting to be connected */
 	int              quit;
 };
 
@@ -65,9 +66,11 @@ jack_mgr_remove_client(jack_mgr_t       *jack_mgr,
                        uuid_t            id,
                        struct list_head *backup_patches);
 
-void
-jack_mgr_get_client_patches(jack_mgr_t       *jack_mgr,
-                            uuid_t            id,
-                            struct list_head *dest);
+/* Return a reference to the client's patch snapshot, which is rebuilt
+   first if the patches have changed. Release it with patch_snapshot_unref,
+   and copy it before modifying the patches. Caller must hold client lock. */
+patch_snapshot_t *
+jack_mgr_get_client_patches(jack_mgr_t *jack_mgr,
+                            uuid_t      id);
 
 #endif /* __LASHD_JACK_MGR_H__ */
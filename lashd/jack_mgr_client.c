@@ -28,6 +28,7 @@
 
 #include "jack_mgr_client.h"
 #include "jack_patch.h"
+#include "patch_snapshot.h"
 #include "client.h"
 #include "project.h"
 #include "server.h"
@@ -39,7 +40,6 @@ jack_mgr_client_new(void)
 
 	if ((client = lash_calloc(1, sizeof(jack_mgr_client_t)))) {
 		INIT_LIST_HEAD(&client->old_patches);
-		INIT_LIST_HEAD(&client->backup_patches);
 #ifndef HAVE_JACK_DBUS
 		INIT_LIST_HEAD(&client->patches);
 #endif
@@ -54,7 +54,7 @@ jack_mgr_client_destroy(jack_mgr_client_t *client)
 	if (client) {
 		lash_free(&client->name);
 		jack_mgr_client_free_patch_list(&client->old_patches);
-		jack_mgr_client_free_patch_list(&client->backup_patches);
+		patch_snapshot_unref(client->backup_patches);
 #ifndef HAVE_JACK_DBUS
 		jack_mgr_client_free_patch_list(&client->patches);
 #endif
@@ -84,6 +84,57 @@ jack_mgr_client_free_patch_list(struct list_head *patch_list)
 		jack_patch_destroy(list_entry(node, jack_patch_t, siblings));
 }
 
+bool
+jack_mgr_client_patch_lists_equal(struct list_head *a,
+                                  struct list_head *b)
+{
+	struct list_head *node_a, *node_b;
+	jack_patch_t *patch_a, *patch_b;
+
+	for (node_a = a->next, node_b = b->next;
+	     node_a != a && node_b != b;
+	     node_a = node_a->next, node_b = node_b->next) {
+		patch_a = list_entry(node_a, jack_patch_t, siblings);
+		patch_b = list_entry(node_b, jack_patch_t, siblings);
+
+		if (strcmp(patch_a->src_desc, patch_b->src_desc) != 0
+		    || strcmp(patch_a->dest_desc, patch_b->dest_desc) != 0
+		    || uuid_compare(patch_a->src_client_id, patch_b->src_client_id) != 0
+		    || uuid_compare(patch_a->dest_client_id, patch_b->dest_client_id) != 0)
+			return false;
+	}
+
+	return node_a == a && node_b == b;
+}
+
+bool
+jack_mgr_client_patch_list_refers_to(struct list_head *patches,
+                                     const char       *client_name)
+{
+	struct list_head *node;
+	jack_patch_t *patch;
+
+	list_for_each (node, patches) {
+		patch = list_entry(node, jack_patch_t, siblings);
+
+		if (strcmp(patch->src_client, client_name) == 0
+		    || strcmp(patch->dest_client, client_name) == 0)
+			return true;
+	}
+
+	return false;
+}
+
+void
+jack_mgr_client_set_backup_patches(jack_mgr_client_t *client,
+                                   struct list_head  *patches)
+{
+	patch_snapshot_unref(client->backup_patches);
+	client->backup_patches =
+		patch_snapshot_new(patches, jack_mgr_client_free_patch_list,
+		                   jack_mgr_client_dup_patch_list);
+}
+
 jack_mgr_client_t *
 jack_mgr_client_find_by_id(struct list_head *client_list,
                            uuid_t            id)
@@ -152,56 +203,6 @@ jack_mgr_client_modified(jack_mgr_client_t *client)
 		project_set_modified_status(lash_client->project, true);
 }
 
-#else /* !HAVE_JACK_DBUS */
-
-void
-jack_mgr_client_dup_uniq_patches(struct list_head *jack_mgr_clients,
-                                 uuid_t            client_id,
-                                 struct list_head *dest)
-{
-	jack_mgr_client_t *client;
-	struct list_head *node, *next, *node2;
-	jack_patch_t *patch, *uniq_patch;
-
-	LIST_HEAD(patches);
-
-	client = jack_mgr_client_find_by_id(jack_mgr_clients, client_id);
-	if (!client) {
-		char id_str[37];
-		uuid_unparse(client_id, id_str);
-		lash_error("Unknown client %s", id_str);
-		return;
-	}
-
-	jack_mgr_client_dup_patch_list(&client->patches, &patches);
-
-	list_for_each_safe (node, next, &patches) {
-		patch = list_entry(node, jack_patch_t, siblings);
-
-		jack_patch_set(patch, jack_mgr_clients);
-
-		list_for_each (node2, dest) {
-			uniq_patch = list_entry(node2, jack_patch_t, siblings);
-
-			if (strcmp(patch->src_client,
-			           uniq_patch->src_client) == 0
-			    && strcmp(patch->src_port,
-			              uniq_patch->src_port) == 0
-			    && strcmp(patch->dest_client,
-			              uniq_patch->dest_client) == 0
-			    && strcmp(patch->dest_port,
-			              uniq_patch->dest_port) == 0) {
-				jack_patch_destroy(patch);
-				goto loop;
-			}
-		}
-
-		list_add_tail(&patch->siblings, dest);
-	loop:
-		continue; /* fix "label at end of compound statement" */
-	}
-}
-
 #endif
 
 /* EOF */
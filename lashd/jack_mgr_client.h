@@ -24,6 +24,7 @@
 
 #include "../config.h"
 
+#include <stdbool.h>
 #include <sys/types.h>
 #include <uuid/uuid.h>
 
@@ -41,12 +42,15 @@ struct _jack_mgr_client
 	// TODO: Add pointer to parent LASH client object, use that to reference the UUID
 	uuid_t            id;
 	struct list_head  old_patches;
-	struct list_head  backup_patches;
+	patch_snapshot_t *backup_patches; /**< Last known patches, or NULL if none. */
 #ifndef HAVE_JACK_DBUS
 	struct list_head  patches;
+	bool              patches_changed; /**< Patches differ from the backup. */
 #else
 	dbus_uint64_t     jackdbus_id;
 	pid_t             pid; /**< Client PID. */
+	unsigned long     backup_graph_serial; /**< Serial of the graph the backup was taken from, or 0 if it is stale. */
+	bool              need_graph_data; /**< Client data must be extracted from the next graph. */
 #endif
 };
 
@@ -63,6 +67,34 @@ jack_mgr_client_dup_patch_list(struct list_head *src,
 void
 jack_mgr_client_free_patch_list(struct list_head *patch_list);
 
+/** Check whether two patch lists describe the same patches in the same order,
+ * with the same client UUIDs.
+ * @param a List of type \ref jack_patch_t.
+ * @param b List of type \ref jack_patch_t.
+ * @return True if the lists are equal, false otherwise.
+ */
+bool
+jack_mgr_client_patch_lists_equal(struct list_head *a,
+                                  struct list_head *b);
+
+/** Check whether any patch in a list connects to a port of a given client.
+ * @param patches List of type \ref jack_patch_t.
+ * @param client_name JACK client name to search for.
+ * @return True if a patch has @a client_name at either end.
+ */
+bool
+jack_mgr_client_patch_list_refers_to(struct list_head *patches,
+                                     const char       *client_name);
+
+/** Replace @a client 's backup patches with a new snapshot.
+ * @param client Pointer to JACK client.
+ * @param patches List of type \ref jack_patch_t. Its contents are moved
+ *                into the snapshot.
+ */
+void
+jack_mgr_client_set_backup_patches(jack_mgr_client_t *client,
+                                   struct list_head  *patches);
+
 jack_mgr_client_t *
 jack_mgr_client_find_by_id(struct list_head *client_list,
                            uuid_t            id);
@@ -88,13 +120,6 @@ jack_mgr_client_find_by_pid(struct list_head *client_list,
 void
 jack_mgr_client_modified(jack_mgr_client_t *client);
 
-#else /* !HAVE_JACK_DBUS */
-
-void
-jack_mgr_client_dup_uniq_patches(struct list_head *jack_mgr_clients,
-                                 uuid_t            client_id,
-                                 struct list_head *dest);
-
 #endif
 
 #endif /* __LASHD_JACK_MGR_CLIENT_H__ */
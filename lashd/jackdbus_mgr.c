@@ -22,6 +22,7 @@
  */
 
 #include <string.h>
+#include <sys/time.h>
 #include <dbus/dbus.h>
 
 #include "common/safety.h"
@@ -29,16 +30,27 @@
 
 #include "jackdbus_mgr.h"
 #include "jack_patch.h"
+#include "patch_snapshot.h"
 #include "jack_mgr_client.h"
 #include "server.h"
 #include "client.h"
 #include "project.h"
+#include "stats.h"
 
 #define JACKDBUS_SERVICE         "org.jackaudio.service"
 #define JACKDBUS_OBJECT          "/org/jackaudio/Controller"
 #define JACKDBUS_IFACE_CONTROL   "org.jackaudio.JackControl"
 #define JACKDBUS_IFACE_PATCHBAY  "org.jackaudio.JackPatchbay"
 
+/* Maximum number of ConnectPortsByName calls awaiting a reply at once */
+#define JACKDBUS_CONNECT_MAX_IN_FLIGHT  16
+/* A failed connection is retried this many times in total */
+#define JACKDBUS_CONNECT_MAX_ATTEMPTS   4
+/* Delay before the first retry, doubled for each subsequent one */
+#define JACKDBUS_CONNECT_RETRY_MSEC     100
+/* A failed GetClientPID or GetGraph call is sent this many times in total */
+#define JACKDBUS_QUERY_MAX_ATTEMPTS     3
+
 static lashd_jackdbus_mgr_t *g_jack_mgr_ptr = NULL;
 
 static DBusHandlerResult
@@ -52,6 +64,16 @@ lashd_jackdbus_mgr_get_unknown_clients(lashd_jackdbus_mgr_t *mgr);
 static bool
 lashd_jackdbus_mgr_get_client_data(jack_mgr_client_t *client);
 
+static void
+lashd_jackdbus_mgr_connect_flush(void);
+
+static void
+lashd_jackdbus_mgr_connect_clear(void);
+
+static void
+lashd_jackdbus_mgr_request_graph(lashd_jackdbus_mgr_t *mgr,
+                                 bool                  will_block);
+
 static
 void
 lashd_jackdbus_mgr_is_server_started_return_handler(
@@ -254,6 +276,9 @@ lashd_jackdbus_mgr_new(void)
 
 	INIT_LIST_HEAD(&mgr->clients);
 	INIT_LIST_HEAD(&mgr->unknown_clients);
+	INIT_LIST_HEAD(&mgr->pid_clients);
+	INIT_LIST_HEAD(&mgr->connect_queue);
+	INIT_LIST_HEAD(&mgr->connect_in_flight);
 	g_jack_mgr_ptr = mgr;
 
 	/* Get list of unknown JACK clients */
@@ -281,15 +306,58 @@ lashd_jackdbus_mgr_graph_free(void)
 	}
 }
 
-/** Return handler for GetClientPid method call in @ref lashd_jackdbus_get_client_pid.
+/** Look for a LASH client with the same PID as the newly resolved JACK client
+ * @a jack_client, bind them together if one is found, otherwise store
+ * @a jack_client as unknown.
+ * @param jack_client Pointer to unlinked JACK client with a valid PID.
+ */
+static void
+lashd_jackdbus_mgr_match_client(jack_mgr_client_t *jack_client)
+{
+	struct lash_client *client;
+
+	if (!(client = server_find_client_by_pid(jack_client->pid))
+	    && !(client = server_find_lost_client_by_pid(jack_client->pid))) {
+		/* None of the known LASH clients have the same PID */
+		lash_debug("Storing unknown JACK client '%s'", jack_client->name);
+		list_add_tail(&jack_client->siblings, &g_jack_mgr_ptr->unknown_clients);
+		/* TODO: we need to create liblash-less client object here */
+		return;
+	}
+
+	/* The new JACK client's PID matches a known LASH client, associate them */
+
+	INIT_LIST_HEAD(&jack_client->siblings);
+	lashd_jackdbus_mgr_bind_client(jack_client, client);
+
+	lash_debug("Client added");
+}
+
+/** The context of a GetClientPID method call. */
+struct lashd_jackdbus_pid_request
+{
+	dbus_uint64_t  client_id; /**< JACK D-Bus ID of the client whose PID is requested. */
+	unsigned int   attempts;  /**< Number of earlier calls which failed. */
+};
+
+static bool
+lashd_jackdbus_mgr_request_pid(dbus_uint64_t client_id,
+                               unsigned int  attempts);
+
+/** Return handler for GetClientPID method call in @ref lashd_jackdbus_mgr_request_pid.
+ * A call which fails is sent again, up to JACKDBUS_QUERY_MAX_ATTEMPTS times.
  * @param pending Pointer to D-Bus pending call.
- * @param data Pointer to memory location in which to store the PID.
+ * @param data Pointer to the request's struct lashd_jackdbus_pid_request.
  */
 static void
 lashd_jackdbus_get_client_pid_return_handler(DBusPendingCall *pending,
                                              void            *data)
 {
+	struct lashd_jackdbus_pid_request *request = data;
 	DBusMessage *msg = dbus_pending_call_steal_reply(pending);
+	dbus_int64_t pid = 0;
+	jack_mgr_client_t *client;
+	bool failed = true;
 
 	if (msg) {
 		const char *err_str;
@@ -301,11 +369,12 @@ lashd_jackdbus_get_client_pid_return_handler(DBusPendingCall *pending,
 			dbus_error_init(&err);
 
 			if (!dbus_message_get_args(msg, &err,
-			                           DBUS_TYPE_INT64, data,
+			                           DBUS_TYPE_INT64, &pid,
 			                           DBUS_TYPE_INVALID)) {
 				lash_error("Cannot get message argument: %s", err.message);
 				dbus_error_free(&err);
-			}
+			} else
+				failed = false;
 		}
 
 		dbus_message_unref(msg);
@@ -313,35 +382,119 @@ lashd_jackdbus_get_client_pid_return_handler(DBusPendingCall *pending,
 		lash_error("Cannot get method return from pending call");
 
 	dbus_pending_call_unref(pending);
+
+	/* The client may have disappeared, or the JACK server may have
+	   stopped, while the call was pending */
+	if (!g_jack_mgr_ptr
+	    || !(client = jack_mgr_client_find_by_jackdbus_id(&g_jack_mgr_ptr->pid_clients,
+	                                                      request->client_id)))
+		return;
+
+	/* Ask again, leaving the client waiting in pid_clients */
+	if (failed) {
+		if (request->attempts + 1 < JACKDBUS_QUERY_MAX_ATTEMPTS
+		    && lashd_jackdbus_mgr_request_pid(request->client_id,
+		                                      request->attempts + 1))
+			return;
+
+		lash_error("Giving up on the PID of JACK client '%s'", client->name);
+	}
+
+	list_del(&client->siblings);
+
+	/* Not finding a PID means the client died before we got to ask */
+	if (pid <= 0) {
+		jack_mgr_client_destroy(client);
+		return;
+	}
+
+	lash_debug("JACK client '%s' with id %llu has pid %lld", client->name,
+	           (unsigned long long)client->jackdbus_id, (long long)pid);
+
+	client->pid = (pid_t) pid;
+	lashd_jackdbus_mgr_match_client(client);
+
+	lashd_jackdbus_mgr_connect_flush();
+}
+
+/** Send a GetClientPID method call for the JACK client with JACK D-Bus ID
+ * @a client_id without waiting for the reply, which is handled by
+ * @ref lashd_jackdbus_get_client_pid_return_handler.
+ * @param client_id JACK D-Bus ID of JACK client.
+ * @param attempts Number of earlier calls for the same client which failed.
+ * @return True if the call was queued, false otherwise.
+ */
+static bool
+lashd_jackdbus_mgr_request_pid(dbus_uint64_t client_id,
+                               unsigned int  attempts)
+{
+	DBusMessage *msg;
+	DBusPendingCall *pending = NULL;
+	struct lashd_jackdbus_pid_request *request;
+
+	msg = dbus_message_new_method_call(JACKDBUS_SERVICE,
+	                                   JACKDBUS_OBJECT,
+	                                   JACKDBUS_IFACE_PATCHBAY,
+	                                   "GetClientPID");
+	if (!msg) {
+		lash_error("Ran out of memory trying to create new method call");
+		return false;
+	}
+
+	if (!dbus_message_append_args(msg, DBUS_TYPE_UINT64, &client_id,
+	                              DBUS_TYPE_INVALID)
+	    || !dbus_connection_send_with_reply(g_server->dbus_service->connection,
+	                                        msg, &pending, -1)
+	    || !pending) {
+		lash_error("Ran out of memory trying to queue method call");
+		dbus_message_unref(msg);
+		return false;
+	}
+
+	dbus_message_unref(msg);
+
+	request = lash_malloc(1, sizeof(struct lashd_jackdbus_pid_request));
+	request->client_id = client_id;
+	request->attempts = attempts;
+	dbus_pending_call_set_notify(pending,
+	                             lashd_jackdbus_get_client_pid_return_handler,
+	                             request, free);
+
+	return true;
 }
 
-/** Get the PID of the JACK client whose JACK ID matches @a client_id.
- * @param client_id ID of JACK client whose PID to get.
- * @return PID of JACK client whose ID matches @a client_id, or 0 if no such
- *         client exists.
+/** Create a JACK client object for the JACK client named @a client_name
+ * and request its PID from jackdbus without waiting for the reply. The
+ * object is kept in @a mgr 's pid_clients list until the reply arrives and
+ * is handled by @ref lashd_jackdbus_get_client_pid_return_handler. The
+ * caller must flush the D-Bus connection, so that a batch of requests can
+ * be sent together.
+ * @param mgr Pointer to JACK D-Bus manager.
+ * @param client_name Name of JACK client.
+ * @param client_id JACK D-Bus ID of JACK client.
+ * @return True if the request was queued, false otherwise.
  */
-static dbus_int64_t
-lashd_jackdbus_get_client_pid(dbus_uint64_t client_id)
+static bool
+lashd_jackdbus_mgr_resolve_pid(lashd_jackdbus_mgr_t *mgr,
+                               const char           *client_name,
+                               dbus_uint64_t         client_id)
 {
-	dbus_int64_t pid;
-
-	pid = 0;
-	if (!method_call_new_valist(g_server->dbus_service, &pid,
-	                            lashd_jackdbus_get_client_pid_return_handler,
-	                            true,
-	                            JACKDBUS_SERVICE,
-	                            JACKDBUS_OBJECT,
-	                            JACKDBUS_IFACE_PATCHBAY,
-	                            "GetClientPID",
-	                            DBUS_TYPE_UINT64, &client_id,
-	                            DBUS_TYPE_INVALID))
-		pid = 0;
-
-	return pid;
+	jack_mgr_client_t *client;
+
+	if (!lashd_jackdbus_mgr_request_pid(client_id, 0))
+		return false;
+
+	client = jack_mgr_client_new();
+	client->name = lash_strdup(client_name);
+	client->jackdbus_id = client_id;
+	list_add_tail(&client->siblings, &mgr->pid_clients);
+
+	return true;
 }
 
-/** Fill @a mgr 's unknown_clients list with one @a jack_mgr_client_t object per
- * each currently running JACK client. This is done in @a lashd_jackdbus_mgr_new
+/** Request the PID of each currently running JACK client, the replies will
+ * fill @a mgr 's unknown_clients list with one @a jack_mgr_client_t object per
+ * client. This is done in @a lashd_jackdbus_mgr_new
  * for @a mgr to be able to later on match JACK client PIDs against LASH clients.
  * @a mgr must be properly initialized, contain a valid graph, and its
  * unknown_clients list must be empty.
@@ -355,8 +508,6 @@ lashd_jackdbus_mgr_get_unknown_clients(lashd_jackdbus_mgr_t *mgr)
 	DBusMessageIter iter, array_iter, struct_iter;
 	dbus_uint64_t client_id;
 	const char *client_name;
-	dbus_int64_t pid;
-	jack_mgr_client_t *jack_client;
 
 	if (!mgr->graph) {
 		lash_error("Cannot find graph");
@@ -389,21 +540,13 @@ lashd_jackdbus_mgr_get_unknown_clients(lashd_jackdbus_mgr_t *mgr)
 			goto fail;
 		}
 
-		pid = lashd_jackdbus_get_client_pid(client_id);
-		if (pid != 0)
-		{
-			/* Create JACK client and store in mgr->unknown_clients */
-			jack_client = jack_mgr_client_new();
-			jack_client->name = lash_strdup(client_name);
-			jack_client->jackdbus_id = client_id;
-			jack_client->pid = (pid_t)pid;
-			lash_debug("Storing unknown JACK client '%s'", client_name);
-			list_add_tail(&jack_client->siblings, &mgr->unknown_clients);
-		}
+		lashd_jackdbus_mgr_resolve_pid(mgr, client_name, client_id);
 
 		dbus_message_iter_next(&array_iter);
 	}
 
+	/* Send all PID requests in one go */
+	dbus_connection_flush(g_server->dbus_service->connection);
 	return;
 
 fail:
@@ -424,6 +567,12 @@ lashd_jackdbus_mgr_clear(
 		jack_mgr_client_destroy(list_entry(node, jack_mgr_client_t, siblings));
 	}
 
+	list_for_each_safe (node, next, &g_jack_mgr_ptr->pid_clients)
+	{
+		jack_mgr_client_destroy(list_entry(node, jack_mgr_client_t, siblings));
+	}
+
+	lashd_jackdbus_mgr_connect_clear();
 	lashd_jackdbus_mgr_graph_free();
 }
 
@@ -439,6 +588,25 @@ lashd_jackdbus_mgr_destroy(lashd_jackdbus_mgr_t *mgr)
 	}
 }
 
+/* Backups refer to other clients by UUID, so the ones which mention a
+   client must be redone when it comes or goes */
+static void
+lashd_jackdbus_mgr_invalidate_backups(lashd_jackdbus_mgr_t *mgr,
+                                      const char           *client_name)
+{
+	struct list_head *node;
+	jack_mgr_client_t *client;
+
+	list_for_each (node, &mgr->clients) {
+		client = list_entry(node, jack_mgr_client_t, siblings);
+
+		if (client->backup_patches
+		    && jack_mgr_client_patch_list_refers_to(&client->backup_patches->patches,
+		                                            client_name))
+			client->backup_graph_serial = 0;
+	}
+}
+
 void
 lashd_jackdbus_mgr_bind_client(
 	jack_mgr_client_t * jack_client_ptr,
@@ -455,69 +623,393 @@ lashd_jackdbus_mgr_bind_client(
 	jack_mgr_client_free_patch_list(&jack_client_ptr->old_patches);
 	INIT_LIST_HEAD(&jack_client_ptr->old_patches);
 	list_splice_init(&lash_client_ptr->jack_patches, &jack_client_ptr->old_patches);
-	jack_mgr_client_dup_patch_list(&jack_client_ptr->old_patches, &jack_client_ptr->backup_patches);
+	if (!list_empty(&jack_client_ptr->old_patches)) {
+		LIST_HEAD(patches);
+		jack_mgr_client_dup_patch_list(&jack_client_ptr->old_patches, &patches);
+		jack_mgr_client_set_backup_patches(jack_client_ptr, &patches);
+	}
+	jack_client_ptr->backup_graph_serial = 0;
 
 	/* Add JACK client to the active client list */
+	lashd_jackdbus_mgr_invalidate_backups(g_jack_mgr_ptr, jack_client_ptr->name);
 	list_add_tail(&jack_client_ptr->siblings, &g_jack_mgr_ptr->clients);
 
-	/* Extract JACK client's data from latest graph */
-	lashd_jackdbus_mgr_get_graph(g_jack_mgr_ptr);
-	if (!lashd_jackdbus_mgr_get_client_data(jack_client_ptr))
-		lash_error("Problem extracting client data from graph");
+	/* Extract JACK client's data from the graph once it arrives */
+	jack_client_ptr->need_graph_data = true;
+	lashd_jackdbus_mgr_request_graph(g_jack_mgr_ptr, false);
 
 	/* Copy JACK client name to LASH client, make sure it has a class string */
 	lash_strset(&lash_client_ptr->jack_client_name, jack_client_ptr->name);
 	client_maybe_fill_class(lash_client_ptr);
 }
 
+/** A pending ConnectPortsByName or DisconnectPortsByName request. */
+struct lashd_jackdbus_connect
+{
+	struct list_head  siblings;
+	uuid_t            owner_id;   /**< UUID of the LASH client whose patch this is. */
+	bool              disconnect; /**< Whether the ports are to be disconnected instead. */
+	char             *src_client;
+	char             *src_port;
+	char             *dest_client;
+	char             *dest_port;
+	unsigned int      attempts;
+	struct timeval    retry_time; /**< Earliest time at which the request may be (re)sent. */
+	DBusPendingCall  *pending;
+};
+
+static void
+lashd_jackdbus_connect_destroy(struct lashd_jackdbus_connect *connect)
+{
+	if (connect->pending) {
+		dbus_pending_call_cancel(connect->pending);
+		dbus_pending_call_unref(connect->pending);
+	}
+
+	free(connect->src_client);
+	free(connect->src_port);
+	free(connect->dest_client);
+	free(connect->dest_port);
+	free(connect);
+}
+
+static bool
+lashd_jackdbus_connect_matches(struct lashd_jackdbus_connect *connect,
+                               bool                           disconnect,
+                               const char                    *client1_name,
+                               const char                    *port1_name,
+                               const char                    *client2_name,
+                               const char                    *port2_name)
+{
+	return (connect->disconnect == disconnect
+	        && strcmp(connect->src_client, client1_name) == 0
+	        && strcmp(connect->src_port, port1_name) == 0
+	        && strcmp(connect->dest_client, client2_name) == 0
+	        && strcmp(connect->dest_port, port2_name) == 0);
+}
+
+static struct lashd_jackdbus_connect *
+lashd_jackdbus_connect_find(struct list_head *list,
+                            bool              disconnect,
+                            const char       *client1_name,
+                            const char       *port1_name,
+                            const char       *client2_name,
+                            const char       *port2_name)
+{
+	struct list_head *node;
+	struct lashd_jackdbus_connect *connect;
+
+	list_for_each (node, list) {
+		connect = list_entry(node, struct lashd_jackdbus_connect, siblings);
+		if (lashd_jackdbus_connect_matches(connect, disconnect,
+		                                   client1_name, port1_name,
+		                                   client2_name, port2_name))
+			return connect;
+	}
+
+	return NULL;
+}
+
+static long
+lashd_jackdbus_timeval_diff_msec(const struct timeval *a,
+                                 const struct timeval *b)
+{
+	return ((a->tv_sec - b->tv_sec) * 1000
+	        + (a->tv_usec - b->tv_usec) / 1000);
+}
+
+/** Return the project owning the LASH client with UUID @a id, or NULL if
+ * the client is no longer loaded.
+ */
+static project_t *
+lashd_jackdbus_connect_get_project(uuid_t id)
+{
+	struct lash_client *client;
+
+	client = server_find_client_by_id(id);
+
+	return client ? client->project : NULL;
+}
+
+/* How a connection request ended, for the reconnection statistics */
+enum
+{
+	JACKDBUS_CONNECT_DONE = 0,
+	JACKDBUS_CONNECT_FAILED,
+	JACKDBUS_CONNECT_CANCELLED  /* Dropped against a request of the opposite kind */
+};
+
+/** Account for a finished connection request in the owning project's
+ * reconnection statistics, and report the throughput once all of the
+ * project's queued patches have been handled. Cancelled requests never
+ * reached JACK, so they are counted separately and left out of the
+ * throughput.
+ */
+static void
+lashd_jackdbus_connect_account(struct lashd_jackdbus_connect *connect,
+                               int                            result)
+{
+	project_t *project;
+	struct timeval now;
+	long msec;
+
+	if (!(project = lashd_jackdbus_connect_get_project(connect->owner_id))
+	    || project->patches_pending == 0)
+		return;
+
+	if (result == JACKDBUS_CONNECT_DONE)
+		++project->patches_connected;
+	else if (result == JACKDBUS_CONNECT_FAILED)
+		++project->patches_failed;
+	else
+		++project->patches_cancelled;
+
+	if (--project->patches_pending != 0)
+		return;
+
+	gettimeofday(&now, NULL);
+	msec = lashd_jackdbus_timeval_diff_msec(&now, &project->patches_start_time);
+
+	lash_info("Project '%s': applied %u JACK patch changes (%u failed, %u cancelled) in %ld ms (%.1f patches/s)",
+	          project->name, project->patches_connected,
+	          project->patches_failed, project->patches_cancelled, msec,
+	          msec > 0
+	          ? (double)(project->patches_connected + project->patches_failed) * 1000.0 / msec
+	          : 0.0);
+
+	project->patches_connected = 0;
+	project->patches_failed = 0;
+	project->patches_cancelled = 0;
+}
+
 static void
 lashd_jackdbus_connect_return_handler(DBusPendingCall *pending,
                                       void            *data)
 {
+	struct lashd_jackdbus_connect *connect = data;
 	DBusMessage *msg = dbus_pending_call_steal_reply(pending);
+	const char *err_str = "No method return";
+	bool success = false;
 
 	if (msg) {
-		const char *err_str;
-
-		if (!method_return_verify(msg, &err_str))
-			lash_error("Failed to connect ports: %s", err_str);
-		else
-			lash_debug("Ports connected");
+		if (method_return_verify(msg, &err_str))
+			success = true;
 
 		dbus_message_unref(msg);
-	} else
-		lash_error("Cannot get method return from pending call");
+	}
 
 	dbus_pending_call_unref(pending);
+	connect->pending = NULL;
+
+	list_del(&connect->siblings);
+	--g_jack_mgr_ptr->connect_in_flight_count;
+
+	if (success) {
+		lash_debug("Ports '%s:%s' -> '%s:%s' %s",
+		           connect->src_client, connect->src_port,
+		           connect->dest_client, connect->dest_port,
+		           connect->disconnect ? "disconnected" : "connected");
+		lashd_jackdbus_connect_account(connect, JACKDBUS_CONNECT_DONE);
+		lashd_jackdbus_connect_destroy(connect);
+	} else if (++connect->attempts < JACKDBUS_CONNECT_MAX_ATTEMPTS) {
+		long delay = JACKDBUS_CONNECT_RETRY_MSEC << (connect->attempts - 1);
+
+		lash_debug("Failed to %s ports '%s:%s' -> '%s:%s', "
+		           "retrying in %ld ms: %s",
+		           connect->disconnect ? "disconnect" : "connect",
+		           connect->src_client, connect->src_port,
+		           connect->dest_client, connect->dest_port,
+		           delay, err_str);
+
+		gettimeofday(&connect->retry_time, NULL);
+		connect->retry_time.tv_sec += delay / 1000;
+		connect->retry_time.tv_usec += (delay % 1000) * 1000;
+		if (connect->retry_time.tv_usec >= 1000000) {
+			++connect->retry_time.tv_sec;
+			connect->retry_time.tv_usec -= 1000000;
+		}
+
+		list_add_tail(&connect->siblings, &g_jack_mgr_ptr->connect_queue);
+	} else {
+		lash_error("Failed to %s ports '%s:%s' -> '%s:%s': %s",
+		           connect->disconnect ? "disconnect" : "connect",
+		           connect->src_client, connect->src_port,
+		           connect->dest_client, connect->dest_port,
+		           err_str);
+		lashd_jackdbus_connect_account(connect, JACKDBUS_CONNECT_FAILED);
+		lashd_jackdbus_connect_destroy(connect);
+	}
+
+	/* A slot in the window was freed, refill it */
+	lashd_jackdbus_mgr_connect_flush();
+}
+
+/** Send as many queued connection requests as the in-flight window allows.
+ * Requests are written out back-to-back and the connection is flushed once,
+ * so that jackdbus can process them as a pipeline instead of one round trip
+ * at a time.
+ */
+static void
+lashd_jackdbus_mgr_connect_flush(void)
+{
+	struct list_head *node, *next;
+	struct lashd_jackdbus_connect *connect;
+	DBusMessage *msg;
+	struct timeval now;
+	bool sent = false;
+
+	if (list_empty(&g_jack_mgr_ptr->connect_queue))
+		return;
+
+	gettimeofday(&now, NULL);
+
+	list_for_each_safe (node, next, &g_jack_mgr_ptr->connect_queue) {
+		if (g_jack_mgr_ptr->connect_in_flight_count >= JACKDBUS_CONNECT_MAX_IN_FLIGHT)
+			break;
+
+		connect = list_entry(node, struct lashd_jackdbus_connect, siblings);
+
+		/* Still backing off */
+		if (lashd_jackdbus_timeval_diff_msec(&connect->retry_time, &now) > 0)
+			continue;
+
+		msg = dbus_message_new_method_call(JACKDBUS_SERVICE,
+		                                   JACKDBUS_OBJECT,
+		                                   JACKDBUS_IFACE_PATCHBAY,
+		                                   (connect->disconnect
+		                                    ? "DisconnectPortsByName"
+		                                    : "ConnectPortsByName"));
+		if (!msg) {
+			lash_error("Ran out of memory trying to create new method call");
+			break;
+		}
+
+		if (!dbus_message_append_args(msg,
+		                              DBUS_TYPE_STRING, &connect->src_client,
+		                              DBUS_TYPE_STRING, &connect->src_port,
+		                              DBUS_TYPE_STRING, &connect->dest_client,
+		                              DBUS_TYPE_STRING, &connect->dest_port,
+		                              DBUS_TYPE_INVALID)
+		    || !dbus_connection_send_with_reply(g_server->dbus_service->connection,
+		                                        msg, &connect->pending, -1)
+		    || !connect->pending) {
+			lash_error("Ran out of memory trying to queue method call");
+			dbus_message_unref(msg);
+			break;
+		}
+
+		dbus_message_unref(msg);
+
+		dbus_pending_call_set_notify(connect->pending,
+		                             lashd_jackdbus_connect_return_handler,
+		                             connect, NULL);
+
+		list_del(&connect->siblings);
+		list_add_tail(&connect->siblings, &g_jack_mgr_ptr->connect_in_flight);
+		++g_jack_mgr_ptr->connect_in_flight_count;
+		sent = true;
+	}
+
+	if (sent)
+		dbus_connection_flush(g_server->dbus_service->connection);
 }
 
+/** Queue a port connection or disconnection request on behalf of the LASH
+ * client whose UUID is @a owner_id. Requests identical to one already queued
+ * or in flight are dropped, and a queued request for the opposite operation
+ * on the same ports is cancelled. Queued requests are sent by
+ * @ref lashd_jackdbus_mgr_connect_flush.
+ */
 static void
-lashd_jackdbus_mgr_connect_ports(const char *client1_name,
+lashd_jackdbus_mgr_queue_ports(uuid_t      owner_id,
+                               bool        disconnect,
+                               const char *client1_name,
+                               const char *port1_name,
+                               const char *client2_name,
+                               const char *port2_name)
+{
+	struct lashd_jackdbus_connect *connect;
+	project_t *project;
+
+	if (lashd_jackdbus_connect_find(&g_jack_mgr_ptr->connect_queue, disconnect,
+	                                client1_name, port1_name,
+	                                client2_name, port2_name)
+	    || lashd_jackdbus_connect_find(&g_jack_mgr_ptr->connect_in_flight, disconnect,
+	                                   client1_name, port1_name,
+	                                   client2_name, port2_name)) {
+		lash_debug("Patch '%s:%s' -> '%s:%s' is already queued",
+		           client1_name, port1_name, client2_name, port2_name);
+		return;
+	}
+
+	if ((connect = lashd_jackdbus_connect_find(&g_jack_mgr_ptr->connect_queue, !disconnect,
+	                                           client1_name, port1_name,
+	                                           client2_name, port2_name))) {
+		lash_debug("Cancelling queued %s of patch '%s:%s' -> '%s:%s'",
+		           disconnect ? "connection" : "disconnection",
+		           client1_name, port1_name, client2_name, port2_name);
+		list_del(&connect->siblings);
+		lashd_jackdbus_connect_account(connect, JACKDBUS_CONNECT_CANCELLED);
+		lashd_jackdbus_connect_destroy(connect);
+	}
+
+	if (disconnect)
+		lash_info("Disconnecting patch '%s:%s' -> '%s:%s'",
+		          client1_name, port1_name, client2_name, port2_name);
+	else
+		lash_info("Attempting to resume patch '%s:%s' -> '%s:%s'",
+		          client1_name, port1_name, client2_name, port2_name);
+
+	connect = lash_calloc(1, sizeof(struct lashd_jackdbus_connect));
+	uuid_copy(connect->owner_id, owner_id);
+	connect->disconnect = disconnect;
+	connect->src_client = lash_strdup(client1_name);
+	connect->src_port = lash_strdup(port1_name);
+	connect->dest_client = lash_strdup(client2_name);
+	connect->dest_port = lash_strdup(port2_name);
+
+	list_add_tail(&connect->siblings, &g_jack_mgr_ptr->connect_queue);
+
+	if ((project = lashd_jackdbus_connect_get_project(owner_id))) {
+		if (project->patches_pending++ == 0)
+			gettimeofday(&project->patches_start_time, NULL);
+	}
+}
+
+static __inline__ void
+lashd_jackdbus_mgr_connect_ports(uuid_t      owner_id,
+                                 const char *client1_name,
                                  const char *port1_name,
                                  const char *client2_name,
                                  const char *port2_name)
 {
-	lash_info("Attempting to resume patch '%s:%s' -> '%s:%s'",
-	           client1_name, port1_name, client2_name, port2_name);
+	lashd_jackdbus_mgr_queue_ports(owner_id, false, client1_name, port1_name,
+	                               client2_name, port2_name);
+}
 
-	/* Send a port connect request */
-	method_call_new_valist(g_server->dbus_service,
-	                       NULL,
-	                       lashd_jackdbus_connect_return_handler,
-	                       false,
-	                       JACKDBUS_SERVICE,
-	                       JACKDBUS_OBJECT,
-	                       JACKDBUS_IFACE_PATCHBAY,
-	                       "ConnectPortsByName",
-	                       DBUS_TYPE_STRING,
-	                       &client1_name,
-	                       DBUS_TYPE_STRING,
-	                       &port1_name,
-	                       DBUS_TYPE_STRING,
-	                       &client2_name,
-	                       DBUS_TYPE_STRING,
-	                       &port2_name,
-	                       DBUS_TYPE_INVALID);
+static void
+lashd_jackdbus_mgr_connect_clear(void)
+{
+	struct list_head *node, *next;
+
+	list_for_each_safe (node, next, &g_jack_mgr_ptr->connect_queue) {
+		list_del(node);
+		lashd_jackdbus_connect_destroy(list_entry(node, struct lashd_jackdbus_connect, siblings));
+	}
+
+	list_for_each_safe (node, next, &g_jack_mgr_ptr->connect_in_flight) {
+		list_del(node);
+		lashd_jackdbus_connect_destroy(list_entry(node, struct lashd_jackdbus_connect, siblings));
+	}
+
+	g_jack_mgr_ptr->connect_in_flight_count = 0;
+}
+
+void
+lashd_jackdbus_mgr_run(lashd_jackdbus_mgr_t *mgr)
+{
+	if (mgr)
+		lashd_jackdbus_mgr_connect_flush();
 }
 
 static
@@ -526,40 +1018,15 @@ lashd_jackdbus_on_client_appeared(
 	const char * client_name,
 	dbus_uint64_t client_id)
 {
-	dbus_int64_t pid;
-	struct lash_client * client_ptr;
-	jack_mgr_client_t * jack_client_ptr;
-
-	/* Not finding a PID means the client died before we got this signal */
-	if ((pid = lashd_jackdbus_get_client_pid(client_id)) <= 0)
-		return;
+	lash_debug("New JACK client '%s' with id %llu",
+	           client_name, (unsigned long long)client_id);
 
-	lash_debug("New JACK client '%s' with id %llu, pid %lld",
-	           client_name, (unsigned long long)client_id, (long long)pid);
-
-	jack_client_ptr = jack_mgr_client_new();
-	jack_client_ptr->name = lash_strdup(client_name);
-	jack_client_ptr->jackdbus_id = client_id;
-	jack_client_ptr->pid = (pid_t) pid;
-
-	if (!(client_ptr = server_find_client_by_pid(pid))
-	    && !(client_ptr = server_find_lost_client_by_pid(pid))) {
-		/* None of the known LASH clients have the same PID */
-		lash_debug("Storing unknown JACK client '%s'", client_name);
-		list_add_tail(&jack_client_ptr->siblings, &g_jack_mgr_ptr->unknown_clients);
-		/* TODO: we need to create liblash-less client object here */
-		return;
-	}
-
-	/* The new JACK client's PID matches a known LASH client, associate them */
-
-	INIT_LIST_HEAD(&jack_client_ptr->siblings);
-	lashd_jackdbus_mgr_bind_client(jack_client_ptr, client_ptr);
-
-	lash_debug("Client added");
+	/* The client is matched against LASH clients once its PID is known */
+	if (lashd_jackdbus_mgr_resolve_pid(g_jack_mgr_ptr, client_name, client_id))
+		dbus_connection_flush(g_server->dbus_service->connection);
 }
 
-/** Remove the unknown client whose id parameter matches \a client_id.
+/** Remove the unknown or unresolved client whose id parameter matches \a client_id.
  * @param client_id The disappeared client's JACK D-Bus ID.
  */
 static void
@@ -567,7 +1034,8 @@ lashd_jackdbus_on_client_disappeared(dbus_uint64_t client_id)
 {
 	jack_mgr_client_t *client;
 
-	if (!(client = jack_mgr_client_find_by_jackdbus_id(&g_jack_mgr_ptr->unknown_clients, client_id)))
+	if (!(client = jack_mgr_client_find_by_jackdbus_id(&g_jack_mgr_ptr->unknown_clients, client_id))
+	    && !(client = jack_mgr_client_find_by_jackdbus_id(&g_jack_mgr_ptr->pid_clients, client_id)))
 		return;
 
 	lash_debug("Removing unknown JACK client '%s'", client->name);
@@ -608,7 +1076,8 @@ lashd_jackdbus_mgr_new_foreign_port(const char *client_name,
 				    || strcmp(patch->dest_port, port_name) != 0)
 					continue;
 
-				lashd_jackdbus_mgr_connect_ports(client->name,
+				lashd_jackdbus_mgr_connect_ports(client->id,
+				                                 client->name,
 				                                 patch->src_port,
 				                                 client_name,
 				                                 port_name);
@@ -618,7 +1087,8 @@ lashd_jackdbus_mgr_new_foreign_port(const char *client_name,
 				    || strcmp(patch->src_port, port_name) != 0)
 					continue;
 
-				lashd_jackdbus_mgr_connect_ports(client_name,
+				lashd_jackdbus_mgr_connect_ports(client->id,
+				                                 client_name,
 				                                 port_name,
 				                                 client->name,
 				                                 patch->dest_port);
@@ -652,7 +1122,8 @@ lashd_jackdbus_mgr_new_client_port(jack_mgr_client_t *client,
 			                                          patch->dest_client_id))
 			          ? (c->name ? c->name : "")
 			          : ""));
-			lashd_jackdbus_mgr_connect_ports(client_name, port_name,
+			lashd_jackdbus_mgr_connect_ports(client->id,
+			                                 client_name, port_name,
 			                                 ptr, patch->dest_port);
 		} else if (uuid_compare(patch->dest_client_id, client->id) == 0
 		    && strcmp(patch->dest_port, port_name) == 0) {
@@ -662,7 +1133,8 @@ lashd_jackdbus_mgr_new_client_port(jack_mgr_client_t *client,
 			                                          patch->src_client_id))
 			          ? (c->name ? c->name : "")
 			          : ""));
-			lashd_jackdbus_mgr_connect_ports(ptr, patch->src_port,
+			lashd_jackdbus_mgr_connect_ports(client->id,
+			                                 ptr, patch->src_port,
 			                                 client_name, port_name);
 		}
 	}
@@ -828,6 +1300,7 @@ lashd_jackdbus_handle_patchbay_signal(
 			lashd_jackdbus_mgr_new_foreign_port(client1_name, port1_name);
 		}
 
+		lashd_jackdbus_mgr_connect_flush();
 		return;
 	}
 
@@ -1017,6 +1490,7 @@ lashd_jackdbus_handler(DBusConnection *connection,
 	if ((path = dbus_message_get_path(message))
 	    && strcmp(path, JACKDBUS_OBJECT) == 0) {
 		if (strcmp(interface, JACKDBUS_IFACE_PATCHBAY) == 0) {
+			stats_count(STATS_JACK_EVENTS);
 			lashd_jackdbus_handle_patchbay_signal(message);
 			return DBUS_HANDLER_RESULT_HANDLED;
 		} else if (strcmp(interface, JACKDBUS_IFACE_CONTROL) == 0) {
@@ -1273,9 +1747,12 @@ lashd_jackdbus_mgr_remove_client(lashd_jackdbus_mgr_t *mgr,
 	lash_debug("Removing client '%s'", client->name);
 
 	list_del(&client->siblings);
+	lashd_jackdbus_mgr_invalidate_backups(mgr, client->name);
 
-	if (backup_patches)
-		list_splice_init(&client->backup_patches, backup_patches);
+	if (backup_patches) {
+		patch_snapshot_release(client->backup_patches, backup_patches);
+		client->backup_patches = NULL;
+	}
 
 	jack_mgr_client_destroy(client);
 
@@ -1283,10 +1760,12 @@ lashd_jackdbus_mgr_remove_client(lashd_jackdbus_mgr_t *mgr,
 }
 
 bool
-lashd_jackdbus_mgr_get_client_patches(lashd_jackdbus_mgr_t *mgr,
-                                      uuid_t                id,
-                                      struct list_head     *dest)
+lashd_jackdbus_mgr_get_client_patches(lashd_jackdbus_mgr_t  *mgr,
+                                      uuid_t                 id,
+                                      patch_snapshot_t     **snapshot_ptr)
 {
+	*snapshot_ptr = NULL;
+
 	if (!mgr) {
 		lash_error("JACK manager pointer is NULL");
 		return false;
@@ -1299,6 +1778,8 @@ lashd_jackdbus_mgr_get_client_patches(lashd_jackdbus_mgr_t *mgr,
 	const char *client1_name, *port1_name, *client2_name, *port2_name;
 	uuid_t *client1_uuid, *client2_uuid;
 
+	LIST_HEAD(patches);
+
 	if (!mgr->graph) {
 		lash_error("Cannot find graph");
 		return false;
@@ -1312,6 +1793,10 @@ lashd_jackdbus_mgr_get_client_patches(lashd_jackdbus_mgr_t *mgr,
 		return false;
 	}
 
+	/* Nothing to do if the graph hasn't changed since the last snapshot */
+	if (client->backup_graph_serial == mgr->graph_serial)
+		goto done;
+
 	lash_debug("Getting patches for client '%s'", client->name);
 
 	/* The graph message has already been checked, this should be safe */
@@ -1358,20 +1843,29 @@ lashd_jackdbus_mgr_get_client_patches(lashd_jackdbus_mgr_t *mgr,
 		patch = jack_patch_new_with_all(client1_uuid, client2_uuid,
 		                                client1_name, client2_name,
 		                                port1_name, port2_name);
-		list_add_tail(&patch->siblings, dest);
+		list_add_tail(&patch->siblings, &patches);
 
 		dbus_message_iter_next(&array_iter);
 	}
 
-	/* Make a fresh backup of the newly acquired patch list */
-	jack_mgr_client_free_patch_list(&client->backup_patches);
-	INIT_LIST_HEAD(&client->backup_patches);
-	if (!list_empty(dest))
-		jack_mgr_client_dup_patch_list(dest, &client->backup_patches);
+	/* Only replace the backup if the patches have changed since, so that
+	   references to it stay valid */
+	if (client->backup_patches
+	    ? !jack_mgr_client_patch_lists_equal(&patches, &client->backup_patches->patches)
+	    : !list_empty(&patches))
+		jack_mgr_client_set_backup_patches(client, &patches);
+	else
+		jack_mgr_client_free_patch_list(&patches);
 
+	client->backup_graph_serial = mgr->graph_serial;
+
+done:
+	*snapshot_ptr = patch_snapshot_ref(client->backup_patches);
 	return true;
 
 fail:
+	jack_mgr_client_free_patch_list(&patches);
+
 	/* If we're here there was something rotten in the graph message,
 	   we should remove it */
 	lashd_jackdbus_mgr_graph_free();
@@ -1379,6 +1873,30 @@ fail:
 
 }
 
+/** Extract the data of all bound clients which are waiting for a graph
+ * from the current graph, and send the resulting patch connections.
+ */
+static void
+lashd_jackdbus_mgr_get_pending_client_data(void)
+{
+	struct list_head *node;
+	jack_mgr_client_t *client;
+
+	list_for_each (node, &g_jack_mgr_ptr->clients) {
+		client = list_entry(node, jack_mgr_client_t, siblings);
+
+		if (!client->need_graph_data)
+			continue;
+
+		client->need_graph_data = false;
+
+		if (!lashd_jackdbus_mgr_get_client_data(client))
+			lash_error("Problem extracting client data from graph");
+	}
+
+	lashd_jackdbus_mgr_connect_flush();
+}
+
 static void
 lashd_jackdbus_mgr_graph_return_handler(DBusPendingCall *pending,
                                         void            *data)
@@ -1391,49 +1909,68 @@ lashd_jackdbus_mgr_graph_return_handler(DBusPendingCall *pending,
 	const char *err_str;
 
 	msg = dbus_pending_call_steal_reply(pending);
+	dbus_pending_call_unref(pending);
 
 	/* Check that the message is valid */
 	if (!msg) {
 		lash_error("Cannot get method return from pending call");
-		goto end;
+		goto fail;
 	} else if (!method_return_verify(msg, &err_str)) {
 		lash_error("Failed to get graph: %s", err_str);
-		goto end_unref_msg;
+		goto fail_unref_msg;
 	} else if (!dbus_message_iter_init(msg, &iter)) {
 		lash_error("Method return has no arguments");
-		goto end_unref_msg;
+		goto fail_unref_msg;
 	}
 
 	/* Check that the graph version argument is valid */
 	if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_UINT64) {
 		lash_error("Cannot find graph version in graph");
-		goto end_unref_msg;
+		goto fail_unref_msg;
 	}
 
+	if (g_jack_mgr_ptr)
+		g_jack_mgr_ptr->graph_failures = 0;
+
 	/* Get the graph version and see if we already have the latest one */
 	dbus_message_iter_get_basic(&iter, &graph_version);
 	if (graph_version == g_jack_mgr_ptr->graph_version) {
 		lash_debug("Current graph is already the latest version");
-		goto end_unref_msg;
+		dbus_message_unref(msg);
+	} else {
+		/* Free the old graph and save the new one */
+		lashd_jackdbus_mgr_graph_free();
+		g_jack_mgr_ptr->graph = msg;
+		g_jack_mgr_ptr->graph_version = graph_version;
+		++g_jack_mgr_ptr->graph_serial;
+		lash_debug("Graph saved");
 	}
 
-	/* Free the old graph and save the new one */
-	lashd_jackdbus_mgr_graph_free();
-	g_jack_mgr_ptr->graph = msg;
-	g_jack_mgr_ptr->graph_version = graph_version;
-	lash_debug("Graph saved");
-
-end:
-	dbus_pending_call_unref(pending);
+	lashd_jackdbus_mgr_get_pending_client_data();
 	return;
 
-end_unref_msg:
+fail_unref_msg:
 	dbus_message_unref(msg);
-	dbus_pending_call_unref(pending);
+
+fail:
+	if (!g_jack_mgr_ptr)
+		return;
+
+	/* Ask again, or make do with the graph we have so that the waiting
+	   clients don't keep waiting for a graph which never arrives */
+	if (++g_jack_mgr_ptr->graph_failures < JACKDBUS_QUERY_MAX_ATTEMPTS) {
+		lashd_jackdbus_mgr_request_graph(g_jack_mgr_ptr, false);
+		return;
+	}
+
+	lash_error("Giving up on getting the graph");
+	g_jack_mgr_ptr->graph_failures = 0;
+	lashd_jackdbus_mgr_get_pending_client_data();
 }
 
-void
-lashd_jackdbus_mgr_get_graph(lashd_jackdbus_mgr_t *mgr)
+static void
+lashd_jackdbus_mgr_request_graph(lashd_jackdbus_mgr_t *mgr,
+                                 bool                  will_block)
 {
 	if (!mgr) {
 		lash_error("JACK manager pointer is NULL");
@@ -1445,7 +1982,7 @@ lashd_jackdbus_mgr_get_graph(lashd_jackdbus_mgr_t *mgr)
 	method_call_new_single(g_server->dbus_service,
 	                       NULL,
 	                       lashd_jackdbus_mgr_graph_return_handler,
-	                       true,
+	                       will_block,
 	                       JACKDBUS_SERVICE,
 	                       JACKDBUS_OBJECT,
 	                       JACKDBUS_IFACE_PATCHBAY,
@@ -1454,4 +1991,217 @@ lashd_jackdbus_mgr_get_graph(lashd_jackdbus_mgr_t *mgr)
 	                       &mgr->graph_version);
 }
 
+void
+lashd_jackdbus_mgr_get_graph(lashd_jackdbus_mgr_t *mgr)
+{
+	lashd_jackdbus_mgr_request_graph(mgr, true);
+}
+
+/** Return the UUID of whichever end of @a patch belongs to a LASH client. */
+static uuid_t *
+lashd_jackdbus_mgr_patch_owner(jack_patch_t *patch)
+{
+	return uuid_is_null(patch->src_client_id)
+	       ? &patch->dest_client_id
+	       : &patch->src_client_id;
+}
+
+/** Check whether the JACK client @a client belongs to a LASH client in
+ * @a project.
+ */
+static bool
+lashd_jackdbus_mgr_client_in_project(jack_mgr_client_t *client,
+                                     project_t         *project)
+{
+	struct lash_client *lash_client;
+
+	return (client
+	        && (lash_client = server_find_client_by_id(client->id))
+	        && lash_client->project == project);
+}
+
+/** Resolve the client end of a scene patch to a JACK client name.
+ * @return Client name, or NULL if the client is not running.
+ */
+static const char *
+lashd_jackdbus_mgr_resolve_patch_client(lashd_jackdbus_mgr_t *mgr,
+                                        const char           *name,
+                                        uuid_t                id)
+{
+	jack_mgr_client_t *client;
+
+	if (uuid_is_null(id))
+		return name;
+
+	client = jack_mgr_client_find_by_id(&mgr->clients, id);
+
+	return client ? client->name : NULL;
+}
+
+bool
+lashd_jackdbus_mgr_switch_patches(lashd_jackdbus_mgr_t *mgr,
+                                  project_t            *project,
+                                  struct list_head     *patches)
+{
+	DBusMessageIter iter, array_iter, struct_iter;
+	dbus_uint64_t client1_id, client2_id;
+	const char *client1_name, *port1_name, *client2_name, *port2_name;
+	jack_mgr_client_t *client1, *client2;
+	struct list_head *node, *next;
+	jack_patch_t *patch, *scene_patch;
+	unsigned int connects = 0, disconnects = 0, unchanged = 0;
+	bool retval = false;
+
+	LIST_HEAD(current);
+	LIST_HEAD(wanted);
+
+	if (!mgr) {
+		lash_error("JACK manager pointer is NULL");
+		return false;
+	}
+
+	/* The diff must be made against the live connections */
+	lashd_jackdbus_mgr_get_graph(mgr);
+	if (!mgr->graph) {
+		lash_error("Cannot find graph");
+		return false;
+	}
+
+	/* The graph message has already been checked, this should be safe */
+	dbus_message_iter_init(mgr->graph, &iter);
+
+	/* Skip over the graph version and client array arguments */
+	dbus_message_iter_next(&iter);
+	dbus_message_iter_next(&iter);
+
+	if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY) {
+		lash_error("Cannot find patch array in graph");
+		lashd_jackdbus_mgr_graph_free();
+		return false;
+	}
+
+	/* Collect the current connections of the project's clients */
+	dbus_message_iter_recurse(&iter, &array_iter);
+	while (dbus_message_iter_get_arg_type(&array_iter) == DBUS_TYPE_STRUCT) {
+		dbus_message_iter_recurse(&array_iter, &struct_iter);
+
+		if (!method_iter_get_args(&struct_iter,
+		                          DBUS_TYPE_UINT64, &client1_id,
+		                          DBUS_TYPE_STRING, &client1_name,
+		                          DBUS_TYPE_UINT64, NULL,
+		                          DBUS_TYPE_STRING, &port1_name,
+		                          DBUS_TYPE_UINT64, &client2_id,
+		                          DBUS_TYPE_STRING, &client2_name,
+		                          DBUS_TYPE_UINT64, NULL,
+		                          DBUS_TYPE_STRING, &port2_name,
+		                          DBUS_TYPE_INVALID)) {
+			lash_error("Failed to parse patch array in graph");
+			lashd_jackdbus_mgr_graph_free();
+			goto end;
+		}
+
+		dbus_message_iter_next(&array_iter);
+
+		client1 = jack_mgr_client_find_by_jackdbus_id(&mgr->clients, client1_id);
+		client2 = jack_mgr_client_find_by_jackdbus_id(&mgr->clients, client2_id);
+
+		if (!lashd_jackdbus_mgr_client_in_project(client1, project))
+			client1 = NULL;
+		if (!lashd_jackdbus_mgr_client_in_project(client2, project))
+			client2 = NULL;
+		if (!client1 && !client2)
+			continue;
+
+		patch = jack_patch_new_with_all(NULL, NULL,
+		                                client1_name, client2_name,
+		                                port1_name, port2_name);
+		if (client1)
+			uuid_copy(patch->src_client_id, client1->id);
+		if (client2)
+			uuid_copy(patch->dest_client_id, client2->id);
+
+		list_add_tail(&patch->siblings, &current);
+	}
+
+	/* Resolve the scene's patches to the names of the running clients */
+	list_for_each (node, patches) {
+		scene_patch = list_entry(node, jack_patch_t, siblings);
+
+		client1_name = lashd_jackdbus_mgr_resolve_patch_client(mgr, scene_patch->src_client,
+		                                                       scene_patch->src_client_id);
+		client2_name = lashd_jackdbus_mgr_resolve_patch_client(mgr, scene_patch->dest_client,
+		                                                       scene_patch->dest_client_id);
+		if (!client1_name || !client2_name) {
+			lash_debug("Skipping scene patch '%s' -> '%s' of a client "
+			           "which is not running", scene_patch->src_desc,
+			           scene_patch->dest_desc);
+			continue;
+		}
+
+		if (jack_patch_find_by_description(&wanted,
+		                                   NULL, client1_name, scene_patch->src_port,
+		                                   NULL, client2_name, scene_patch->dest_port))
+			continue;
+
+		patch = jack_patch_new_with_all(NULL, NULL,
+		                                client1_name, client2_name,
+		                                scene_patch->src_port,
+		                                scene_patch->dest_port);
+		uuid_copy(patch->src_client_id, scene_patch->src_client_id);
+		uuid_copy(patch->dest_client_id, scene_patch->dest_client_id);
+
+		list_add_tail(&patch->siblings, &wanted);
+	}
+
+	/* Tear down what the scene doesn't have */
+	list_for_each (node, &current) {
+		patch = list_entry(node, jack_patch_t, siblings);
+
+		if (jack_patch_find_by_description(&wanted,
+		                                   NULL, patch->src_client, patch->src_port,
+		                                   NULL, patch->dest_client, patch->dest_port)) {
+			++unchanged;
+			continue;
+		}
+
+		lashd_jackdbus_mgr_queue_ports(*lashd_jackdbus_mgr_patch_owner(patch), true,
+		                               patch->src_client, patch->src_port,
+		                               patch->dest_client, patch->dest_port);
+		++disconnects;
+	}
+
+	/* Make what the scene has but the graph doesn't */
+	list_for_each (node, &wanted) {
+		patch = list_entry(node, jack_patch_t, siblings);
+
+		if (jack_patch_find_by_description(&current,
+		                                   NULL, patch->src_client, patch->src_port,
+		                                   NULL, patch->dest_client, patch->dest_port))
+			continue;
+
+		lashd_jackdbus_mgr_queue_ports(*lashd_jackdbus_mgr_patch_owner(patch), false,
+		                               patch->src_client, patch->src_port,
+		                               patch->dest_client, patch->dest_port);
+		++connects;
+	}
+
+	lash_info("Project '%s': %u JACK patches to disconnect, %u to connect, %u unchanged",
+	          project->name, disconnects, connects, unchanged);
+
+	lashd_jackdbus_mgr_connect_flush();
+	retval = true;
+
+end:
+	list_for_each_safe (node, next, &current) {
+		list_del(node);
+		jack_patch_destroy(list_entry(node, jack_patch_t, siblings));
+	}
+	list_for_each_safe (node, next, &wanted) {
+		list_del(node);
+		jack_patch_destroy(list_entry(node, jack_patch_t, siblings));
+	}
+
+	return retval;
+}
+
 /* EOF */
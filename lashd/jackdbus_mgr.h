@@ -33,8 +33,14 @@ struct _lashd_jackdbus_mgr
 {
 	struct list_head  clients;
 	struct list_head  unknown_clients; /**< List of JACK clients not known to be LASH clients. */
+	struct list_head  pid_clients;     /**< List of JACK clients whose PID is being resolved. */
 	DBusMessage      *graph;
 	dbus_uint64_t     graph_version;
+	unsigned long     graph_serial;      /**< Incremented whenever a new graph is saved. */
+	unsigned int      graph_failures;    /**< Failed graph requests since the last good one. */
+	struct list_head  connect_queue;     /**< Patch connections waiting to be sent to jackdbus. */
+	struct list_head  connect_in_flight; /**< Patch connections waiting for a reply from jackdbus. */
+	unsigned int      connect_in_flight_count;
 };
 
 lashd_jackdbus_mgr_t *
@@ -58,20 +64,43 @@ void
 lashd_jackdbus_mgr_bind_client(jack_mgr_client_t *client,
                                struct lash_client          *lash_client);
 
-/** Find client with UUID @a id in jackdbus manager @a mgr and append its
- * patches to @a list. \a list must be properly initialized before calling.
- * If the operation fails the contents of \a list is undefined.
+/** Find client with UUID @a id in jackdbus manager @a mgr and get a
+ * reference to its patches. The client's snapshot is only rebuilt when a new
+ * graph has arrived since it was taken. The snapshot must not be modified;
+ * use patch_snapshot_copy() to get a list which can be.
  * @param mgr Pointer to JACK D-Bus manager.
  * @param id UUID of client.
- * @param dest Pointer to target list head. Must be initialized.
+ * @param snapshot_ptr Set to a reference to the client's patches, or NULL if
+ *                     it has none. Release it with patch_snapshot_unref().
  * @return True on success, false otherwise.
  */
 bool
-lashd_jackdbus_mgr_get_client_patches(lashd_jackdbus_mgr_t *mgr,
-                                      uuid_t                id,
-                                      struct list_head     *dest);
+lashd_jackdbus_mgr_get_client_patches(lashd_jackdbus_mgr_t  *mgr,
+                                      uuid_t                 id,
+                                      patch_snapshot_t     **snapshot_ptr);
 
 void
 lashd_jackdbus_mgr_get_graph(lashd_jackdbus_mgr_t *mgr);
 
+/** Make the JACK connections of @a project 's clients match @a patches.
+ * The live graph is diffed against @a patches and only the connections which
+ * differ are disconnected or connected, as one pipelined batch. Patches of
+ * clients which are not running are skipped.
+ * @param mgr Pointer to JACK D-Bus manager.
+ * @param project Project whose connections to change.
+ * @param patches List of @ref jack_patch_t objects describing the wanted connections.
+ * @return True if the changes were queued, false if the graph could not be read.
+ */
+bool
+lashd_jackdbus_mgr_switch_patches(lashd_jackdbus_mgr_t *mgr,
+                                  project_t            *project,
+                                  struct list_head     *patches);
+
+/** Send queued patch connection requests whose retry delay has expired.
+ * Should be called periodically from the server main loop.
+ * @param mgr Pointer to JACK D-Bus manager.
+ */
+void
+lashd_jackdbus_mgr_run(lashd_jackdbus_mgr_t *mgr);
+
 #endif /* __LASHD_JACKDBUS_MGR_H__ */
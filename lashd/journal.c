@@ -0,0 +1,158 @@
+/*
+ *   LASH
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <stdarg.h>
+#include <time.h>
+
+#include "common/safety.h"
+#include "common/debug.h"
+
+#include "journal.h"
+
+journal_t *
+journal_new(void)
+{
+	journal_t *journal;
+
+	journal = lash_calloc(1, sizeof(journal_t));
+
+	/* Leave room for 2^20 changes per second of uptime before sequence
+	   numbers of successive server instances could overlap */
+	journal->seq = ((dbus_uint64_t) time(NULL)) << 20;
+
+	return journal;
+}
+
+static void
+journal_entry_clear(struct _journal_entry *entry)
+{
+	int i;
+
+	for (i = 0; i < JOURNAL_MAX_ARGS && entry->args[i]; ++i)
+		lash_free(&entry->args[i]);
+}
+
+void
+journal_destroy(journal_t *journal)
+{
+	unsigned int i;
+
+	if (!journal)
+		return;
+
+	for (i = 0; i < JOURNAL_SIZE; ++i)
+		journal_entry_clear(&journal->entries[i]);
+
+	free(journal);
+}
+
+void
+journal_record(journal_t  *journal,
+               const char *event,
+               int         num_args,
+                           ...)
+{
+	struct _journal_entry *entry;
+	va_list ap;
+	const char *arg;
+	int i;
+
+	entry = &journal->entries[++journal->seq % JOURNAL_SIZE];
+	journal_entry_clear(entry);
+
+	entry->seq = journal->seq;
+	entry->event = event;
+
+	if (num_args > JOURNAL_MAX_ARGS) {
+		lash_error("Too many arguments for journal entry '%s'", event);
+		num_args = JOURNAL_MAX_ARGS;
+	}
+
+	va_start(ap, num_args);
+	for (i = 0; i < num_args; ++i) {
+		arg = va_arg(ap, const char *);
+		entry->args[i] = lash_strdup(arg ? arg : "");
+	}
+	va_end(ap);
+
+	if (journal->length < JOURNAL_SIZE)
+		++journal->length;
+}
+
+bool
+journal_covers(const journal_t *journal,
+               dbus_uint64_t    since_seq)
+{
+	return (since_seq <= journal->seq
+	        && journal->seq - since_seq <= journal->length);
+}
+
+bool
+journal_append_entry(DBusMessageIter    *iter,
+                     dbus_uint64_t       seq,
+                     const char         *event,
+                     const char * const *args)
+{
+	DBusMessageIter struct_iter, array_iter;
+	int i;
+
+	if (!dbus_message_iter_open_container(iter, DBUS_TYPE_STRUCT, NULL, &struct_iter))
+		return false;
+
+	if (!dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_UINT64, &seq)
+	    || !dbus_message_iter_append_basic(&struct_iter, DBUS_TYPE_STRING, &event)
+	    || !dbus_message_iter_open_container(&struct_iter, DBUS_TYPE_ARRAY, "s", &array_iter))
+		goto fail;
+
+	for (i = 0; i < JOURNAL_MAX_ARGS && args[i]; ++i) {
+		if (!dbus_message_iter_append_basic(&array_iter, DBUS_TYPE_STRING, &args[i])) {
+			dbus_message_iter_close_container(&struct_iter, &array_iter);
+			goto fail;
+		}
+	}
+
+	if (!dbus_message_iter_close_container(&struct_iter, &array_iter))
+		goto fail;
+
+	return dbus_message_iter_close_container(iter, &struct_iter);
+
+fail:
+	dbus_message_iter_close_container(iter, &struct_iter);
+	return false;
+}
+
+bool
+journal_append_since(const journal_t *journal,
+                     DBusMessageIter *iter,
+                     dbus_uint64_t    since_seq)
+{
+	const struct _journal_entry *entry;
+	dbus_uint64_t seq;
+
+	for (seq = since_seq + 1; seq <= journal->seq; ++seq) {
+		entry = &journal->entries[seq % JOURNAL_SIZE];
+		if (!journal_append_entry(iter, entry->seq, entry->event,
+		                          (const char * const *) entry->args))
+			return false;
+	}
+
+	return true;
+}
+
+/* EOF */
@@ -0,0 +1,125 @@
+/*
+ *   LASH
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __LASHD_JOURNAL_H__
+#define __LASHD_JOURNAL_H__
+
+#include <stdbool.h>
+#include <dbus/dbus.h>
+
+#include "types.h"
+
+/* Number of state changes the journal remembers */
+#define JOURNAL_SIZE     256
+
+/* Maximum number of arguments of a journal entry */
+#define JOURNAL_MAX_ARGS 3
+
+struct _journal_entry
+{
+	dbus_uint64_t  seq;
+	const char    *event;                  /* Name of the corresponding signal */
+	char          *args[JOURNAL_MAX_ARGS]; /* NULL after the last argument */
+};
+
+/**
+ * A ring of the most recent state changes reported to controllers, each
+ * with a sequence number. It lets a controller which has missed signals
+ * catch up without fetching everything again.
+ */
+struct _journal
+{
+	dbus_uint64_t          seq;    /* Sequence number of the latest entry */
+	unsigned int           length; /* Number of valid entries */
+	struct _journal_entry  entries[JOURNAL_SIZE];
+};
+
+/**
+ * Create a new, empty journal. Sequence numbers are based on the current
+ * time so that they keep growing across server restarts.
+ *
+ * @return Pointer to the newly allocated journal.
+ */
+journal_t *
+journal_new(void);
+
+/**
+ * Free a journal and all of its entries.
+ *
+ * @param journal The journal, or NULL.
+ */
+void
+journal_destroy(journal_t *journal);
+
+/**
+ * Record a state change, replacing the oldest entry if the journal is full.
+ *
+ * @param journal The journal.
+ * @param event Name of the signal announcing the change. Must be a static
+ *              string.
+ * @param num_args Number of string arguments, at most JOURNAL_MAX_ARGS.
+ * @param ... The string arguments. NULL is recorded as an empty string.
+ */
+void
+journal_record(journal_t  *journal,
+               const char *event,
+               int         num_args,
+                           ...);
+
+/**
+ * Check whether the journal still holds every change after @a since_seq.
+ *
+ * @param journal The journal.
+ * @param since_seq Sequence number of the last change the caller has seen.
+ * @return True if \ref journal_append_since can bring the caller up to
+ *         date, false if a full snapshot is needed.
+ */
+bool
+journal_covers(const journal_t *journal,
+               dbus_uint64_t    since_seq);
+
+/**
+ * Append the entries following @a since_seq to an a(tsas) array.
+ *
+ * @param journal The journal.
+ * @param iter Iterator of the array to append to.
+ * @param since_seq Sequence number of the last change the caller has seen.
+ * @return True on success, false if memory ran out.
+ */
+bool
+journal_append_since(const journal_t *journal,
+                     DBusMessageIter *iter,
+                     dbus_uint64_t    since_seq);
+
+/**
+ * Append a single (tsas) entry to an array. Used for building snapshots
+ * in the same format as the journal's entries.
+ *
+ * @param iter Iterator of the array to append to.
+ * @param seq Sequence number of the entry.
+ * @param event Name of the signal.
+ * @param args NULL-terminated array of at most JOURNAL_MAX_ARGS arguments.
+ * @return True on success, false if memory ran out.
+ */
+bool
+journal_append_entry(DBusMessageIter    *iter,
+                     dbus_uint64_t       seq,
+                     const char         *event,
+                     const char * const *args);
+
+#endif /* __LASHD_JOURNAL_H__ */
@@ -45,6 +45,7 @@
 #include "client.h"
 #include "project.h"
 #include "sigsegv.h"
+#include "stats.h"
 
 #define XTERM_COMMAND_EXTENSION "&& sh || sh"
 
@@ -163,6 +164,7 @@ loader_sigchld_handler(int signum)
 
 	while ((pid = waitpid(-1, &status, WNOHANG)) > 0) {
 		child_ptr = loader_child_find_and_mark_dead(pid);
+		stats_count(STATS_CHILD_EXITS);
 
 		if (!child_ptr)
 			lash_error("LASH loader detected termination of "
@@ -475,7 +477,7 @@ loader_execute(struct lash_client *client,
 	if (pid == -1) {
 		lash_error("Could not fork to exec program '%s': %s",
 		           program, strerror(errno));
-		client->pid = 0;
+		server_set_client_pid(client, 0);
 		return;
 	}
 
@@ -513,7 +515,7 @@ loader_execute(struct lash_client *client,
 		}
 	}
 
-	client->pid = pid;
+	server_set_client_pid(client, pid);
 	child_ptr->pid = pid;
 	lash_info("Forked to run program '%s' pid = %llu", program, (unsigned long long)pid);
 }
@@ -0,0 +1,85 @@
+/*
+ *   LASH
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "common/safety.h"
+
+#include "patch_snapshot.h"
+
+patch_snapshot_t *
+patch_snapshot_new(struct list_head       *patches,
+                   patch_list_free_func_t  free_list,
+                   patch_list_dup_func_t   dup_list)
+{
+	patch_snapshot_t *snapshot;
+
+	snapshot = lash_malloc(1, sizeof(patch_snapshot_t));
+	snapshot->refcount = 1;
+	snapshot->free_list = free_list;
+	snapshot->dup_list = dup_list;
+
+	INIT_LIST_HEAD(&snapshot->patches);
+	list_splice_init(patches, &snapshot->patches);
+
+	return snapshot;
+}
+
+patch_snapshot_t *
+patch_snapshot_ref(patch_snapshot_t *snapshot)
+{
+	if (snapshot)
+		__atomic_add_fetch(&snapshot->refcount, 1, __ATOMIC_RELAXED);
+
+	return snapshot;
+}
+
+void
+patch_snapshot_unref(patch_snapshot_t *snapshot)
+{
+	if (snapshot
+	    && __atomic_sub_fetch(&snapshot->refcount, 1, __ATOMIC_ACQ_REL) == 0) {
+		snapshot->free_list(&snapshot->patches);
+		free(snapshot);
+	}
+}
+
+void
+patch_snapshot_copy(patch_snapshot_t *snapshot,
+                    struct list_head *dest)
+{
+	if (snapshot)
+		snapshot->dup_list(&snapshot->patches, dest);
+}
+
+void
+patch_snapshot_release(patch_snapshot_t *snapshot,
+                       struct list_head *dest)
+{
+	if (!snapshot)
+		return;
+
+	/* With the only reference nobody else can get at the snapshot */
+	if (__atomic_load_n(&snapshot->refcount, __ATOMIC_ACQUIRE) == 1) {
+		list_splice_init(&snapshot->patches, dest);
+		free(snapshot);
+	} else {
+		snapshot->dup_list(&snapshot->patches, dest);
+		patch_snapshot_unref(snapshot);
+	}
+}
+
+/* EOF */
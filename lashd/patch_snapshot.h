@@ -0,0 +1,102 @@
+/*
+ *   LASH
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __LASHD_PATCH_SNAPSHOT_H__
+#define __LASHD_PATCH_SNAPSHOT_H__
+
+#include <stdbool.h>
+
+#include "common/klist.h"
+
+#include "types.h"
+
+/** Function which frees every patch in a list. */
+typedef void (*patch_list_free_func_t)(struct list_head *patches);
+
+/** Function which appends copies of the patches in @a src to @a dest. */
+typedef void (*patch_list_dup_func_t)(struct list_head *src,
+                                      struct list_head *dest);
+
+/**
+ * An immutable, reference counted set of patches. A snapshot is only
+ * replaced when the patches it describes actually change, so holding on to
+ * one costs nothing between changes. The reference count is atomic, so
+ * the main thread can drop a snapshot which a patch manager thread has
+ * replaced meanwhile.
+ */
+struct _patch_snapshot
+{
+	unsigned int            refcount;
+	struct list_head        patches;
+	patch_list_free_func_t  free_list;
+	patch_list_dup_func_t   dup_list;
+};
+
+/**
+ * Create a new snapshot holding one reference.
+ *
+ * @param patches List of patches. Its contents are moved into the snapshot,
+ *                leaving it empty.
+ * @param free_list Function for freeing the patches.
+ * @param dup_list Function for copying the patches.
+ * @return Pointer to the newly allocated snapshot.
+ */
+patch_snapshot_t *
+patch_snapshot_new(struct list_head       *patches,
+                   patch_list_free_func_t  free_list,
+                   patch_list_dup_func_t   dup_list);
+
+/**
+ * Take a reference to a snapshot.
+ *
+ * @param snapshot The snapshot, or NULL.
+ * @return @a snapshot.
+ */
+patch_snapshot_t *
+patch_snapshot_ref(patch_snapshot_t *snapshot);
+
+/**
+ * Drop a reference to a snapshot, and free it if it was the last one.
+ *
+ * @param snapshot The snapshot, or NULL.
+ */
+void
+patch_snapshot_unref(patch_snapshot_t *snapshot);
+
+/**
+ * Append copies of a snapshot's patches to a list.
+ *
+ * @param snapshot The snapshot, or NULL.
+ * @param dest List to append the copies to.
+ */
+void
+patch_snapshot_copy(patch_snapshot_t *snapshot,
+                    struct list_head *dest);
+
+/**
+ * Drop a reference to a snapshot and append its patches to a list. If the
+ * reference was the last one the patches are moved instead of copied.
+ *
+ * @param snapshot The snapshot, or NULL.
+ * @param dest List to append the patches to.
+ */
+void
+patch_snapshot_release(patch_snapshot_t *snapshot,
+                       struct list_head *dest);
+
+#endif /* __LASHD_PATCH_SNAPSHOT_H__ */
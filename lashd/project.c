@@ -45,7 +45,10 @@
 #include "store.h"
 #include "file.h"
 #include "jack_patch.h"
+#include "patch_snapshot.h"
+#include "scene.h"
 #include "server.h"
+#include "journal.h"
 #include "loader.h"
 #include "dbus_iface_control.h"
 #include "common/safety.h"
@@ -75,6 +78,7 @@ project_new(void)
 
 	INIT_LIST_HEAD(&project->clients);
 	INIT_LIST_HEAD(&project->lost_clients);
+	INIT_LIST_HEAD(&project->scenes);
 
 	return project;
 }
@@ -149,6 +153,9 @@ project_set_modified_status(project_t *project,
 	dbus_bool_t value = new_status;
 	project->modified_status = new_status;
 
+	journal_record(g_server->journal, "ProjectModifiedStatusChanged", 2,
+	               project->name, new_status ? "true" : "false");
+
 	signal_new_valist(g_server->dbus_service,
 	                  "/", "org.nongnu.LASH.Control",
 	                  "ProjectModifiedStatusChanged",
@@ -235,6 +242,17 @@ project_satisfy_client_dependency(project_t *project,
 	}
 }
 
+/* Clients restored as part of a project load share the load's task ID,
+   so that their progress can be matched with the ProjectProgress signals */
+static dbus_uint64_t
+project_client_task_id(project_t *project)
+{
+	if (project && project->task_type == LASH_TASK_LOAD)
+		return project->task_id;
+
+	return ++g_server->task_iter;
+}
+
 void
 project_load_file(project_t *project,
                   struct lash_client  *client)
@@ -242,7 +260,7 @@ project_load_file(project_t *project,
 	lash_info("Requesting client '%s' to load data from disk",
 	           client_get_identity(client));
 
-	client->pending_task = (++g_server->task_iter);
+	client->pending_task = project_client_task_id(project);
 	client->task_type = LASH_Restore_File;
 	client->task_progress = 0;
 
@@ -257,7 +275,79 @@ project_load_file(project_t *project,
 	                       DBUS_TYPE_INVALID);
 }
 
-/* Send a LoadDataSet method call to the client */
+static bool
+project_append_config_array(store_t         *store,
+                            DBusMessageIter *iter)
+{
+	DBusMessageIter array_iter;
+
+	if (!dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY, "{sv}", &array_iter)) {
+		lash_error("Failed to open config array container");
+		return false;
+	}
+
+	if (!store_create_config_array(store, &array_iter)) {
+		lash_error("Failed to create config array");
+		dbus_message_iter_close_container(iter, &array_iter);
+		return false;
+	}
+
+	if (!dbus_message_iter_close_container(iter, &array_iter)) {
+		lash_error("Failed to close config array container");
+		return false;
+	}
+
+	return true;
+}
+
+/* Send a LoadDataSetKeys method call to the client */
+static void
+project_load_data_set_keys(struct lash_client *client)
+{
+	method_msg_t new_call;
+	DBusMessageIter iter;
+	dbus_uint64_t task_id;
+
+	if (!method_call_init(&new_call, g_server->dbus_service,
+	                      NULL,
+	                      method_default_handler,
+	                      client->dbus_name,
+	                      "/org/nongnu/LASH/Client",
+	                      "org.nongnu.LASH.Client",
+	                      "LoadDataSetKeys")) {
+		lash_error("Failed to initialise LoadDataSetKeys method call");
+		return;
+	}
+
+	dbus_message_iter_init_append(new_call.message, &iter);
+
+	task_id = project_client_task_id(client->project);
+
+	if (!dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT64, &task_id)) {
+		lash_error("Failed to write task ID");
+		goto fail;
+	}
+
+	if (!store_create_key_array(client->store, &iter))
+		goto fail;
+
+	if (!method_send(&new_call, false)) {
+		lash_error("Failed to send LoadDataSetKeys method call");
+		return;
+	}
+
+	client->pending_task = task_id;
+	client->task_type = LASH_Restore_Data_Set;
+	client->task_progress = 0;
+
+	return;
+
+fail:
+	dbus_message_unref(new_call.message);
+}
+
+/* Send a LoadDataSet method call to the client, or LoadDataSetFd
+   if the client can receive its data set as a file descriptor */
 void
 project_load_data_set(project_t *project,
                       struct lash_client  *client)
@@ -278,8 +368,22 @@ project_load_data_set(project_t *project,
 	}
 
 	method_msg_t new_call;
-	DBusMessageIter iter, array_iter;
+	DBusMessageIter iter;
 	dbus_uint64_t task_id;
+	int fd = -1;
+
+	/* A lazy client only gets the keys, and fetches values later */
+	if (client->flags & LASH_Lazy_Data_Set) {
+		project_load_data_set_keys(client);
+		return;
+	}
+
+#ifdef HAVE_DATA_SET_FD
+	if ((client->flags & LASH_Data_Set_Fd)
+	    && (fd = store_create_config_fd(client->store)) == -1)
+		lash_error("Failed to create data set fd; "
+		           "sending data set in message");
+#endif
 
 	if (!method_call_init(&new_call, g_server->dbus_service,
 	                      NULL,
@@ -287,34 +391,33 @@ project_load_data_set(project_t *project,
 	                      client->dbus_name,
 	                      "/org/nongnu/LASH/Client",
 	                      "org.nongnu.LASH.Client",
-	                      "LoadDataSet")) {
+	                      fd != -1 ? "LoadDataSetFd" : "LoadDataSet")) {
 		lash_error("Failed to initialise LoadDataSet method call");
-		return;
+		goto fail_close;
 	}
 
 	dbus_message_iter_init_append(new_call.message, &iter);
 
-	task_id = (++g_server->task_iter);
+	task_id = project_client_task_id(client->project);
 
 	if (!dbus_message_iter_append_basic(&iter, DBUS_TYPE_UINT64, &task_id)) {
 		lash_error("Failed to write task ID");
 		goto fail;
 	}
 
-	if (!dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY, "{sv}", &array_iter)) {
-		lash_error("Failed to open config array container");
-		goto fail;
-	}
-
-	if (!store_create_config_array(client->store, &array_iter)) {
-		lash_error("Failed to create config array");
-		goto fail;
-	}
-
-	if (!dbus_message_iter_close_container(&iter, &array_iter)) {
-		lash_error("Failed to close config array container");
+#ifdef HAVE_DATA_SET_FD
+	if (fd != -1) {
+		/* The message takes a duplicate of the fd */
+		if (!dbus_message_iter_append_basic(&iter, DBUS_TYPE_UNIX_FD, &fd)) {
+			lash_error("Failed to write data set fd");
+			goto fail;
+		}
+		close(fd);
+		fd = -1;
+	} else
+#endif
+	if (!project_append_config_array(client->store, &iter))
 		goto fail;
-	}
 
 	if (!method_send(&new_call, false)) {
 		lash_error("Failed to send LoadDataSet method call");
@@ -330,6 +433,9 @@ project_load_data_set(project_t *project,
 
 fail:
 	dbus_message_unref(new_call.message);
+fail_close:
+	if (fd != -1)
+		close(fd);
 }
 
 void
@@ -485,28 +591,33 @@ project_save_clients(project_t *project)
 	project->task_type = LASH_TASK_SAVE;
 	project->client_tasks_total = 0;
 	project->client_tasks_progress = 0;
-	++g_server->task_iter;
 
-	lash_debug("Signaling all clients of project '%s' to save (task %llu)",
-	           project->name, g_server->task_iter);
-	signal_new_valist(g_server->dbus_service,
-	                  "/", "org.nongnu.LASH.Server", "Save",
-	                  DBUS_TYPE_STRING, &project->name,
-	                  DBUS_TYPE_UINT64, &g_server->task_iter,
-	                  DBUS_TYPE_INVALID);
+	lash_debug("Signaling clients of project '%s' to save (task %llu)",
+	           project->name, project->task_id);
 
+	/* Address the signal to each client that has something to save,
+	   instead of waking up the clients of every project */
 	list_for_each (node, &project->clients) {
 		client = list_entry(node, struct lash_client, siblings);
 
-		if (CLIENT_HAS_INTERNAL_STATE(client))
+		if (CLIENT_HAS_INTERNAL_STATE(client) && client->dbus_name)
 		{
-			client->pending_task = g_server->task_iter;
+			signal_new_unicast_valist(g_server->dbus_service,
+			                          client->dbus_name,
+			                          "/", "org.nongnu.LASH.Server", "Save",
+			                          DBUS_TYPE_STRING, &project->name,
+			                          DBUS_TYPE_UINT64, &project->task_id,
+			                          DBUS_TYPE_INVALID);
+
+			client->pending_task = project->task_id;
 			client->task_type = (CLIENT_CONFIG_FILE(client)) ? LASH_Save_File : LASH_Save_Data_Set;
 			client->task_progress = 0;
 			++project->client_tasks_total;
 		}
 	}
 
+	dbus_connection_flush(g_server->dbus_service->connection);
+
 	project->client_tasks_pending = project->client_tasks_total;
 	if (project->client_tasks_total == 0)
 	{
@@ -520,35 +631,36 @@ project_create_client_jack_patch_xml(project_t  *project,
                                      xmlNodePtr  clientxml)
 {
 	xmlNodePtr jack_patch_set;
-	struct list_head *node, *next;
+	struct list_head *node;
 	jack_patch_t *patch;
-
-	LIST_HEAD(patches);
+	patch_snapshot_t *snapshot;
 
 #ifdef HAVE_JACK_DBUS
 	if (!lashd_jackdbus_mgr_get_client_patches(g_server->jackdbus_mgr,
-	                                           client->id, &patches)) {
+	                                           client->id, &snapshot)
+	    || !snapshot || list_empty(&snapshot->patches)) {
 #else
 	jack_mgr_lock(g_server->jack_mgr);
-	jack_mgr_get_client_patches(g_server->jack_mgr, client->id, &patches);
+	snapshot = jack_mgr_get_client_patches(g_server->jack_mgr, client->id);
 	jack_mgr_unlock(g_server->jack_mgr);
-	if (list_empty(&patches)) {
+	if (!snapshot || list_empty(&snapshot->patches)) {
 #endif
 		lash_info("client '%s' has no patches to save", client_get_identity(client));
+		patch_snapshot_unref(snapshot);
 		return;
 	}
 
 	jack_patch_set =
 		xmlNewChild(clientxml, NULL, BAD_CAST "jack_patch_set", NULL);
 
-	list_for_each_safe (node, next, &patches) {
+	list_for_each (node, &snapshot->patches) {
 		patch = list_entry(node, jack_patch_t, siblings);
 
 		lash_info("Saving client '%s' patch %s:%s -> %s:%s", client_get_identity(client), patch->src_client, patch->src_port, patch->dest_client, patch->dest_port);
 		jack_patch_create_xml(patch, jack_patch_set);
-
-		jack_patch_destroy(patch);
 	}
+
+	patch_snapshot_unref(snapshot);
 }
 
 #ifdef HAVE_ALSA
@@ -558,25 +670,25 @@ project_create_client_alsa_patch_xml(project_t  *project,
                                      xmlNodePtr  clientxml)
 {
 	xmlNodePtr alsa_patch_set;
-	struct list_head *node, *next;
-	alsa_patch_t *patch;
-
-	LIST_HEAD(patches);
+	struct list_head *node;
+	patch_snapshot_t *snapshot;
 
 	alsa_mgr_lock(g_server->alsa_mgr);
-	alsa_mgr_get_client_patches(g_server->alsa_mgr, client->id, &patches);
+	snapshot = alsa_mgr_get_client_patches(g_server->alsa_mgr, client->id);
 	alsa_mgr_unlock(g_server->alsa_mgr);
-	if (list_empty(&patches))
+	if (!snapshot || list_empty(&snapshot->patches)) {
+		patch_snapshot_unref(snapshot);
 		return;
+	}
 
 	alsa_patch_set =
 		xmlNewChild(clientxml, NULL, BAD_CAST "alsa_patch_set", NULL);
 
-	list_for_each_safe (node, next, &patches) {
-		patch = list_entry(node, alsa_patch_t, siblings);
-		alsa_patch_create_xml(patch, alsa_patch_set);
-		alsa_patch_destroy(patch);
-	}
+	list_for_each (node, &snapshot->patches)
+		alsa_patch_create_xml(list_entry(node, alsa_patch_t, siblings),
+		                      alsa_patch_set);
+
+	patch_snapshot_unref(snapshot);
 }
 #endif
 
@@ -603,7 +715,7 @@ static xmlDocPtr
 project_create_xml(project_t *project)
 {
 	xmlDocPtr doc;
-	xmlNodePtr lash_project, clientxml, arg_set;
+	xmlNodePtr lash_project, clientxml, arg_set, scenes;
 	struct list_head *node;
 	struct lash_client *client;
 	char num[16];
@@ -671,6 +783,14 @@ project_create_xml(project_t *project)
 			                                       clientxml);
 	}
 
+	if (!list_empty(&project->scenes)) {
+		scenes = xmlNewChild(lash_project, NULL, BAD_CAST "scenes", NULL);
+
+		list_for_each (node, &project->scenes)
+			scene_create_xml(list_entry(node, scene_t, siblings),
+			                 scenes);
+	}
+
 	return doc;
 }
 
@@ -787,7 +907,12 @@ project_update_last_modify_time(
 		return false;
 	}
 
-	project_ptr->last_modify_time = st.st_mtime;
+	if (project_ptr->last_modify_time != st.st_mtime)
+	{
+		project_ptr->last_modify_time = st.st_mtime;
+		server_projects_changed();
+	}
+
 	return true;
 }
 
@@ -802,7 +927,7 @@ project_clients_save_complete(
 	success = project_write_info(project_ptr);
 
 	/* Signal task completion */
-	lashd_dbus_signal_emit_progress(100);
+	project_progress(project_ptr, 100);
 	lashd_dbus_signal_emit_project_saved(project_ptr->name);
 
 	project_update_last_modify_time(project_ptr);
@@ -826,7 +951,7 @@ project_loaded(
 	project_t * project_ptr)
 {
 	/* Signal task completion */
-	lashd_dbus_signal_emit_progress(100);
+	project_progress(project_ptr, 100);
 	lashd_dbus_signal_emit_project_loaded(project_ptr->name);
 
 	lash_info("Project '%s' loaded.", project_ptr->name);
@@ -845,11 +970,13 @@ project_save(project_t *project)
 	lash_info("Saving project '%s' ...", project->name);
 
 	/* Signal beginning of task */
-	lashd_dbus_signal_emit_progress(0);
+	project->task_id = ++g_server->task_iter;
+	project_progress(project, 0);
 
 	if (list_empty(&project->siblings_all)) {
 		/* this is first save for new project, add it to available for loading list */
 		list_add_tail(&project->siblings_all, &g_server->all_projects);
+		server_projects_changed();
 	}
 
 	if (!lash_dir_exists(project->directory)) {
@@ -905,6 +1032,7 @@ project_load(project_t *project)
 			content = xmlNodeGetContent(xmlnode);
 			lash_strset(&project->name, (const char *) content);
 			xmlFree(content);
+			server_projects_changed();
 		} else if (strcmp((const char *) xmlnode->name, "client") == 0) {
 			struct lash_client *client;
 
@@ -916,6 +1044,22 @@ project_load(project_t *project)
 			//       the basic stuff (id, class, etc.)
 
 			list_add(&client->siblings, &project->lost_clients);
+			client->lost = true;
+		} else if (strcmp((const char *) xmlnode->name, "scenes") == 0) {
+			xmlNodePtr scenenode;
+			scene_t *scene;
+
+			for (scenenode = xmlnode->children; scenenode;
+			     scenenode = scenenode->next) {
+				if (strcmp((const char *) scenenode->name, "scene") != 0)
+					continue;
+
+				if ((scene = scene_parse_xml(scenenode)))
+					list_add_tail(&scene->siblings, &project->scenes);
+				else
+					lash_error("Ignoring unnamed scene in project '%s'",
+					           project->directory);
+			}
 		}
 	}
 
@@ -1117,10 +1261,11 @@ project_lose_client(project_t *project,
 	/* Pid is only stored for clients who were recently launched so that
 	   lashd can tell launched clients from recovering ones. All lost
 	   clients must have valid project pointers. */
-	client->pid = 0;
+	server_set_client_pid(client, 0);
 	client->project = project;
 
 	list_add(&client->siblings, &project->lost_clients);
+	client->lost = true;
 	project_set_modified_status(project, true);
 	lashd_dbus_signal_emit_client_disappeared(client->id_str, project->name);
 }
@@ -1138,9 +1283,18 @@ project_unload(project_t *project)
 	lash_debug("Signaling all clients of project '%s' to quit",
 	           project->name);
 
-	signal_new_single(g_server->dbus_service,
-	                  "/", "org.nongnu.LASH.Server", "Quit",
-	                  DBUS_TYPE_STRING, &project->name);
+	list_for_each (node, &project->clients) {
+		client = list_entry(node, struct lash_client, siblings);
+
+		if (client->dbus_name)
+			signal_new_unicast_valist(g_server->dbus_service,
+			                          client->dbus_name,
+			                          "/", "org.nongnu.LASH.Server", "Quit",
+			                          DBUS_TYPE_STRING, &project->name,
+			                          DBUS_TYPE_INVALID);
+	}
+
+	dbus_connection_flush(g_server->dbus_service->connection);
 
 	list_for_each_safe (node, next, &project->clients) {
 		client = list_entry(node, struct lash_client, siblings);
@@ -1177,6 +1331,8 @@ project_unload(project_t *project)
 		client_destroy(client);
 	}
 
+	scene_destroy_list(&project->scenes);
+
 	if (project->move_on_close)
 	{
 		char * project_dir;
@@ -1223,6 +1379,8 @@ project_destroy(project_t *project)
 		lash_free(&project->description);
 		lash_free(&project->notes);
 
+		scene_destroy_list(&project->scenes);
+
 		// TODO: Free client lists
 
 		free(project);
@@ -1252,7 +1410,59 @@ project_client_progress(project_t *project,
 		return;
 
 	uint8_t p = project->client_tasks_progress / project->client_tasks_total;
-	lashd_dbus_signal_emit_progress(p > 99 ? 99 : p);
+	project_progress(project, p > 99 ? 99 : p);
+}
+
+static void
+project_signal_progress(project_t *project,
+                        uint8_t    percentage)
+{
+	lashd_dbus_signal_emit_project_progress(project->name, project->task_id,
+	                                        percentage);
+
+	project->progress_sent = percentage;
+	project->progress_pending = 0;
+	gettimeofday(&project->progress_time, NULL);
+}
+
+/* Return true if a progress signal sent now would exceed the rate limit */
+static bool
+project_progress_too_soon(project_t *project)
+{
+	struct timeval now, elapsed;
+
+	gettimeofday(&now, NULL);
+	timersub(&now, &project->progress_time, &elapsed);
+
+	return (elapsed.tv_sec == 0
+	        && elapsed.tv_usec < 1000000 / PROJECT_PROGRESS_RATE);
+}
+
+void
+project_progress(project_t *project,
+                 uint8_t    percentage)
+{
+	if (percentage == 0 || percentage >= 100) {
+		project_signal_progress(project, percentage);
+		return;
+	}
+
+	if (percentage == project->progress_sent) {
+		project->progress_pending = 0;
+		return;
+	}
+
+	if (project_progress_too_soon(project))
+		project->progress_pending = percentage;
+	else
+		project_signal_progress(project, percentage);
+}
+
+void
+project_flush_progress(project_t *project)
+{
+	if (project->progress_pending && !project_progress_too_soon(project))
+		project_signal_progress(project, project->progress_pending);
 }
 
 /* Send the appropriate signal(s) to signify that a client completed a task */
@@ -1295,6 +1505,7 @@ project_rename(project_t  *project,
 	}
 
 	project->name = lash_strdup(new_name);
+	server_projects_changed();
 
 	lashd_dbus_signal_emit_project_name_changed(old_name, new_name);
 
@@ -1308,6 +1519,7 @@ project_set_description(project_t  *project,
                         const char *description)
 {
 	lash_strset(&project->description, description);
+	server_projects_changed();
 	lashd_dbus_signal_emit_project_description_changed(project->name, description);
 
 	project_set_modified_status(project, true);
@@ -1346,4 +1558,106 @@ project_clear_id_dir(project_t *project)
 	}
 }
 
+bool
+project_save_scene(project_t  *project,
+                   const char *name)
+{
+	struct list_head *node, *node2, *next;
+	struct lash_client *client;
+	jack_patch_t *patch, *existing;
+	patch_snapshot_t *snapshot;
+	scene_t *scene, *old_scene;
+	bool duplicate;
+
+	LIST_HEAD(patches);
+
+	scene = scene_new(name);
+
+#ifdef HAVE_JACK_DBUS
+	/* Make sure that the scene reflects the live connections */
+	lashd_jackdbus_mgr_get_graph(g_server->jackdbus_mgr);
+#endif
+
+	list_for_each (node, &project->clients) {
+		client = list_entry(node, struct lash_client, siblings);
+
+		if (!client->jack_client_name)
+			continue;
+
+#ifdef HAVE_JACK_DBUS
+		lashd_jackdbus_mgr_get_client_patches(g_server->jackdbus_mgr,
+		                                      client->id, &snapshot);
+#else
+		jack_mgr_lock(g_server->jack_mgr);
+		snapshot = jack_mgr_get_client_patches(g_server->jack_mgr, client->id);
+		jack_mgr_unlock(g_server->jack_mgr);
+#endif
+
+		/* The scene owns its patches, so it gets copies */
+		patch_snapshot_copy(snapshot, &patches);
+		patch_snapshot_unref(snapshot);
+	}
+
+	/* A patch between two of the project's clients is reported by both */
+	list_for_each_safe (node, next, &patches) {
+		patch = list_entry(node, jack_patch_t, siblings);
+		list_del(&patch->siblings);
+
+		duplicate = false;
+		list_for_each (node2, &scene->jack_patches) {
+			existing = list_entry(node2, jack_patch_t, siblings);
+			if (strcmp(existing->src_desc, patch->src_desc) == 0
+			    && strcmp(existing->dest_desc, patch->dest_desc) == 0) {
+				duplicate = true;
+				break;
+			}
+		}
+
+		if (duplicate)
+			jack_patch_destroy(patch);
+		else
+			list_add_tail(&patch->siblings, &scene->jack_patches);
+	}
+
+	if ((old_scene = scene_find_by_name(&project->scenes, name))) {
+		list_del(&old_scene->siblings);
+		scene_destroy(old_scene);
+	}
+
+	list_add_tail(&scene->siblings, &project->scenes);
+	project_set_modified_status(project, true);
+
+	lash_info("Saved scene '%s' of project '%s'", name, project->name);
+
+	return true;
+}
+
+bool
+project_switch_scene(project_t *project,
+                     scene_t   *scene)
+{
+	lash_info("Switching project '%s' to scene '%s'",
+	          project->name, scene->name);
+
+#ifdef HAVE_JACK_DBUS
+	return lashd_jackdbus_mgr_switch_patches(g_server->jackdbus_mgr, project,
+	                                         &scene->jack_patches);
+#else
+	lash_error("Scene switching requires the JACK D-Bus interface");
+	return false;
+#endif
+}
+
+void
+project_remove_scene(project_t *project,
+                     scene_t   *scene)
+{
+	lash_info("Removing scene '%s' of project '%s'",
+	          scene->name, project->name);
+
+	list_del(&scene->siblings);
+	scene_destroy(scene);
+	project_set_modified_status(project, true);
+}
+
 /* EOF */
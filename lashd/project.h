@@ -24,6 +24,7 @@
 
 #include <stdbool.h>
 #include <stdint.h>
+#include <sys/time.h>
 #include <uuid/uuid.h>
 #include <libxml/tree.h>
 
@@ -37,6 +38,10 @@
 #define PROJECT_NOTES_FILE  ".notes"
 #define PROJECT_XML_VERSION "1.0"
 
+/* Maximum number of progress signals per second for a project's task,
+   not counting the ones for 0 and 100 percent */
+#define PROJECT_PROGRESS_RATE 10
+
 enum
 {
 	LASH_TASK_SAVE = 1,
@@ -68,11 +73,27 @@ struct _project
 	 * loaded yet, or failed to run, or dropped out of the session */
 	struct list_head  lost_clients;
 
+	/** Named JACK connection sets that can be switched between */
+	struct list_head  scenes;
+
 	/* For task progress feedback (LASH_Percentage) */
 	int               task_type;
 	uint32_t          client_tasks_total;
 	uint32_t          client_tasks_pending;
 	uint32_t          client_tasks_progress; // Min is 0, max is client_tasks_total*100
+
+	/* For coalescing progress signals */
+	uint64_t          task_id;          /* Sent along with progress signals */
+	uint8_t           progress_sent;    /* Percentage last signalled */
+	uint8_t           progress_pending; /* Percentage waiting to be signalled, or 0 */
+	struct timeval    progress_time;    /* When progress was last signalled */
+
+	/* For JACK patch reconnection throughput reporting */
+	uint32_t          patches_pending;
+	uint32_t          patches_connected;
+	uint32_t          patches_failed;
+	uint32_t          patches_cancelled;
+	struct timeval    patches_start_time;
 };
 
 /** Create a new, empty project object, without setting the directory. Initializes
@@ -150,9 +171,29 @@ void
 project_move(project_t  *project,
              const char *new_dir);
 
+/** Signal the completion percentage of the project's current task. 0 and
+ * 100 percent are always signalled immediately, other values at most
+ * PROJECT_PROGRESS_RATE times per second; the latest one of those is held
+ * back until \ref project_flush_progress can send it.
+ *
+ * @arg project    project whose task progressed
+ * @arg percentage completion percentage of the task
+ */
+void
+project_progress(project_t *project,
+                 uint8_t    percentage);
+
+/** Signal a progress value held back by \ref project_progress if enough
+ * time has passed since the previous signal.
+ *
+ * @arg project    project pointer
+ */
+void
+project_flush_progress(project_t *project);
+
 /** Set the client's completion percentage to a given value, and update the
- * overall completion percentage accordingly. Calls 
- * lashd_dbus_signal_emit_progress to communicate the new overall percentage.
+ * overall completion percentage accordingly. Calls
+ * project_progress to communicate the new overall percentage.
  * 
  * @arg project    project that the percentage change occured in
  * @arg client     the client for which a percentage value needs to be set
@@ -271,4 +312,34 @@ project_new_client(
 	project_t *project,
 	struct lash_client  *client);
 
+/** Store the current JACK connections of @a project 's clients as a scene
+ * called @a name, replacing any scene of the same name, and set the modified
+ * state to true.
+ *
+ * @arg project    project to save the scene in
+ * @arg name       name of the scene
+ */
+bool
+project_save_scene(project_t  *project,
+                   const char *name);
+
+/** Make the JACK connections of @a project 's clients match @a scene. Only
+ * the connections which differ from the scene are changed.
+ *
+ * @arg project    project to switch
+ * @arg scene      scene to switch to, must belong to project
+ */
+bool
+project_switch_scene(project_t *project,
+                     scene_t   *scene);
+
+/** Unlink and destroy @a scene, and set the modified state to true.
+ *
+ * @arg project    project the scene belongs to
+ * @arg scene      scene to remove
+ */
+void
+project_remove_scene(project_t *project,
+                     scene_t   *scene);
+
 #endif /* __LASHD_PROJECT_H__ */
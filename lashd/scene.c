@@ -0,0 +1,139 @@
+/*
+ *   LASH
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <string.h>
+
+#include "common/safety.h"
+#include "common/debug.h"
+
+#include "scene.h"
+#include "jack_patch.h"
+
+scene_t *
+scene_new(const char *name)
+{
+	scene_t *scene;
+
+	scene = lash_calloc(1, sizeof(scene_t));
+	scene->name = lash_strdup(name);
+	INIT_LIST_HEAD(&scene->jack_patches);
+
+	return scene;
+}
+
+void
+scene_destroy(scene_t *scene)
+{
+	struct list_head *node, *next;
+
+	if (!scene)
+		return;
+
+	list_for_each_safe (node, next, &scene->jack_patches) {
+		list_del(node);
+		jack_patch_destroy(list_entry(node, jack_patch_t, siblings));
+	}
+
+	lash_free(&scene->name);
+	free(scene);
+}
+
+void
+scene_destroy_list(struct list_head *scene_list)
+{
+	struct list_head *node, *next;
+
+	list_for_each_safe (node, next, scene_list) {
+		list_del(node);
+		scene_destroy(list_entry(node, scene_t, siblings));
+	}
+}
+
+scene_t *
+scene_find_by_name(struct list_head *scene_list,
+                   const char       *name)
+{
+	struct list_head *node;
+	scene_t *scene;
+
+	list_for_each (node, scene_list) {
+		scene = list_entry(node, scene_t, siblings);
+
+		if (strcmp(scene->name, name) == 0)
+			return scene;
+	}
+
+	return NULL;
+}
+
+void
+scene_create_xml(scene_t    *scene,
+                 xmlNodePtr  parent)
+{
+	xmlNodePtr scenexml, patch_set;
+	struct list_head *node;
+
+	scenexml = xmlNewChild(parent, NULL, BAD_CAST "scene", NULL);
+
+	xmlNewChild(scenexml, NULL, BAD_CAST "name", BAD_CAST scene->name);
+
+	patch_set = xmlNewChild(scenexml, NULL, BAD_CAST "jack_patch_set", NULL);
+
+	list_for_each (node, &scene->jack_patches)
+		jack_patch_create_xml(list_entry(node, jack_patch_t, siblings),
+		                      patch_set);
+}
+
+scene_t *
+scene_parse_xml(xmlNodePtr parent)
+{
+	xmlNodePtr xmlnode, patchnode;
+	xmlChar *content;
+	jack_patch_t *patch;
+	scene_t *scene;
+
+	scene = scene_new("");
+
+	for (xmlnode = parent->children; xmlnode; xmlnode = xmlnode->next) {
+		if (strcmp((const char *) xmlnode->name, "name") == 0) {
+			content = xmlNodeGetContent(xmlnode);
+			lash_strset(&scene->name, (const char *) content);
+			xmlFree(content);
+		} else if (strcmp((const char *) xmlnode->name, "jack_patch_set") == 0) {
+			for (patchnode = xmlnode->children; patchnode;
+			     patchnode = patchnode->next) {
+				if (strcmp((const char *) patchnode->name, "jack_patch") != 0)
+					continue;
+
+				patch = jack_patch_new();
+				jack_patch_parse_xml(patch, patchnode);
+				list_add_tail(&patch->siblings, &scene->jack_patches);
+			}
+		}
+	}
+
+	if (!scene->name || !scene->name[0]) {
+		lash_error("Scene node has no name, ignoring it");
+		scene_destroy(scene);
+		return NULL;
+	}
+
+	return scene;
+}
+
+/* EOF */
@@ -0,0 +1,95 @@
+/*
+ *   LASH
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __LASHD_SCENE_H__
+#define __LASHD_SCENE_H__
+
+#include <libxml/tree.h>
+
+#include "common/klist.h"
+
+#include "types.h"
+
+/**
+ * A named set of JACK connections belonging to a project.
+ */
+struct _scene
+{
+	struct list_head  siblings;
+	char             *name;
+	struct list_head  jack_patches; /**< List of @ref jack_patch_t objects. */
+};
+
+/**
+ * Create a new scene with no patches.
+ *
+ * @param name The scene's name.
+ * @return Pointer to the newly allocated scene.
+ */
+scene_t *
+scene_new(const char *name);
+
+/**
+ * Destroy a scene and its patches. The scene must already be unlinked
+ * from any list it was in.
+ *
+ * @param scene The scene to destroy.
+ */
+void
+scene_destroy(scene_t *scene);
+
+/**
+ * Unlink and destroy all scenes in a list.
+ *
+ * @param scene_list List of @ref scene_t objects.
+ */
+void
+scene_destroy_list(struct list_head *scene_list);
+
+/**
+ * Find a scene by name.
+ *
+ * @param scene_list List of @ref scene_t objects.
+ * @param name The name to look for.
+ * @return Pointer to the scene, or NULL if no scene has that name.
+ */
+scene_t *
+scene_find_by_name(struct list_head *scene_list,
+                   const char       *name);
+
+/**
+ * Add a scene node describing @a scene to an XML document.
+ *
+ * @param scene The scene to describe.
+ * @param parent The node to add the scene node to.
+ */
+void
+scene_create_xml(scene_t    *scene,
+                 xmlNodePtr  parent);
+
+/**
+ * Create a new scene from a scene node.
+ *
+ * @param parent The scene node.
+ * @return Pointer to the newly allocated scene, or NULL if the node
+ *         does not name the scene.
+ */
+scene_t *
+scene_parse_xml(xmlNodePtr parent);
+
+#endif /* __LASHD_SCENE_H__ */
@@ -29,6 +29,7 @@
 #include <unistd.h>
 #include <dirent.h>
 #include <errno.h>
+#include <stdlib.h>
 #include <string.h>
 
 #include "server.h"
@@ -39,6 +40,9 @@
 #include "appdb.h"
 #include "file.h"
 #include "client_dependency.h"
+#include "journal.h"
+#include "stats.h"
+#include "watchdog.h"
 #include "dbus_iface_control.h"
 #include "common/safety.h"
 #include "common/debug.h"
@@ -59,10 +63,17 @@ server_fill_projects(void);
 bool
 server_start(const char *default_dir)
 {
+	int i;
+
 	g_server = lash_calloc(1, sizeof(server_t));
 
 	INIT_LIST_HEAD(&g_server->loaded_projects);
 	INIT_LIST_HEAD(&g_server->all_projects);
+	g_server->projects_generation = 1;
+	g_server->journal = journal_new();
+
+	for (i = 0; i < SERVER_PID_HASH_SIZE; ++i)
+		INIT_LIST_HEAD(&g_server->client_pids[i]);
 
 	lash_debug("Starting server");
 
@@ -118,6 +129,7 @@ server_stop(void)
 {
 	struct list_head *node;
 	project_t *project;
+	int i;
 
 	if (!g_server)
 		return;
@@ -129,6 +141,11 @@ server_stop(void)
 		project_destroy(project);
 	}
 
+	for (i = 0; i < SERVER_PROJECTS_NUM_ORDERS; ++i)
+		lash_free(&g_server->projects_index[i]);
+
+	journal_destroy(g_server->journal);
+
 	lash_debug("Destroying D-Bus service");
 	service_destroy(g_server->dbus_service);
 	g_server->dbus_service = NULL;
@@ -190,6 +207,96 @@ server_fill_projects(void)
 	}
 
 	closedir(dir);
+
+	server_projects_changed();
+}
+
+void
+server_projects_changed(void)
+{
+	++g_server->projects_generation;
+}
+
+static int
+server_project_compare_name(const void *a,
+                            const void *b)
+{
+	return strcmp((*(project_t * const *) a)->name,
+	              (*(project_t * const *) b)->name);
+}
+
+static int
+server_project_compare_mtime(const void *a,
+                             const void *b)
+{
+	time_t ta = (*(project_t * const *) a)->last_modify_time;
+	time_t tb = (*(project_t * const *) b)->last_modify_time;
+
+	if (ta != tb)
+		return (ta < tb) ? 1 : -1;
+
+	return server_project_compare_name(a, b);
+}
+
+/* Rebuild the sorted project arrays from all_projects */
+static void
+server_index_projects(void)
+{
+	struct list_head *node;
+	size_t num_projects = 0;
+	int i;
+
+	list_for_each (node, &g_server->all_projects)
+		++num_projects;
+
+	for (i = 0; i < SERVER_PROJECTS_NUM_ORDERS; ++i) {
+		lash_free(&g_server->projects_index[i]);
+		if (num_projects)
+			g_server->projects_index[i] = lash_malloc(num_projects, sizeof(project_t *));
+	}
+
+	g_server->projects_index_size = num_projects;
+	g_server->projects_index_generation = g_server->projects_generation;
+
+	if (!num_projects)
+		return;
+
+	num_projects = 0;
+	list_for_each (node, &g_server->all_projects)
+		g_server->projects_index[SERVER_PROJECTS_BY_NAME][num_projects++]
+		  = list_entry(node, project_t, siblings_all);
+
+	qsort(g_server->projects_index[SERVER_PROJECTS_BY_NAME], num_projects,
+	      sizeof(project_t *), server_project_compare_name);
+
+	memcpy(g_server->projects_index[SERVER_PROJECTS_BY_MTIME],
+	       g_server->projects_index[SERVER_PROJECTS_BY_NAME],
+	       num_projects * sizeof(project_t *));
+
+	qsort(g_server->projects_index[SERVER_PROJECTS_BY_MTIME], num_projects,
+	      sizeof(project_t *), server_project_compare_mtime);
+}
+
+project_t **
+server_get_sorted_projects(int     order,
+                           size_t *num_projects_ptr)
+{
+	if (g_server->projects_index_generation != g_server->projects_generation)
+		server_index_projects();
+
+	*num_projects_ptr = g_server->projects_index_size;
+
+	return g_server->projects_index[order];
+}
+
+bool
+server_project_matches(const project_t *project,
+                       const char      *filter)
+{
+	return (!filter[0]
+	        || strcasestr(project->name, filter)
+	        || (project->description
+	            && strcasestr(project->description, filter)));
 }
 
 /*****************************
@@ -231,23 +338,6 @@ find_client_in_list_by_dbus_name(struct list_head *client_list,
 	return NULL;
 }
 
-static __inline__ struct lash_client *
-find_client_in_list_by_pid(struct list_head *client_list,
-                           pid_t             pid)
-{
-	struct list_head *node;
-	struct lash_client *client;
-
-	list_for_each (node, client_list) {
-		client = list_entry(node, struct lash_client, siblings);
-
-		if (client->pid == pid)
-			return client;
-	}
-
-	return NULL;
-}
-
 struct lash_client *
 server_find_client_by_dbus_name(const char *dbus_name)
 {
@@ -285,42 +375,64 @@ server_find_client_by_id(uuid_t id)
 	return NULL;
 }
 
-struct lash_client *
-server_find_client_by_pid(pid_t pid)
+static __inline__ struct list_head *
+server_pid_bucket(pid_t pid)
 {
-	struct list_head *node;
-	project_t *project;
-	struct lash_client *client;
+	return &g_server->client_pids[(unsigned int) pid & (SERVER_PID_HASH_SIZE - 1)];
+}
 
-	list_for_each (node, &g_server->loaded_projects) {
-		project = list_entry(node, project_t, siblings_loaded);
+void
+server_set_client_pid(struct lash_client *client,
+                      pid_t               pid)
+{
+	list_del_init(&client->siblings_pid);
 
-		client = find_client_in_list_by_pid(&project->clients, pid);
-		if (client)
-			return client;
-	}
+	client->pid = pid;
 
-	return NULL;
+	if (pid)
+		list_add(&client->siblings_pid, server_pid_bucket(pid));
 }
 
-struct lash_client *
-server_find_lost_client_by_pid(pid_t pid)
+static bool
+server_client_is_lost(struct lash_client *client)
 {
-	struct list_head *node;
-	project_t *project;
+	return client->project && client->lost;
+}
+
+static struct lash_client *
+server_find_indexed_client_by_pid(pid_t pid,
+                                  bool  lost)
+{
+	struct list_head *node, *bucket;
 	struct lash_client *client;
 
-	list_for_each (node, &g_server->loaded_projects) {
-		project = list_entry(node, project_t, siblings_loaded);
+	if (!pid)
+		return NULL;
 
-		client = find_client_in_list_by_pid(&project->lost_clients, pid);
-		if (client)
+	bucket = server_pid_bucket(pid);
+
+	list_for_each (node, bucket) {
+		client = list_entry(node, struct lash_client, siblings_pid);
+
+		if (client->pid == pid && server_client_is_lost(client) == lost)
 			return client;
 	}
 
 	return NULL;
 }
 
+struct lash_client *
+server_find_client_by_pid(pid_t pid)
+{
+	return server_find_indexed_client_by_pid(pid, false);
+}
+
+struct lash_client *
+server_find_lost_client_by_pid(pid_t pid)
+{
+	return server_find_indexed_client_by_pid(pid, true);
+}
+
 static const char *
 server_create_new_project_name(const char *suggestion)
 {
@@ -479,15 +591,26 @@ server_add_client(const char  *dbus_name,
 {
 	struct lash_client *client;
 
+	/* Data sets are passed as file descriptors only if both ends
+	   and the bus between them support it */
+#ifdef HAVE_DATA_SET_FD
+	if (!dbus_connection_can_send_type(g_server->dbus_service->connection,
+	                                   DBUS_TYPE_UNIX_FD))
+#endif
+		flags &= ~LASH_Data_Set_Fd;
+
 	/* See if we launched this client */
 	if (pid && (client = server_find_lost_client_by_pid(pid))) {
 		lash_strset(&client->dbus_name, dbus_name);
 		client->flags |= LASH_Restored;
+		/* The restarted client may have been built differently */
+		client->flags = (client->flags & ~CLIENT_CONNECTION_FLAGS)
+		                | (flags & CLIENT_CONNECTION_FLAGS);
 		client_resume_project(client);
 	/* Otherwise add a new client */
 	} else {
 		client = client_new();
-		client->pid = pid;
+		server_set_client_pid(client, pid);
 		lash_strset(&client->class, class);
 		client->flags = flags;
 		client->argc = argc;
@@ -545,7 +668,8 @@ server_project_restore(project_t *project)
 	project->client_tasks_total = project->client_tasks_progress = 0;
 
 	/* Signal beginning of task */
-	lashd_dbus_signal_emit_progress(0);
+	project->task_id = ++g_server->task_iter;
+	project_progress(project, 0);
 
 	list_for_each (node, &project->lost_clients) {
 		client = list_entry(node, struct lash_client, siblings);
@@ -625,12 +749,34 @@ server_project_save_by_name(const char *project_name)
 void
 server_main(void)
 {
+	DBusConnection *conn = g_server->dbus_service->connection;
+	struct list_head *node;
+	uint64_t start;
+
 	while (!g_server->quit) {
-		dbus_connection_read_write_dispatch(g_server->dbus_service->connection, 50);
+		/* Only wait for new data when there is none left to dispatch */
+		if (dbus_connection_get_dispatch_status(conn) != DBUS_DISPATCH_DATA_REMAINS)
+			dbus_connection_read_write(conn, 50);
+
+		/* Time the iteration from here on, leaving out the wait */
+		start = histogram_now_usec();
+
+		dbus_connection_dispatch(conn);
+
+		list_for_each (node, &g_server->loaded_projects)
+			project_flush_progress(list_entry(node, project_t, siblings_loaded));
 
 		loader_run();
 		// TODO: wtf?
 		loader_run();
+
+		watchdog_run();
+
+#ifdef HAVE_JACK_DBUS
+		lashd_jackdbus_mgr_run(g_server->jackdbus_mgr);
+#endif
+
+		histogram_record(&g_stats.main_loop, histogram_now_usec() - start);
 	}
 
 	lash_debug("Finished");
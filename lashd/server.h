@@ -38,6 +38,17 @@
 
 extern server_t *g_server;
 
+/* Number of buckets in the client PID index, must be a power of two */
+#define SERVER_PID_HASH_SIZE 64
+
+/* Orders in which the available projects can be listed */
+enum
+{
+	SERVER_PROJECTS_BY_NAME = 0,
+	SERVER_PROJECTS_BY_MTIME,    /* Most recently modified first */
+	SERVER_PROJECTS_NUM_ORDERS
+};
+
 struct _server
 {
 	service_t            *dbus_service;
@@ -57,6 +68,19 @@ struct _server
 	struct list_head      all_projects;
 	struct list_head      appdb;
 	dbus_uint64_t         task_iter;
+	journal_t            *journal;
+
+	/** Clients with a known PID, hashed by PID */
+	struct list_head      client_pids[SERVER_PID_HASH_SIZE];
+
+	/** Generation of the available projects list, bumped whenever
+	    a project is added to it or a listed property changes */
+	dbus_uint64_t         projects_generation;
+	/** all_projects in each of the SERVER_PROJECTS_* orders, valid
+	    while projects_index_generation equals projects_generation */
+	project_t           **projects_index[SERVER_PROJECTS_NUM_ORDERS];
+	size_t                projects_index_size;
+	dbus_uint64_t         projects_index_generation;
 
 	bool                  quit;
 };
@@ -73,6 +97,31 @@ server_main(void);
 project_t *
 server_find_project_by_name(const char *project_name);
 
+/** Bump the generation of the available projects list. Must be called
+ * whenever a project is added to g_server->all_projects or the name,
+ * description, or modification time of such a project changes.
+ */
+void
+server_projects_changed(void);
+
+/** Get the available projects sorted in @a order. The array is owned
+ * by the server and stays valid until \ref server_projects_changed
+ * is called.
+ * @param order One of the SERVER_PROJECTS_* orders.
+ * @param num_projects_ptr Pointer to set to the number of projects.
+ * @return Array of projects, or NULL if there are none.
+ */
+project_t **
+server_get_sorted_projects(int     order,
+                           size_t *num_projects_ptr);
+
+/** Check whether @a filter is a substring of the name or description
+ * of @a project, ignoring case. An empty filter matches all projects.
+ */
+bool
+server_project_matches(const project_t *project,
+                       const char      *filter);
+
 struct lash_client *
 server_add_client(const char  *dbus_name,
                   pid_t        pid,
@@ -85,6 +134,15 @@ server_add_client(const char  *dbus_name,
 struct lash_client *
 server_find_client_by_dbus_name(const char *dbus_name);
 
+/** Set the PID of @a client to @a pid and update the server's PID index
+ * accordingly. A PID of 0 removes the client from the index.
+ * @param client Pointer to client.
+ * @param pid New PID of client.
+ */
+void
+server_set_client_pid(struct lash_client *client,
+                      pid_t               pid);
+
 struct lash_client *
 server_find_client_by_pid(pid_t pid);
 
@@ -0,0 +1,40 @@
+/*
+ *   LASH
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "stats.h"
+
+struct _stats g_stats;
+
+const char *const g_stats_counter_names[STATS_NUM_COUNTERS] = {
+	"jack_events",
+	"alsa_events",
+	"child_exits"
+};
+
+void
+stats_reset(void)
+{
+	unsigned int i;
+
+	histogram_reset(&g_stats.main_loop);
+
+	for (i = 0; i < STATS_NUM_COUNTERS; ++i)
+		__sync_fetch_and_and(&g_stats.counters[i], 0);
+}
+
+/* EOF */
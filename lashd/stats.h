@@ -0,0 +1,64 @@
+/*
+ *   LASH
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __LASHD_STATS_H__
+#define __LASHD_STATS_H__
+
+#include <stdint.h>
+
+#include "common/histogram.h"
+
+/* Counters of events handled by the server's managers */
+enum
+{
+	STATS_JACK_EVENTS = 0,   /* JACK port and graph notifications */
+	STATS_ALSA_EVENTS,       /* ALSA sequencer announcements */
+	STATS_CHILD_EXITS,       /* Terminated loader children */
+	STATS_NUM_COUNTERS
+};
+
+struct _stats
+{
+	/** Time spent busy in each main loop iteration, in microseconds */
+	struct histogram main_loop;
+	/** Event counts, which may be incremented from any thread or from
+	    a signal handler and must therefore only be touched atomically */
+	uint64_t         counters[STATS_NUM_COUNTERS];
+};
+
+extern struct _stats g_stats;
+
+extern const char *const g_stats_counter_names[STATS_NUM_COUNTERS];
+
+static __inline__ void
+stats_count(unsigned int counter)
+{
+	__sync_fetch_and_add(&g_stats.counters[counter], 1);
+}
+
+static __inline__ uint64_t
+stats_get(unsigned int counter)
+{
+	return __sync_fetch_and_add(&g_stats.counters[counter], 0);
+}
+
+/** Reset the main loop histogram and all event counters. */
+void
+stats_reset(void);
+
+#endif /* __LASHD_STATS_H__ */
@@ -21,6 +21,8 @@
 
 #define _GNU_SOURCE
 
+#include "config.h"
+
 #include <stdio.h>
 #include <stdint.h>
 #include <fcntl.h>
@@ -30,6 +32,13 @@
 #include <errno.h>
 #include <arpa/inet.h>
 
+#include <sys/mman.h>
+
+#ifdef HAVE_DATA_SET_FD
+# include <sys/sendfile.h>
+# include <sys/uio.h>
+#endif
+
 #include "store.h"
 #include "file.h"
 #include "common/safety.h"
@@ -42,9 +51,19 @@
 struct _store_key
 {
 	struct list_head  siblings;
+	struct list_head  hash_siblings;
 	char             *name;
 };
 
+#ifdef HAVE_DATA_SET_FD
+/* A data set file descriptor shared by the configs read from it */
+struct _store_fd
+{
+	int           fd;
+	unsigned int  refcount;
+};
+#endif
+
 struct _store_config
 {
 	struct list_head  siblings;
@@ -52,18 +71,25 @@ struct _store_config
 	void             *value;
 	size_t            value_size;
 	char              type;
+#ifdef HAVE_DATA_SET_FD
+	struct _store_fd *source; /* Data set fd holding the value, or NULL */
+	off_t             offset; /* Offset of the value size in source */
+#endif
 };
 
 store_t *
 store_new(void)
 {
 	store_t *store;
+	int i;
 
 	store = lash_calloc(1, sizeof(store_t));
 
 	INIT_LIST_HEAD(&store->keys);
 	INIT_LIST_HEAD(&store->removed_keys);
 	INIT_LIST_HEAD(&store->unstored_configs);
+	for (i = 0; i < STORE_KEY_HASH_SIZE; ++i)
+		INIT_LIST_HEAD(&store->key_hash[i]);
 
 	return store;
 }
@@ -87,6 +113,29 @@ store_destroy(store_t *store)
 	}
 }
 
+#ifdef HAVE_DATA_SET_FD
+static void
+store_fd_unref(struct _store_fd *sfd)
+{
+	if (sfd && --sfd->refcount == 0) {
+		close(sfd->fd);
+		free(sfd);
+	}
+}
+
+/* Forget the config's current value and the fd it may refer to */
+static void
+store_config_drop_source(struct _store_config *config)
+{
+	if (config->source) {
+		store_fd_unref(config->source);
+		config->source = NULL;
+		lash_free(&config->value);
+		config->value_size = 0;
+	}
+}
+#endif
+
 static void
 store_config_destroy(struct _store_config *config)
 {
@@ -94,6 +143,9 @@ store_config_destroy(struct _store_config *config)
 		list_del(&config->siblings);
 		lash_free(&config->key);
 		lash_free(&config->value);
+#ifdef HAVE_DATA_SET_FD
+		store_fd_unref(config->source);
+#endif
 		free(config);
 	}
 }
@@ -117,6 +169,7 @@ store_key_destroy(struct _store_key *key)
 {
 	if (key) {
 		list_del(&key->siblings);
+		list_del(&key->hash_siblings);
 		lash_free(&key->name);
 		free(key);
 	}
@@ -142,10 +195,53 @@ store_key_new(const char *name)
 	key = lash_malloc(1, sizeof(struct _store_key));
 	key->name = lash_strdup(name);
 	INIT_LIST_HEAD(&key->siblings);
+	INIT_LIST_HEAD(&key->hash_siblings);
 
 	return key;
 }
 
+static struct list_head *
+store_key_bucket(store_t    *store,
+                 const char *key_name)
+{
+	const unsigned char *p;
+	unsigned int hash = 2166136261u;
+
+	/* FNV-1a */
+	for (p = (const unsigned char *) key_name; *p; ++p)
+		hash = (hash ^ *p) * 16777619u;
+
+	return &store->key_hash[hash & (STORE_KEY_HASH_SIZE - 1)];
+}
+
+/* Add key to the end of the store's key list */
+static void
+store_add_key(store_t           *store,
+              struct _store_key *key)
+{
+	list_add_tail(&key->siblings, &store->keys);
+	list_add(&key->hash_siblings, store_key_bucket(store, key->name));
+}
+
+/* Return the key named key_name from the store's key list, or NULL */
+static struct _store_key *
+store_find_key(store_t    *store,
+               const char *key_name)
+{
+	struct list_head *node, *bucket;
+	struct _store_key *key;
+
+	bucket = store_key_bucket(store, key_name);
+
+	list_for_each (node, bucket) {
+		key = list_entry(node, struct _store_key, hash_siblings);
+		if (strcmp(key->name, key_name) == 0)
+			return key;
+	}
+
+	return NULL;
+}
+
 static __inline__ const char *
 store_get_info_filename(store_t *store)
 {
@@ -225,7 +321,7 @@ store_open(store_t *store)
 			*ptr = '\0';
 
 		key = store_key_new(line);
-		list_add_tail(&key->siblings, &store->keys);
+		store_add_key(store, key);
 	}
 
 	lash_free(&line);
@@ -260,13 +356,73 @@ fail:
 	return false;
 }
 
+#ifdef HAVE_DATA_SET_FD
+/* Copy len bytes starting at offset of in_fd to out_fd's current position
+   without passing them through user space */
+static bool
+store_copy_range(int    in_fd,
+                 off_t  offset,
+                 int    out_fd,
+                 size_t len)
+{
+	bool use_sendfile = false;
+	ssize_t copied;
+
+	while (len > 0) {
+		if (!use_sendfile) {
+			copied = copy_file_range(in_fd, &offset, out_fd, NULL,
+			                         len, 0);
+			/* Not every pair of file systems supports this,
+			   sendfile() can copy between any of them */
+			if (copied == -1
+			    && (errno == EXDEV || errno == EINVAL
+			        || errno == ENOSYS || errno == EOPNOTSUPP)) {
+				use_sendfile = true;
+				continue;
+			}
+		} else
+			copied = sendfile(out_fd, in_fd, &offset, len);
+
+		if (copied == -1) {
+			if (errno == EINTR)
+				continue;
+			return false;
+		} else if (copied == 0) {
+			errno = ENODATA;
+			return false;
+		}
+
+		len -= copied;
+	}
+
+	return true;
+}
+#endif
+
+static __inline__ bool
+store_write_config_value(int                   config_file,
+                         struct _store_config *config)
+{
+	ssize_t written;
+	uint32_t size;
+
+	/* Write the value size in network byte order */
+	size = ntohl(config->value_size);
+	written = write(config_file, &size, sizeof(uint32_t));
+	if (written == -1 || written < sizeof(uint32_t))
+		return false;
+
+	/* Write the value data and type byte */
+	written = write(config_file, config->value, config->value_size);
+	return !(written == -1 || written < config->value_size
+	         || write(config_file, &config->type, 1) < 1);
+}
+
 static __inline__ bool
 store_write_config(store_t              *store,
                    struct _store_config *config)
 {
 	int config_file;
-	ssize_t written;
-	uint32_t size;
 
 	if (config->value_size == 0) {
 		lash_error("Config '%s' has a value size of 0", config->key);
@@ -284,16 +440,17 @@ store_write_config(store_t              *store,
 		return false;
 	}
 
-	/* Write the value size in network byte order */
-	size = ntohl(config->value_size);
-	written = write(config_file, &size, sizeof(uint32_t));
-	if (written == -1 || written < sizeof(uint32_t))
-		goto fail_write;
-
-	/* Write the value data and type byte */
-	written = write(config_file, config->value, config->value_size);
-	if (written == -1 || written < config->value_size
-	    || write(config_file, &config->type, 1) < 1)
+#ifdef HAVE_DATA_SET_FD
+	/* A value received in a data set fd is already laid out like
+	   a config file's contents, so it's copied as it is */
+	if (config->source) {
+		if (!store_copy_range(config->source->fd, config->offset,
+		                      config_file,
+		                      sizeof(uint32_t) + config->value_size + 1))
+			goto fail_write;
+	} else
+#endif
+	if (!store_write_config_value(config_file, config))
 		goto fail_write;
 
 	if (close(config_file) == -1) {
@@ -385,7 +542,7 @@ store_delete_removed_configs(store_t *store)
 		filename = store_get_config_filename(store, key->name);
 
 		lash_debug("Removing config with key '%s', filename '%s'",
-		           key, filename);
+		           key->name, filename);
 
 		if (lash_file_exists(filename)) {
 			if (unlink(filename) == -1) {
@@ -402,7 +559,8 @@ store_delete_removed_configs(store_t *store)
 bool
 store_write(store_t *store)
 {
-	if (list_empty(&store->unstored_configs))
+	if (list_empty(&store->unstored_configs)
+	    && list_empty(&store->removed_keys))
 		return true;
 
 	if (!lash_dir_exists(store->dir))
@@ -430,6 +588,80 @@ store_write(store_t *store)
 	return true;
 }
 
+/* Return the unstored config for key_name, creating it and
+   adding the key to the store's key list if necessary */
+static struct _store_config *
+store_get_config_slot(store_t    *store,
+                      const char *key_name)
+{
+	struct list_head *node;
+	struct _store_key *key;
+	struct _store_config *config;
+	bool found;
+
+	/* If the key isn't in the store's key list add it, taking it back
+	   from the removed keys so that its new file isn't deleted */
+	if (!store_find_key(store, key_name)) {
+		found = false;
+		list_for_each (node, &store->removed_keys) {
+			key = list_entry(node, struct _store_key, siblings);
+			if (strcmp(key->name, key_name) == 0) {
+				found = true;
+				break;
+			}
+		}
+
+		if (found)
+			list_del(&key->siblings);
+		else
+			key = store_key_new(key_name);
+		store_add_key(store, key);
+		++store->num_keys;
+	}
+
+	/* Check whether we're overwriting a previous config */
+	list_for_each (node, &store->unstored_configs) {
+		config = list_entry(node, struct _store_config, siblings);
+		if (strcmp(config->key, key_name) == 0) {
+#ifdef HAVE_DATA_SET_FD
+			store_config_drop_source(config);
+#endif
+			return config;
+		}
+	}
+
+	/* A config wasn't found, allocate a new one and add it to the list */
+	config = lash_calloc(1, sizeof(struct _store_config));
+	lash_strset(&config->key, key_name);
+	list_add_tail(&config->siblings, &store->unstored_configs);
+
+	return config;
+}
+
+/* Get the slot of config key_name with a value buffer of size bytes */
+static struct _store_config *
+store_prepare_config(store_t    *store,
+                     const char *key_name,
+                     size_t      size,
+                     int         type)
+{
+	struct _store_config *config;
+
+	config = store_get_config_slot(store, key_name);
+
+	/* Enlarge the config's buffer if necessary */
+	if (config->value_size < size)
+		config->value = lash_realloc(config->value, 1, size);
+
+	config->value_size = size;
+	config->type = (char) type;
+
+	lash_debug("Added key \"%s\" of type '%c' to data set (%u bytes)",
+	           key_name, config->type, size);
+
+	return config;
+}
+
 bool
 store_set_config(store_t    *store,
                  const char *key_name,
@@ -448,55 +680,32 @@ store_set_config(store_t    *store,
 		return false;
 	}
 
-	struct list_head *node;
-	struct _store_key *key;
 	struct _store_config *config;
-	bool found;
 
-	/* Check if the config's key is already in the store's key list */
-	found = false;
-	list_for_each (node, &store->keys) {
-		key = list_entry(node, struct _store_key, siblings);
-		if (strcmp(key->name, key_name) == 0) {
-			found = true;
-			break;
-		}
-	}
+	config = store_prepare_config(store, key_name, size, type);
+	memcpy(config->value, value, size);
 
-	/* If the key wasn't found add it to the list */
-	if (!found) {
-		key = store_key_new(key_name);
-		list_add_tail(&key->siblings, &store->keys);
-		++store->num_keys;
-	} else
-		/* Needs a reset for the next check */
-		found = false;
+	return true;
+}
 
-	/* Check whether we're overwriting a previous config */
-	list_for_each (node, &store->unstored_configs) {
-		config = list_entry(node, struct _store_config, siblings);
-		if (strcmp(config->key, key_name) == 0) {
-			found = true;
-			break;
-		}
+bool
+store_set_config_block(store_t       *store,
+                       const char    *key_name,
+                       unsigned char  tag,
+                       const void    *data,
+                       size_t         size)
+{
+	if (!key_name || !key_name[0] || (size && !data)) {
+		lash_error("Invalid config parameter(s)");
+		return false;
 	}
 
-	/* If a config wasn't found allocate a new one and add it to the list */
-	if (!found) {
-		config = lash_calloc(1, sizeof(struct _store_config));
-		config->value = lash_malloc(1, size);
-		list_add_tail(&config->siblings, &store->unstored_configs);
-	} else if (config->value_size < size)
-		/* Enlarge existing config's buffer if necessary */
-		config->value = lash_realloc(config->value, 1, size);
-
-	lash_strset(&config->key, key_name);
-	memcpy(config->value, value, size);
-	config->value_size = size;
-	config->type = (char) type;
+	struct _store_config *config;
 
-	lash_debug("Added key \"%s\" of type '%c' to data set (%u bytes)",
-	           key_name, config->type, size);
+	config = store_prepare_config(store, key_name, size + 1,
+	                              LASH_TYPE_BLOCK);
+	((unsigned char *) config->value)[0] = tag;
+	memcpy((char *) config->value + 1, data, size);
 
 	return true;
 }
@@ -517,28 +726,304 @@ store_get_unstored_config(store_t    *store,
 	return NULL;
 }
 
-static __inline__ bool
-store_get_config(store_t     *store,
-                 const char  *key,
-                 void       **value_ptr,
-                 size_t      *size_ptr,
-                 int         *type_ptr)
+bool
+store_remove_config(store_t    *store,
+                    const char *key_name)
 {
+	struct _store_key *key;
 	struct _store_config *config;
-	const char *filename;
-	int config_file;
+
+	/* Drop a value which hasn't been written yet */
+	config = store_get_unstored_config(store, key_name);
+	if (config)
+		store_config_destroy(config);
+
+	key = store_find_key(store, key_name);
+	if (!key)
+		return false;
+
+	/* The file is deleted by store_write() */
+	list_move_tail(&key->siblings, &store->removed_keys);
+	list_del_init(&key->hash_siblings);
+	--store->num_keys;
+	lash_debug("Removed key \"%s\" from data set", key_name);
+	return true;
+}
+
+/* Get the value of an unstored config */
+static bool
+store_get_unstored_value(struct _store_config  *config,
+                         const void           **value_ptr)
+{
+#ifdef HAVE_DATA_SET_FD
 	ssize_t err;
+
+	/* Values in a data set fd are only read when needed */
+	if (config->source && !config->value) {
+		config->value = lash_malloc(1, config->value_size);
+		err = pread(config->source->fd, config->value,
+		            config->value_size,
+		            config->offset + sizeof(uint32_t));
+		if (err == -1 || err < config->value_size) {
+			lash_error("Cannot read value of config '%s' "
+			           "from data set fd: %s", config->key,
+			           err == -1 ? strerror(errno)
+			                     : "Not enough data read");
+			lash_free(&config->value);
+			return false;
+		}
+	}
+#endif
+
+	*value_ptr = config->value;
+	return true;
+}
+
+static __inline__ bool
+store_config_type_is_valid(char type)
+{
+	return (type == LASH_TYPE_DOUBLE || type == LASH_TYPE_INTEGER
+	        || type == LASH_TYPE_STRING || type == LASH_TYPE_RAW
+	        || type == LASH_TYPE_DOUBLE_ARRAY || type == LASH_TYPE_FLOAT_ARRAY
+	        || type == LASH_TYPE_INT_ARRAY || type == LASH_TYPE_BLOCK);
+}
+
+/* Read the value size and type of the config in file config_file */
+static bool
+store_read_config_header(int         config_file,
+                         const char *filename,
+                         size_t      file_size,
+                         size_t     *size_ptr,
+                         char       *type_ptr)
+{
 	uint32_t u;
 	size_t size;
-	void *value;
 	char type;
 
-	/* If there's an unstored config return that */
+	if (pread(config_file, &u, sizeof(uint32_t), 0) != sizeof(uint32_t)) {
+		lash_error("Cannot read value size from config file '%s'",
+		           filename);
+		return false;
+	}
+	size = ntohl(u);
+
+	if (size == 0 || file_size < sizeof(uint32_t) + size) {
+		lash_error("Config file '%s' contains an invalid value size",
+		           filename);
+		return false;
+	}
+
+	/* Files without a type byte contain raw data */
+	if (file_size == sizeof(uint32_t) + size)
+		type = LASH_TYPE_RAW;
+	else if (pread(config_file, &type, 1, sizeof(uint32_t) + size) != 1
+	         || !store_config_type_is_valid(type)) {
+		lash_error("Config file '%s' contains an invalid type",
+		           filename);
+		return false;
+	}
+
+	*size_ptr = size;
+	*type_ptr = type;
+	return true;
+}
+
+/* A config file mapped into memory */
+struct _store_mapping
+{
+	void       *map;
+	size_t      map_size;
+	const char *value;
+	size_t      value_size;
+	char        type;
+};
+
+static bool
+store_map_config(store_t               *store,
+                 const char            *key,
+                 struct _store_mapping *mapping)
+{
+	const char *filename;
+	struct stat st;
+	int config_file;
+
+	filename = store_get_config_filename(store, key);
+
+	config_file = open(filename, O_RDONLY);
+	if (config_file == -1) {
+		lash_error("Cannot open config file '%s' for reading: %s",
+		           filename, strerror(errno));
+		return false;
+	}
+
+	if (fstat(config_file, &st) == -1) {
+		lash_error("Cannot stat config file '%s': %s",
+		           filename, strerror(errno));
+		goto fail;
+	}
+
+	if (!store_read_config_header(config_file, filename, st.st_size,
+	                              &mapping->value_size, &mapping->type))
+		goto fail;
+
+	mapping->map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE,
+	                    config_file, 0);
+	if (mapping->map == MAP_FAILED) {
+		lash_error("Cannot map config file '%s': %s",
+		           filename, strerror(errno));
+		goto fail;
+	}
+
+	mapping->map_size = st.st_size;
+	mapping->value = (const char *) mapping->map + sizeof(uint32_t);
+
+	close(config_file);
+	return true;
+
+fail:
+	close(config_file);
+	return false;
+}
+
+/* Append a config to a D-Bus message as a dict entry */
+static bool
+store_append_config(store_t         *store,
+                    DBusMessageIter *iter,
+                    const char      *key)
+{
+	struct _store_config *config;
+	struct _store_mapping mapping;
+	const void *value, *ptr;
+	size_t size;
+	char type;
+	bool ret;
+
+	union {
+		double   d;
+		uint32_t u;
+	} number;
+
+	mapping.map = NULL;
+
+	/* If there's an unstored config use that, otherwise map the file */
+	config = store_get_unstored_config(store, key);
+	if (config) {
+		if (!store_get_unstored_value(config, &value))
+			return false;
+		size = config->value_size;
+		type = config->type;
+	} else {
+		if (!store_map_config(store, key, &mapping))
+			return false;
+		value = mapping.value;
+		size = mapping.value_size;
+		type = mapping.type;
+	}
+
+	/* Numbers are copied out of the mapping to have them aligned */
+	if (type == LASH_TYPE_DOUBLE || type == LASH_TYPE_INTEGER) {
+		if (size != (type == LASH_TYPE_DOUBLE ? sizeof(double)
+		                                      : sizeof(uint32_t))) {
+			lash_error("Config '%s' has an invalid value size", key);
+			ret = false;
+			goto end;
+		}
+		memcpy(&number, value, size);
+		ptr = &number;
+	} else {
+		/* A string must be terminated within the value */
+		if (type == LASH_TYPE_STRING
+		    && ((const char *) value)[size - 1] != '\0') {
+			lash_error("Config '%s' has an unterminated string", key);
+			ret = false;
+			goto end;
+		}
+		ptr = &value;
+	}
+
+	ret = method_iter_append_dict_entry(iter, type, key, ptr, size);
+	if (!ret)
+		lash_error("Failed to append dict entry");
+
+end:
+	if (mapping.map)
+		munmap(mapping.map, mapping.map_size);
+
+	return ret;
+}
+
+/* Add an array of configs to a D-Bus message. Used to
+   create a LoadDataSet message to be sent to a client. */
+bool
+store_create_config_array(store_t         *store,
+                          DBusMessageIter *iter)
+{
+	struct list_head *node;
+
+	list_for_each (node, &store->keys) {
+		/* Unreadable configs are skipped */
+		store_append_config(store, iter,
+		                    list_entry(node, struct _store_key,
+		                               siblings)->name);
+	}
+
+	return true;
+}
+
+bool
+store_create_config_array_for_keys(store_t            *store,
+                                   DBusMessageIter    *iter,
+                                   const char * const *keys,
+                                   int                 num_keys)
+{
+	int i;
+
+	for (i = 0; i < num_keys; ++i) {
+		if (store_find_key(store, keys[i])
+		    && !store_append_config(store, iter, keys[i]))
+			return false;
+	}
+
+	return true;
+}
+
+bool
+store_create_config_array_by_prefix(store_t         *store,
+                                    DBusMessageIter *iter,
+                                    const char      *prefix)
+{
+	struct list_head *node;
+	const char *key_name;
+	size_t len;
+
+	len = strlen(prefix);
+
+	list_for_each (node, &store->keys) {
+		key_name = list_entry(node, struct _store_key, siblings)->name;
+		if (strncmp(key_name, prefix, len) == 0
+		    && !store_append_config(store, iter, key_name))
+			return false;
+	}
+
+	return true;
+}
+
+/* Get the value size and type of a config without reading its value */
+static bool
+store_get_config_info(store_t    *store,
+                      const char *key,
+                      size_t     *size_ptr,
+                      char       *type_ptr)
+{
+	struct _store_config *config;
+	const char *filename;
+	struct stat st;
+	int config_file;
+	bool ret;
+
 	config = store_get_unstored_config(store, key);
 	if (config) {
-		*value_ptr = config->value;
 		*size_ptr = config->value_size;
-		// TODO: Can we trust the object to always contain a sane type?
 		*type_ptr = config->type;
 		return true;
 	}
@@ -552,93 +1037,325 @@ store_get_config(store_t     *store,
 		return false;
 	}
 
-	/* Read the value size from the file's first 2 bytes */
-	err = read(config_file, &u, sizeof(uint32_t));
-	if (err == -1 || err < sizeof(uint32_t)) {
-		lash_error("Cannot read value size from config file '%s': %s",
-		           filename,
-		           err == -1 ? strerror(errno) : "Not enough data read");
-		goto fail;
+	ret = (fstat(config_file, &st) == 0
+	       && store_read_config_header(config_file, filename, st.st_size,
+	                                   size_ptr, type_ptr));
+
+	close(config_file);
+	return ret;
+}
+
+bool
+store_create_key_array(store_t         *store,
+                       DBusMessageIter *iter)
+{
+	DBusMessageIter array_iter, struct_iter;
+	struct list_head *node;
+	const char *key_name;
+	dbus_uint32_t size;
+	size_t value_size;
+	unsigned char type;
+	char c;
+
+	if (!dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY, "(suy)",
+	                                      &array_iter)) {
+		lash_error("Failed to open key array container");
+		return false;
 	}
-	size = ntohl(u);
 
-	if (size == 0) {
-		lash_error("Config file '%s' contains a value size of 0", filename);
-		goto fail;
+	list_for_each (node, &store->keys) {
+		key_name = list_entry(node, struct _store_key, siblings)->name;
+
+		if (!store_get_config_info(store, key_name, &value_size, &c))
+			continue;
+
+		size = (dbus_uint32_t) value_size;
+		type = (unsigned char) c;
+
+		if (!dbus_message_iter_open_container(&array_iter,
+		                                      DBUS_TYPE_STRUCT, NULL,
+		                                      &struct_iter)
+		    || !dbus_message_iter_append_basic(&struct_iter,
+		                                       DBUS_TYPE_STRING,
+		                                       &key_name)
+		    || !dbus_message_iter_append_basic(&struct_iter,
+		                                       DBUS_TYPE_UINT32, &size)
+		    || !dbus_message_iter_append_basic(&struct_iter,
+		                                       DBUS_TYPE_BYTE, &type)
+		    || !dbus_message_iter_close_container(&array_iter,
+		                                          &struct_iter)) {
+			lash_error("Failed to append key '%s'", key_name);
+			dbus_message_iter_close_container(iter, &array_iter);
+			return false;
+		}
 	}
 
-	/* Read the config data itself */
-	value = lash_malloc(1, size);
-	err = read(config_file, value, size);
-	if (err == -1 || err < size) {
-		lash_error("Cannot read value from config file '%s': %s",
-		           filename,
-		           err == -1 ? strerror(errno) : "Not enough data read");
-		goto fail_free;
+	if (!dbus_message_iter_close_container(iter, &array_iter)) {
+		lash_error("Failed to close key array container");
+		return false;
 	}
 
-	/* Try to read the value type byte, if that fails assume raw data */
-	if (read(config_file, &type, 1) != 1)
-		type = LASH_TYPE_RAW;
+	return true;
+}
+
+#ifdef HAVE_DATA_SET_FD
+
+/* A record which has been validated but not yet applied to the store */
+struct _store_fd_record
+{
+	struct list_head  siblings;
+	char             *key;
+	size_t            value_size;
+	off_t             offset;
+	char              type;
+};
+
+static void
+store_fd_free_records(struct list_head *records)
+{
+	struct list_head *node, *next;
+	struct _store_fd_record *record;
 
-	/* Only accept API-defined types */
-	else if (type != LASH_TYPE_DOUBLE && type != LASH_TYPE_INTEGER
-	         && type != LASH_TYPE_STRING && type != LASH_TYPE_RAW) {
-		lash_error("Config file '%s' contains invalid type %d",
-		           filename, type);
-		goto fail_free;
+	list_for_each_safe (node, next, records) {
+		record = list_entry(node, struct _store_fd_record, siblings);
+		free(record->key);
+		free(record);
 	}
+}
 
-	/* Done */
-	*value_ptr = value;
-	*size_ptr = size;
-	*type_ptr = type;
+bool
+store_set_configs_from_fd(store_t *store,
+                          int      fd)
+{
+	struct _store_fd *sfd;
+	struct _store_fd_record *record;
+	struct _store_config *config;
+	struct list_head *node;
+	struct stat st;
+	const char *map, *ptr, *end;
+	size_t key_size, value_size;
+	uint32_t u;
+	char type;
+	int seals;
+	unsigned long count = 0;
+
+	LIST_HEAD(records);
+
+	/* The sender must not be able to change the
+	   data after it has been validated */
+	seals = fcntl(fd, F_GET_SEALS);
+	if (seals == -1
+	    || (seals & (F_SEAL_WRITE | F_SEAL_SHRINK))
+	       != (F_SEAL_WRITE | F_SEAL_SHRINK)) {
+		lash_error("Data set fd is not a sealed memfd");
+		close(fd);
+		return false;
+	}
 
-	/* This is non-fatal */
-	if (close(config_file) == -1) {
-		lash_error("Error closing config file '%s': %s",
-		           filename, strerror(errno));
+	if (fstat(fd, &st) == -1) {
+		lash_error("Cannot stat data set fd: %s", strerror(errno));
+		close(fd);
+		return false;
+	} else if (st.st_size == 0) {
+		lash_error("Data set fd contains no configs");
+		close(fd);
+		return false;
 	}
 
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		lash_error("Cannot map data set fd: %s", strerror(errno));
+		close(fd);
+		return false;
+	}
+
+	ptr = map;
+	end = map + st.st_size;
+
+	/* Validate every record before touching the store, so that
+	   a corrupt data set leaves it as it was */
+	while (ptr < end) {
+		if ((size_t) (end - ptr) < sizeof(uint32_t))
+			goto corrupt;
+		memcpy(&u, ptr, sizeof(uint32_t));
+		key_size = ntohl(u);
+		ptr += sizeof(uint32_t);
+
+		if (key_size == 0
+		    || (size_t) (end - ptr) < key_size + sizeof(uint32_t)
+		    || memchr(ptr, '\0', key_size))
+			goto corrupt;
+
+		memcpy(&u, ptr + key_size, sizeof(uint32_t));
+		value_size = ntohl(u);
+
+		if (value_size == 0
+		    || (size_t) (end - ptr) < key_size + sizeof(uint32_t) + value_size + 1)
+			goto corrupt;
+
+		type = ptr[key_size + sizeof(uint32_t) + value_size];
+		if (!store_config_type_is_valid(type)
+		    || (type == LASH_TYPE_STRING
+		        && ptr[key_size + sizeof(uint32_t) + value_size - 1] != '\0'))
+			goto corrupt;
+
+		record = lash_malloc(1, sizeof(struct _store_fd_record));
+		record->key = lash_malloc(1, key_size + 1);
+		memcpy(record->key, ptr, key_size);
+		record->key[key_size] = '\0';
+		record->value_size = value_size;
+		record->offset = ptr + key_size - map;
+		record->type = type;
+		list_add_tail(&record->siblings, &records);
+
+		ptr += key_size + sizeof(uint32_t) + value_size + 1;
+	}
+
+	munmap((void *) map, st.st_size);
+
+	/* Each applied config holds a reference to the fd */
+	sfd = lash_malloc(1, sizeof(struct _store_fd));
+	sfd->fd = fd;
+	sfd->refcount = 0;
+
+	list_for_each (node, &records) {
+		record = list_entry(node, struct _store_fd_record, siblings);
+
+		config = store_get_config_slot(store, record->key);
+		lash_free(&config->value);
+		config->value_size = record->value_size;
+		config->type = record->type;
+		config->source = sfd;
+		config->offset = record->offset;
+		++sfd->refcount;
+		++count;
+	}
+
+	lash_debug("Added %lu configs from data set fd (%lu bytes)",
+	           count, (unsigned long) st.st_size);
+
+	store_fd_free_records(&records);
+
 	return true;
 
-fail_free:
-	free(value);
-fail:
-	close(config_file);
+corrupt:
+	lash_error("Data set fd is corrupt at offset %lu",
+	           (unsigned long) (ptr - map));
+	store_fd_free_records(&records);
+	munmap((void *) map, st.st_size);
+	close(fd);
+
 	return false;
 }
 
-/* Add an array of configs to a D-Bus message. Used to
-   create a LoadDataSet message to be sent to a client. */
-bool
-store_create_config_array(store_t         *store,
-                          DBusMessageIter *iter)
+static __inline__ bool
+store_write_record_key(int         fd,
+                       const char *key)
+{
+	uint32_t size;
+	struct iovec iov[2];
+
+	size = htonl(strlen(key));
+	iov[0].iov_base = &size;
+	iov[0].iov_len = sizeof(uint32_t);
+	iov[1].iov_base = (void *) key;
+	iov[1].iov_len = strlen(key);
+
+	return writev(fd, iov, 2) == (ssize_t) (iov[0].iov_len + iov[1].iov_len);
+}
+
+/* Append the record of the stored config in filename to data set fd.
+   Returns 1 on success, 0 if the config file is unusable, and -1 if
+   the data set fd can no longer be used. */
+static int
+store_write_config_file_record(int         fd,
+                               const char *key,
+                               const char *filename)
+{
+	int config_file, ret = 0;
+	struct stat st;
+	size_t size;
+	char type;
+
+	config_file = open(filename, O_RDONLY);
+	if (config_file == -1) {
+		lash_error("Cannot open config file '%s' for reading: %s",
+		           filename, strerror(errno));
+		return 0;
+	}
+
+	if (fstat(config_file, &st) == -1
+	    || !store_read_config_header(config_file, filename, st.st_size,
+	                                 &size, &type))
+		goto end;
+
+	if (!store_write_record_key(fd, key)
+	    || !store_copy_range(config_file, 0, fd, sizeof(uint32_t) + size)
+	    || write(fd, &type, 1) != 1) {
+		lash_error("Cannot copy config file '%s' to data set fd: %s",
+		           filename, strerror(errno));
+		ret = -1;
+	} else
+		ret = 1;
+
+end:
+	close(config_file);
+	return ret;
+}
+
+int
+store_create_config_fd(store_t *store)
 {
 	struct list_head *node;
+	struct _store_config *config;
 	const char *key_name;
-	void *value, *ptr;
-	size_t size;
-	int type;
+	bool ok;
+	int fd;
+
+	fd = memfd_create("lash-data-set", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (fd == -1) {
+		lash_error("Cannot create data set memfd: %s", strerror(errno));
+		return -1;
+	}
 
 	list_for_each (node, &store->keys) {
 		key_name = list_entry(node, struct _store_key, siblings)->name;
 
-		if (!store_get_config(store, key_name, &value, &size, &type))
+		config = store_get_unstored_config(store, key_name);
+		if (!config) {
+			if (store_write_config_file_record(fd, key_name,
+			                                   store_get_config_filename(store, key_name)) == -1)
+				goto fail;
 			continue;
+		}
 
-		if (type == LASH_TYPE_STRING || type == LASH_TYPE_RAW)
-			ptr = &value;
-		else
-			ptr = value;
+		ok = store_write_record_key(fd, key_name);
+		if (ok && config->source)
+			ok = store_copy_range(config->source->fd, config->offset, fd,
+			                      sizeof(uint32_t) + config->value_size + 1);
+		else if (ok)
+			ok = store_write_config_value(fd, config);
 
-		if (!method_iter_append_dict_entry(iter, type, key_name, ptr, size)) {
-			lash_error("Failed to append dict entry");
-			return false;
+		if (!ok) {
+			lash_error("Cannot write config '%s' to data set memfd: %s",
+			           key_name, strerror(errno));
+			goto fail;
 		}
 	}
 
-	return true;
+	if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW
+	                           | F_SEAL_WRITE | F_SEAL_SEAL) == -1) {
+		lash_error("Cannot seal data set memfd: %s", strerror(errno));
+		goto fail;
+	}
+
+	return fd;
+
+fail:
+	close(fd);
+	return -1;
 }
 
+#endif /* HAVE_DATA_SET_FD */
+
 /* EOF */
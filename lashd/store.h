@@ -30,6 +30,8 @@
 
 #include "types.h"
 
+#define STORE_KEY_HASH_SIZE 64
+
 /* When a store is created, it will load the data from a directory if one
  * exists, but it won't create it, or the directory.  It will create files
  * when told to write to disk.
@@ -42,6 +44,8 @@ struct _store
 	struct list_head  keys;
 	struct list_head  removed_keys;
 	struct list_head  unstored_configs;
+	/* The keys in the keys list, hashed by name */
+	struct list_head  key_hash[STORE_KEY_HASH_SIZE];
 };
 
 store_t *
@@ -63,8 +67,79 @@ store_set_config(store_t    *store,
                  size_t      size,
                  int         type);
 
+/** Set a \ref LASH_TYPE_BLOCK config. The value is stored as @a tag
+ * followed by the @a size bytes at @a data.
+ */
+bool
+store_set_config_block(store_t       *store,
+                       const char    *key_name,
+                       unsigned char  tag,
+                       const void    *data,
+                       size_t         size);
+
+/** Remove the config named @a key_name from @a store. Its file is
+ * deleted the next time the store is written.
+ * @return True if the config existed, false otherwise.
+ */
+bool
+store_remove_config(store_t    *store,
+                    const char *key_name);
+
 bool
 store_create_config_array(store_t         *store,
                           DBusMessageIter *iter);
 
+/** Add a dict entry array of the configs named in @a keys to a D-Bus message.
+ * Keys which are not in @a store are skipped.
+ */
+bool
+store_create_config_array_for_keys(store_t            *store,
+                                   DBusMessageIter    *iter,
+                                   const char * const *keys,
+                                   int                 num_keys);
+
+/** Add a dict entry array of the configs whose keys begin with @a prefix
+ * to a D-Bus message.
+ */
+bool
+store_create_config_array_by_prefix(store_t         *store,
+                                    DBusMessageIter *iter,
+                                    const char      *prefix);
+
+/** Add an array of (key, value size, type) structs describing all of
+ * @a store 's configs to a D-Bus message, without reading the values.
+ */
+bool
+store_create_key_array(store_t         *store,
+                       DBusMessageIter *iter);
+
+#ifdef HAVE_DATA_SET_FD
+/* A data set file descriptor is a sealed memfd holding a sequence of
+ * records of the form [key size][key][value size][value][type byte].
+ * Sizes are 32-bit and in network byte order, and the key is not
+ * NUL-terminated. The part of a record which follows the key is
+ * identical to the contents of a config file, which lets configs be
+ * copied between the two without passing through user space.
+ */
+
+/** Set the configs contained in data set file descriptor @a fd.
+ * The values are not copied; the configs refer to @a fd until they are
+ * written to disk, and @a fd is closed when no config refers to it.
+ * @param store Store to set the configs in.
+ * @param fd Sealed memfd to read the configs from. Ownership is taken.
+ * @return True if at least one config was set, false otherwise.
+ */
+bool
+store_set_configs_from_fd(store_t *store,
+                          int      fd);
+
+/** Create a sealed data set file descriptor containing all of
+ * @a store 's configs.
+ * @param store Store to read the configs from.
+ * @return New file descriptor, or -1 on failure.
+ */
+int
+store_create_config_fd(store_t *store);
+#endif
+
 #endif /* __LASHD_STORE_H__ */
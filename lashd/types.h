@@ -35,6 +35,10 @@ typedef struct _jack_patch jack_patch_t;
 
 typedef struct _jack_mgr_client jack_mgr_client_t;
 
+typedef struct _patch_snapshot patch_snapshot_t;
+
+typedef struct _journal journal_t;
+
 #ifdef HAVE_ALSA
 typedef struct _alsa_mgr alsa_mgr_t;
 
@@ -51,4 +55,6 @@ typedef struct _store store_t;
 
 typedef struct _client_dependency client_dependency_t;
 
+typedef struct _scene scene_t;
+
 #endif /* __LASHD_TYPES_H__ */
@@ -0,0 +1,197 @@
+/*
+ *   LASH
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "../config.h"
+
+#include "common/debug.h"
+#include "common/klist.h"
+
+#include "watchdog.h"
+#include "server.h"
+#include "project.h"
+#include "client.h"
+
+static void
+watchdog_ping_return_handler(DBusPendingCall *pending,
+                             void            *data)
+{
+	struct lash_client *client = data;
+	struct _watchdog *watchdog = &client->watchdog;
+	DBusMessage *msg;
+	uint64_t now = histogram_now_usec();
+
+	msg = dbus_pending_call_steal_reply(pending);
+	dbus_pending_call_unref(pending);
+	watchdog->pending = NULL;
+
+	if (!msg || dbus_message_get_type(msg) != DBUS_MESSAGE_TYPE_METHOD_RETURN) {
+		/* Leave the client flagged, or let the budget flag it, and
+		   keep probing it closely */
+		lash_debug("Client '%s' did not answer ping: %s",
+		           client_get_identity(client),
+		           msg ? dbus_message_get_error_name(msg) : "No reply");
+		watchdog->interval = WATCHDOG_IDLE_MIN;
+		watchdog->next_usec = now + WATCHDOG_IDLE_MIN;
+		if (msg)
+			dbus_message_unref(msg);
+		return;
+	}
+
+	dbus_message_unref(msg);
+
+	histogram_record(&watchdog->latency, now - watchdog->sent_usec);
+
+	if (watchdog->unresponsive) {
+		lash_info("Client '%s' is responding again after %llu ms",
+		          client_get_identity(client),
+		          (unsigned long long) (now - watchdog->sent_usec) / 1000);
+		watchdog->unresponsive = false;
+		watchdog->interval = WATCHDOG_IDLE_MIN;
+	} else if (!client->pending_task) {
+		/* Back off while the client is idle and healthy */
+		watchdog->interval *= 2;
+		if (watchdog->interval > WATCHDOG_IDLE_MAX)
+			watchdog->interval = WATCHDOG_IDLE_MAX;
+	}
+
+	watchdog->next_usec = now + (client->pending_task
+	                             ? WATCHDOG_TASK_INTERVAL
+	                             : watchdog->interval);
+}
+
+/* Queue a ping to client. The connection is not flushed, so the pings
+   of one round go out together when the main loop next writes. */
+static void
+watchdog_ping(struct lash_client *client,
+              uint64_t            now)
+{
+	struct _watchdog *watchdog = &client->watchdog;
+	DBusMessage *msg;
+
+	msg = dbus_message_new_method_call(client->dbus_name, "/",
+	                                   DBUS_INTERFACE_PEER, "Ping");
+	if (!msg) {
+		lash_error("Ran out of memory trying to create ping");
+		return;
+	}
+
+	if (!dbus_connection_send_with_reply(g_server->dbus_service->connection,
+	                                     msg, &watchdog->pending, -1)
+	    || !watchdog->pending) {
+		lash_error("Cannot queue ping to client '%s'",
+		           client_get_identity(client));
+		watchdog->pending = NULL;
+		watchdog->next_usec = now + WATCHDOG_IDLE_MIN;
+	} else if (!dbus_pending_call_set_notify(watchdog->pending,
+	                                         watchdog_ping_return_handler,
+	                                         client, NULL)) {
+		lash_error("Ran out of memory trying to watch ping");
+		dbus_pending_call_cancel(watchdog->pending);
+		dbus_pending_call_unref(watchdog->pending);
+		watchdog->pending = NULL;
+		watchdog->next_usec = now + WATCHDOG_IDLE_MIN;
+	} else
+		watchdog->sent_usec = now;
+
+	dbus_message_unref(msg);
+}
+
+static void
+watchdog_check_client(struct lash_client *client,
+                      uint64_t            now)
+{
+	struct _watchdog *watchdog = &client->watchdog;
+
+	if (!client->dbus_name)
+		return;
+
+	if (watchdog->pending) {
+		if (!watchdog->unresponsive
+		    && now - watchdog->sent_usec > WATCHDOG_BUDGET) {
+			lash_error("Client '%s' has not answered a ping in %u ms",
+			           client_get_identity(client),
+			           WATCHDOG_BUDGET / 1000);
+			watchdog->unresponsive = true;
+			++watchdog->overruns;
+		}
+		return;
+	}
+
+	if (!watchdog->interval)
+		watchdog->interval = WATCHDOG_IDLE_MIN;
+
+	/* Don't wait out a long idle interval once a task has begun */
+	if (client->pending_task
+	    && watchdog->next_usec > watchdog->sent_usec + WATCHDOG_TASK_INTERVAL)
+		watchdog->next_usec = watchdog->sent_usec + WATCHDOG_TASK_INTERVAL;
+
+	if (now >= watchdog->next_usec)
+		watchdog_ping(client, now);
+}
+
+void
+watchdog_run(void)
+{
+	struct list_head *pnode, *cnode;
+	project_t *project;
+	uint64_t now = histogram_now_usec();
+
+	list_for_each (pnode, &g_server->loaded_projects) {
+		project = list_entry(pnode, project_t, siblings_loaded);
+
+		list_for_each (cnode, &project->clients)
+			watchdog_check_client(list_entry(cnode, struct lash_client,
+			                                 siblings), now);
+	}
+}
+
+void
+watchdog_client_reset(struct lash_client *client)
+{
+	struct _watchdog *watchdog = &client->watchdog;
+
+	if (watchdog->pending) {
+		dbus_pending_call_cancel(watchdog->pending);
+		dbus_pending_call_unref(watchdog->pending);
+		watchdog->pending = NULL;
+	}
+
+	watchdog->unresponsive = false;
+	watchdog->interval = WATCHDOG_IDLE_MIN;
+	watchdog->next_usec = 0;
+}
+
+void
+watchdog_reset_stats(void)
+{
+	struct list_head *pnode, *cnode;
+	project_t *project;
+	struct lash_client *client;
+
+	list_for_each (pnode, &g_server->loaded_projects) {
+		project = list_entry(pnode, project_t, siblings_loaded);
+
+		list_for_each (cnode, &project->clients) {
+			client = list_entry(cnode, struct lash_client, siblings);
+			histogram_reset(&client->watchdog.latency);
+			client->watchdog.overruns = 0;
+		}
+	}
+}
+
+/* EOF */
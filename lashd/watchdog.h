@@ -0,0 +1,73 @@
+/*
+ *   LASH
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __LASHD_WATCHDOG_H__
+#define __LASHD_WATCHDOG_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <dbus/dbus.h>
+
+#include "common/histogram.h"
+
+struct lash_client;
+
+/* Connected clients are pinged with org.freedesktop.DBus.Peer.Ping,
+   which libdbus answers when the client dispatches its messages, so the
+   round trip shows how quickly the client's main loop reacts. While a
+   client is idle the interval between pings doubles after every timely
+   answer, from WATCHDOG_IDLE_MIN up to WATCHDOG_IDLE_MAX. While it is
+   working on a task it is pinged every WATCHDOG_TASK_INTERVAL. A client
+   whose ping has not been answered within WATCHDOG_BUDGET is flagged as
+   unresponsive until it answers again. All times are in microseconds. */
+#define WATCHDOG_IDLE_MIN       1000000
+#define WATCHDOG_IDLE_MAX       60000000
+#define WATCHDOG_TASK_INTERVAL  1000000
+#define WATCHDOG_BUDGET         2000000
+
+struct _watchdog
+{
+	DBusPendingCall  *pending;      /* Ping in flight, or NULL */
+	uint64_t          sent_usec;    /* When the ping in flight was sent */
+	uint64_t          next_usec;    /* When to send the next ping */
+	uint64_t          interval;     /* Current interval while idle */
+	bool              unresponsive; /* Over budget since the last answer */
+	/** Round trip times of answered pings */
+	struct histogram  latency;
+	/** Number of times the client went over budget */
+	uint64_t          overruns;
+};
+
+/** Send the pings which are due and flag clients which have not
+ * answered theirs in time. Called once per main loop iteration.
+ */
+void
+watchdog_run(void);
+
+/** Cancel the ping in flight to @a client, if any, and start probing
+ * it from scratch the next time it is connected. Must be called when
+ * the client disconnects or is destroyed.
+ */
+void
+watchdog_client_reset(struct lash_client *client);
+
+/** Reset the latency statistics of all connected clients. */
+void
+watchdog_reset_stats(void);
+
+#endif /* __LASHD_WATCHDOG_H__ */
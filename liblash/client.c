@@ -20,32 +20,87 @@
  */
 
 #include <stdlib.h>
+#include <unistd.h>
 
 #include "common/safety.h"
+#include "dbus/service.h"
 
 #include "client.h"
+#include "io_thread.h"
+#include "dbus_iface_client.h"
+
+#ifdef LASH_OLD_API
+# include "lash/event.h"
+# include "lash/config.h"
+# include "event.h"
+# include "lash_config.h"
+#endif
 
 lash_client_t *
 lash_client_new(void)
 {
-#ifdef LASH_OLD_API
 	lash_client_t *client;
 	if ((client = lash_calloc(1, sizeof(lash_client_t)))) {
-		INIT_LIST_HEAD(&client->events_in);
-		INIT_LIST_HEAD(&client->configs_in);
+		client->epoll_fd = -1;
+		client->timer_fd = -1;
+		client->save_fd = -1;
+		client->progress.step = LASH_PROGRESS_STEP;
+		client->progress.interval = LASH_PROGRESS_INTERVAL * 1000;
+#ifdef LASH_OLD_API
+		client->event_pool = lash_calloc(1, sizeof(struct _lash_pool));
+		client->config_pool = lash_calloc(1, sizeof(struct _lash_pool));
+#endif
 	}
 	return client;
-#else
-	return lash_calloc(1, sizeof(lash_client_t));
-#endif
 }
 
 void
 lash_client_destroy(lash_client_t * client)
 {
 	if (client) {
+		lash_io_thread_stop(client);
+
+		/* The application can't complete a deferred save any more */
+		lash_save_cancel(client);
+
+		/* Closing the connection removes its watches and timeouts,
+		   so this must come before they are freed */
+		service_destroy(client->dbus_service);
+
 		lash_free(&client->class);
+		lash_free(&client->name);
 		lash_free(&client->project_name);
+		lash_free(&client->working_dir);
+		lash_free(&client->data_path);
+
+		if (client->epoll_fd != -1)
+			close(client->epoll_fd);
+		if (client->timer_fd != -1)
+			close(client->timer_fd);
+		if (client->save_fd != -1)
+			close(client->save_fd);
+		free(client->watches);
+		free(client->timeouts);
+		lash_dirty_keys_clear(&client->dirty_keys);
+		lash_dirty_keys_clear(&client->delta_keys);
+
+#ifdef LASH_OLD_API
+		lash_event_t *event;
+		lash_config_t *config;
+
+		/* The application may still destroy it */
+		if (client->pending_event)
+			client->pending_event->client = NULL;
+
+		while ((event = lash_queue_pop(&client->events_in)))
+			lash_event_destroy(event);
+		while ((config = lash_queue_pop(&client->configs_in)))
+			lash_config_destroy(config);
+		lash_queue_free(&client->events_in);
+		lash_queue_free(&client->configs_in);
+		lash_pool_release(client->event_pool, lash_event_free);
+		lash_pool_release(client->config_pool, lash_config_free);
+#endif
 
 		if (client->argv) {
 			int i;
@@ -60,26 +115,20 @@ lash_client_destroy(lash_client_t * client)
 }
 
 #ifdef LASH_OLD_API
-# include "event.h"
-# include "lash_config.h"
 void
 lash_client_add_event(lash_client_t *client,
                       lash_event_t  *event)
 {
-	if (client && event) {
-		list_add_tail(&event->siblings, &client->events_in);
-		++client->num_events_in;
-	}
+	if (client && event)
+		lash_queue_push(&client->events_in, event);
 }
 
 void
 lash_client_add_config(lash_client_t *client,
                        lash_config_t *config)
 {
-	if (client && config) {
-		list_add_tail(&config->siblings, &client->configs_in);
-		++client->num_configs_in;
-	}
+	if (client && config)
+		lash_queue_push(&client->configs_in, config);
 }
 #endif
 
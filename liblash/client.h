@@ -33,10 +33,16 @@
 
 #include "lash/types.h"
 
+#include "lash_config.h"
+
 #ifdef LASH_OLD_API
-# include "common/klist.h"
+# include "queue.h"
 #endif
 
+/* Default progress report coalescing, see lash_set_progress_coalescing() */
+#define LASH_PROGRESS_STEP     5    /* Percentage points */
+#define LASH_PROGRESS_INTERVAL 100  /* Milliseconds */
+
 struct _lash_client
 {
 	char       *class;
@@ -52,9 +58,45 @@ struct _lash_client
 	bool        quit; // TODO: What to do with this?
 	uint64_t    pending_task;
 	uint8_t     task_progress;
+
+	/* Progress report coalescing, see lash_notify_progress() */
+	struct
+	{
+		uint8_t   step;      /* Change which is reported at once */
+		uint64_t  interval;  /* Microseconds before a smaller change is reported */
+		uint64_t  task;      /* Task which sent and held refer to */
+		uint8_t   sent;      /* Last percentage sent */
+		uint8_t   held;      /* Percentage held back, or 0 */
+		uint64_t  sent_usec;
+		uint64_t  slot;      /* Atomic, the held back report for the flushing thread */
+		uint64_t  due;       /* Atomic, time after which slot is sent */
+	} progress;
+	size_t      data_set_size; /* size of the last saved data set, for progress estimates */
 	short       server_connected;
 	char       *data_path;
 
+	/* The connection's watches and timeouts, see watch.c */
+	DBusWatch   **watches;
+	size_t        num_watches;
+	DBusTimeout **timeouts;
+	size_t        num_timeouts;
+	int           epoll_fd;  /* -1 until lash_get_epoll_fd() is called */
+	int           timer_fd;
+	bool          data_remains; /* last status from lash_watch_dispatch_status() */
+
+	/* NULL unless lash_start_io_thread() has been called */
+	struct _lash_io_thread *io;
+
+	/* Keys changed since the last save, see lash_config_mark_dirty() */
+	struct _lash_dirty_keys dirty_keys;
+	struct _lash_dirty_keys delta_keys;   /* Keys of the delta awaiting a reply */
+	bool                    delta_sent;   /* A delta awaits its reply */
+	bool                    full_save;    /* A delta failed, the next save can't be one */
+
+	/* Save which the application has deferred, see lash_save_defer() */
+	struct _lash_save_token *save_token;
+	int                      save_fd;  /* Written by lash_save_complete() */
+
 	struct
 	{
 		LashEventCallback    trysave;
@@ -84,14 +126,16 @@ struct _lash_client
 	} ctx;
 
 #ifdef LASH_OLD_API
-	struct list_head events_in;
-	uint32_t         num_events_in;
+	struct _lash_queue  events_in;
+	struct _lash_queue  configs_in;
+	struct _lash_pool  *event_pool;
+	struct _lash_pool  *config_pool;
 
-	struct list_head configs_in;
-	uint32_t         num_configs_in;
+	/* Save or restore event which the application hasn't sent back yet */
+	lash_event_t       *pending_event;
 
-	method_msg_t     unsent_configs;
-	DBusMessageIter  iter, array_iter;
+	method_msg_t        unsent_configs;
+	DBusMessageIter     iter, array_iter;
 #endif
 };
 
@@ -21,6 +21,11 @@
 
 #include "../config.h"
 
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+
 #include "common/safety.h"
 #include "common/debug.h"
 
@@ -33,10 +38,13 @@
 
 #include "client.h"
 #include "lash_config.h"
+#include "dbus_iface_client.h"
+#include "io_thread.h"
 
 #ifdef LASH_OLD_API
 # include "lash/event.h"
 # include "lash/config.h"
+# include "event.h"
 #endif
 
 #define client_ptr ((lash_client_t *)(((object_path_t *)call->context)->context))
@@ -121,18 +129,64 @@ lash_dbus_try_save(method_call_t *call)
 	method_return_new_single(call, DBUS_TYPE_BOOLEAN, &retval);
 }
 
-/* Report task completion or failure to the LASH server */
+bool
+lash_send_progress(lash_client_t *client,
+                   dbus_uint64_t  task_id,
+                   uint8_t        percentage)
+{
+	DBusMessage *msg;
+	bool sent;
+
+	/* libdbus reuses freed messages, so this doesn't usually allocate */
+	msg = dbus_message_new_method_call("org.nongnu.LASH",
+	                                   "/",
+	                                   "org.nongnu.LASH.Server",
+	                                   "Progress");
+	if (!msg) {
+		lash_error("Ran out of memory trying to create Progress call");
+		return false;
+	}
+
+	dbus_message_set_no_reply(msg, TRUE);
+
+	sent = dbus_message_append_args(msg, DBUS_TYPE_UINT64, &task_id,
+	                                DBUS_TYPE_BYTE, &percentage,
+	                                DBUS_TYPE_INVALID)
+	       && dbus_connection_send(client->dbus_service->connection,
+	                               msg, NULL);
+	if (!sent)
+		lash_error("Ran out of memory trying to send Progress call");
+
+	dbus_message_unref(msg);
+
+	return sent;
+}
+
+/* Report completion or failure of task_id to the LASH server */
 static void
 report_success_or_failure(lash_client_t *client,
+                          dbus_uint64_t  task_id,
                           bool           success)
 {
-	if (!client->pending_task) {
+	if (!task_id) {
 		lash_error("Client has no pending task");
 		return;
 	}
 
 	uint8_t x = (uint8_t) (success ? 255 : 0);
 
+	/* With an I/O thread the result is sent by it after the progress
+	   reports, which would otherwise arrive after the result */
+	if (client->io) {
+		if (lash_io_thread_queue_result(client, task_id, x))
+			return;
+		if (!lash_io_thread_stopped(client))
+			lash_error("I/O result queue full, sending task result directly");
+	}
+
+	/* The last progress report goes before the result */
+	lash_flush_progress(client, task_id, true);
+
 	/* Send a success or failure report */
 	method_call_new_valist(client->dbus_service, NULL,
 	                       method_default_handler, false,
@@ -140,7 +194,7 @@ report_success_or_failure(lash_client_t *client,
 	                       "/",
 	                       "org.nongnu.LASH.Server",
 	                       "Progress",
-	                       DBUS_TYPE_UINT64, &client->pending_task,
+	                       DBUS_TYPE_UINT64, &task_id,
 	                       DBUS_TYPE_BYTE, &x,
 	                       DBUS_TYPE_INVALID);
 }
@@ -157,10 +211,10 @@ lash_new_save_task(lash_client_t *client,
 		/* Call the save callback; its return value dictates whether 
 		   to report success or failure back to the server */
 		if (client->cb.save(client->ctx.save)) {
-			report_success_or_failure(client, true);
+			report_success_or_failure(client, task_id, true);
 		} else {
 			lash_error("Client failed to save data");
-			report_success_or_failure(client, false);
+			report_success_or_failure(client, task_id, false);
 		}
 
 		client->pending_task = 0;
@@ -168,8 +222,8 @@ lash_new_save_task(lash_client_t *client,
 #ifdef LASH_OLD_API
 		/* Create a Save event and add it to the incoming queue */
 		lash_event_t *event;
-		if (!(event = lash_event_new_with_all(LASH_Save_File,
-		                                      client->data_path))) {
+		if (!(event = lash_client_new_event(client, LASH_Save_File,
+		                                    client->data_path))) {
 			lash_error("Failed to allocate lash_event_t");
 			client->pending_task = 0;
 			return;
@@ -266,10 +320,10 @@ lash_dbus_load(method_call_t *call)
 		/* Call the load callback; its return value dictates whether
 		   to report success or failure back to the server */
 		if (client_ptr->cb.load(client_ptr->ctx.load)) {
-			report_success_or_failure(client_ptr, true);
+			report_success_or_failure(client_ptr, task_id, true);
 		} else {
 			lash_error("Client failed to load data");
-			report_success_or_failure(client_ptr, false);
+			report_success_or_failure(client_ptr, task_id, false);
 		}
 
 		client_ptr->pending_task = 0;
@@ -281,8 +335,8 @@ lash_dbus_load(method_call_t *call)
 #else /* LASH_OLD_API */
 		/* Create a Restore event and add it to the incoming queue */
 		lash_event_t *event;
-		if (!(event = lash_event_new_with_all(LASH_Restore_File,
-		                                      client_ptr->data_path))) {
+		if (!(event = lash_client_new_event(client_ptr, LASH_Restore_File,
+		                                    client_ptr->data_path))) {
 			lash_dbus_error(call, LASH_DBUS_ERROR_GENERIC,
 			                "Failed to allocate lash_event_t");
 			return;
@@ -293,30 +347,80 @@ lash_dbus_load(method_call_t *call)
 	}
 }
 
-void
-lash_new_save_data_set_task(lash_client_t *client,
-                            dbus_uint64_t  task_id)
+#ifdef HAVE_DATA_SET_FD
+/* Pass the data set which has been saved into a memfd through cfg to the
+   server with CommitDataSetFd, which lets it reach the disk without being
+   copied into a message */
+static bool
+lash_commit_data_set_fd(lash_client_t              *client,
+                        dbus_uint64_t               task_id,
+                        struct _lash_config_handle *cfg)
 {
-	method_msg_t *new_call;
-	DBusMessageIter *iter, *array_iter;
+	method_msg_t new_call;
+	dbus_bool_t appended;
+	int fd;
 
-/* An ugly hack for the backwards compat API */
-#ifdef LASH_OLD_API
-	new_call = &client->unsent_configs;
-	iter = &client->iter;
-	array_iter = &client->array_iter;
-#else /* !LASH_OLD_API */
-	method_msg_t _new_call;
-	DBusMessageIter _iter, _array_iter;
-	new_call = &_new_call;
-	iter = &_iter;
-	array_iter = &_array_iter;
-#endif
+	if ((fd = lash_config_handle_take_fd(cfg)) == -1)
+		return false;
 
-	client->pending_task = task_id;
-	client->task_progress = 0;
+	if (!method_call_init(&new_call, client->dbus_service,
+	                      NULL,
+	                      method_default_handler,
+	                      "org.nongnu.LASH",
+	                      "/",
+	                      "org.nongnu.LASH.Server",
+	                      "CommitDataSetFd")) {
+		lash_error("Failed to initialise CommitDataSetFd method call");
+		close(fd);
+		return false;
+	}
+
+	/* The message takes a duplicate of the fd */
+	appended = dbus_message_append_args(new_call.message,
+	                                    DBUS_TYPE_UINT64, &task_id,
+	                                    DBUS_TYPE_UNIX_FD, &fd,
+	                                    DBUS_TYPE_INVALID);
+	close(fd);
 
-	if (!method_call_init(new_call, client->dbus_service,
+	if (!appended) {
+		lash_error("Failed to write CommitDataSetFd arguments");
+		dbus_message_unref(new_call.message);
+		return false;
+	}
+
+	if (!method_send(&new_call, false)) {
+		lash_error("Failed to send CommitDataSetFd method call");
+		return false;
+	}
+
+	lash_debug("Sent data set fd");
+
+	return true;
+}
+#endif
+
+/* State of a data set which is sent to the server in chunks */
+struct _data_set_stream
+{
+	lash_client_t   *client;
+	dbus_uint64_t    task_id;
+	method_msg_t    *call;
+	DBusMessageIter *iter;
+	DBusMessageIter *array_iter;
+	size_t           sent;   /* Bytes sent in earlier chunks */
+	bool             begun;  /* BeginDataSet has been sent */
+	bool             failed; /* call no longer holds a message */
+};
+
+/* Create a CommitDataSet message with an open config array */
+static bool
+lash_data_set_message_init(lash_client_t   *client,
+                           dbus_uint64_t    task_id,
+                           method_msg_t    *call,
+                           DBusMessageIter *iter,
+                           DBusMessageIter *array_iter)
+{
+	if (!method_call_init(call, client->dbus_service,
 	                      NULL,
 	                      method_default_handler,
 	                      "org.nongnu.LASH",
@@ -324,70 +428,473 @@ lash_new_save_data_set_task(lash_client_t *client,
 	                      "org.nongnu.LASH.Server",
 	                      "CommitDataSet")) {
 		lash_error("Failed to initialise CommitDataSet method call");
-		goto fail;
+		return false;
 	}
 
-	dbus_message_iter_init_append(new_call->message, iter);
+	dbus_message_iter_init_append(call->message, iter);
 
 	if (!dbus_message_iter_append_basic(iter, DBUS_TYPE_UINT64, &task_id)) {
 		lash_error("Failed to write task ID");
-		goto fail_unref;
+		goto fail;
 	}
 
 	if (!dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY, "{sv}", array_iter)) {
 		lash_error("Failed to open config array container");
-		goto fail_unref;
+		goto fail;
 	}
 
-	if (client->cb.save_data_set) {
-		struct _lash_config_handle cfg;
+	return true;
 
-		/* Call the save callback */
-		cfg.iter = array_iter;
-		cfg.is_read = false;
-		if (!client->cb.save_data_set(&cfg,
-		                              client->ctx.save_data_set)) {
-			lash_error("Callback failed to save data set");
-			dbus_message_iter_close_container(iter, array_iter);
-			goto fail_unref;
-		}
+fail:
+	dbus_message_unref(call->message);
+	call->message = NULL;
+	return false;
+}
 
-		if (!dbus_message_iter_close_container(iter, array_iter)) {
-			lash_error("Failed to close array container");
-			goto fail_unref;
+/* Send the configs written so far as an AppendDataSet chunk and
+   continue in a new message. Called by lash_config_write() and
+   lash_config_write_raw() when a chunk's worth has been written. */
+static bool
+lash_data_set_flush(struct _lash_config_handle *cfg)
+{
+	struct _data_set_stream *stream = cfg->flush_arg;
+	lash_client_t *client = stream->client;
+	uint8_t percentage = 0;
+
+	if (!stream->begun) {
+		if (!method_call_new_valist(client->dbus_service, NULL,
+		                            method_default_handler, false,
+		                            "org.nongnu.LASH",
+		                            "/",
+		                            "org.nongnu.LASH.Server",
+		                            "BeginDataSet",
+		                            DBUS_TYPE_UINT64, &stream->task_id,
+		                            DBUS_TYPE_INVALID)) {
+			lash_error("Failed to send BeginDataSet method call");
+			goto fail;
 		}
+		stream->begun = true;
+	}
+
+	stream->sent += cfg->chunk_size;
+	cfg->chunk_size = 0;
+
+	/* Estimate the progress from the size of the previous data set,
+	   0 tells the server that there's no estimate */
+	if (client->data_set_size) {
+		percentage = (uint8_t) (stream->sent * 99 / client->data_set_size);
+		if (stream->sent >= client->data_set_size)
+			percentage = 99;
+		else if (percentage == 0)
+			percentage = 1;
+	}
+
+	if (!dbus_message_iter_close_container(stream->iter, stream->array_iter)
+	    || !dbus_message_iter_append_basic(stream->iter, DBUS_TYPE_BYTE,
+	                                       &percentage)
+	    || !dbus_message_set_member(stream->call->message, "AppendDataSet")) {
+		lash_error("Failed to finish data set chunk");
+		goto fail;
+	}
+
+	if (!method_send(stream->call, false)) {
+		lash_error("Failed to send AppendDataSet method call");
+		stream->failed = true;
+		return false;
+	}
+
+	if (!lash_data_set_message_init(client, stream->task_id, stream->call,
+	                                stream->iter, stream->array_iter)) {
+		stream->failed = true;
+		return false;
+	}
+
+	return true;
+
+fail:
+	dbus_message_unref(stream->call->message);
+	stream->call->message = NULL;
+	stream->failed = true;
+	return false;
+}
+
+/* A data set save in progress. It lives on the heap so that the
+   application can finish writing the data set after the save callback
+   has returned, see lash_save_defer(). */
+struct _lash_save_token
+{
+	lash_client_t              *client;
+	dbus_uint64_t               task_id;
+	struct _lash_config_handle  cfg;
+	method_msg_t                call;
+	DBusMessageIter             iter;
+	DBusMessageIter             array_iter;
+	struct _data_set_stream     stream;
+	bool                        use_fd;      /* cfg writes to a memfd */
+	bool                        in_callback; /* The save callback is running */
+	bool                        deferred;
+	bool                        delta;       /* Sent with CommitDataSetDelta */
+	bool                        completed;   /* Atomic, set by lash_save_complete() */
+	bool                        success;     /* Written before completed is set */
+};
+
+/* The dirty keys of a delta are only forgotten once the server has
+   merged it. Otherwise they are kept, and the next save sends the whole
+   data set, since the stored one may now miss changes. */
+static void
+lash_commit_delta_handler(DBusPendingCall *pending,
+                          void            *data)
+{
+	lash_client_t *client = data;
+	DBusMessage *msg = dbus_pending_call_steal_reply(pending);
+	const char *err_str = NULL;
 
-		/* Succesfully sending the data set implies success */
-		if (!method_send(new_call, false)) {
-			lash_error("Failed to send CommitDataSet method call");
+	if (msg && method_return_verify(msg, &err_str)) {
+		lash_dirty_keys_clear(&client->delta_keys);
+	} else {
+		lash_error("Failed to commit data set delta: %s",
+		           err_str ? err_str : "No reply");
+		lash_dirty_keys_merge(&client->dirty_keys, &client->delta_keys);
+		client->full_save = true;
+	}
+
+	client->delta_sent = false;
+
+	if (msg)
+		dbus_message_unref(msg);
+	dbus_pending_call_unref(pending);
+}
+
+/* Send the data set written through the token's config handle, or report
+   failure if saved is false, and free the token */
+static void
+lash_save_finish(struct _lash_save_token *token,
+                 bool                     saved)
+{
+	lash_client_t *client = token->client;
+
+#ifdef HAVE_DATA_SET_FD
+	if (token->use_fd) {
+		if (!saved) {
+			lash_error("Callback failed to save data set");
+			lash_config_handle_close_fd(&token->cfg);
 			goto fail;
 		}
+		if (!lash_commit_data_set_fd(client, token->task_id, &token->cfg))
+			goto fail;
+		client->full_save = false;
+		goto end;
+	}
+#endif
 
-		lash_debug("Sent data set message");
+	/* The message is gone if sending a chunk failed */
+	if (token->stream.failed) {
+		lash_error("Failed to send data set chunk");
+		goto fail;
+	}
 
-		client->pending_task = 0;
+	if (!saved) {
+		lash_error("Callback failed to save data set");
+		dbus_message_iter_close_container(&token->iter, &token->array_iter);
+		goto fail_unref;
+	}
+
+	if (!dbus_message_iter_close_container(&token->iter, &token->array_iter)) {
+		lash_error("Failed to close array container");
+		goto fail_unref;
+	}
+
+	/* The dirty keys which weren't written have been removed */
+	if (token->delta
+	    && (!lash_dirty_keys_append_removed(&client->dirty_keys, &token->iter)
+	        || !dbus_message_set_member(token->call.message,
+	                                    "CommitDataSetDelta"))) {
+		lash_error("Failed to append removed keys");
+		goto fail_unref;
+	}
+
+	if (token->delta) {
+		token->call.return_handler = lash_commit_delta_handler;
+		token->call.context = client;
+	}
+
+	/* Succesfully sending the data set implies success */
+	if (!method_send(&token->call, false)) {
+		lash_error("Failed to send CommitDataSet method call");
+		goto fail;
+	}
+
+	lash_debug("Sent data set message");
+
+	if (token->delta) {
+		/* Keys marked from now on belong to the next save */
+		client->delta_keys = client->dirty_keys;
+		memset(&client->dirty_keys, 0, sizeof(client->dirty_keys));
+		client->delta_sent = true;
 	} else {
+		client->data_set_size = token->stream.sent + token->cfg.chunk_size;
+		client->full_save = false;
+	}
+	goto end;
+
+fail_unref:
+	dbus_message_unref(token->call.message);
+fail:
+	/* Keep the dirty keys for the next save */
+	if (token->delta)
+		lash_dirty_keys_reset(&client->dirty_keys);
+	report_success_or_failure(client, token->task_id, false);
+end:
+	/* Another task may have begun while the save was deferred */
+	if (client->pending_task == token->task_id)
+		client->pending_task = 0;
+	if (client->save_token == token)
+		client->save_token = NULL;
+	free(token);
+}
+
+void
+lash_save_cancel(lash_client_t *client)
+{
+	struct _lash_save_token *token = client->save_token;
+
+	if (!token)
+		return;
+
+#ifdef HAVE_DATA_SET_FD
+	if (token->use_fd)
+		lash_config_handle_close_fd(&token->cfg);
+	else
+#endif
+	if (!token->stream.failed) {
+		dbus_message_iter_close_container(&token->iter, &token->array_iter);
+		dbus_message_unref(token->call.message);
+	}
+
+	if (client->pending_task == token->task_id)
+		client->pending_task = 0;
+	client->save_token = NULL;
+	free(token);
+}
+
+/* Set up the token's config handle to write a CommitDataSet message,
+   which is sent in chunks if it grows bigger than a chunk */
+static bool
+lash_save_token_init_message(struct _lash_save_token *token)
+{
+	if (!lash_data_set_message_init(token->client, token->task_id,
+	                                &token->call, &token->iter,
+	                                &token->array_iter))
+		return false;
+
+	token->stream.client = token->client;
+	token->stream.task_id = token->task_id;
+	token->stream.call = &token->call;
+	token->stream.iter = &token->iter;
+	token->stream.array_iter = &token->array_iter;
+
+	lash_config_handle_init(&token->cfg, &token->array_iter, false);
+	token->cfg.flush = lash_data_set_flush;
+	token->cfg.flush_arg = &token->stream;
+
+	return true;
+}
+
+/* Create a token and call the save callback with its config handle,
+   which sends the data set in chunks if it grows bigger than a chunk */
+static void
+lash_save_data_set(lash_client_t *client,
+                   dbus_uint64_t  task_id)
+{
+	struct _lash_save_token *token;
+	bool saved;
+
+	token = lash_calloc(1, sizeof(struct _lash_save_token));
+	token->client = client;
+	token->task_id = task_id;
+
+#ifdef HAVE_DATA_SET_FD
+	if (client->flags & LASH_Data_Set_Fd) {
+		token->use_fd = true;
+		if (!lash_config_handle_init_fd_write(&token->cfg)) {
+			report_success_or_failure(client, task_id, false);
+			client->pending_task = 0;
+			free(token);
+			return;
+		}
+	} else
+#endif
+	if (!lash_save_token_init_message(token)) {
+		report_success_or_failure(client, task_id, false);
+		client->pending_task = 0;
+		free(token);
+		return;
+	}
+
+	token->cfg.save_token = token;
+
+	token->in_callback = true;
+	saved = client->cb.save_data_set(&token->cfg, client->ctx.save_data_set);
+	token->in_callback = false;
+
+	/* The application will call lash_save_complete() */
+	if (token->deferred) {
+		client->save_token = token;
+		return;
+	}
+
+	lash_save_finish(token, saved);
+}
+
+lash_save_token_t *
+lash_save_defer(lash_config_handle_t *config_handle)
+{
+	if (!config_handle || !config_handle->save_token
+	    || !config_handle->save_token->in_callback) {
+		lash_error("Saves can only be deferred from a save data set callback");
+		return NULL;
+	}
+
+	config_handle->save_token->deferred = true;
+
+	return config_handle->save_token;
+}
+
+bool
+lash_config_commit_delta(lash_config_handle_t *config_handle)
+{
+	struct _lash_save_token *token;
+
+	if (!config_handle || !(token = config_handle->save_token)
+	    || !(token->in_callback || token->deferred)) {
+		lash_error("Only saves can be sent as deltas");
+		return false;
+	}
+
+	if (token->delta)
+		return true;
+
+	/* Another delta would be merged into a data set which may be stale */
+	if (token->client->full_save || token->client->delta_sent) {
+		lash_debug("Previous delta is unconfirmed, sending all configs");
+		return false;
+	}
+
+#ifdef HAVE_DATA_SET_FD
+	/* A delta is small, and removed keys can't be sent in a memfd,
+	   so it always goes in the message */
+	if (token->use_fd) {
+		int fd = token->cfg.fd;
+
+		if (lseek(fd, 0, SEEK_END) != 0) {
+			lash_error("Cannot send a delta after configs have been written");
+			return false;
+		}
+
+		/* On failure the handle still writes to the memfd */
+		if (!lash_save_token_init_message(token))
+			return false;
+
+		close(fd);
+		token->use_fd = false;
+		token->cfg.save_token = token;
+	} else
+#endif
+	if (token->stream.begun || token->cfg.chunk_size) {
+		lash_error("Cannot send a delta after configs have been written");
+		return false;
+	}
+
+	token->delta = true;
+	token->cfg.delta = &token->client->dirty_keys;
+
+	return true;
+}
+
+/* The application may complete the save from any thread, so the token
+   is only marked and the rest is left to lash_save_dispatch() */
+void
+lash_save_complete(lash_save_token_t *token,
+                   bool               success)
+{
+	uint64_t one = 1;
+
+	if (!token || !token->deferred) {
+		lash_error("Invalid save token");
+		return;
+	}
+
+	token->success = success;
+	__atomic_store_n(&token->completed, true, __ATOMIC_RELEASE);
+
+	if (write(token->client->save_fd, &one, sizeof(one)) == -1)
+		lash_error("Cannot write event descriptor: %s", strerror(errno));
+}
+
+void
+lash_save_dispatch(lash_client_t *client)
+{
+	struct _lash_save_token *token = client->save_token;
+	uint64_t count;
+
+	if (!token || !__atomic_load_n(&token->completed, __ATOMIC_ACQUIRE))
+		return;
+
+	if (read(client->save_fd, &count, sizeof(count)) == -1
+	    && errno != EAGAIN)
+		lash_error("Cannot read event descriptor: %s", strerror(errno));
+
+	lash_save_finish(token, token->success);
+}
+
+void
+lash_new_save_data_set_task(lash_client_t *client,
+                            dbus_uint64_t  task_id)
+{
+	/* The data set can't be written twice at once */
+	if (client->save_token) {
+		lash_error("Task %llu is still saving the data set",
+		           client->save_token->task_id);
+		report_success_or_failure(client, task_id, false);
+		return;
+	}
+
+	client->pending_task = task_id;
+	client->task_progress = 0;
+
+	if (client->cb.save_data_set) {
+		lash_save_data_set(client, task_id);
+		return;
+	}
+
 #ifndef LASH_OLD_API
-		lash_error("SaveDataSet callback not registered");
-		goto fail;
+	lash_error("SaveDataSet callback not registered");
+	report_success_or_failure(client, task_id, false);
+	client->pending_task = 0;
 #else /* LASH_OLD_API */
-		/* Create a SaveDataSet event and add it to the incoming queue */
-		lash_event_t *event;
-		if (!(event = lash_event_new_with_type(LASH_Save_Data_Set))) {
-			lash_error("Failed to allocate lash_event_t");
-			goto fail;
-		}
-		lash_client_add_event(client, event);
-#endif /* LASH_OLD_API */
+	/* An ugly hack for the backwards compat API: the data set is
+	   written to the client's own message by lash_send_config() */
+	lash_event_t *event;
+
+	if (!lash_data_set_message_init(client, task_id,
+	                                &client->unsent_configs,
+	                                &client->iter, &client->array_iter))
+		goto fail;
+
+	/* Create a SaveDataSet event and add it to the incoming queue */
+	if (!(event = lash_client_new_event(client, LASH_Save_Data_Set, NULL))) {
+		lash_error("Failed to allocate lash_event_t");
+		dbus_message_unref(client->unsent_configs.message);
+		goto fail;
 	}
+	lash_client_add_event(client, event);
 
 	return;
 
-fail_unref:
-	dbus_message_unref(new_call->message);
 fail:
-	report_success_or_failure(client, false);
+	report_success_or_failure(client, task_id, false);
 	client->pending_task = 0;
+#endif /* LASH_OLD_API */
 }
 
 #if 0
@@ -409,31 +916,12 @@ lash_dbus_save_data_set(method_call_t *call)
 }
 #endif
 
+/* Pass the data set readable through cfg to the client */
 static void
-lash_dbus_load_data_set(method_call_t *call)
+lash_load_data_set(method_call_t              *call,
+                   dbus_uint64_t               task_id,
+                   struct _lash_config_handle *cfg)
 {
-	lash_debug("LoadDataSet");
-
-	DBusMessageIter iter, array_iter;
-	dbus_uint64_t task_id;
-	struct _lash_config_handle cfg;
-
-	if (!get_task_id(call, &task_id, &iter))
-		return;
-
-	if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY) {
-		lash_dbus_error(call, LASH_DBUS_ERROR_INVALID_ARGS,
-		                "Invalid arguments to method \"%s\": "
-		                "Cannot find data set array in message",
-		                call->method_name);
-		return;
-	}
-
-	dbus_message_iter_recurse(&iter, &array_iter);
-
-	cfg.iter = &array_iter;
-	cfg.is_read = true;
-
 	client_ptr->pending_task = task_id;
 	client_ptr->task_progress = 0;
 
@@ -444,12 +932,12 @@ lash_dbus_load_data_set(method_call_t *call)
 
 		/* Call the load callback; its return value dictates whether
 		   to report success or failure back to the server */
-		if (client_ptr->cb.load_data_set(&cfg,
+		if (client_ptr->cb.load_data_set(cfg,
 		                                 client_ptr->ctx.load_data_set)) {
-			report_success_or_failure(client_ptr, true);
+			report_success_or_failure(client_ptr, task_id, true);
 		} else {
 			lash_error("Callback failed to load data set");
-			report_success_or_failure(client_ptr, false);
+			report_success_or_failure(client_ptr, task_id, false);
 		}
 
 		client_ptr->pending_task = 0;
@@ -472,7 +960,8 @@ lash_dbus_load_data_set(method_call_t *call)
 		lash_event_t *event;
 		lash_config_t *config;
 
-		event = lash_event_new_with_type(LASH_Restore_Data_Set);
+		event = lash_client_new_event(client_ptr, LASH_Restore_Data_Set,
+		                              NULL);
 		if (!event) {
 			lash_dbus_error(call, LASH_DBUS_ERROR_GENERIC,
 			                "Failed to allocate lash_event_t");
@@ -481,14 +970,14 @@ lash_dbus_load_data_set(method_call_t *call)
 		}
 		lash_client_add_event(client_ptr, event);
 
-		while ((ret = lash_config_read(&cfg, &key, &value, &type))) {
+		while ((ret = lash_config_read(cfg, &key, &value, &type))) {
 			if (ret == -1) {
 				lash_dbus_error(call, LASH_DBUS_ERROR_GENERIC,
 				                "Failed to read data set");
 				break;
 			}
 
-			config = lash_config_new_with_key(key);
+			config = lash_client_new_config(client_ptr, key);
 			if (!config) {
 				lash_dbus_error(call, LASH_DBUS_ERROR_GENERIC,
 				                "Failed to allocate lash_config_t");
@@ -503,6 +992,11 @@ lash_dbus_load_data_set(method_call_t *call)
 				lash_config_set_value_string(config, value.s);
 			else if (type == LASH_TYPE_RAW)
 				lash_config_set_value(config, value.v, (size_t) ret);
+			else if (type == LASH_TYPE_DOUBLE_ARRAY
+			         || type == LASH_TYPE_FLOAT_ARRAY
+			         || type == LASH_TYPE_INT_ARRAY)
+				lash_config_set_value_array(config, type, value.v,
+				                            (size_t) ret);
 			else {
 				lash_error("Unknown config type '%c'", type);
 				lash_config_destroy(config);
@@ -515,6 +1009,105 @@ lash_dbus_load_data_set(method_call_t *call)
 	}
 }
 
+static void
+lash_dbus_load_data_set(method_call_t *call)
+{
+	lash_debug("LoadDataSet");
+
+	DBusMessageIter iter, array_iter;
+	dbus_uint64_t task_id;
+	struct _lash_config_handle cfg;
+
+	if (!get_task_id(call, &task_id, &iter))
+		return;
+
+	if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY) {
+		lash_dbus_error(call, LASH_DBUS_ERROR_INVALID_ARGS,
+		                "Invalid arguments to method \"%s\": "
+		                "Cannot find data set array in message",
+		                call->method_name);
+		return;
+	}
+
+	dbus_message_iter_recurse(&iter, &array_iter);
+
+	lash_config_handle_init(&cfg, &array_iter, true);
+	lash_load_data_set(call, task_id, &cfg);
+}
+
+/* Same as LoadDataSet, but the data set is an a(suy) array of keys,
+   value sizes, and types; the values are fetched with lash_get_configs() */
+static void
+lash_dbus_load_data_set_keys(method_call_t *call)
+{
+	lash_debug("LoadDataSetKeys");
+
+	DBusMessageIter iter, array_iter;
+	dbus_uint64_t task_id;
+	struct _lash_config_handle cfg;
+
+	if (!get_task_id(call, &task_id, &iter))
+		return;
+
+	if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_ARRAY) {
+		lash_dbus_error(call, LASH_DBUS_ERROR_INVALID_ARGS,
+		                "Invalid arguments to method \"%s\": "
+		                "Cannot find key array in message",
+		                call->method_name);
+		return;
+	}
+
+	/* The old API's config events need the values */
+	if (!client_ptr->cb.load_data_set) {
+		lash_dbus_error(call, LASH_DBUS_ERROR_GENERIC,
+		                "LoadDataSet callback not registered");
+		return;
+	}
+
+	dbus_message_iter_recurse(&iter, &array_iter);
+
+	lash_config_handle_init(&cfg, &array_iter, true);
+	cfg.keys_only = true;
+	lash_load_data_set(call, task_id, &cfg);
+}
+
+#ifdef HAVE_DATA_SET_FD
+/* Same as LoadDataSet, but the data set is in a sealed memfd */
+static void
+lash_dbus_load_data_set_fd(method_call_t *call)
+{
+	lash_debug("LoadDataSetFd");
+
+	DBusMessageIter iter;
+	dbus_uint64_t task_id;
+	struct _lash_config_handle cfg;
+	int fd;
+
+	if (!get_task_id(call, &task_id, &iter))
+		return;
+
+	if (dbus_message_iter_get_arg_type(&iter) != DBUS_TYPE_UNIX_FD) {
+		lash_dbus_error(call, LASH_DBUS_ERROR_INVALID_ARGS,
+		                "Invalid arguments to method \"%s\": "
+		                "Cannot find data set fd in message",
+		                call->method_name);
+		return;
+	}
+
+	dbus_message_iter_get_basic(&iter, &fd);
+
+	if (!lash_config_handle_init_fd_read(&cfg, fd)) {
+		lash_dbus_error(call, LASH_DBUS_ERROR_GENERIC,
+		                "Cannot read data set fd");
+		lash_config_handle_close_fd(&cfg);
+		return;
+	}
+
+	lash_load_data_set(call, task_id, &cfg);
+	lash_config_handle_close_fd(&cfg);
+}
+#endif
+
 void
 lash_new_quit_task(lash_client_t *client)
 {
@@ -530,7 +1123,7 @@ lash_new_quit_task(lash_client_t *client)
 #else /* LASH_OLD_API */
 		/* Create a Quit event and add it to the incoming queue */
 		lash_event_t *event;
-		if (!(event = lash_event_new_with_type(LASH_Quit))) {
+		if (!(event = lash_client_new_event(client, LASH_Quit, NULL))) {
 			lash_error("Failed to allocate lash_event_t");
 			return;
 		}
@@ -685,6 +1278,18 @@ METHOD_ARGS_BEGIN(LoadDataSet)
   METHOD_ARG_DESCRIBE("configs", "a{sv}", DIRECTION_IN)
 METHOD_ARGS_END
 
+METHOD_ARGS_BEGIN(LoadDataSetKeys)
+  METHOD_ARG_DESCRIBE("task_id", "t", DIRECTION_IN)
+  METHOD_ARG_DESCRIBE("keys", "a(suy)", DIRECTION_IN)
+METHOD_ARGS_END
+
+#ifdef HAVE_DATA_SET_FD
+METHOD_ARGS_BEGIN(LoadDataSetFd)
+  METHOD_ARG_DESCRIBE("task_id", "t", DIRECTION_IN)
+  METHOD_ARG_DESCRIBE("configs_fd", "h", DIRECTION_IN)
+METHOD_ARGS_END
+#endif
+
 METHOD_ARGS_BEGIN(Quit)
 METHOD_ARGS_END
 
@@ -704,6 +1309,10 @@ METHODS_BEGIN
   METHOD_DESCRIBE(Save, lash_dbus_save)
   METHOD_DESCRIBE(Load, lash_dbus_load)
   METHOD_DESCRIBE(LoadDataSet, lash_dbus_load_data_set)
+  METHOD_DESCRIBE(LoadDataSetKeys, lash_dbus_load_data_set_keys)
+#ifdef HAVE_DATA_SET_FD
+  METHOD_DESCRIBE(LoadDataSetFd, lash_dbus_load_data_set_fd)
+#endif
   METHOD_DESCRIBE(Quit, lash_dbus_quit)
   METHOD_DESCRIBE(TrySave, lash_dbus_try_save)
   METHOD_DESCRIBE(TryPathChange, lash_dbus_try_path_change)
@@ -40,4 +40,43 @@ lash_new_save_data_set_task(lash_client_t *client,
 void
 lash_new_quit_task(lash_client_t *client);
 
+/* Queue a Progress method call which expects no reply, without flushing
+   the connection */
+bool
+lash_send_progress(lash_client_t *client,
+                   dbus_uint64_t  task_id,
+                   uint8_t        percentage);
+
+/* Take the progress report which lash_notify_progress() has held back
+   for task_id, or for any task if task_id is 0. If force is false it is
+   only taken once the minimum interval has passed. Only one thread may
+   take reports: the I/O thread if there is one, otherwise the thread
+   dispatching messages. */
+bool
+lash_take_held_progress(lash_client_t *client,
+                        dbus_uint64_t  task_id,
+                        bool           force,
+                        dbus_uint64_t *held_task,
+                        uint8_t       *percentage);
+
+/* Take the held back report as above and send it */
+void
+lash_flush_progress(lash_client_t *client,
+                    dbus_uint64_t  task_id,
+                    bool           force);
+
+/* Milliseconds until the held back report is due, or -1 if none is */
+int
+lash_held_progress_timeout(lash_client_t *client);
+
+/* Drop a deferred save whose token the application still holds, without
+   reporting anything to the server */
+void
+lash_save_cancel(lash_client_t *client);
+
+/* Finish the deferred save if lash_save_complete() has been called for
+   it. Runs in the thread which dispatches the client's messages. */
+void
+lash_save_dispatch(lash_client_t *client);
+
 #endif /* __LIBLASH_DBUS_IFACE_CLIENT_H__ */
@@ -41,8 +41,11 @@ lash_dbus_service_new(lash_client_t *client)
 		return NULL;
 	}
 
+	/* A connection of its own keeps the client's watch functions from
+	   clashing with the application's, or another client's, use of the
+	   shared session bus connection */
 	return service_new(NULL, &client->quit,
-	                   1,
+	                   true, 1,
 	                   object_path_new("/org/nongnu/LASH/Client",
 	                                   (void *) client, 1,
 	                                   &g_liblash_interface_client, NULL),
@@ -124,20 +127,22 @@ end:
 }
 
 
-void
-lash_dbus_service_connect(lash_client_t *client)
+DBusPendingCall *
+lash_dbus_service_connect(lash_client_t *client,
+                          bool           auto_start)
 {
 	if (!client) {
 		lash_error("NULL client parameter");
-		return;
+		return NULL;
 	} else if (client->server_connected) {
 		lash_error("Client is already connected");
-		return;
+		return NULL;
 	}
 
 	method_msg_t call;
 	dbus_int32_t pid;
 	DBusMessageIter iter, array_iter;
+	DBusPendingCall *pending = NULL;
 	int i;
 
 	if (!method_call_init(&call, client->dbus_service,
@@ -151,6 +156,16 @@ lash_dbus_service_connect(lash_client_t *client)
 
 	pid = (dbus_int32_t) getpid();
 
+	/* Offer to exchange data sets as file descriptors if the bus
+	   can carry them; the server clears the flag if it can't */
+#ifdef HAVE_DATA_SET_FD
+	if (dbus_connection_can_send_type(client->dbus_service->connection,
+	                                  DBUS_TYPE_UNIX_FD))
+		client->flags |= LASH_Data_Set_Fd;
+	else
+#endif
+		client->flags &= ~LASH_Data_Set_Fd;
+
 	if (!dbus_message_append_args(call.message,
 	                              DBUS_TYPE_INT32, &pid,
 	                              DBUS_TYPE_STRING, &client->class,
@@ -174,21 +189,40 @@ lash_dbus_service_connect(lash_client_t *client)
 		}
 	}
 
-	if (dbus_message_iter_close_container(&iter, &array_iter)) {
-		lash_debug("Sending connection request to LASH server");
-		if (method_send(&call, true))
-			return;
-		goto fail;
+	if (!dbus_message_iter_close_container(&iter, &array_iter))
+		goto fail_oom;
+
+	/* Without auto-start the call fails at once if there's no server */
+	dbus_message_set_auto_start(call.message, auto_start);
+
+	lash_debug("Sending connection request to LASH server");
+
+	if (!dbus_connection_send_with_reply(client->dbus_service->connection,
+	                                     call.message, &pending, -1)
+	    || !pending) {
+		lash_error("Ran out of memory trying to queue method call");
+		goto fail_unref;
 	}
 
+	/* One reference is dropped by the handler, the other by the caller */
+	dbus_pending_call_ref(pending);
+	dbus_pending_call_set_notify(pending, lash_dbus_service_connect_handler,
+	                             client, NULL);
+
+	dbus_message_unref(call.message);
+
+	return pending;
+
 fail_oom:
 	lash_error("Ran out of memory trying to append arguments");
 
+fail_unref:
 	dbus_message_unref(call.message);
 	call.message = NULL;
 
 fail:
 	lash_debug("Failed to connect to LASH server");
+	return NULL;
 }
 
 /* The appropriate destructor is service_destroy() in dbus/service.c */
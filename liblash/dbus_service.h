@@ -21,6 +21,9 @@
 #ifndef __LIBLASH_DBUS_SERVICE_H__
 #define __LIBLASH_DBUS_SERVICE_H__
 
+#include <stdbool.h>
+#include <dbus/dbus.h>
+
 #include "lash/types.h"
 
 #include "dbus/types.h"
@@ -28,8 +31,16 @@
 service_t *
 lash_dbus_service_new(lash_client_t *client);
 
-void
-lash_dbus_service_connect(lash_client_t *client);
+/** Send a Connect request for @a client to the LASH server without waiting
+ * for the reply. The client's ID, name, project and so on are filled in
+ * when the returned pending call completes.
+ * @param client Client to connect.
+ * @param auto_start Whether the bus may start the server if it isn't running.
+ * @return Pending call to block on and unreference, or NULL on failure.
+ */
+DBusPendingCall *
+lash_dbus_service_connect(lash_client_t *client,
+                          bool           auto_start);
 
 /* The appropriate destructor is service_destroy() in dbus/service.c */
 
@@ -21,6 +21,7 @@
 
 #include <stdlib.h>
 #include <stdint.h>
+#include <string.h>
 #include <dbus/dbus.h>
 
 #include "common/safety.h"
@@ -35,15 +36,10 @@
 
 #include "lash/client_interface.h"
 
-#define set_string_property(property, value) \
-  do {                               \
-    if (property)                    \
-      free(property);                \
-    if (value)                       \
-      property = lash_strdup(value); \
-    else                             \
-      property = NULL;               \
-  } while (0)
+#define set_string_property(property, value)                      \
+  lash_buffer_set((void **) &property, &property ## _buf,          \
+                  &property ## _buf_size, value,                   \
+                  (value) ? strlen(value) + 1 : 0)
 
 lash_event_t *
 lash_event_new(void)
@@ -128,8 +124,7 @@ _lash_id_query_handler(DBusPendingCall *pending,
 
 	/* Create an event and add it to the incoming queue */
 
-	if (!(event = lash_event_new_with_all(ctx->ev_type,
-	                                      name))) {
+	if (!(event = lash_client_new_event(client, ctx->ev_type, name))) {
 		lash_error("Failed to allocate event");
 		goto end_unref_msg;
 	}
@@ -334,14 +329,56 @@ lash_event_new_with_all(enum LASH_Event_Type  type,
 	return event;
 }
 
+lash_event_t *
+lash_client_new_event(lash_client_t        *client,
+                      enum LASH_Event_Type  type,
+                      const char           *string)
+{
+	if (type < 1 || type > 17) {
+		lash_error("Invalid type");
+		return NULL;
+	}
+
+	lash_event_t *event;
+
+	event = lash_pool_get(client->event_pool, sizeof(lash_event_t));
+	event->pool = client->event_pool;
+	event->type = type;
+	event->ctor = g_lash_event_ctors[type];
+	lash_event_set_string(event, string);
+	event->project = NULL;
+	event->client = NULL;
+	uuid_clear(event->client_id);
+
+	return event;
+}
+
+void
+lash_event_free(void *ptr)
+{
+	lash_event_t *event = ptr;
+
+	free(event->string_buf);
+	free(event->project_buf);
+	free(event);
+}
+
 void
 lash_event_destroy(lash_event_t *event)
 {
-	if (event) {
-		lash_free(&event->string);
-		lash_free(&event->project);
-		free(event);
+	if (!event)
+		return;
+
+	/* Don't leave the client to send it back later */
+	if (event->client) {
+		if (event->client->pending_event == event)
+			event->client->pending_event = NULL;
+		event->client = NULL;
 	}
+
+	/* Pooled events keep their buffers for reuse */
+	if (!(event->pool && lash_pool_put(event->pool, event)))
+		lash_event_free(event);
 }
 
 enum LASH_Event_Type
@@ -24,19 +24,37 @@
 
 #include <uuid/uuid.h>
 
-#include "common/klist.h"
 #include "lash/types.h"
 
+#include "queue.h"
+
 typedef void (*LASHEventConstructor) (lash_client_t *, lash_event_t *);
 
 struct _lash_event
 {
-  struct list_head      siblings;
   enum LASH_Event_Type  type;
-  char                 *string;
-  char                 *project;
+  char                 *string;      /* Points to string_buf, or NULL */
+  char                 *project;     /* Points to project_buf, or NULL */
   uuid_t                client_id;
   LASHEventConstructor  ctor;
+  struct _lash_pool    *pool;        /* Pool the event returns to, or NULL */
+  lash_client_t        *client;      /* Client whose pending event it is, or NULL */
+  void                 *string_buf;
+  size_t                string_buf_size;
+  void                 *project_buf;
+  size_t                project_buf_size;
 };
 
+/** Get an event of type @a type with string @a string (which may be NULL)
+ * from @a client 's event pool.
+ */
+lash_event_t *
+lash_client_new_event(lash_client_t        *client,
+                      enum LASH_Event_Type  type,
+                      const char           *string);
+
+/** Free an event and its buffers without returning it to its pool. */
+void
+lash_event_free(void *event);
+
 #endif /* __LIBLASH_EVENT_H__ */
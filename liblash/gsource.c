@@ -0,0 +1,75 @@
+/*
+ *   LASH
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "lash/glib.h"
+
+typedef struct
+{
+	GSource        source;
+	GPollFD        pollfd;
+	lash_client_t *client;
+} LashGSource;
+
+static gboolean
+lash_gsource_prepare(GSource *source,
+                     gint    *timeout)
+{
+	*timeout = -1;
+	return FALSE;
+}
+
+static gboolean
+lash_gsource_check(GSource *source)
+{
+	return (((LashGSource *) source)->pollfd.revents & G_IO_IN) ? TRUE : FALSE;
+}
+
+static gboolean
+lash_gsource_dispatch(GSource     *source,
+                      GSourceFunc  callback,
+                      gpointer     user_data)
+{
+	lash_handle_epoll_events(((LashGSource *) source)->client);
+	return TRUE;
+}
+
+static GSourceFuncs lash_gsource_funcs = {
+	lash_gsource_prepare,
+	lash_gsource_check,
+	lash_gsource_dispatch,
+	NULL
+};
+
+GSource *
+lash_gsource_new(lash_client_t *client)
+{
+	LashGSource *lash_source;
+	int fd;
+
+	if ((fd = lash_get_epoll_fd(client)) == -1)
+		return NULL;
+
+	lash_source = (LashGSource *) g_source_new(&lash_gsource_funcs,
+	                                           sizeof(LashGSource));
+	lash_source->client = client;
+	lash_source->pollfd.fd = fd;
+	lash_source->pollfd.events = G_IO_IN;
+	g_source_add_poll(&lash_source->source, &lash_source->pollfd);
+
+	return &lash_source->source;
+}
@@ -0,0 +1,375 @@
+/*
+ *   LASH
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "../config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "common/safety.h"
+#include "common/debug.h"
+
+#include "dbus/method.h"
+
+#include "lash/lash.h"
+
+#include "client.h"
+#include "io_thread.h"
+#include "watch.h"
+#include "dbus_iface_client.h"
+
+static void
+lash_io_thread_send(lash_client_t                 *client,
+                    const struct _lash_io_command *command)
+{
+	const char *name;
+
+	if (command->dropped)
+		lash_error("I/O queue was full, %u calls dropped",
+		           command->dropped);
+
+	switch (command->type) {
+	case LASH_IO_PROGRESS:
+		lash_send_progress(client, command->task_id, command->value);
+		break;
+	case LASH_IO_JACK_NAME:
+		name = command->name;
+		method_call_new_single(client->dbus_service, NULL,
+		                       method_default_handler, false,
+		                       "org.nongnu.LASH",
+		                       "/",
+		                       "org.nongnu.LASH.Server",
+		                       "JackName",
+		                       DBUS_TYPE_STRING, &name);
+		break;
+	case LASH_IO_ALSA_ID:
+		method_call_new_single(client->dbus_service, NULL,
+		                       method_default_handler, false,
+		                       "org.nongnu.LASH",
+		                       "/",
+		                       "org.nongnu.LASH.Server",
+		                       "AlsaId",
+		                       DBUS_TYPE_BYTE, &command->value);
+		break;
+	default:
+		lash_error("Unknown I/O thread command %u", command->type);
+	}
+}
+
+/* Read the counter of an eventfd, resetting it */
+static void
+lash_io_thread_drain_fd(int fd)
+{
+	uint64_t count;
+
+	if (read(fd, &count, sizeof(count)) == -1 && errno != EAGAIN)
+		lash_error("Cannot read event descriptor: %s", strerror(errno));
+}
+
+/* Increment the counter of an eventfd. This runs in the thread queueing
+   commands, so a failure is only counted, and reported by
+   lash_io_thread_report_failures() */
+static void
+lash_io_thread_signal_fd(struct _lash_io_thread *io,
+                         int                     fd)
+{
+	uint64_t one = 1;
+
+	if (write(fd, &one, sizeof(one)) == -1)
+		__atomic_add_fetch(&io->failed_signals, 1, __ATOMIC_RELAXED);
+}
+
+static void
+lash_io_thread_report_failures(struct _lash_io_thread *io)
+{
+	uint32_t failed;
+
+	if ((failed = __atomic_exchange_n(&io->failed_signals, 0,
+	                                  __ATOMIC_RELAXED)))
+		lash_error("Cannot write event descriptor, %u wakeups lost",
+		           failed);
+}
+
+/* Send the commands which the application has queued */
+static void
+lash_io_thread_send_commands(lash_client_t *client)
+{
+	struct _lash_io_command command;
+
+	while (spsc_pop(&client->io->commands, &command))
+		lash_io_thread_send(client, &command);
+}
+
+/* Send the held back progress report for task_id, or for any task if
+   task_id is 0. Reports queued before it was held go first. */
+static void
+lash_io_thread_flush_progress(lash_client_t *client,
+                              dbus_uint64_t  task_id,
+                              bool           force)
+{
+	dbus_uint64_t held_task;
+	uint8_t percentage;
+
+	if (lash_take_held_progress(client, task_id, force,
+	                            &held_task, &percentage)) {
+		lash_io_thread_send_commands(client);
+		lash_send_progress(client, held_task, percentage);
+	}
+}
+
+/* Send the task results which the dispatching thread has queued */
+static void
+lash_io_thread_send_results(lash_client_t *client)
+{
+	struct _lash_io_command result;
+
+	/* A task's last progress report goes before its result */
+	while (spsc_pop(&client->io->results, &result)) {
+		lash_io_thread_flush_progress(client, result.task_id, true);
+		lash_io_thread_send(client, &result);
+	}
+}
+
+/* The I/O thread reads and writes the connection and sends the queued
+   commands. Incoming messages are left in the connection's queue to be
+   dispatched by the application, so callbacks never run on this thread.
+   It also sends a held back progress report once it is due, so that a
+   report doesn't wait for the application to make another. */
+static void *
+lash_io_thread_run(void *data)
+{
+	lash_client_t *client = data;
+	struct _lash_io_thread *io = client->io;
+	DBusConnection *connection = client->dbus_service->connection;
+	struct pollfd fds[3];
+	int conn_fd;
+
+	if (!dbus_connection_get_unix_fd(connection, &conn_fd)) {
+		lash_error("Cannot get D-Bus connection descriptor");
+		goto end;
+	}
+
+	fds[0].fd = conn_fd;
+	fds[1].fd = io->wake_fd;
+	fds[1].events = POLLIN;
+	fds[2].fd = client->save_fd;
+	fds[2].events = POLLIN;
+
+	while (!__atomic_load_n(&io->quit, __ATOMIC_ACQUIRE)
+	       && dbus_connection_get_is_connected(connection)) {
+		fds[0].events = POLLIN;
+		if (dbus_connection_has_messages_to_send(connection))
+			fds[0].events |= POLLOUT;
+
+		if (poll(fds, 3, lash_held_progress_timeout(client)) == -1) {
+			if (errno == EINTR)
+				continue;
+			lash_error("Cannot poll D-Bus connection: %s", strerror(errno));
+			break;
+		}
+
+		lash_io_thread_report_failures(io);
+
+		if (fds[1].revents & POLLIN)
+			lash_io_thread_drain_fd(io->wake_fd);
+
+		lash_io_thread_send_commands(client);
+		lash_io_thread_flush_progress(client, 0, false);
+
+		lash_io_thread_send_results(client);
+
+		if (fds[0].revents)
+			dbus_connection_read_write(connection, 0);
+
+		/* A completed save is finished by the application thread */
+		if (fds[2].revents & POLLIN) {
+			lash_io_thread_drain_fd(client->save_fd);
+			lash_io_thread_signal_fd(io, io->notify_fd);
+		}
+
+		if (dbus_connection_get_dispatch_status(connection)
+		    == DBUS_DISPATCH_DATA_REMAINS)
+			lash_io_thread_signal_fd(io, io->notify_fd);
+	}
+
+end:
+	/* Hand the connection back to the application thread, and wake
+	   it up in case it's waiting for a notification */
+	__atomic_store_n(&io->stopped, true, __ATOMIC_RELEASE);
+	lash_io_thread_signal_fd(io, io->notify_fd);
+
+	/* Results are sent directly from now on, these were queued before */
+	if (dbus_connection_get_is_connected(connection)) {
+		lash_io_thread_send_results(client);
+		dbus_connection_flush(connection);
+	}
+
+	return NULL;
+}
+
+bool
+lash_start_io_thread(lash_client_t *client)
+{
+	struct _lash_io_thread *io;
+	int err;
+
+	if (!client || !client->dbus_service) {
+		lash_error("Client is not connected");
+		return false;
+	}
+
+	if (client->io)
+		return true;
+
+	if (client->epoll_fd != -1) {
+		lash_error("The I/O thread must be started before "
+		           "lash_get_epoll_fd() is called");
+		return false;
+	}
+
+	io = lash_calloc(1, sizeof(struct _lash_io_thread));
+	io->wake_fd = io->notify_fd = -1;
+	spsc_init(&io->commands, io->command_buf, LASH_IO_QUEUE_SIZE,
+	          sizeof(struct _lash_io_command));
+	spsc_init(&io->results, io->result_buf, LASH_IO_RESULT_QUEUE_SIZE,
+	          sizeof(struct _lash_io_command));
+
+	if ((io->wake_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1
+	    || (io->notify_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1) {
+		lash_error("Cannot create event descriptor: %s", strerror(errno));
+		goto fail;
+	}
+
+	/* The thread's reads and writes would otherwise run the watch
+	   callbacks while the application thread looks at the watches */
+	lash_watch_fini(client);
+
+	client->io = io;
+
+	if ((err = pthread_create(&io->thread, NULL, lash_io_thread_run, client))) {
+		lash_error("Cannot start I/O thread: %s", strerror(err));
+		client->io = NULL;
+		lash_watch_init(client);
+		goto fail;
+	}
+
+	/* Messages may have arrived before the thread started */
+	if (dbus_connection_get_dispatch_status(client->dbus_service->connection)
+	    == DBUS_DISPATCH_DATA_REMAINS)
+		lash_io_thread_signal_fd(io, io->notify_fd);
+
+	return true;
+
+fail:
+	if (io->wake_fd != -1)
+		close(io->wake_fd);
+	if (io->notify_fd != -1)
+		close(io->notify_fd);
+	free(io);
+	return false;
+}
+
+bool
+lash_io_thread_queue(lash_client_t                 *client,
+                     const struct _lash_io_command *command)
+{
+	struct _lash_io_thread *io = client->io;
+	struct _lash_io_command counted;
+
+	if (__atomic_load_n(&io->stopped, __ATOMIC_ACQUIRE)) {
+		++io->dropped;
+		return false;
+	}
+
+	counted = *command;
+	counted.dropped = io->dropped;
+
+	if (!spsc_push(&io->commands, &counted)) {
+		++io->dropped;
+		return false;
+	}
+
+	io->dropped = 0;
+	lash_io_thread_signal_fd(io, io->wake_fd);
+
+	return true;
+}
+
+bool
+lash_io_thread_queue_result(lash_client_t *client,
+                            dbus_uint64_t  task_id,
+                            uint8_t        value)
+{
+	struct _lash_io_thread *io = client->io;
+	struct _lash_io_command result;
+
+	if (__atomic_load_n(&io->stopped, __ATOMIC_ACQUIRE))
+		return false;
+
+	result.type = LASH_IO_PROGRESS;
+	result.value = value;
+	result.dropped = 0;
+	result.task_id = task_id;
+
+	if (!spsc_push(&io->results, &result))
+		return false;
+
+	lash_io_thread_signal_fd(io, io->wake_fd);
+
+	return true;
+}
+
+void
+lash_io_thread_wake(lash_client_t *client)
+{
+	lash_io_thread_signal_fd(client->io, client->io->wake_fd);
+}
+
+bool
+lash_io_thread_stopped(lash_client_t *client)
+{
+	return __atomic_load_n(&client->io->stopped, __ATOMIC_ACQUIRE);
+}
+
+void
+lash_io_thread_stop(lash_client_t *client)
+{
+	struct _lash_io_thread *io = client->io;
+
+	if (!io)
+		return;
+
+	__atomic_store_n(&io->quit, true, __ATOMIC_RELEASE);
+	lash_io_thread_signal_fd(io, io->wake_fd);
+	pthread_join(io->thread, NULL);
+
+	lash_io_thread_report_failures(io);
+	if (io->dropped)
+		lash_error("I/O queue was full, %u calls dropped", io->dropped);
+
+	close(io->wake_fd);
+	close(io->notify_fd);
+	free(io);
+	client->io = NULL;
+}
+
+/* EOF */
@@ -0,0 +1,123 @@
+/*
+ *   LASH
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __LIBLASH_IO_THREAD_H__
+#define __LIBLASH_IO_THREAD_H__
+
+#include <stdbool.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <dbus/dbus.h>
+
+#include "common/spsc.h"
+
+#include "lash/types.h"
+
+/* Number of outgoing calls which can wait for the I/O thread, must be
+   a power of two */
+#define LASH_IO_QUEUE_SIZE 64
+
+/* Number of task results which can wait for the I/O thread, must be
+   a power of two */
+#define LASH_IO_RESULT_QUEUE_SIZE 16
+
+/* Longest JACK client name which can be queued, including the NUL */
+#define LASH_IO_NAME_SIZE  64
+
+enum
+{
+	LASH_IO_PROGRESS = 1,
+	LASH_IO_JACK_NAME,
+	LASH_IO_ALSA_ID
+};
+
+/* An outgoing call, queued by value so that queueing never allocates */
+struct _lash_io_command
+{
+	uint8_t        type;
+	uint8_t        value;    /* Percentage or ALSA client ID */
+	uint32_t       dropped;  /* Commands dropped since the last one queued */
+	dbus_uint64_t  task_id;
+	char           name[LASH_IO_NAME_SIZE];
+};
+
+struct _lash_io_thread
+{
+	pthread_t                thread;
+	bool                     quit;
+	bool                     stopped;    /* Set when the thread has exited */
+	uint32_t                 dropped;    /* Written by the producer only */
+	uint32_t                 failed_signals; /* Atomic, see lash_io_thread_signal_fd() */
+	int                      wake_fd;    /* Written after queueing a command */
+	int                      notify_fd;  /* Written when messages await dispatch */
+	struct spsc              commands;
+	struct _lash_io_command  command_buf[LASH_IO_QUEUE_SIZE];
+	struct spsc              results;    /* Queued by the dispatching thread only */
+	struct _lash_io_command  result_buf[LASH_IO_RESULT_QUEUE_SIZE];
+};
+
+/**
+ * Queue an outgoing call for the I/O thread to send. Doesn't allocate,
+ * take locks or log, so it's safe in realtime code; only one thread at
+ * a time may queue commands. A command which can't be queued is counted
+ * and the I/O thread reports the count along with the next one.
+ *
+ * @param client Client running an I/O thread.
+ * @param command Command to copy into the queue.
+ * @return True if the command was queued, false if it was dropped
+ *         because the queue is full or the thread has stopped.
+ */
+bool
+lash_io_thread_queue(lash_client_t                 *client,
+                     const struct _lash_io_command *command);
+
+/**
+ * Queue a task's result for the I/O thread to send after the task's
+ * progress reports. Only called by the thread dispatching messages, so
+ * results never share a queue with the application's commands.
+ *
+ * @return True if the result was queued, false if the queue is full or
+ *         the thread has stopped.
+ */
+bool
+lash_io_thread_queue_result(lash_client_t *client,
+                            dbus_uint64_t  task_id,
+                            uint8_t        value);
+
+/**
+ * Wake the I/O thread up to look at the held back progress report.
+ * Safe in realtime code, like lash_io_thread_queue().
+ */
+void
+lash_io_thread_wake(lash_client_t *client);
+
+/**
+ * Check whether the client's I/O thread has exited on its own, after
+ * an error or because the connection was lost. The connection is then
+ * left to the application thread.
+ */
+bool
+lash_io_thread_stopped(lash_client_t *client);
+
+/**
+ * Stop the client's I/O thread and free its resources.
+ */
+void
+lash_io_thread_stop(lash_client_t *client);
+
+#endif /* __LIBLASH_IO_THREAD_H__ */
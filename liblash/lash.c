@@ -29,14 +29,17 @@
 #include <dbus/dbus.h>
 
 #include <errno.h>
+#include <poll.h>
 #include <netinet/in.h>
 #include <arpa/inet.h>
 #include <unistd.h>
 #include <sys/param.h>
+#include <sys/eventfd.h>
 #include <rpc/xdr.h>
 
 #include "common/safety.h"
 #include "common/debug.h"
+#include "common/histogram.h"
 
 #include "lash/lash.h"
 
@@ -44,6 +47,8 @@
 
 #include "dbus_service.h"
 #include "client.h"
+#include "watch.h"
+#include "io_thread.h"
 #include "lash_config.h"
 
 #include "dbus_iface_client.h"
@@ -70,12 +75,23 @@ lash_client_new_with_service(void)
 		return NULL;
 	}
 
+	/* The connection must be thread-safe in case the application
+	   later starts an I/O thread */
+	dbus_threads_init_default();
+
 	/* Connect to the D-Bus daemon */
 	client->dbus_service = lash_dbus_service_new(client);
 	if (!client->dbus_service) {
 		lash_error("Failed to start client D-Bus service");
 		lash_client_destroy(client);
 		client = NULL;
+	} else if (!lash_watch_init(client)) {
+		lash_client_destroy(client);
+		client = NULL;
+	} else if ((client->save_fd = eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC)) == -1) {
+		lash_error("Cannot create event descriptor: %s", strerror(errno));
+		lash_client_destroy(client);
+		client = NULL;
 	}
 
 	return client;
@@ -330,31 +346,50 @@ lash_dbus_signal_handler(DBusConnection *connection,
 	return DBUS_HANDLER_RESULT_HANDLED;
 }
 
+/* Ask the bus daemon to add a match rule without waiting for its reply.
+   Unlike dbus_bus_add_match() this costs no round trip; the rules are
+   constant, so there are no errors worth waiting for. */
 static bool
-lash_client_register_as_controller(lash_client_t *client)
+lash_add_match_async(lash_client_t *client,
+                     const char    *rule)
 {
-	DBusError err;
+	DBusMessage *msg;
+	bool sent;
+
+	msg = dbus_message_new_method_call(DBUS_SERVICE_DBUS,
+	                                   DBUS_PATH_DBUS,
+	                                   DBUS_INTERFACE_DBUS,
+	                                   "AddMatch");
+	if (!msg) {
+		lash_error("Ran out of memory trying to create AddMatch call");
+		return false;
+	}
 
-	dbus_error_init(&err);
+	dbus_message_set_no_reply(msg, TRUE);
 
+	sent = dbus_message_append_args(msg, DBUS_TYPE_STRING, &rule,
+	                                DBUS_TYPE_INVALID)
+	       && dbus_connection_send(client->dbus_service->connection,
+	                               msg, NULL);
+	if (!sent)
+		lash_error("Ran out of memory trying to send AddMatch call");
+
+	dbus_message_unref(msg);
+
+	return sent;
+}
+
+static bool
+lash_client_register_as_controller(lash_client_t *client)
+{
 	lash_debug("Registering client as control application");
 
 	/* Listen to the LASH server's frontend-facing beacon */
-	dbus_bus_add_match(client->dbus_service->connection,
-	                   "type='signal'"
-	                   ",sender='org.nongnu.LASH'"
-	                   ",path='/'"
-	                   ",interface='org.nongnu.LASH.Control'",
-	                   &err);
-
-	if (dbus_error_is_set(&err)) {
-		lash_error("Failed to add D-Bus match rule: "
-		           "%s", err.message);
-		dbus_error_free(&err);
-		return false;
-	}
-
-	return true;
+	return lash_add_match_async(client,
+	                            "type='signal'"
+	                            ",sender='org.nongnu.LASH'"
+	                            ",path='/'"
+	                            ",interface='org.nongnu.LASH.Control'");
 }
 
 static void
@@ -393,7 +428,8 @@ lash_client_open(const char  *class,
 	}
 
 	char *str, wd[MAXPATHLEN];
-	DBusError err;
+	DBusPendingCall *pending;
+	bool auto_start;
 
 	client = lash_client_new_with_service();
 	if (!client) {
@@ -417,28 +453,24 @@ lash_client_open(const char  *class,
 	client->flags = flags;
 	lash_strset(&client->class, class);
 
-	dbus_error_init(&err);
-
-	/* Check whether the server is active */
-	if (!dbus_bus_name_has_owner(client->dbus_service->connection,
-	                             // TODO: Move service name into public header
-	                             "org.nongnu.LASH", &err)) {
-		if (dbus_error_is_set(&err)) {
-			lash_error("Failed to query LASH service "
-			           "availability: %s", err.message);
-			dbus_error_free(&err);
-			dbus_error_init(&err);
-		}
+	/* Everything up to the Connect reply is pipelined: the match rules
+	   and the Connect call are queued back to back, and the Connect
+	   reply is the only one waited for. The rules go first so that the
+	   bus has them in place before the server learns about us. */
 
-		if (!getenv("LASH_NO_START_SERVER"))
-			lash_info("Attempting to auto-start LASH server");
-		else {
-			lash_info("Not attempting to auto-start LASH server");
-			goto fail;
-		}
-	}
-
-	lash_dbus_service_connect(client);
+	/* Listen to the LASH server's client-facing beacon */
+	if (!lash_add_match_async(client,
+	                          "type='signal'"
+	                          ",sender='org.nongnu.LASH'"
+	                          ",path='/'"
+	                          ",interface='org.nongnu.LASH.Server'")
+	    || !lash_add_match_async(client,
+	                             "type='signal'"
+	                             ",sender='org.nongnu.LASH'"
+	                             ",path='/'"
+	                             ",interface='org.nongnu.LASH.Control'"
+	                             ",member='ProjectNameChanged'"))
+		goto fail;
 
 	if (client->flags & LASH_Server_Interface) {
 		lash_client_register_as_controller(client);
@@ -446,35 +478,24 @@ lash_client_open(const char  *class,
 		client->is_controller = 2;
 	}
 
-	/* Listen to the LASH server's client-facing beacon */
-	dbus_bus_add_match(client->dbus_service->connection,
-	                   "type='signal'"
-	                   ",sender='org.nongnu.LASH'"
-	                   ",path='/'"
-	                   ",interface='org.nongnu.LASH.Server'",
-	                   &err);
-
-	if (!dbus_error_is_set(&err)) {
-		dbus_bus_add_match(client->dbus_service->connection,
-		                   "type='signal'"
-		                   ",sender='org.nongnu.LASH'"
-		                   ",path='/'"
-		                   ",interface='org.nongnu.LASH.Control'"
-		                   ",member='ProjectNameChanged'",
-		                   &err);
-	}
-
-	if (dbus_error_is_set(&err)) {
-		lash_error("Failed to add D-Bus match rule: %s", err.message);
+	auto_start = getenv("LASH_NO_START_SERVER") ? false : true;
+	if (!auto_start)
+		lash_info("Not attempting to auto-start LASH server");
+
+	if (!(pending = lash_dbus_service_connect(client, auto_start)))
+		goto fail;
+
+	dbus_pending_call_block(pending);
+	dbus_pending_call_unref(pending);
+
+	if (!auto_start && !client->server_connected)
 		goto fail;
-	}
 
 	lash_client_add_filter(&client);
 
 	goto end;
 
 fail:
-	dbus_error_free(&err);
 	lash_client_destroy(client);
 	client = NULL;
 
@@ -680,16 +701,69 @@ lash_set_path_change_callback(lash_client_t     *client,
 void
 lash_wait(lash_client_t *client)
 {
-	if (client && client->dbus_service)
-		(void) dbus_connection_read_write(client->dbus_service->connection, -1);
+	DBusConnection *connection;
+	struct pollfd pfd, fds[2];
+	int conn_fd;
+
+	if (!client || !client->dbus_service)
+		return;
+
+	/* The I/O thread does the reading, wait for it to say so */
+	if (client->io && !lash_io_thread_stopped(client)) {
+		pfd.fd = client->io->notify_fd;
+		pfd.events = POLLIN;
+		if (dbus_connection_get_dispatch_status(client->dbus_service->connection)
+		    != DBUS_DISPATCH_DATA_REMAINS)
+			(void) poll(&pfd, 1, -1);
+		return;
+	}
+
+	connection = client->dbus_service->connection;
+
+	/* A deferred save may be completed by another thread */
+	if (client->save_token && dbus_connection_get_unix_fd(connection, &conn_fd)) {
+		fds[0].fd = conn_fd;
+		fds[0].events = POLLIN;
+		if (dbus_connection_has_messages_to_send(connection))
+			fds[0].events |= POLLOUT;
+		fds[1].fd = client->save_fd;
+		fds[1].events = POLLIN;
+		if (poll(fds, 2, -1) > 0 && fds[0].revents)
+			(void) dbus_connection_read_write(connection, 0);
+		return;
+	}
+
+	(void) dbus_connection_read_write(connection, -1);
 }
 
 void
 lash_dispatch(lash_client_t *client)
 {
+	uint64_t count;
+
 	if (!client || !client->dbus_service)
 		return;
 
+	lash_save_dispatch(client);
+
+	/* Send a held back progress report whose time has come. A running
+	   I/O thread does this on its own. */
+	if (!client->io || lash_io_thread_stopped(client))
+		lash_flush_progress(client, 0, false);
+
+	/* Only dispatch what the I/O thread has read. Once it has stopped
+	   its notification is left pending, so that a main loop keeps
+	   coming back here to read the connection. */
+	if (client->io && !lash_io_thread_stopped(client)) {
+		if (read(client->io->notify_fd, &count, sizeof(count)) == -1
+		    && errno != EAGAIN)
+			lash_error("Cannot read event descriptor: %s", strerror(errno));
+		while (dbus_connection_dispatch(client->dbus_service->connection)
+		       == DBUS_DISPATCH_DATA_REMAINS)
+			;
+		return;
+	}
+
 	do
 	{
 		dbus_connection_read_write_dispatch(client->dbus_service->connection, 0);
@@ -700,6 +774,11 @@ lash_dispatch(lash_client_t *client)
 bool
 lash_dispatch_once(lash_client_t *client)
 {
+	if (client && client->io && !lash_io_thread_stopped(client))
+		return (client->dbus_service
+		        && dbus_connection_dispatch(client->dbus_service->connection)
+		           == DBUS_DISPATCH_DATA_REMAINS) ? true : false;
+
 	return
 	  (client && client->dbus_service
 	   && dbus_connection_read_write_dispatch(client->dbus_service->connection, 0)
@@ -708,10 +787,43 @@ lash_dispatch_once(lash_client_t *client)
 	  ? true : false;
 }
 
+/* The report which lash_notify_progress() holds back is shared with the
+   thread which flushes it, packed into one word so that it can be taken
+   atomically. Task IDs are counters which never reach 2^56. */
+#define LASH_PROGRESS_SLOT(task, percentage) \
+	(((uint64_t) (task) << 8) | (percentage))
+
+/* Send a progress report, or queue it for the I/O thread */
+static void
+lash_report_progress(lash_client_t *client,
+                     uint8_t        percentage,
+                     uint64_t       now)
+{
+	/* This report supersedes the held back one */
+	__atomic_store_n(&client->progress.slot, 0, __ATOMIC_RELEASE);
+
+	client->progress.sent = percentage;
+	client->progress.held = 0;
+	client->progress.sent_usec = now;
+
+	if (client->io) {
+		struct _lash_io_command command;
+		command.type = LASH_IO_PROGRESS;
+		command.value = percentage;
+		command.task_id = client->progress.task;
+		lash_io_thread_queue(client, &command);
+		return;
+	}
+
+	lash_send_progress(client, client->progress.task, percentage);
+}
+
 void
 lash_notify_progress(lash_client_t *client,
                      uint8_t        percentage)
 {
+	uint64_t now;
+
 	if (!client || !client->dbus_service
 	    || !client->pending_task || !percentage)
 		return;
@@ -719,15 +831,258 @@ lash_notify_progress(lash_client_t *client,
 	if (percentage > 99)
 		percentage = 99;
 
-	method_call_new_valist(client->dbus_service, NULL,
-	                       method_default_handler, false,
-	                       "org.nongnu.LASH",
-	                       "/",
-	                       "org.nongnu.LASH.Server",
-	                       "Progress",
-	                       DBUS_TYPE_UINT64, &client->pending_task,
-	                       DBUS_TYPE_BYTE, &percentage,
-	                       DBUS_TYPE_INVALID);
+	/* Start over for a new task */
+	if (client->progress.task != client->pending_task) {
+		client->progress.task = client->pending_task;
+		client->progress.sent = 0;
+		client->progress.held = 0;
+		client->progress.sent_usec = 0;
+	}
+
+	now = histogram_now_usec();
+
+	/* Catch up with a held back report which has been flushed */
+	if (client->progress.held
+	    && !__atomic_load_n(&client->progress.slot, __ATOMIC_ACQUIRE)) {
+		client->progress.sent = client->progress.held;
+		client->progress.held = 0;
+		client->progress.sent_usec = now;
+	}
+
+	if (percentage == client->progress.sent) {
+		client->progress.held = 0;
+		__atomic_store_n(&client->progress.slot, 0, __ATOMIC_RELEASE);
+		return;
+	}
+
+	/* Hold back small changes until the interval has passed, but
+	   report reaching the end at once */
+	if (percentage != 99
+	    && abs((int) percentage - (int) client->progress.sent)
+	       < client->progress.step
+	    && now - client->progress.sent_usec < client->progress.interval) {
+		client->progress.held = percentage;
+		__atomic_store_n(&client->progress.due,
+		                 client->progress.sent_usec + client->progress.interval,
+		                 __ATOMIC_RELAXED);
+		/* Let the I/O thread know when to send it */
+		if (!__atomic_exchange_n(&client->progress.slot,
+		                         LASH_PROGRESS_SLOT(client->progress.task,
+		                                            percentage),
+		                         __ATOMIC_RELEASE)
+		    && client->io)
+			lash_io_thread_wake(client);
+		return;
+	}
+
+	lash_report_progress(client, percentage, now);
+}
+
+bool
+lash_take_held_progress(lash_client_t *client,
+                        dbus_uint64_t  task_id,
+                        bool           force,
+                        dbus_uint64_t *held_task,
+                        uint8_t       *percentage)
+{
+	uint64_t slot = __atomic_load_n(&client->progress.slot, __ATOMIC_ACQUIRE);
+
+	if (!slot || (task_id && (slot >> 8) != task_id))
+		return false;
+
+	if (!force && histogram_now_usec()
+	              < __atomic_load_n(&client->progress.due, __ATOMIC_RELAXED))
+		return false;
+
+	/* Fails if the reporting thread has replaced the report */
+	if (!__atomic_compare_exchange_n(&client->progress.slot, &slot, 0, false,
+	                                 __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE))
+		return false;
+
+	*held_task = slot >> 8;
+	*percentage = (uint8_t) (slot & 0xff);
+
+	return true;
+}
+
+void
+lash_flush_progress(lash_client_t *client,
+                    dbus_uint64_t  task_id,
+                    bool           force)
+{
+	dbus_uint64_t held_task;
+	uint8_t percentage;
+
+	if (lash_take_held_progress(client, task_id, force,
+	                            &held_task, &percentage))
+		lash_send_progress(client, held_task, percentage);
+}
+
+int
+lash_held_progress_timeout(lash_client_t *client)
+{
+	uint64_t now, due;
+
+	if (!__atomic_load_n(&client->progress.slot, __ATOMIC_ACQUIRE))
+		return -1;
+
+	due = __atomic_load_n(&client->progress.due, __ATOMIC_RELAXED);
+	now = histogram_now_usec();
+
+	return (due > now) ? (int) ((due - now + 999) / 1000) : 0;
+}
+
+void
+lash_set_progress_coalescing(lash_client_t *client,
+                             uint8_t        step,
+                             unsigned int   min_interval)
+{
+	if (!client) {
+		lash_error("Invalid arguments");
+		return;
+	}
+
+	client->progress.step = step;
+	client->progress.interval = (uint64_t) min_interval * 1000;
+}
+
+/* Keep a GetConfig or GetConfigsByPrefix return in the config handle */
+static void
+lash_get_configs_handler(DBusPendingCall *pending,
+                         void            *data)
+{
+	struct _lash_config_handle *handle = data;
+	DBusMessage *msg = dbus_pending_call_steal_reply(pending);
+	const char *err_str;
+
+	if (!msg) {
+		lash_error("Cannot get method return from pending call");
+		goto end;
+	}
+
+	if (!method_return_verify(msg, &err_str)) {
+		lash_error("Server failed to get configs: %s", err_str);
+		dbus_message_unref(msg);
+		goto end;
+	}
+
+	handle->reply = msg;
+
+end:
+	dbus_pending_call_unref(pending);
+}
+
+/* Send a blocking GetConfig or GetConfigsByPrefix method call and
+   return a config handle for reading the configs in its return */
+static lash_config_handle_t *
+lash_get_configs_send(method_msg_t *call)
+{
+	struct _lash_config_handle *handle = call->context;
+
+	if (!method_send(call, true) || !handle->reply)
+		goto fail;
+
+	if (!dbus_message_iter_init(handle->reply, &handle->reply_iter)
+	    || dbus_message_iter_get_arg_type(&handle->reply_iter) != DBUS_TYPE_ARRAY) {
+		lash_error("Cannot find config array in method return");
+		dbus_message_unref(handle->reply);
+		goto fail;
+	}
+
+	dbus_message_iter_recurse(&handle->reply_iter, &handle->reply_array_iter);
+
+	return handle;
+
+fail:
+	free(handle);
+	return NULL;
+}
+
+/* Allocate a config handle and initialise a method call to fill it */
+static struct _lash_config_handle *
+lash_get_configs_init(lash_client_t *client,
+                      method_msg_t  *call,
+                      const char    *method_name)
+{
+	struct _lash_config_handle *handle;
+
+	// TODO: Find some generic place for this
+	if (!client->dbus_service) {
+		lash_error("D-Bus service not running");
+		return NULL;
+	}
+
+	handle = lash_malloc(1, sizeof(struct _lash_config_handle));
+	lash_config_handle_init(handle, &handle->reply_array_iter, true);
+
+	if (!method_call_init(call, client->dbus_service,
+	                      handle,
+	                      lash_get_configs_handler,
+	                      "org.nongnu.LASH",
+	                      "/",
+	                      "org.nongnu.LASH.Server",
+	                      method_name)) {
+		free(handle);
+		return NULL;
+	}
+
+	return handle;
+}
+
+lash_config_handle_t *
+lash_get_configs(lash_client_t      *client,
+                 const char * const *keys,
+                 int                 num_keys)
+{
+	if (!client || !keys || num_keys < 0) {
+		lash_error("Invalid arguments");
+		return NULL;
+	}
+
+	method_msg_t call;
+	struct _lash_config_handle *handle;
+
+	if (!(handle = lash_get_configs_init(client, &call, "GetConfig")))
+		return NULL;
+
+	if (!dbus_message_append_args(call.message,
+	                              DBUS_TYPE_ARRAY, DBUS_TYPE_STRING,
+	                              &keys, num_keys,
+	                              DBUS_TYPE_INVALID)) {
+		lash_error("Ran out of memory trying to append arguments");
+		dbus_message_unref(call.message);
+		free(handle);
+		return NULL;
+	}
+
+	return lash_get_configs_send(&call);
+}
+
+lash_config_handle_t *
+lash_get_configs_by_prefix(lash_client_t *client,
+                           const char    *prefix)
+{
+	if (!client || !prefix) {
+		lash_error("Invalid arguments");
+		return NULL;
+	}
+
+	method_msg_t call;
+	struct _lash_config_handle *handle;
+
+	if (!(handle = lash_get_configs_init(client, &call, "GetConfigsByPrefix")))
+		return NULL;
+
+	if (!dbus_message_append_args(call.message,
+	                              DBUS_TYPE_STRING, &prefix,
+	                              DBUS_TYPE_INVALID)) {
+		lash_error("Ran out of memory trying to append arguments");
+		dbus_message_unref(call.message);
+		free(handle);
+		return NULL;
+	}
+
+	return lash_get_configs_send(&call);
 }
 
 const char *
@@ -765,6 +1120,18 @@ lash_jack_client_name(lash_client_t *client,
 		return;
 	}
 
+	if (client->io) {
+		struct _lash_io_command command;
+		if (strlen(name) >= LASH_IO_NAME_SIZE) {
+			lash_error("JACK client name too long");
+			return;
+		}
+		command.type = LASH_IO_JACK_NAME;
+		strcpy(command.name, name);
+		lash_io_thread_queue(client, &command);
+		return;
+	}
+
 	method_call_new_single(client->dbus_service, NULL,
 	                       method_default_handler, false,
 	                       "org.nongnu.LASH",
@@ -791,6 +1158,14 @@ lash_alsa_client_id(lash_client_t *client,
 		return;
 	}
 
+	if (client->io) {
+		struct _lash_io_command command;
+		command.type = LASH_IO_ALSA_ID;
+		command.value = id;
+		lash_io_thread_queue(client, &command);
+		return;
+	}
+
 	method_call_new_single(client->dbus_service, NULL,
 	                       method_default_handler, false,
 	                       "org.nongnu.LASH",
@@ -1030,17 +1405,14 @@ lash_init(const lash_args_t *args,
 	return lash_client_open(class, client_flags, args->argc, args->argv);
 }
 
-static lash_event_t * g_pending_event = NULL;
-
-static
-void
-lash_handle_pending_event(
-	lash_client_t *client)
+/* Send back a save or restore event which the application didn't */
+static void
+lash_handle_pending_event(lash_client_t *client)
 {
-	if (g_pending_event != NULL)
-	{
-		lash_error("Application didnt sent event of type %d back to LASH, trying to workaround", g_pending_event->type);
-		lash_send_event(client, g_pending_event);
+	if (client->pending_event) {
+		lash_error("Application didnt sent event of type %d back to LASH, trying to workaround",
+		           client->pending_event->type);
+		lash_send_event(client, client->pending_event);
 	}
 }
 
@@ -1054,7 +1426,7 @@ lash_get_pending_event_count(lash_client_t *client)
 
 	lash_dispatch(client);
 
-	return (unsigned int) client->num_events_in;
+	return (unsigned int) client->events_in.count;
 }
 
 unsigned int
@@ -1065,7 +1437,7 @@ lash_get_pending_config_count(lash_client_t *client)
 
 	lash_dispatch(client);
 
-	return (unsigned int) client->num_configs_in;
+	return (unsigned int) client->configs_in.count;
 }
 
 lash_event_t *
@@ -1076,15 +1448,11 @@ lash_get_event(lash_client_t *client)
 
 	lash_handle_pending_event(client);
 
-	lash_event_t *event = NULL;
+	lash_event_t *event;
 
 	lash_dispatch_once(client);
 
-	if (!list_empty(&client->events_in)) {
-		event = list_entry(client->events_in.next, lash_event_t, siblings);
-		list_del(&event->siblings);
-		--client->num_events_in;
-	}
+	event = lash_queue_pop(&client->events_in);
 
 	if (event != NULL)
 	{
@@ -1093,7 +1461,8 @@ lash_get_event(lash_client_t *client)
 		    event->type == LASH_Save_Data_Set ||
 		    event->type == LASH_Restore_Data_Set)
 		{
-			g_pending_event = event;
+			client->pending_event = event;
+			event->client = client;
 		}
 	}
 
@@ -1103,29 +1472,22 @@ lash_get_event(lash_client_t *client)
 lash_config_t *
 lash_get_config(lash_client_t *client)
 {
-	lash_config_t *config = NULL;
-
 	if (!client)
 		return NULL;
 
 	lash_dispatch_once(client);
 
-	if (!list_empty(&client->configs_in)) {
-		config = list_entry(client->configs_in.next, lash_config_t, siblings);
-		list_del(&config->siblings);
-		--client->num_configs_in;
-	}
-
-	return config;
+	return lash_queue_pop(&client->configs_in);
 }
 
 void
 lash_send_event(lash_client_t *client,
                 lash_event_t  *event)
 {
-	if (g_pending_event != NULL && event != NULL && g_pending_event->type == event->type)
+	if (client && client->pending_event && event
+	    && client->pending_event->type == event->type)
 	{
-		g_pending_event = NULL;
+		client->pending_event = NULL;
 	}
 
 	if (!client || !event)
@@ -1144,12 +1506,17 @@ lash_send_config(lash_client_t *client,
 		lash_error("Invalid arguments");
 	} else {
 		struct _lash_config_handle cfg;
+		int element_size;
 
-		cfg.iter = &client->array_iter;
-		cfg.is_read = false;
+		lash_config_handle_init(&cfg, &client->array_iter, false);
 
-		lash_config_write_raw(&cfg, config->key,
-		                      config->value, config->value_size);
+		if ((element_size = lash_config_element_size(config->value_type)))
+			lash_config_write_array(&cfg, config->key,
+			                        config->value_type, config->value,
+			                        (int) config->value_size / element_size);
+		else
+			lash_config_write_raw(&cfg, config->key,
+			                      config->value, config->value_size);
 	}
 
 	lash_config_destroy(config);
@@ -19,18 +19,429 @@
  *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
  */
 
+#define _GNU_SOURCE
+
+#include "../config.h"
+
+#ifdef HAVE_DATA_SET_FD
+# include <unistd.h>
+# include <fcntl.h>
+# include <errno.h>
+# include <sys/mman.h>
+# include <sys/stat.h>
+# include <sys/uio.h>
+#endif
+
+#include <stdlib.h>
 #include <string.h>
 #include <arpa/inet.h>
 #include <rpc/xdr.h>
 
+#include "common/safety.h"
 #include "common/debug.h"
 
 #include "lash/config.h"
 
 #include "lash_config.h"
+#include "client.h"
 
 #include "dbus/method.h"
 
+int
+lash_config_element_size(int type)
+{
+	if (type == LASH_TYPE_DOUBLE_ARRAY)
+		return sizeof(double);
+	else if (type == LASH_TYPE_FLOAT_ARRAY)
+		return sizeof(float);
+	else if (type == LASH_TYPE_INT_ARRAY)
+		return sizeof(int32_t);
+
+	return 0;
+}
+
+/* Find the slot of key in a dirty key table, or the free slot where
+   it belongs. The table must have at least one free slot. */
+static struct _lash_dirty_key *
+lash_dirty_keys_find(struct _lash_dirty_keys *dirty,
+                     const char              *key)
+{
+	const unsigned char *p;
+	size_t i, hash = 2166136261u;
+
+	/* FNV-1a */
+	for (p = (const unsigned char *) key; *p; ++p)
+		hash = (hash ^ *p) * 16777619u;
+
+	for (i = hash & (dirty->size - 1);
+	     dirty->table[i].key && strcmp(dirty->table[i].key, key) != 0;
+	     i = (i + 1) & (dirty->size - 1))
+		;
+
+	return &dirty->table[i];
+}
+
+void
+lash_dirty_keys_add(struct _lash_dirty_keys *dirty,
+                    const char              *key)
+{
+	struct _lash_dirty_key *slot;
+
+	/* Keep the table at most three quarters full */
+	if ((dirty->count + 1) * 4 > dirty->size * 3) {
+		struct _lash_dirty_keys old = *dirty;
+		size_t i;
+
+		dirty->size = old.size ? old.size * 2 : 64;
+		dirty->table = lash_calloc(dirty->size,
+		                           sizeof(struct _lash_dirty_key));
+
+		for (i = 0; i < old.size; ++i) {
+			if (old.table[i].key)
+				*lash_dirty_keys_find(dirty, old.table[i].key)
+				  = old.table[i];
+		}
+		free(old.table);
+	}
+
+	slot = lash_dirty_keys_find(dirty, key);
+	if (!slot->key) {
+		slot->key = lash_strdup(key);
+		++dirty->count;
+	}
+}
+
+/* Note that the value of key has been written in a delta save */
+static __inline__ void
+lash_dirty_keys_written(struct _lash_dirty_keys *dirty,
+                        const char              *key)
+{
+	struct _lash_dirty_key *slot;
+
+	if (dirty->count) {
+		slot = lash_dirty_keys_find(dirty, key);
+		if (slot->key)
+			slot->written = true;
+	}
+}
+
+bool
+lash_dirty_keys_append_removed(struct _lash_dirty_keys *dirty,
+                               DBusMessageIter         *iter)
+{
+	DBusMessageIter array_iter;
+	size_t i;
+
+	if (!dbus_message_iter_open_container(iter, DBUS_TYPE_ARRAY,
+	                                      "s", &array_iter))
+		return false;
+
+	for (i = 0; i < dirty->size; ++i) {
+		if (dirty->table[i].key && !dirty->table[i].written
+		    && !dbus_message_iter_append_basic(&array_iter,
+		                                       DBUS_TYPE_STRING,
+		                                       &dirty->table[i].key)) {
+			dbus_message_iter_close_container(iter, &array_iter);
+			return false;
+		}
+	}
+
+	return dbus_message_iter_close_container(iter, &array_iter);
+}
+
+void
+lash_dirty_keys_reset(struct _lash_dirty_keys *dirty)
+{
+	size_t i;
+
+	for (i = 0; i < dirty->size; ++i)
+		dirty->table[i].written = false;
+}
+
+void
+lash_dirty_keys_clear(struct _lash_dirty_keys *dirty)
+{
+	size_t i;
+
+	for (i = 0; i < dirty->size; ++i)
+		free(dirty->table[i].key);
+
+	lash_free(&dirty->table);
+	dirty->size = 0;
+	dirty->count = 0;
+}
+
+void
+lash_dirty_keys_merge(struct _lash_dirty_keys *dirty,
+                      struct _lash_dirty_keys *from)
+{
+	size_t i;
+
+	for (i = 0; i < from->size; ++i)
+		if (from->table[i].key)
+			lash_dirty_keys_add(dirty, from->table[i].key);
+
+	lash_dirty_keys_clear(from);
+}
+
+void
+lash_config_mark_dirty(lash_client_t *client,
+                       const char    *key)
+{
+	if (!client || !key || !key[0]) {
+		lash_error("Invalid arguments");
+		return;
+	}
+
+	lash_dirty_keys_add(&client->dirty_keys, key);
+}
+
+void
+lash_config_handle_init(struct _lash_config_handle *handle,
+                        DBusMessageIter            *iter,
+                        bool                        is_read)
+{
+	handle->iter = iter;
+	handle->is_read = is_read;
+	handle->flush = NULL;
+	handle->flush_arg = NULL;
+	handle->chunk_size = 0;
+	handle->keys_only = false;
+	handle->reply = NULL;
+	handle->save_token = NULL;
+	handle->delta = NULL;
+#ifdef HAVE_DATA_SET_FD
+	handle->fd = -1;
+	handle->map = NULL;
+	handle->map_size = 0;
+	handle->map_offset = 0;
+#endif
+}
+
+#ifdef HAVE_DATA_SET_FD
+
+bool
+lash_config_handle_init_fd_write(struct _lash_config_handle *handle)
+{
+	lash_config_handle_init(handle, NULL, false);
+
+	handle->fd = memfd_create("lash-data-set",
+	                          MFD_CLOEXEC | MFD_ALLOW_SEALING);
+	if (handle->fd == -1) {
+		lash_error("Cannot create data set memfd: %s", strerror(errno));
+		return false;
+	}
+
+	return true;
+}
+
+bool
+lash_config_handle_init_fd_read(struct _lash_config_handle *handle,
+                                int                         fd)
+{
+	struct stat st;
+	void *map;
+
+	lash_config_handle_init(handle, NULL, true);
+	handle->fd = fd;
+
+	if (fstat(fd, &st) == -1) {
+		lash_error("Cannot stat data set fd: %s", strerror(errno));
+		return false;
+	}
+
+	if (st.st_size == 0)
+		return true;
+
+	/* The mapping is private and writable so that keys can be
+	   NUL-terminated in place; see lash_config_read_record() */
+	map = mmap(NULL, st.st_size, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0);
+	if (map == MAP_FAILED) {
+		lash_error("Cannot map data set fd: %s", strerror(errno));
+		return false;
+	}
+
+	handle->map = map;
+	handle->map_size = st.st_size;
+
+	return true;
+}
+
+int
+lash_config_handle_take_fd(struct _lash_config_handle *handle)
+{
+	int fd = handle->fd;
+
+	handle->fd = -1;
+
+	if (fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW
+	                           | F_SEAL_WRITE | F_SEAL_SEAL) == -1) {
+		lash_error("Cannot seal data set memfd: %s", strerror(errno));
+		close(fd);
+		return -1;
+	}
+
+	return fd;
+}
+
+void
+lash_config_handle_close_fd(struct _lash_config_handle *handle)
+{
+	if (handle->map) {
+		munmap(handle->map, handle->map_size);
+		handle->map = NULL;
+	}
+
+	if (handle->fd != -1) {
+		close(handle->fd);
+		handle->fd = -1;
+	}
+}
+
+/* Write a record to the data set memfd. If tag is not NULL it is
+   written as the first byte of the value. */
+static bool
+lash_config_write_record(struct _lash_config_handle *handle,
+                         const char                 *key,
+                         const unsigned char        *tag,
+                         const void                 *value,
+                         size_t                      size,
+                         char                        type)
+{
+	uint32_t key_size, value_size;
+	struct iovec iov[6];
+	ssize_t len;
+	int n = 0;
+
+	key_size = htonl(strlen(key));
+	value_size = htonl(size + (tag ? 1 : 0));
+
+	iov[n].iov_base = &key_size;
+	iov[n++].iov_len = sizeof(uint32_t);
+	iov[n].iov_base = (void *) key;
+	iov[n++].iov_len = strlen(key);
+	iov[n].iov_base = &value_size;
+	iov[n++].iov_len = sizeof(uint32_t);
+	if (tag) {
+		iov[n].iov_base = (void *) tag;
+		iov[n++].iov_len = 1;
+	}
+	iov[n].iov_base = (void *) value;
+	iov[n++].iov_len = size;
+	iov[n].iov_base = &type;
+	iov[n++].iov_len = 1;
+
+	len = writev(handle->fd, iov, n);
+	if (len != (ssize_t) (2 * sizeof(uint32_t) + strlen(key) + size
+	                      + (tag ? 2 : 1))) {
+		lash_error("Cannot write config \"%s\" to data set memfd: %s",
+		           key, len == -1 ? strerror(errno) : "Short write");
+		return false;
+	}
+
+	return true;
+}
+
+/* Get the next record from the mapped data set fd. Values are returned
+   the same way as lash_config_read_entry() returns them. */
+static int
+lash_config_read_record(struct _lash_config_handle  *handle,
+                        const char                 **key_ptr,
+                        void                        *value_ptr,
+                        int                         *type_ptr,
+                        int                         *size_ptr,
+                        unsigned char               *tag_ptr)
+{
+	char *ptr, *end, *value, *next;
+	uint32_t u;
+	size_t key_size, value_size, misalign;
+	int element_size;
+
+	ptr = handle->map + handle->map_offset;
+	end = handle->map + handle->map_size;
+
+	if (ptr == end)
+		return 0;
+
+	if ((size_t) (end - ptr) < sizeof(uint32_t))
+		goto corrupt;
+	memcpy(&u, ptr, sizeof(uint32_t));
+	key_size = ntohl(u);
+
+	if (key_size == 0
+	    || (size_t) (end - ptr) < 2 * sizeof(uint32_t) + key_size)
+		goto corrupt;
+	memcpy(&u, ptr + sizeof(uint32_t) + key_size, sizeof(uint32_t));
+	value_size = ntohl(u);
+
+	if (value_size == 0
+	    || (size_t) (end - ptr) < 2 * sizeof(uint32_t) + key_size
+	                              + value_size + 1)
+		goto corrupt;
+
+	value = ptr + 2 * sizeof(uint32_t) + key_size;
+	*type_ptr = value[value_size];
+	next = value + value_size + 1;
+
+	/* Move the key back over the already decoded key size to make room
+	   for a terminating NUL. This leaves 7 unused bytes in front of
+	   the value. */
+	memmove(ptr, ptr + sizeof(uint32_t), key_size);
+	ptr[key_size] = '\0';
+	*key_ptr = ptr;
+
+	if (*type_ptr == LASH_TYPE_DOUBLE || *type_ptr == LASH_TYPE_INTEGER) {
+		if (value_size != (*type_ptr == LASH_TYPE_DOUBLE ? 8 : sizeof(uint32_t)))
+			goto corrupt;
+		memcpy(value_ptr, value, value_size);
+	} else if (*type_ptr == LASH_TYPE_STRING) {
+		if (value[value_size - 1] != '\0')
+			goto corrupt;
+		*((const char **) value_ptr) = value;
+	} else if (*type_ptr == LASH_TYPE_BLOCK) {
+		if (tag_ptr)
+			*tag_ptr = (unsigned char) value[0];
+		*((const void **) value_ptr) = value + 1;
+		--value_size;
+	} else {
+		/* Records are packed, so an array may be misaligned. Move it
+		   back into the unused bytes to let it be read in place. */
+		element_size = lash_config_element_size(*type_ptr);
+		if (element_size
+		    && (misalign = (uintptr_t) value % element_size)) {
+			memmove(value - misalign, value, value_size);
+			value -= misalign;
+		}
+		*((const void **) value_ptr) = value;
+	}
+
+	handle->map_offset = next - handle->map;
+	*size_ptr = (int) value_size;
+
+	return 1;
+
+corrupt:
+	lash_error("Data set fd is corrupt at offset %lu",
+	           (unsigned long) handle->map_offset);
+	return -1;
+}
+
+#endif /* HAVE_DATA_SET_FD */
+
+/* Account for a config appended to the message, and have the message
+   sent as a chunk of the data set once it has grown big enough */
+static bool
+lash_config_appended(struct _lash_config_handle *handle,
+                     size_t                      size)
+{
+	handle->chunk_size += size;
+
+	if (handle->flush && handle->chunk_size >= LASH_DATA_SET_CHUNK_SIZE)
+		return handle->flush(handle);
+
+	return true;
+}
+
 bool
 lash_config_write(lash_config_handle_t *handle,
                   const char           *key,
@@ -43,6 +454,7 @@ lash_config_write(lash_config_handle_t *handle,
 	}
 
 	const void *value_ptr;
+	size_t size;
 	char buf[8];
 
 	if (handle->is_read) {
@@ -58,11 +470,14 @@ lash_config_write(lash_config_handle_t *handle,
 			return false;
 		}
 		value_ptr = buf;
+		size = 8;
 	} else if (type == LASH_TYPE_INTEGER) {
 		*((uint32_t *) buf) = htonl(*((uint32_t *) value));
 		value_ptr = buf;
+		size = sizeof(uint32_t);
 	} else if (type == LASH_TYPE_STRING) {
 		value_ptr = value;
+		size = strlen(value) + 1;
 	} else {
 		lash_error("Invalid value type %i", type);
 		return false;
@@ -70,12 +485,21 @@ lash_config_write(lash_config_handle_t *handle,
 
 	lash_debug("Writing config \"%s\" of type '%c'", key, (char) type);
 
+	if (handle->delta)
+		lash_dirty_keys_written(handle->delta, key);
+
+#ifdef HAVE_DATA_SET_FD
+	if (handle->fd != -1)
+		return lash_config_write_record(handle, key, NULL, value_ptr,
+		                                size, (char) type);
+#endif
+
 	if (!method_iter_append_dict_entry(handle->iter, type, key, value_ptr, 0)) {
 		lash_error("Failed to append dict entry");
 		return false;
 	}
 
-	return true;
+	return lash_config_appended(handle, strlen(key) + size);
 }
 
 bool
@@ -96,44 +520,159 @@ lash_config_write_raw(lash_config_handle_t *handle,
 
 	lash_debug("Writing raw config \"%s\"", key);
 
+	if (handle->delta)
+		lash_dirty_keys_written(handle->delta, key);
+
+#ifdef HAVE_DATA_SET_FD
+	if (handle->fd != -1)
+		return lash_config_write_record(handle, key, NULL, buf, size,
+		                                LASH_TYPE_RAW);
+#endif
+
 	if (!method_iter_append_dict_entry(handle->iter, LASH_TYPE_RAW, key, &buf, size)) {
 		lash_error("Failed to append dict entry");
 		return false;
 	}
 
-	return true;
+	return lash_config_appended(handle, strlen(key) + size);
 }
 
-int
-lash_config_read(lash_config_handle_t  *handle,
-                 const char           **key_ptr,
-                 void                  *value_ptr,
-                 int                   *type_ptr)
+bool
+lash_config_write_array(lash_config_handle_t *handle,
+                        const char           *key,
+                        int                   type,
+                        const void           *elements,
+                        int                   count)
 {
-	if (!handle || !key_ptr || !value_ptr || !type_ptr) {
+	if (!handle || !key || !key[0] || !elements || count < 1
+	    || !lash_config_element_size(type)) {
 		lash_error("Invalid arguments");
-		return -1;
+		return false;
 	}
 
-	int size;
+	int size = count * lash_config_element_size(type);
 
-	if (!handle->is_read) {
-		lash_error("Cannot read config data during a SaveDataSet operation");
-		return -1;
+	if (handle->is_read) {
+		lash_error("Cannot write config data during a LoadDataSet operation");
+		return false;
+	}
+
+	lash_debug("Writing array config \"%s\" of type '%c' (%i elements)",
+	           key, (char) type, count);
+
+	if (handle->delta)
+		lash_dirty_keys_written(handle->delta, key);
+
+#ifdef HAVE_DATA_SET_FD
+	if (handle->fd != -1)
+		return lash_config_write_record(handle, key, NULL, elements,
+		                                size, (char) type);
+#endif
+
+	if (!method_iter_append_dict_entry(handle->iter, type, key,
+	                                   &elements, size)) {
+		lash_error("Failed to append dict entry");
+		return false;
+	}
+
+	return lash_config_appended(handle, strlen(key) + size);
+}
+
+bool
+lash_config_write_block(lash_config_handle_t *handle,
+                        const char           *key,
+                        unsigned char         tag,
+                        const void           *buf,
+                        int                   size)
+{
+	if (!handle || !key || !key[0] || !buf || size < 1) {
+		lash_error("Invalid arguments");
+		return false;
+	}
+
+	if (handle->is_read) {
+		lash_error("Cannot write config data during a LoadDataSet operation");
+		return false;
+	}
+
+	lash_debug("Writing block config \"%s\" with tag %u", key, tag);
+
+	if (handle->delta)
+		lash_dirty_keys_written(handle->delta, key);
+
+#ifdef HAVE_DATA_SET_FD
+	if (handle->fd != -1)
+		return lash_config_write_record(handle, key, &tag, buf, size,
+		                                LASH_TYPE_BLOCK);
+#endif
+
+	if (!method_iter_append_dict_entry_block(handle->iter, key, tag,
+	                                         buf, size)) {
+		lash_error("Failed to append dict entry");
+		return false;
 	}
 
+	return lash_config_appended(handle, strlen(key) + size + 1);
+}
+
+/* Get the next dict entry from the config message. Returns 1 if an
+   entry was read, 0 if none remain, and -1 on error. */
+static int
+lash_config_read_entry(struct _lash_config_handle  *handle,
+                       const char                 **key_ptr,
+                       void                        *value_ptr,
+                       int                         *type_ptr,
+                       int                         *size_ptr,
+                       unsigned char               *tag_ptr)
+{
 	/* No data left in message */
 	if (dbus_message_iter_get_arg_type(handle->iter) == DBUS_TYPE_INVALID)
 		return 0;
 
 	if (!method_iter_get_dict_entry(handle->iter, key_ptr, value_ptr,
-	                                type_ptr, &size)) {
+	                                type_ptr, size_ptr, tag_ptr)) {
 		lash_error("Failed to read config message");
 		return -1;
 	}
 
 	dbus_message_iter_next(handle->iter);
 
+	return 1;
+}
+
+/* Read the next config, see lash_config_read(). The tag of a block
+   is saved in tag_ptr if it is not NULL. */
+static int
+lash_config_read_value(struct _lash_config_handle  *handle,
+                       const char                 **key_ptr,
+                       void                        *value_ptr,
+                       int                         *type_ptr,
+                       unsigned char               *tag_ptr)
+{
+	int ret, size, element_size;
+
+	if (!handle->is_read) {
+		lash_error("Cannot read config data during a SaveDataSet operation");
+		return -1;
+	}
+
+	if (handle->keys_only) {
+		lash_error("Config handle only contains keys, use "
+		           "lash_get_configs to fetch the values");
+		return -1;
+	}
+
+#ifdef HAVE_DATA_SET_FD
+	if (handle->fd != -1)
+		ret = lash_config_read_record(handle, key_ptr, value_ptr,
+		                              type_ptr, &size, tag_ptr);
+	else
+#endif
+	ret = lash_config_read_entry(handle, key_ptr, value_ptr,
+	                             type_ptr, &size, tag_ptr);
+	if (ret < 1)
+		return ret;
+
 	if (*type_ptr == LASH_TYPE_DOUBLE) {
 		XDR x;
 		double d;
@@ -154,7 +693,14 @@ lash_config_read(lash_config_handle_t  *handle,
 			lash_error("String length is 0");
 			return -1;
 		}
-	} else if (*type_ptr != LASH_TYPE_RAW) {
+	} else if ((element_size = lash_config_element_size(*type_ptr))) {
+		if (size % element_size != 0) {
+			lash_error("Array size %i is not a multiple of %i",
+			           size, element_size);
+			return -1;
+		}
+		size /= element_size;
+	} else if (*type_ptr != LASH_TYPE_RAW && *type_ptr != LASH_TYPE_BLOCK) {
 		lash_error("Unknown value type %i", *type_ptr);
 		return -1;
 	}
@@ -162,6 +708,157 @@ lash_config_read(lash_config_handle_t  *handle,
 	return size;
 }
 
+int
+lash_config_read(lash_config_handle_t  *handle,
+                 const char           **key_ptr,
+                 void                  *value_ptr,
+                 int                   *type_ptr)
+{
+	if (!handle || !key_ptr || !value_ptr || !type_ptr) {
+		lash_error("Invalid arguments");
+		return -1;
+	}
+
+	return lash_config_read_value(handle, key_ptr, value_ptr,
+	                              type_ptr, NULL);
+}
+
+int
+lash_config_read_view(lash_config_handle_t  *handle,
+                      const char           **key_ptr,
+                      lash_config_view_t    *view,
+                      int                   *type_ptr)
+{
+	if (!handle || !key_ptr || !view || !type_ptr) {
+		lash_error("Invalid arguments");
+		return -1;
+	}
+
+	union {
+		double      d;
+		uint32_t    u;
+		const void *v;
+	} value;
+	unsigned char tag = 0;
+	int ret;
+
+	ret = lash_config_read_value(handle, key_ptr, &value, type_ptr, &tag);
+	if (ret < 1)
+		return ret;
+
+	/* Numbers are kept in the handle to give them an address */
+	if (*type_ptr == LASH_TYPE_DOUBLE) {
+		handle->number.d = value.d;
+		view->elements = &handle->number.d;
+		view->count = 1;
+	} else if (*type_ptr == LASH_TYPE_INTEGER) {
+		handle->number.u = value.u;
+		view->elements = &handle->number.u;
+		view->count = 1;
+	} else {
+		view->elements = value.v;
+		view->count = ret;
+	}
+	view->tag = tag;
+
+	return ret;
+}
+
+int
+lash_config_read_key(lash_config_handle_t  *handle,
+                     const char           **key_ptr,
+                     int                   *type_ptr)
+{
+	if (!handle || !key_ptr || !type_ptr) {
+		lash_error("Invalid arguments");
+		return -1;
+	}
+
+	DBusMessageIter struct_iter;
+	dbus_uint32_t size;
+	unsigned char type;
+	int element_size;
+
+	if (!handle->is_read) {
+		lash_error("Cannot read config data during a SaveDataSet operation");
+		return -1;
+	}
+
+	/* A full data set is read as usual, and the value dropped */
+	if (!handle->keys_only) {
+		union {
+			double      d;
+			uint32_t    u;
+			const void *v;
+		} value;
+
+		return lash_config_read(handle, key_ptr, &value, type_ptr);
+	}
+
+	/* No data left in message */
+	if (dbus_message_iter_get_arg_type(handle->iter) == DBUS_TYPE_INVALID)
+		return 0;
+
+	if (dbus_message_iter_get_arg_type(handle->iter) != DBUS_TYPE_STRUCT)
+		goto fail;
+
+	dbus_message_iter_recurse(handle->iter, &struct_iter);
+
+	if (dbus_message_iter_get_arg_type(&struct_iter) != DBUS_TYPE_STRING)
+		goto fail;
+	dbus_message_iter_get_basic(&struct_iter, key_ptr);
+	dbus_message_iter_next(&struct_iter);
+
+	if (dbus_message_iter_get_arg_type(&struct_iter) != DBUS_TYPE_UINT32)
+		goto fail;
+	dbus_message_iter_get_basic(&struct_iter, &size);
+	dbus_message_iter_next(&struct_iter);
+
+	if (dbus_message_iter_get_arg_type(&struct_iter) != DBUS_TYPE_BYTE)
+		goto fail;
+	dbus_message_iter_get_basic(&struct_iter, &type);
+
+	dbus_message_iter_next(handle->iter);
+
+	*type_ptr = (int) type;
+
+	/* Return the same count as lash_config_read() would: elements for
+	   arrays, and neither a string's terminator nor a block's tag */
+	if ((element_size = lash_config_element_size(*type_ptr))) {
+		if (size % element_size != 0) {
+			lash_error("Array size %u is not a multiple of %i",
+			           (unsigned int) size, element_size);
+			return -1;
+		}
+		size /= element_size;
+	} else if (*type_ptr == LASH_TYPE_STRING || *type_ptr == LASH_TYPE_BLOCK) {
+		if (size < (*type_ptr == LASH_TYPE_STRING ? 2 : 1))
+			goto fail;
+		--size;
+	}
+
+	return (int) size;
+
+fail:
+	lash_error("Failed to read config key message");
+	return -1;
+}
+
+void
+lash_config_handle_free(lash_config_handle_t *handle)
+{
+	if (!handle)
+		return;
+
+	if (!handle->reply) {
+		lash_error("Config handle was not returned by lash_get_configs");
+		return;
+	}
+
+	dbus_message_unref(handle->reply);
+	free(handle);
+}
+
 
 #ifdef LASH_OLD_API
 # include "common/safety.h"
@@ -185,13 +882,12 @@ lash_config_dup(const lash_config_t *config)
 
 	lash_config_t *config_dup;
 
-	config_dup = lash_calloc(1, sizeof(lash_config_t));
-	config_dup->key = lash_strdup(config->key);
+	config_dup = lash_config_new_with_key(config->key);
 
 	if (config->value && config->value_size > 0) {
-		config_dup->value = lash_malloc(1, config->value_size);
-		memcpy(config_dup->value, config->value, config->value_size);
-		config_dup->value_size = config->value_size;
+		lash_config_set_value(config_dup, config->value,
+		                      config->value_size);
+		config_dup->value_type = config->value_type;
 	}
 
 	return config_dup;
@@ -204,26 +900,42 @@ lash_config_new_with_key(const char *key)
 
 	config = lash_calloc(1, sizeof(lash_config_t));
 	if (key)
-		config->key = lash_strdup(key);
+		lash_config_set_key(config, key);
 
 	return config;
 }
 
-void
-lash_config_free(lash_config_t *config)
+lash_config_t *
+lash_client_new_config(lash_client_t *client,
+                       const char    *key)
 {
-	lash_free(&config->key);
-	lash_free(&config->value);
+	lash_config_t *config;
+
+	config = lash_pool_get(client->config_pool, sizeof(lash_config_t));
+	config->pool = client->config_pool;
+	config->value = NULL;
 	config->value_size = 0;
+	lash_config_set_key(config, key);
+
+	return config;
+}
+
+void
+lash_config_free(void *ptr)
+{
+	lash_config_t *config = ptr;
+
+	free(config->key_buf);
+	free(config->value_buf);
+	free(config);
 }
 
 void
 lash_config_destroy(lash_config_t *config)
 {
-	if (config) {
+	/* Pooled configs keep their buffers for reuse */
+	if (config && !(config->pool && lash_pool_put(config->pool, config)))
 		lash_config_free(config);
-		free(config);
-	}
 }
 
 const char *
@@ -244,6 +956,12 @@ lash_config_get_value_size(const lash_config_t *config)
 	return config ? config->value_size : 0;
 }
 
+int
+lash_config_get_value_type(const lash_config_t *config)
+{
+	return config ? config->value_type : 0;
+}
+
 uint32_t
 lash_config_get_value_int(const lash_config_t *config)
 {
@@ -272,14 +990,10 @@ void
 lash_config_set_key(lash_config_t *config,
                     const char    *key)
 {
-	if (config) {
-		/* Free the existing key */
-		if (config->key)
-			free(config->key);
-
-		/* Copy the new one */
-		config->key = lash_strdup(key);
-	}
+	if (config)
+		lash_buffer_set((void **) &config->key, &config->key_buf,
+		                &config->key_buf_size, key,
+		                key ? strlen(key) + 1 : 0);
 }
 
 void
@@ -288,18 +1002,14 @@ lash_config_set_value(lash_config_t *config,
                       size_t         value_size)
 {
 	if (config) {
-		/* Free the existing value */
-		if (config->value)
-			free(config->value);
-
 		if (!value || value_size < 1) {
 			config->value = NULL;
 			config->value_size = 0;
 			return;
 		}
 
-		config->value = lash_malloc(1, value_size);
-		memcpy(config->value, value, value_size);
+		lash_buffer_set(&config->value, &config->value_buf,
+		                &config->value_buf_size, value, value_size);
 		config->value_size = value_size;
 		config->value_type = LASH_TYPE_RAW;
 	}
@@ -337,6 +1047,25 @@ lash_config_set_value_string(lash_config_t *config,
 		lash_config_set_value(config, value, strlen(value) + 1);
 }
 
+void
+lash_config_set_value_array(lash_config_t *config,
+                            int            type,
+                            const void    *elements,
+                            size_t         count)
+{
+	size_t element_size;
+
+	if (!(element_size = lash_config_element_size(type))) {
+		lash_error("Invalid array type '%c'", type);
+		return;
+	}
+
+	lash_config_set_value(config, elements, count * element_size);
+
+	if (config && config->value)
+		config->value_type = type;
+}
+
 #endif /* LASH_OLD_API */
 
 /* EOF */
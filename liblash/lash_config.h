@@ -28,26 +28,145 @@
 
 #include "lash/types.h"
 
+/* Size in bytes after which a data set message is sent as a chunk */
+#define LASH_DATA_SET_CHUNK_SIZE (64 * 1024)
+
+/* A key in a dirty key table */
+struct _lash_dirty_key
+{
+	char *key;     /* NULL if the slot is free */
+	bool  written; /* The key's value has been written in a delta save */
+};
+
+/* Hash table of the keys which the client has changed or removed since
+   its last save, see lash_config_mark_dirty() */
+struct _lash_dirty_keys
+{
+	struct _lash_dirty_key *table;
+	size_t                  size;  /* Number of slots, a power of two */
+	size_t                  count; /* Number of keys */
+};
+
 struct _lash_config_handle
 {
 	DBusMessageIter *iter;
 	bool             is_read;
+	bool           (*flush)(struct _lash_config_handle *handle); /* Sends a chunk, or NULL */
+	void            *flush_arg;
+	size_t           chunk_size; /* Bytes written through iter since the last flush */
+	bool             keys_only;  /* iter points to an a(suy) key array, see LoadDataSetKeys */
+	DBusMessage     *reply;      /* Message owned by a handle from lash_get_configs(), or NULL */
+	lash_save_token_t *save_token; /* Save which the handle writes, or NULL */
+	struct _lash_dirty_keys *delta; /* Dirty keys of a delta save, or NULL */
+	DBusMessageIter  reply_iter;
+	DBusMessageIter  reply_array_iter;
+	union {
+		double   d;
+		uint32_t u;
+	}                number;     /* Number pointed to by the last lash_config_read_view() */
+#ifdef HAVE_DATA_SET_FD
+	int              fd;         /* Data set memfd, or -1 if iter is used */
+	char            *map;        /* Private mapping of fd when reading */
+	size_t           map_size;
+	size_t           map_offset; /* Offset of the next record in map */
+#endif
 };
 
+/** Initialise a config handle which reads from or writes to
+ * the dict entry array pointed to by @a iter.
+ */
+void
+lash_config_handle_init(struct _lash_config_handle *handle,
+                        DBusMessageIter            *iter,
+                        bool                        is_read);
+
+/** Get the element size of an array config type, or 0 for other types. */
+int
+lash_config_element_size(int type);
+
+/** Add @a key to @a dirty unless it already is in it. */
+void
+lash_dirty_keys_add(struct _lash_dirty_keys *dirty,
+                    const char              *key);
+
+/** Append the keys in @a dirty whose values haven't been written
+ * to a D-Bus message as a string array.
+ * @return True on success, false if memory ran out.
+ */
+bool
+lash_dirty_keys_append_removed(struct _lash_dirty_keys *dirty,
+                               DBusMessageIter         *iter);
+
+/** Forget that the keys in @a dirty have been written, for retrying
+ * a delta save which failed.
+ */
+void
+lash_dirty_keys_reset(struct _lash_dirty_keys *dirty);
+
+/** Remove and free all keys in @a dirty. */
+void
+lash_dirty_keys_clear(struct _lash_dirty_keys *dirty);
+
+/** Move the keys in @a from to @a dirty, unwritten, leaving @a from empty. */
+void
+lash_dirty_keys_merge(struct _lash_dirty_keys *dirty,
+                      struct _lash_dirty_keys *from);
+
+#ifdef HAVE_DATA_SET_FD
+/** Initialise a config handle which writes records to a new data set memfd.
+ * The record format is described in lashd/store.h.
+ * @return True on success, false otherwise.
+ */
+bool
+lash_config_handle_init_fd_write(struct _lash_config_handle *handle);
+
+/** Initialise a config handle which reads records from data set memfd @a fd.
+ * @param handle Handle to initialise.
+ * @param fd Sealed data set memfd. Ownership is taken.
+ * @return True on success, false otherwise.
+ */
+bool
+lash_config_handle_init_fd_read(struct _lash_config_handle *handle,
+                                int                         fd);
+
+/** Seal the data set memfd written through @a handle and take it over.
+ * @return Sealed data set memfd, or -1 on failure.
+ */
+int
+lash_config_handle_take_fd(struct _lash_config_handle *handle);
+
+/** Unmap and close the data set memfd of @a handle, if any. */
+void
+lash_config_handle_close_fd(struct _lash_config_handle *handle);
+#endif
+
 
 #ifdef LASH_OLD_API
 # include <sys/types.h>
-# include "common/klist.h"
+# include "queue.h"
 
 struct _lash_config
 {
-	struct list_head  siblings;
-	char             *key;
-	void             *value;
-	size_t            value_size;
-	int               value_type;
+	char              *key;        /* Points to key_buf, or NULL */
+	void              *value;      /* Points to value_buf, or NULL */
+	size_t             value_size;
+	int                value_type;
+	struct _lash_pool *pool;       /* Pool the config returns to, or NULL */
+	void              *key_buf;
+	size_t             key_buf_size;
+	void              *value_buf;
+	size_t             value_buf_size;
 };
 
+/** Get a config with key @a key from @a client 's config pool. */
+lash_config_t *
+lash_client_new_config(lash_client_t *client,
+                       const char    *key);
+
+/** Free a config and its buffers without returning it to its pool. */
+void
+lash_config_free(void *config);
+
 #endif /* LASH_OLD_API */
 
 #endif /* __LIBLASH_CONFIG_H__ */
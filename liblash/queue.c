@@ -0,0 +1,146 @@
+/*
+ *   LASH
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "common/safety.h"
+
+#include "queue.h"
+
+void
+lash_queue_push(struct _lash_queue *queue,
+                void               *item)
+{
+	if (queue->count == queue->size) {
+		size_t i, size = queue->size ? queue->size * 2 : 16;
+		void **items;
+
+		/* Unwrap the items into the new ring */
+		items = lash_malloc(size, sizeof(void *));
+		for (i = 0; i < queue->count; ++i)
+			items[i] = queue->items[(queue->head + i) & (queue->size - 1)];
+
+		free(queue->items);
+		queue->items = items;
+		queue->size = size;
+		queue->head = 0;
+	}
+
+	queue->items[(queue->head + queue->count) & (queue->size - 1)] = item;
+	++queue->count;
+}
+
+void *
+lash_queue_pop(struct _lash_queue *queue)
+{
+	void *item;
+
+	if (!queue->count)
+		return NULL;
+
+	item = queue->items[queue->head];
+	queue->head = (queue->head + 1) & (queue->size - 1);
+	--queue->count;
+
+	return item;
+}
+
+void
+lash_queue_free(struct _lash_queue *queue)
+{
+	lash_free(&queue->items);
+	queue->count = 0;
+	queue->size = 0;
+	queue->head = 0;
+}
+
+void *
+lash_pool_get(struct _lash_pool *pool,
+              size_t             size)
+{
+	++pool->num_used;
+
+	if (pool->num_free)
+		return pool->free[--pool->num_free];
+
+	return lash_calloc(1, size);
+}
+
+bool
+lash_pool_put(struct _lash_pool *pool,
+              void              *object)
+{
+	--pool->num_used;
+
+	if (pool->orphaned) {
+		if (!pool->num_used)
+			free(pool);
+		return false;
+	}
+
+	if (pool->num_free == pool->size) {
+		pool->size = pool->size ? pool->size * 2 : 16;
+		pool->free = lash_realloc(pool->free, pool->size, sizeof(void *));
+	}
+
+	pool->free[pool->num_free++] = object;
+	return true;
+}
+
+void
+lash_pool_release(struct _lash_pool  *pool,
+                  void              (*destroy)(void *))
+{
+	if (!pool)
+		return;
+
+	/* Keep the objects from coming back */
+	pool->orphaned = true;
+
+	while (pool->num_free)
+		destroy(pool->free[--pool->num_free]);
+	lash_free(&pool->free);
+	pool->size = 0;
+
+	if (!pool->num_used)
+		free(pool);
+}
+
+void
+lash_buffer_set(void        **value_ptr,
+                void        **buf_ptr,
+                size_t       *buf_size_ptr,
+                const void   *data,
+                size_t        size)
+{
+	if (!data) {
+		*value_ptr = NULL;
+		return;
+	}
+
+	if (*buf_size_ptr < size) {
+		*buf_ptr = lash_realloc(*buf_ptr, 1, size);
+		*buf_size_ptr = size;
+	}
+
+	memcpy(*buf_ptr, data, size);
+	*value_ptr = *buf_ptr;
+}
+
+/* EOF */
@@ -0,0 +1,101 @@
+/*
+ *   LASH
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __LIBLASH_QUEUE_H__
+#define __LIBLASH_QUEUE_H__
+
+#include <stdbool.h>
+#include <stddef.h>
+
+/* Event and config queues of the old API. Incoming objects are queued
+   in rings, and objects given back to liblash are kept in their client's
+   pool for reuse along with their buffers. A pool grows to hold as many
+   objects as have been out at once, so that a client which keeps up with
+   its events doesn't allocate once its queues and pools have grown. */
+
+/* A FIFO of pointers in a ring buffer */
+struct _lash_queue
+{
+	void   **items;
+	size_t   size;  /* Number of slots, 0 or a power of two */
+	size_t   head;  /* Slot of the oldest item */
+	size_t   count;
+};
+
+/* A cache of freed objects of one type. Objects remember their pool,
+   and the pool outlives its client if the application still holds
+   objects from it when the client is destroyed. */
+struct _lash_pool
+{
+	void  **free;
+	size_t  size;     /* Number of slots in free */
+	size_t  num_free;
+	size_t  num_used; /* Objects handed out and not yet returned */
+	bool    orphaned; /* The client is gone; free the pool with its last object */
+};
+
+/** Add @a item to the tail of @a queue, growing it if it is full. */
+void
+lash_queue_push(struct _lash_queue *queue,
+                void               *item);
+
+/** Remove the item at the head of @a queue.
+ * @return The item, or NULL if @a queue is empty.
+ */
+void *
+lash_queue_pop(struct _lash_queue *queue);
+
+/** Free the ring of @a queue. Items left in it are not destroyed. */
+void
+lash_queue_free(struct _lash_queue *queue);
+
+/** Get an object of @a size bytes from @a pool. A reused object keeps
+ * its contents, a new one is zeroed.
+ */
+void *
+lash_pool_get(struct _lash_pool *pool,
+              size_t             size);
+
+/** Give @a object back to @a pool, growing it if it is full.
+ * @return True if the pool keeps the object, false if the caller
+ *         must free it.
+ */
+bool
+lash_pool_put(struct _lash_pool *pool,
+              void              *object);
+
+/** Free the objects kept in @a pool with @a destroy, and free @a pool
+ * itself once all objects handed out from it have been returned.
+ */
+void
+lash_pool_release(struct _lash_pool  *pool,
+                  void              (*destroy)(void *));
+
+/** Copy @a size bytes at @a data into the buffer at @a buf_ptr, which
+ * holds @a buf_size_ptr bytes and is grown if necessary, and point
+ * @a value_ptr to the copy. If @a data is NULL @a value_ptr is set to
+ * NULL and the buffer is kept.
+ */
+void
+lash_buffer_set(void        **value_ptr,
+                void        **buf_ptr,
+                size_t       *buf_size_ptr,
+                const void   *data,
+                size_t        size);
+
+#endif /* __LIBLASH_QUEUE_H__ */
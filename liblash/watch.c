@@ -0,0 +1,572 @@
+/*
+ *   LASH
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include "../config.h"
+
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <time.h>
+#include <unistd.h>
+#include <dbus/dbus.h>
+#ifdef HAVE_EPOLL
+# include <sys/epoll.h>
+# include <sys/timerfd.h>
+#endif
+
+#include "common/safety.h"
+#include "common/debug.h"
+
+#include "lash/lash.h"
+
+#include "client.h"
+#include "watch.h"
+#include "io_thread.h"
+#include "dbus_iface_client.h"
+
+/* Maximum number of descriptors handled per lash_handle_epoll_events() */
+#define LASH_EPOLL_MAX_EVENTS 8
+
+static uint64_t
+lash_watch_now_msec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/* Time in milliseconds until the earliest enabled timeout expires,
+   0 if there are messages waiting to be dispatched, or -1 if none */
+static int
+lash_watch_next_timeout(lash_client_t *client)
+{
+	uint64_t now, expiry, earliest = UINT64_MAX;
+	size_t i;
+
+	/* The status is tracked rather than queried since this is also
+	   called from libdbus callbacks, which hold the connection lock */
+	if (client->data_remains)
+		return 0;
+
+	for (i = 0; i < client->num_timeouts; ++i) {
+		if (!dbus_timeout_get_enabled(client->timeouts[i]))
+			continue;
+		expiry = *((uint64_t *) dbus_timeout_get_data(client->timeouts[i]));
+		if (expiry < earliest)
+			earliest = expiry;
+	}
+
+	if (earliest == UINT64_MAX)
+		return -1;
+
+	now = lash_watch_now_msec();
+
+	return (earliest > now) ? (int) (earliest - now) : 0;
+}
+
+#ifdef HAVE_EPOLL
+/* Bring the epoll set's entry for descriptor fd in line with the
+   combined conditions of the enabled watches on it */
+static void
+lash_watch_epoll_update_fd(lash_client_t *client,
+                           int            fd)
+{
+	struct epoll_event ev;
+	unsigned int flags = 0;
+	size_t i;
+
+	if (client->epoll_fd == -1)
+		return;
+
+	for (i = 0; i < client->num_watches; ++i)
+		if (dbus_watch_get_enabled(client->watches[i])
+		    && dbus_watch_get_unix_fd(client->watches[i]) == fd)
+			flags |= dbus_watch_get_flags(client->watches[i]);
+
+	memset(&ev, 0, sizeof(ev));
+	ev.data.fd = fd;
+	if (flags & DBUS_WATCH_READABLE)
+		ev.events |= EPOLLIN;
+	if (flags & DBUS_WATCH_WRITABLE)
+		ev.events |= EPOLLOUT;
+
+	if (!ev.events) {
+		if (epoll_ctl(client->epoll_fd, EPOLL_CTL_DEL, fd, NULL) == -1
+		    && errno != ENOENT)
+			lash_error("Cannot remove descriptor from epoll set: %s",
+			           strerror(errno));
+	} else if (epoll_ctl(client->epoll_fd, EPOLL_CTL_MOD, fd, &ev) == -1
+	           && (errno != ENOENT
+	               || epoll_ctl(client->epoll_fd, EPOLL_CTL_ADD, fd, &ev) == -1)) {
+		lash_error("Cannot add descriptor to epoll set: %s",
+		           strerror(errno));
+	}
+}
+
+/* Arm the timer descriptor to fire when the next timeout expires,
+   or straight away if there are messages waiting to be dispatched */
+static void
+lash_watch_epoll_update_timer(lash_client_t *client)
+{
+	struct itimerspec its;
+	int msec;
+
+	if (client->timer_fd == -1)
+		return;
+
+	memset(&its, 0, sizeof(its));
+
+	if ((msec = lash_watch_next_timeout(client)) == 0)
+		its.it_value.tv_nsec = 1;
+	else if (msec > 0) {
+		its.it_value.tv_sec = msec / 1000;
+		its.it_value.tv_nsec = (msec % 1000) * 1000000;
+	}
+
+	if (timerfd_settime(client->timer_fd, 0, &its, NULL) == -1)
+		lash_error("Cannot arm timer descriptor: %s", strerror(errno));
+}
+#else
+# define lash_watch_epoll_update_fd(client, fd)
+# define lash_watch_epoll_update_timer(client)
+#endif /* HAVE_EPOLL */
+
+static dbus_bool_t
+lash_watch_add(DBusWatch *watch,
+               void      *data)
+{
+	lash_client_t *client = data;
+
+	client->watches = lash_realloc(client->watches,
+	                               client->num_watches + 1,
+	                               sizeof(DBusWatch *));
+	client->watches[client->num_watches++] = watch;
+
+	lash_watch_epoll_update_fd(client, dbus_watch_get_unix_fd(watch));
+
+	return TRUE;
+}
+
+static void
+lash_watch_remove(DBusWatch *watch,
+                  void      *data)
+{
+	lash_client_t *client = data;
+	size_t i;
+
+	for (i = 0; i < client->num_watches; ++i) {
+		if (client->watches[i] == watch) {
+			client->watches[i] = client->watches[--client->num_watches];
+			lash_watch_epoll_update_fd(client, dbus_watch_get_unix_fd(watch));
+			return;
+		}
+	}
+}
+
+static void
+lash_watch_toggled(DBusWatch *watch,
+                   void      *data)
+{
+	lash_watch_epoll_update_fd((lash_client_t *) data,
+	                           dbus_watch_get_unix_fd(watch));
+}
+
+/* Set the timeout's expiry time a full interval from now */
+static void
+lash_timeout_restart(DBusTimeout *timeout)
+{
+	*((uint64_t *) dbus_timeout_get_data(timeout)) =
+	  lash_watch_now_msec() + dbus_timeout_get_interval(timeout);
+}
+
+static dbus_bool_t
+lash_timeout_add(DBusTimeout *timeout,
+                 void        *data)
+{
+	lash_client_t *client = data;
+
+	dbus_timeout_set_data(timeout, lash_malloc(1, sizeof(uint64_t)), free);
+	lash_timeout_restart(timeout);
+
+	client->timeouts = lash_realloc(client->timeouts,
+	                                client->num_timeouts + 1,
+	                                sizeof(DBusTimeout *));
+	client->timeouts[client->num_timeouts++] = timeout;
+
+	lash_watch_epoll_update_timer(client);
+
+	return TRUE;
+}
+
+static void
+lash_timeout_remove(DBusTimeout *timeout,
+                    void        *data)
+{
+	lash_client_t *client = data;
+	size_t i;
+
+	for (i = 0; i < client->num_timeouts; ++i) {
+		if (client->timeouts[i] == timeout) {
+			client->timeouts[i] = client->timeouts[--client->num_timeouts];
+			lash_watch_epoll_update_timer(client);
+			return;
+		}
+	}
+}
+
+static void
+lash_timeout_toggled(DBusTimeout *timeout,
+                     void        *data)
+{
+	if (dbus_timeout_get_enabled(timeout))
+		lash_timeout_restart(timeout);
+
+	lash_watch_epoll_update_timer((lash_client_t *) data);
+}
+
+static void
+lash_watch_dispatch_status(DBusConnection     *connection,
+                           DBusDispatchStatus  new_status,
+                           void               *data)
+{
+	lash_client_t *client = data;
+
+	client->data_remains = (new_status == DBUS_DISPATCH_DATA_REMAINS);
+
+	if (client->data_remains)
+		lash_watch_epoll_update_timer(client);
+}
+
+bool
+lash_watch_init(lash_client_t *client)
+{
+	DBusConnection *connection = client->dbus_service->connection;
+
+	if (!dbus_connection_set_watch_functions(connection,
+	                                         lash_watch_add,
+	                                         lash_watch_remove,
+	                                         lash_watch_toggled,
+	                                         client, NULL)
+	    || !dbus_connection_set_timeout_functions(connection,
+	                                              lash_timeout_add,
+	                                              lash_timeout_remove,
+	                                              lash_timeout_toggled,
+	                                              client, NULL)) {
+		lash_error("Failed to set D-Bus watch functions");
+		return false;
+	}
+
+	dbus_connection_set_dispatch_status_function(connection,
+	                                             lash_watch_dispatch_status,
+	                                             client, NULL);
+
+	/* Messages may have arrived before the function was set */
+	client->data_remains =
+	  (dbus_connection_get_dispatch_status(connection)
+	   == DBUS_DISPATCH_DATA_REMAINS);
+
+	return true;
+}
+
+void
+lash_watch_fini(lash_client_t *client)
+{
+	DBusConnection *connection = client->dbus_service->connection;
+
+	dbus_connection_set_watch_functions(connection, NULL, NULL, NULL,
+	                                    NULL, NULL);
+	dbus_connection_set_timeout_functions(connection, NULL, NULL, NULL,
+	                                      NULL, NULL);
+	dbus_connection_set_dispatch_status_function(connection, NULL,
+	                                             NULL, NULL);
+}
+
+int
+lash_get_pollfds(lash_client_t *client,
+                 struct pollfd *fds,
+                 int            max_fds,
+                 int           *timeout)
+{
+	unsigned int flags;
+	short events;
+	size_t i;
+	int fd, j, num_fds = 0;
+
+	if (!client || !client->dbus_service) {
+		lash_error("Client is not connected");
+		return -1;
+	}
+
+	/* With an I/O thread running there is only its notifications
+	   to wait for */
+	if (client->io) {
+		if (max_fds > 0) {
+			fds[0].fd = client->io->notify_fd;
+			fds[0].events = POLLIN;
+			fds[0].revents = 0;
+		}
+		if (timeout)
+			*timeout = -1;
+		return 1;
+	}
+
+	for (i = 0; i < client->num_watches; ++i) {
+		if (!dbus_watch_get_enabled(client->watches[i]))
+			continue;
+
+		fd = dbus_watch_get_unix_fd(client->watches[i]);
+		flags = dbus_watch_get_flags(client->watches[i]);
+		events = ((flags & DBUS_WATCH_READABLE) ? POLLIN : 0)
+		         | ((flags & DBUS_WATCH_WRITABLE) ? POLLOUT : 0);
+
+		/* The read and write watches usually share a descriptor */
+		for (j = 0; j < num_fds && j < max_fds; ++j) {
+			if (fds[j].fd == fd) {
+				fds[j].events |= events;
+				break;
+			}
+		}
+
+		if (j < num_fds)
+			continue;
+
+		if (num_fds < max_fds) {
+			fds[num_fds].fd = fd;
+			fds[num_fds].events = events;
+			fds[num_fds].revents = 0;
+		}
+		++num_fds;
+	}
+
+	/* A deferred save may be completed by another thread */
+	if (client->save_token) {
+		if (num_fds < max_fds) {
+			fds[num_fds].fd = client->save_fd;
+			fds[num_fds].events = POLLIN;
+			fds[num_fds].revents = 0;
+		}
+		++num_fds;
+	}
+
+	if (timeout)
+		*timeout = lash_watch_next_timeout(client);
+
+	return num_fds;
+}
+
+void
+lash_handle_events(lash_client_t       *client,
+                   const struct pollfd *fds,
+                   int                  num_fds)
+{
+	DBusConnection *connection;
+	DBusTimeout *timeout;
+	unsigned int flags, handled;
+	uint64_t now;
+	size_t i;
+	int j;
+
+	if (!client || !client->dbus_service)
+		return;
+
+	if (client->io) {
+		lash_dispatch(client);
+		return;
+	}
+
+	connection = client->dbus_service->connection;
+
+	dbus_connection_ref(connection);
+
+	for (j = 0; j < num_fds; ++j) {
+		if (!fds[j].revents)
+			continue;
+
+		flags = ((fds[j].revents & POLLIN) ? DBUS_WATCH_READABLE : 0)
+		        | ((fds[j].revents & POLLOUT) ? DBUS_WATCH_WRITABLE : 0)
+		        | ((fds[j].revents & POLLERR) ? DBUS_WATCH_ERROR : 0)
+		        | ((fds[j].revents & POLLHUP) ? DBUS_WATCH_HANGUP : 0);
+
+		/* Handling a watch may add or remove others, so the scan
+		   starts over after each one. The conditions which have
+		   been handled are cleared so no watch gets them twice. */
+		while (flags) {
+			for (i = 0; i < client->num_watches; ++i)
+				if (dbus_watch_get_unix_fd(client->watches[i]) == fds[j].fd
+				    && dbus_watch_get_enabled(client->watches[i])
+				    && (flags & (dbus_watch_get_flags(client->watches[i])
+				                 | DBUS_WATCH_ERROR | DBUS_WATCH_HANGUP)))
+					break;
+
+			if (i == client->num_watches)
+				break;
+
+			handled = flags & (dbus_watch_get_flags(client->watches[i])
+			                   | DBUS_WATCH_ERROR | DBUS_WATCH_HANGUP);
+			dbus_watch_handle(client->watches[i], handled);
+			flags &= ~handled;
+		}
+	}
+
+	/* Expired timeouts are restarted before being handled so that
+	   each one is handled once even though the scan starts over */
+	now = lash_watch_now_msec();
+	for (i = 0; i < client->num_timeouts; ) {
+		timeout = client->timeouts[i];
+		if (dbus_timeout_get_enabled(timeout)
+		    && *((uint64_t *) dbus_timeout_get_data(timeout)) <= now) {
+			lash_timeout_restart(timeout);
+			dbus_timeout_handle(timeout);
+			i = 0;
+		} else {
+			++i;
+		}
+	}
+
+	while (dbus_connection_dispatch(connection) == DBUS_DISPATCH_DATA_REMAINS)
+		;
+	client->data_remains = false;
+
+	lash_save_dispatch(client);
+	lash_flush_progress(client, 0, false);
+
+	lash_watch_epoll_update_timer(client);
+
+	dbus_connection_unref(connection);
+}
+
+int
+lash_get_epoll_fd(lash_client_t *client)
+{
+#ifdef HAVE_EPOLL
+	struct epoll_event ev;
+	size_t i;
+
+	if (!client || !client->dbus_service) {
+		lash_error("Client is not connected");
+		return -1;
+	}
+
+	if (client->io)
+		return client->io->notify_fd;
+
+	if (client->epoll_fd != -1)
+		return client->epoll_fd;
+
+	if ((client->epoll_fd = epoll_create1(EPOLL_CLOEXEC)) == -1) {
+		lash_error("Cannot create epoll descriptor: %s", strerror(errno));
+		return -1;
+	}
+
+	if ((client->timer_fd = timerfd_create(CLOCK_MONOTONIC,
+	                                       TFD_NONBLOCK | TFD_CLOEXEC)) == -1) {
+		lash_error("Cannot create timer descriptor: %s", strerror(errno));
+		goto fail;
+	}
+
+	memset(&ev, 0, sizeof(ev));
+	ev.events = EPOLLIN;
+	ev.data.fd = client->timer_fd;
+
+	if (epoll_ctl(client->epoll_fd, EPOLL_CTL_ADD, client->timer_fd, &ev) == -1) {
+		lash_error("Cannot add timer descriptor to epoll set: %s",
+		           strerror(errno));
+		goto fail;
+	}
+
+	ev.data.fd = client->save_fd;
+
+	if (epoll_ctl(client->epoll_fd, EPOLL_CTL_ADD, client->save_fd, &ev) == -1) {
+		lash_error("Cannot add event descriptor to epoll set: %s",
+		           strerror(errno));
+		goto fail;
+	}
+
+	for (i = 0; i < client->num_watches; ++i)
+		lash_watch_epoll_update_fd(client,
+		                           dbus_watch_get_unix_fd(client->watches[i]));
+
+	lash_watch_epoll_update_timer(client);
+
+	return client->epoll_fd;
+
+fail:
+	if (client->timer_fd != -1) {
+		close(client->timer_fd);
+		client->timer_fd = -1;
+	}
+	close(client->epoll_fd);
+	client->epoll_fd = -1;
+#else
+	lash_error("epoll is not supported on this system");
+#endif
+	return -1;
+}
+
+void
+lash_handle_epoll_events(lash_client_t *client)
+{
+#ifdef HAVE_EPOLL
+	struct epoll_event events[LASH_EPOLL_MAX_EVENTS];
+	struct pollfd fds[LASH_EPOLL_MAX_EVENTS];
+	uint64_t expirations;
+	int i, n, num_fds = 0;
+
+	if (client && client->io) {
+		lash_dispatch(client);
+		return;
+	}
+
+	if (!client || client->epoll_fd == -1)
+		return;
+
+	n = epoll_wait(client->epoll_fd, events, LASH_EPOLL_MAX_EVENTS, 0);
+
+	for (i = 0; i < n; ++i) {
+		if (events[i].data.fd == client->timer_fd) {
+			/* Only drains the timer, due timeouts are
+			   found by lash_handle_events() */
+			if (read(client->timer_fd, &expirations,
+			         sizeof(expirations)) == -1 && errno != EAGAIN)
+				lash_error("Cannot read timer descriptor: %s",
+				           strerror(errno));
+			continue;
+		}
+
+		/* Drained by lash_save_dispatch() */
+		if (events[i].data.fd == client->save_fd)
+			continue;
+
+		fds[num_fds].fd = events[i].data.fd;
+		fds[num_fds].events = 0;
+		fds[num_fds].revents =
+		  ((events[i].events & EPOLLIN) ? POLLIN : 0)
+		  | ((events[i].events & EPOLLOUT) ? POLLOUT : 0)
+		  | ((events[i].events & EPOLLERR) ? POLLERR : 0)
+		  | ((events[i].events & EPOLLHUP) ? POLLHUP : 0);
+		++num_fds;
+	}
+
+	lash_handle_events(client, fds, num_fds);
+#endif
+}
+
+/* EOF */
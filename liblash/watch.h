@@ -0,0 +1,45 @@
+/*
+ *   LASH
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __LIBLASH_WATCH_H__
+#define __LIBLASH_WATCH_H__
+
+#include <stdbool.h>
+
+#include "lash/types.h"
+
+/**
+ * Start tracking the watches and timeouts of the client's D-Bus
+ * connection so that they can be handed to the application's main loop.
+ *
+ * @param client Client whose D-Bus service has been created.
+ * @return True on success, false otherwise.
+ */
+bool
+lash_watch_init(lash_client_t *client);
+
+/**
+ * Stop tracking the connection's watches and timeouts, forgetting
+ * those already tracked.
+ *
+ * @param client Client whose watches were set up by lash_watch_init().
+ */
+void
+lash_watch_fini(lash_client_t *client);
+
+#endif /* __LIBLASH_WATCH_H__ */
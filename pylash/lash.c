@@ -21,9 +21,200 @@
  *
  *****************************************************************************/
 
+#include <Python.h>
+
 #include "lash/lash.h"
+#include "lash.h"
+
+#if PY_MAJOR_VERSION < 3
+# define PYLASH_TPFLAGS_BUFFER Py_TPFLAGS_HAVE_NEWBUFFER
+#else
+# define PYLASH_TPFLAGS_BUFFER 0
+#endif
+
+/* Exporter of a config's value through the buffer protocol */
+typedef struct
+{
+  PyObject_HEAD
+  lash_config_t * config;
+  Py_ssize_t count;             /* number of elements */
+  Py_ssize_t itemsize;
+  const char * format;
+} config_buffer_t;
 
 lash_client_t * init(int * argc, char *** argv, const char * client_class, int client_flags)
 {
   return lash_init(lash_extract_args(argc, argv), client_class, client_flags, LASH_PROTOCOL_VERSION);
 }
+
+static int config_buffer_get(PyObject * self, Py_buffer * view, int flags)
+{
+  config_buffer_t * buffer = (config_buffer_t *) self;
+  static char empty[1];
+
+  if ((flags & PyBUF_WRITABLE) == PyBUF_WRITABLE)
+  {
+    PyErr_SetString(PyExc_BufferError, "LASH config values are read-only");
+    view->obj = NULL;
+    return -1;
+  }
+
+  view->buf = (void *) lash_config_get_value(buffer->config);
+  if (view->buf == NULL)
+  {
+    view->buf = empty;
+  }
+
+  view->obj = self;
+  Py_INCREF(self);
+  view->len = buffer->count * buffer->itemsize;
+  view->readonly = 1;
+  view->itemsize = buffer->itemsize;
+  view->format = (flags & PyBUF_FORMAT) == PyBUF_FORMAT ? (char *) buffer->format : NULL;
+  view->ndim = 1;
+  view->shape = (flags & PyBUF_ND) == PyBUF_ND ? &buffer->count : NULL;
+  view->strides = (flags & PyBUF_STRIDES) == PyBUF_STRIDES ? &buffer->itemsize : NULL;
+  view->suboffsets = NULL;
+  view->internal = NULL;
+
+  return 0;
+}
+
+static void config_buffer_dealloc(PyObject * self)
+{
+  lash_config_destroy(((config_buffer_t *) self)->config);
+  Py_TYPE(self)->tp_free(self);
+}
+
+static PyBufferProcs config_buffer_procs =
+{
+  .bf_getbuffer = config_buffer_get,
+};
+
+static PyTypeObject config_buffer_type =
+{
+  PyVarObject_HEAD_INIT(NULL, 0)
+  .tp_name = "lash.ConfigBuffer",
+  .tp_basicsize = sizeof(config_buffer_t),
+  .tp_dealloc = config_buffer_dealloc,
+  .tp_as_buffer = &config_buffer_procs,
+  .tp_flags = Py_TPFLAGS_DEFAULT | PYLASH_TPFLAGS_BUFFER,
+  .tp_doc = "Value of a LASH config, exported through the buffer protocol",
+};
+
+PyObject * config_get_buffer(lash_config_t * config)
+{
+  config_buffer_t * buffer;
+  PyObject * view;
+
+  if (config == NULL)
+  {
+    PyErr_SetString(PyExc_ValueError, "config is NULL");
+    return NULL;
+  }
+
+  if (PyType_Ready(&config_buffer_type) < 0 ||
+      (buffer = PyObject_New(config_buffer_t, &config_buffer_type)) == NULL)
+  {
+    lash_config_destroy(config);
+    return NULL;
+  }
+
+  buffer->config = config;
+
+  switch (lash_config_get_value_type(config))
+  {
+  case LASH_TYPE_DOUBLE_ARRAY:
+    buffer->format = "d";
+    buffer->itemsize = sizeof(double);
+    break;
+  case LASH_TYPE_FLOAT_ARRAY:
+    buffer->format = "f";
+    buffer->itemsize = sizeof(float);
+    break;
+  case LASH_TYPE_INT_ARRAY:
+    buffer->format = "i";
+    buffer->itemsize = sizeof(int32_t);
+    break;
+  default:
+    buffer->format = "B";
+    buffer->itemsize = 1;
+  }
+
+  buffer->count = lash_config_get_value_size(config) / buffer->itemsize;
+
+  view = PyMemoryView_FromObject((PyObject *) buffer);
+  Py_DECREF(buffer);
+
+  return view;
+}
+
+/* Get the array type matching a buffer format, or LASH_TYPE_RAW */
+static int config_buffer_type_of(const char * format, Py_ssize_t itemsize)
+{
+  static const union { uint16_t u; char c; } byte_order = { 1 };
+
+  if (format == NULL)
+  {
+    return LASH_TYPE_RAW;
+  }
+
+  /* Only the native byte order can be stored as an array */
+  if (*format == '@' || *format == '=' || *format == (byte_order.c ? '<' : '>'))
+  {
+    format++;
+  }
+
+  if (format[0] == '\0' || format[1] != '\0')
+  {
+    return LASH_TYPE_RAW;
+  }
+
+  if (format[0] == 'd' && itemsize == sizeof(double))
+  {
+    return LASH_TYPE_DOUBLE_ARRAY;
+  }
+
+  if (format[0] == 'f' && itemsize == sizeof(float))
+  {
+    return LASH_TYPE_FLOAT_ARRAY;
+  }
+
+  if ((format[0] == 'i' || format[0] == 'l') && itemsize == sizeof(int32_t))
+  {
+    return LASH_TYPE_INT_ARRAY;
+  }
+
+  return LASH_TYPE_RAW;
+}
+
+PyObject * config_set_buffer(lash_config_t * config, PyObject * buffer)
+{
+  Py_buffer view;
+  int type;
+
+  if (config == NULL)
+  {
+    PyErr_SetString(PyExc_ValueError, "config is NULL");
+    return NULL;
+  }
+
+  if (PyObject_GetBuffer(buffer, &view, PyBUF_C_CONTIGUOUS | PyBUF_FORMAT) < 0)
+  {
+    return NULL;
+  }
+
+  type = config_buffer_type_of(view.format, view.itemsize);
+  if (type == LASH_TYPE_RAW)
+  {
+    lash_config_set_value(config, view.buf, view.len);
+  }
+  else
+  {
+    lash_config_set_value_array(config, type, view.buf, view.len / view.itemsize);
+  }
+
+  PyBuffer_Release(&view);
+
+  Py_RETURN_NONE;
+}
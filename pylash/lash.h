@@ -24,6 +24,23 @@
 #ifndef LASH_H__74601D15_FF3A_4086_B6F6_8D626BBCD7A2__INCLUDED
 #define LASH_H__74601D15_FF3A_4086_B6F6_8D626BBCD7A2__INCLUDED
 
+#include <Python.h>
+
 lash_client_t * init(int * argc, char *** argv, const char * client_class, int client_flags); 
 
+/* Take over config and return a read-only memoryview of its value which
+ * refers to the value in place. The format of the view follows the
+ * config's type, so that e.g. numpy.frombuffer() gives an array of
+ * doubles for a LASH_TYPE_DOUBLE_ARRAY config without copying. The
+ * config is destroyed when the last view of it is released; it must not
+ * be passed to lash_config_destroy() or lash_send_config(). */
+PyObject * config_get_buffer(lash_config_t * config);
+
+/* Set the value of config from any object which supports the buffer
+ * protocol, such as bytes, array.array or a numpy array. Contiguous
+ * doubles, floats and 32-bit integers are set as arrays of the matching
+ * type, anything else as raw data. The data is copied once, straight
+ * from the object's memory. */
+PyObject * config_set_buffer(lash_config_t * config, PyObject * buffer);
+
 #endif /* #ifndef LASH_H__74601D15_FF3A_4086_B6F6_8D626BBCD7A2__INCLUDED */
@@ -69,7 +69,7 @@
         goto fail;
     }
 
-    (*$2)[i] = PyString_AsString(s);
+    (*$2)[i] = (char *) PyString_AsString(s);
   }
 
   (*$2)[i] = 0;
@@ -116,12 +116,19 @@
 
 %{
 #include <lash/client_interface.h>
+#include <lash/client_interface_new.h>
 #include <lash/types.h>
 #include <lash/event.h>
 #include <lash/config.h>
 #include "lash.h"
 typedef unsigned char * uuid_t_compat;
 #define uuid_t uuid_t_compat
+
+#if PY_MAJOR_VERSION >= 3
+# define PyString_Check PyUnicode_Check
+# define PyString_AsString PyUnicode_AsUTF8
+# define PyString_FromString PyUnicode_FromString
+#endif
 %}
 
 #endif
@@ -132,4 +139,67 @@ typedef unsigned char * uuid_t_compat;
 %include <lash/config.h>
 %include <lash.h>
 
+/* Main loop integration, see lash/client_interface_new.h */
+int lash_get_epoll_fd(lash_client_t *client);
+void lash_handle_epoll_events(lash_client_t *client);
+
+#ifdef SWIG
+%pythoncode %{
+# Handles of the first ready() calls scheduled by attach(), by descriptor
+_attach_handles = {}
+
+def attach(client, callback, loop=None):
+    """Handle the events of client on an asyncio event loop.
+
+    liblash's descriptor is watched by the loop, and whenever it becomes
+    readable the client's connection is serviced and callback is called
+    with each event which has arrived, so the client doesn't have to poll
+    lash_get_event(). The callback takes over the event like a caller of
+    lash_get_event() does. Configs of a restored data set can be fetched
+    with lash_get_config() when the LASH_Restore_Data_Set event arrives.
+
+    loop defaults to the running event loop. Returns the descriptor.
+    """
+    import asyncio
+
+    if loop is None:
+        loop = asyncio.get_running_loop()
+
+    fd = lash_get_epoll_fd(client)
+    if fd < 0:
+        raise RuntimeError("liblash has no descriptor to watch")
+
+    def ready():
+        lash_handle_epoll_events(client)
+        event = lash_get_event(client)
+        while event:
+            callback(event)
+            event = lash_get_event(client)
+
+    loop.add_reader(fd, ready)
+
+    # Handle what arrived before the descriptor was watched
+    _attach_handles[fd] = loop.call_soon(ready)
+
+    return fd
+
+def detach(client, loop=None):
+    """Stop handling the events of client on an asyncio event loop.
+
+    loop defaults to the running event loop.
+    """
+    import asyncio
+
+    if loop is None:
+        loop = asyncio.get_running_loop()
+
+    fd = lash_get_epoll_fd(client)
+    if fd >= 0:
+        loop.remove_reader(fd)
+        handle = _attach_handles.pop(fd, None)
+        if handle is not None:
+            handle.cancel()
+%}
+#endif
+
 #endif /* #ifndef LASH_I__74601D15_FF3A_4086_B6F6_8D626BBCD7A2__INCLUDED */
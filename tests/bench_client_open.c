@@ -0,0 +1,187 @@
+/*
+ *   LASH
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <pthread.h>
+#include <dbus/dbus.h>
+
+#include "lash/lash.h"
+#include "liblash/client.h"
+
+#include "test.h"
+
+/* Times lash_client_open() against the session bus. If no LASH server
+   is running, a stand-in which only answers Connect takes its name, so
+   that the figures are those of the client's own round trips. */
+
+#define DEFAULT_ROUNDS 100
+
+static bool stand_in_quit;
+
+static void
+stand_in_connect(DBusConnection *connection,
+                 DBusMessage    *message)
+{
+	static const char *id_str = "00000000-0000-0000-0000-000000000001";
+	static const char *empty = "";
+	const char *class, *wd;
+	dbus_int32_t pid, flags = 0;
+	DBusMessage *reply;
+
+	if (!dbus_message_get_args(message, NULL,
+	                           DBUS_TYPE_INT32, &pid,
+	                           DBUS_TYPE_STRING, &class,
+	                           DBUS_TYPE_INT32, &flags,
+	                           DBUS_TYPE_STRING, &wd,
+	                           DBUS_TYPE_INVALID))
+		reply = dbus_message_new_error(message, DBUS_ERROR_INVALID_ARGS,
+		                               "Bad Connect arguments");
+	else if ((reply = dbus_message_new_method_return(message)))
+		dbus_message_append_args(reply,
+		                         DBUS_TYPE_STRING, &id_str,
+		                         DBUS_TYPE_STRING, &empty,
+		                         DBUS_TYPE_STRING, &empty,
+		                         DBUS_TYPE_STRING, &empty,
+		                         DBUS_TYPE_INT32, &flags,
+		                         DBUS_TYPE_STRING, &wd,
+		                         DBUS_TYPE_INVALID);
+
+	if (reply) {
+		dbus_connection_send(connection, reply, NULL);
+		dbus_message_unref(reply);
+	}
+}
+
+static void *
+stand_in_run(void *data)
+{
+	DBusConnection *connection = data;
+	DBusMessage *message;
+
+	while (!__atomic_load_n(&stand_in_quit, __ATOMIC_ACQUIRE)
+	       && dbus_connection_read_write(connection, 100)) {
+		while ((message = dbus_connection_pop_message(connection))) {
+			if (dbus_message_is_method_call(message,
+			                                "org.nongnu.LASH.Server",
+			                                "Connect"))
+				stand_in_connect(connection, message);
+			dbus_message_unref(message);
+		}
+	}
+
+	return NULL;
+}
+
+static uint64_t
+now_usec(void)
+{
+	struct timespec ts;
+
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+
+	return (uint64_t) ts.tv_sec * 1000000 + ts.tv_nsec / 1000;
+}
+
+static int
+compare_usec(const void *a,
+             const void *b)
+{
+	uint64_t x = *((const uint64_t *) a), y = *((const uint64_t *) b);
+
+	return (x > y) - (x < y);
+}
+
+int
+main(int    argc,
+     char **argv)
+{
+	DBusConnection *connection;
+	pthread_t thread;
+	bool stand_in = false;
+	lash_client_t *client;
+	uint64_t *usec, start, total = 0;
+	char **client_argv;
+	int i, rounds;
+
+	rounds = (argc > 1) ? atoi(argv[1]) : DEFAULT_ROUNDS;
+	if (rounds < 1)
+		rounds = DEFAULT_ROUNDS;
+
+	dbus_threads_init_default();
+
+	if (!(connection = dbus_bus_get_private(DBUS_BUS_SESSION, NULL))) {
+		fprintf(stderr, "No session bus, skipping\n");
+		return TEST_SKIPPED;
+	}
+
+	if (dbus_bus_request_name(connection, "org.nongnu.LASH",
+	                          DBUS_NAME_FLAG_DO_NOT_QUEUE, NULL)
+	    == DBUS_REQUEST_NAME_REPLY_PRIMARY_OWNER) {
+		if (pthread_create(&thread, NULL, stand_in_run, connection) != 0) {
+			fprintf(stderr, "Cannot start stand-in server\n");
+			return 1;
+		}
+		stand_in = true;
+	}
+
+	/* Never wait for the bus to start a server */
+	setenv("LASH_NO_START_SERVER", "1", 1);
+
+	usec = calloc(rounds, sizeof(uint64_t));
+
+	for (i = 0; i < rounds; ++i) {
+		/* The client takes ownership of its arguments */
+		client_argv = calloc(2, sizeof(char *));
+		client_argv[0] = strdup(argv[0]);
+
+		start = now_usec();
+		client = lash_client_open("bench_client_open", 0, 1, client_argv);
+		usec[i] = now_usec() - start;
+
+		CHECK(client != NULL);
+		if (!client)
+			break;
+		total += usec[i];
+		lash_client_destroy(client);
+	}
+
+	if (i == rounds) {
+		qsort(usec, rounds, sizeof(uint64_t), compare_usec);
+		printf("lash_client_open() against %s, %d rounds: "
+		       "min %llu us, median %llu us, max %llu us, mean %llu us\n",
+		       stand_in ? "a stand-in server" : "the LASH server", rounds,
+		       (unsigned long long) usec[0],
+		       (unsigned long long) usec[rounds / 2],
+		       (unsigned long long) usec[rounds - 1],
+		       (unsigned long long) (total / rounds));
+	}
+
+	free(usec);
+
+	if (stand_in) {
+		__atomic_store_n(&stand_in_quit, true, __ATOMIC_RELEASE);
+		pthread_join(thread, NULL);
+	}
+	dbus_connection_close(connection);
+	dbus_connection_unref(connection);
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,42 @@
+/*
+ *   LASH
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#ifndef __LASH_TESTS_TEST_H__
+#define __LASH_TESTS_TEST_H__
+
+#include <stdio.h>
+
+/* Exit status which tells automake's test driver that a test was skipped */
+#define TEST_SKIPPED 77
+
+static int test_failures __attribute__ ((unused));
+
+/* Report a failed check and carry on with the test */
+#define CHECK(cond) \
+	do { \
+		if (!(cond)) { \
+			fprintf(stderr, "%s:%d: check failed: %s\n", \
+			        __FILE__, __LINE__, #cond); \
+			++test_failures; \
+		} \
+	} while (0)
+
+/* Exit status of a test which has run */
+#define TEST_RESULT() (test_failures ? 1 : 0)
+
+#endif /* __LASH_TESTS_TEST_H__ */
@@ -0,0 +1,174 @@
+/*
+ *   LASH
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdio.h>
+#include <string.h>
+#include <dbus/dbus.h>
+
+#include "lash/lash.h"
+#include "liblash/lash_config.h"
+
+#include "test.h"
+
+#define NUM_KEYS 1000
+
+static void
+test_dirty_keys_add(void)
+{
+	struct _lash_dirty_keys dirty = { NULL, 0, 0 };
+	char key[16];
+	int i;
+
+	for (i = 0; i < NUM_KEYS; ++i) {
+		sprintf(key, "key%d", i);
+		lash_dirty_keys_add(&dirty, key);
+	}
+
+	/* Adding a key again doesn't add it twice */
+	for (i = 0; i < NUM_KEYS; i += 7) {
+		sprintf(key, "key%d", i);
+		lash_dirty_keys_add(&dirty, key);
+	}
+
+	CHECK(dirty.count == NUM_KEYS);
+	CHECK((dirty.size & (dirty.size - 1)) == 0);
+	CHECK(dirty.count * 4 <= dirty.size * 3);
+
+	lash_dirty_keys_clear(&dirty);
+	CHECK(dirty.count == 0 && dirty.size == 0 && dirty.table == NULL);
+}
+
+/* The keys which a delta save didn't write are sent as removed */
+static void
+test_dirty_keys_removed(void)
+{
+	struct _lash_dirty_keys dirty = { NULL, 0, 0 };
+	struct _lash_config_handle handle;
+	DBusMessage *message;
+	DBusMessageIter iter, array_iter, removed_iter;
+	const char *removed;
+	char key[16];
+	bool seen[NUM_KEYS];
+	int i, n, count = 0;
+	uint32_t value = 1;
+
+	for (i = 0; i < NUM_KEYS; ++i) {
+		sprintf(key, "key%d", i);
+		lash_dirty_keys_add(&dirty, key);
+	}
+
+	message = dbus_message_new_method_call("org.nongnu.LASH", "/",
+	                                       "org.nongnu.LASH.Server",
+	                                       "CommitDataSetDelta");
+	dbus_message_iter_init_append(message, &iter);
+	CHECK(dbus_message_iter_open_container(&iter, DBUS_TYPE_ARRAY,
+	                                       "{sv}", &array_iter));
+
+	lash_config_handle_init(&handle, &array_iter, false);
+	handle.delta = &dirty;
+
+	/* Write every third key, plus one which isn't dirty */
+	for (i = 0; i < NUM_KEYS; i += 3) {
+		sprintf(key, "key%d", i);
+		CHECK(lash_config_write(&handle, key, &value, LASH_TYPE_INTEGER));
+	}
+	CHECK(lash_config_write(&handle, "clean", &value, LASH_TYPE_INTEGER));
+
+	CHECK(dbus_message_iter_close_container(&iter, &array_iter));
+	CHECK(lash_dirty_keys_append_removed(&dirty, &iter));
+
+	memset(seen, 0, sizeof(seen));
+	dbus_message_iter_init(message, &iter);
+	CHECK(dbus_message_iter_next(&iter));
+	CHECK(dbus_message_iter_get_arg_type(&iter) == DBUS_TYPE_ARRAY);
+	dbus_message_iter_recurse(&iter, &removed_iter);
+	while (dbus_message_iter_get_arg_type(&removed_iter) == DBUS_TYPE_STRING) {
+		dbus_message_iter_get_basic(&removed_iter, &removed);
+		n = -1;
+		sscanf(removed, "key%d", &n);
+		CHECK(n >= 0 && n < NUM_KEYS && n % 3 != 0);
+		if (n >= 0 && n < NUM_KEYS) {
+			CHECK(!seen[n]);
+			seen[n] = true;
+		}
+		++count;
+		dbus_message_iter_next(&removed_iter);
+	}
+	CHECK(count == NUM_KEYS - (NUM_KEYS + 2) / 3);
+
+	/* After a failed save every key is removed again */
+	lash_dirty_keys_reset(&dirty);
+	dbus_message_unref(message);
+	message = dbus_message_new_method_call("org.nongnu.LASH", "/",
+	                                       "org.nongnu.LASH.Server",
+	                                       "CommitDataSetDelta");
+	dbus_message_iter_init_append(message, &iter);
+	CHECK(lash_dirty_keys_append_removed(&dirty, &iter));
+	dbus_message_iter_init(message, &iter);
+	dbus_message_iter_recurse(&iter, &removed_iter);
+	count = 0;
+	while (dbus_message_iter_get_arg_type(&removed_iter) == DBUS_TYPE_STRING) {
+		++count;
+		dbus_message_iter_next(&removed_iter);
+	}
+	CHECK(count == NUM_KEYS);
+
+	dbus_message_unref(message);
+	lash_dirty_keys_clear(&dirty);
+}
+
+/* The keys of a delta which the server rejected are marked again,
+   along with those marked since it was sent */
+static void
+test_dirty_keys_merge(void)
+{
+	struct _lash_dirty_keys dirty = { NULL, 0, 0 };
+	struct _lash_dirty_keys sent = { NULL, 0, 0 };
+	char key[16];
+	size_t i;
+	int n;
+
+	for (n = 0; n < NUM_KEYS; ++n) {
+		sprintf(key, "key%d", n);
+		lash_dirty_keys_add(&sent, key);
+	}
+	for (i = 0; i < sent.size; ++i)
+		sent.table[i].written = true;
+
+	lash_dirty_keys_add(&dirty, "key0");
+	lash_dirty_keys_add(&dirty, "new");
+
+	lash_dirty_keys_merge(&dirty, &sent);
+
+	CHECK(sent.count == 0 && sent.table == NULL);
+	CHECK(dirty.count == NUM_KEYS + 1);
+	for (i = 0; i < dirty.size; ++i)
+		CHECK(!dirty.table[i].written);
+
+	lash_dirty_keys_clear(&dirty);
+}
+
+int
+main(void)
+{
+	test_dirty_keys_add();
+	test_dirty_keys_removed();
+	test_dirty_keys_merge();
+
+	return TEST_RESULT();
+}
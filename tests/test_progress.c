@@ -0,0 +1,212 @@
+/*
+ *   LASH
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdlib.h>
+#include <unistd.h>
+#include <sys/eventfd.h>
+
+#include "lash/lash.h"
+#include "liblash/client.h"
+#include "liblash/io_thread.h"
+#include "liblash/dbus_iface_client.h"
+
+#include "test.h"
+
+#define TASK_ID 42
+
+/* The reports are checked as queued for the I/O thread, which is
+   left out so that no connection is needed */
+static struct _lash_io_thread *
+test_io_new(lash_client_t *client)
+{
+	struct _lash_io_thread *io = calloc(1, sizeof(struct _lash_io_thread));
+
+	spsc_init(&io->commands, io->command_buf, LASH_IO_QUEUE_SIZE,
+	          sizeof(struct _lash_io_command));
+	io->wake_fd = eventfd(0, EFD_NONBLOCK);
+	io->notify_fd = -1;
+	client->io = io;
+
+	return io;
+}
+
+/* Check that the next queued report is percentage for task_id */
+static void
+check_report(struct _lash_io_thread *io,
+             dbus_uint64_t           task_id,
+             uint8_t                 percentage)
+{
+	struct _lash_io_command command;
+
+	CHECK(spsc_pop(&io->commands, &command));
+	CHECK(command.type == LASH_IO_PROGRESS);
+	CHECK(command.task_id == task_id);
+	CHECK(command.value == percentage);
+}
+
+static void
+check_no_report(struct _lash_io_thread *io)
+{
+	struct _lash_io_command command;
+
+	CHECK(!spsc_pop(&io->commands, &command));
+}
+
+/* Check that the report held back for the I/O thread is percentage
+   for task_id, and take it */
+static void
+check_held(lash_client_t *client,
+           dbus_uint64_t  task_id,
+           uint8_t        percentage)
+{
+	dbus_uint64_t held_task = 0;
+	uint8_t held = 0;
+
+	CHECK(lash_take_held_progress(client, task_id, true, &held_task, &held));
+	CHECK(held_task == task_id);
+	CHECK(held == percentage);
+}
+
+static void
+test_progress_coalescing(lash_client_t          *client,
+                         struct _lash_io_thread *io)
+{
+	dbus_uint64_t held_task;
+	uint8_t held;
+	uint64_t count;
+
+	/* Long enough that the test never reaches it */
+	lash_set_progress_coalescing(client, 5, 60000);
+
+	/* The first report goes at once */
+	lash_notify_progress(client, 1);
+	check_report(io, TASK_ID, 1);
+
+	/* Small changes are held back, big ones sent */
+	lash_notify_progress(client, 2);
+	lash_notify_progress(client, 3);
+	check_no_report(io);
+	lash_notify_progress(client, 8);
+	check_report(io, TASK_ID, 8);
+	check_no_report(io);
+
+	/* A held back report is left for the I/O thread, which is woken
+	   up to send it once it is due. It is only taken for its own
+	   task, or early when forced. */
+	(void) read(io->wake_fd, &count, sizeof(count));
+	lash_notify_progress(client, 9);
+	check_no_report(io);
+	CHECK(read(io->wake_fd, &count, sizeof(count)) == sizeof(count));
+	CHECK(lash_held_progress_timeout(client) > 0);
+	CHECK(!lash_take_held_progress(client, TASK_ID + 1, true,
+	                               &held_task, &held));
+	CHECK(!lash_take_held_progress(client, TASK_ID, false,
+	                               &held_task, &held));
+	check_held(client, TASK_ID, 9);
+	CHECK(!lash_take_held_progress(client, 0, true, &held_task, &held));
+	CHECK(lash_held_progress_timeout(client) == -1);
+
+	/* The reporting thread counts the taken report as sent */
+	lash_notify_progress(client, 10);
+	check_no_report(io);
+	check_held(client, TASK_ID, 10);
+
+	/* A report sent at once replaces the held back one */
+	lash_notify_progress(client, 11);
+	lash_notify_progress(client, 20);
+	check_report(io, TASK_ID, 20);
+	CHECK(!lash_take_held_progress(client, 0, true, &held_task, &held));
+
+	/* Reaching the end is reported at once, and capped */
+	lash_notify_progress(client, 150);
+	check_report(io, TASK_ID, 99);
+	check_no_report(io);
+
+	/* A new task starts over */
+	client->pending_task = TASK_ID + 1;
+	lash_notify_progress(client, 2);
+	check_report(io, TASK_ID + 1, 2);
+	client->pending_task = TASK_ID;
+
+	/* A report is taken without forcing once it is due */
+	lash_set_progress_coalescing(client, 5, 1);
+	lash_notify_progress(client, 21);
+	check_report(io, TASK_ID, 21);
+	lash_notify_progress(client, 22);
+	check_no_report(io);
+	usleep(2000);
+	CHECK(lash_held_progress_timeout(client) == 0);
+	CHECK(lash_take_held_progress(client, 0, false, &held_task, &held));
+	CHECK(held_task == TASK_ID && held == 22);
+
+	/* Without an interval every change is reported */
+	lash_set_progress_coalescing(client, 5, 0);
+	lash_notify_progress(client, 50);
+	lash_notify_progress(client, 51);
+	check_report(io, TASK_ID, 50);
+	check_report(io, TASK_ID, 51);
+	check_no_report(io);
+}
+
+/* Reports which don't fit in the queue are counted, not lost silently */
+static void
+test_progress_dropped(lash_client_t          *client,
+                      struct _lash_io_thread *io)
+{
+	struct _lash_io_command command;
+	int i;
+
+	lash_set_progress_coalescing(client, 0, 0);
+
+	for (i = 0; i < LASH_IO_QUEUE_SIZE + 10; ++i)
+		lash_notify_progress(client, 1 + i % 2);
+	CHECK(io->dropped == 10);
+
+	while (spsc_pop(&io->commands, &command))
+		;
+
+	/* The count goes with the next queued report */
+	lash_notify_progress(client, 10);
+	CHECK(spsc_pop(&io->commands, &command));
+	CHECK(command.dropped == 10);
+	CHECK(io->dropped == 0);
+}
+
+int
+main(void)
+{
+	lash_client_t *client;
+	struct _lash_io_thread *io;
+	service_t service;
+
+	client = lash_client_new();
+	client->dbus_service = &service;
+	client->pending_task = TASK_ID;
+	io = test_io_new(client);
+
+	test_progress_coalescing(client, io);
+	test_progress_dropped(client, io);
+
+	close(io->wake_fd);
+	free(io);
+	client->io = NULL;
+	client->dbus_service = NULL;
+	lash_client_destroy(client);
+
+	return TEST_RESULT();
+}
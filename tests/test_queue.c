@@ -0,0 +1,118 @@
+/*
+ *   LASH
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#include <stdint.h>
+#include <stdlib.h>
+
+#include "liblash/queue.h"
+
+#include "test.h"
+
+#define NUM_OBJECTS 100
+
+static void
+test_queue_order(void)
+{
+	struct _lash_queue queue = { NULL, 0, 0, 0 };
+	uintptr_t i, next = 1;
+
+	CHECK(lash_queue_pop(&queue) == NULL);
+
+	/* Wrap around the ring before it has to grow */
+	for (i = 1; i <= 10; ++i)
+		lash_queue_push(&queue, (void *) i);
+	for (; next <= 5; ++next)
+		CHECK(lash_queue_pop(&queue) == (void *) next);
+	for (; i <= NUM_OBJECTS; ++i)
+		lash_queue_push(&queue, (void *) i);
+
+	CHECK(queue.count == NUM_OBJECTS - 5);
+	CHECK((queue.size & (queue.size - 1)) == 0);
+
+	for (; next <= NUM_OBJECTS; ++next)
+		CHECK(lash_queue_pop(&queue) == (void *) next);
+
+	CHECK(lash_queue_pop(&queue) == NULL);
+	CHECK(queue.count == 0);
+
+	lash_queue_free(&queue);
+	CHECK(queue.items == NULL && queue.size == 0);
+}
+
+static void
+test_pool_reuse(void)
+{
+	struct _lash_pool *pool = calloc(1, sizeof(struct _lash_pool));
+	void *objects[NUM_OBJECTS];
+	size_t i, j;
+
+	for (i = 0; i < NUM_OBJECTS; ++i) {
+		objects[i] = lash_pool_get(pool, 16);
+		CHECK(objects[i] != NULL);
+	}
+	CHECK(pool->num_used == NUM_OBJECTS);
+
+	/* A pool keeps as many objects as have been out at once */
+	for (i = 0; i < NUM_OBJECTS; ++i)
+		CHECK(lash_pool_put(pool, objects[i]));
+	CHECK(pool->num_used == 0);
+	CHECK(pool->num_free == NUM_OBJECTS);
+
+	/* They are handed out again instead of new ones */
+	for (i = 0; i < NUM_OBJECTS; ++i) {
+		void *object = lash_pool_get(pool, 16);
+		for (j = 0; j < NUM_OBJECTS && objects[j] != object; ++j)
+			;
+		CHECK(j < NUM_OBJECTS);
+	}
+	CHECK(pool->num_free == 0);
+
+	for (i = 0; i < NUM_OBJECTS; ++i)
+		lash_pool_put(pool, objects[i]);
+
+	lash_pool_release(pool, free);
+}
+
+static void
+test_pool_orphaned(void)
+{
+	struct _lash_pool *pool = calloc(1, sizeof(struct _lash_pool));
+	void *kept, *held;
+
+	kept = lash_pool_get(pool, 16);
+	held = lash_pool_get(pool, 16);
+	lash_pool_put(pool, kept);
+
+	/* The pool outlives its client while an object is out, and goes
+	   with the object's return */
+	lash_pool_release(pool, free);
+	CHECK(pool->orphaned);
+	CHECK(pool->num_used == 1);
+	CHECK(!lash_pool_put(pool, held));
+	free(held);
+}
+
+int
+main(void)
+{
+	test_queue_order();
+	test_pool_reuse();
+	test_pool_orphaned();
+
+	return TEST_RESULT();
+}
@@ -0,0 +1,161 @@
+/*
+ *   LASH
+ *
+ *   This program is free software; you can redistribute it and/or modify
+ *   it under the terms of the GNU General Public License as published by
+ *   the Free Software Foundation; either version 2 of the License, or
+ *   (at your option) any later version.
+ *
+ *   This program is distributed in the hope that it will be useful,
+ *   but WITHOUT ANY WARRANTY; without even the implied warranty of
+ *   MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+ *   GNU General Public License for more details.
+ *
+ *   You should have received a copy of the GNU General Public License
+ *   along with this program; if not, write to the Free Software
+ *   Foundation, Inc., 51 Franklin St, Fifth Floor, Boston, MA 02110-1301 USA.
+ */
+
+#define _GNU_SOURCE
+
+#include "config.h"
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <arpa/inet.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "lash/types.h"
+#include "lashd/store.h"
+
+#include "test.h"
+
+#ifdef HAVE_DATA_SET_FD
+
+/* Append a data set record to buf, see lashd/store.h */
+static size_t
+append_record(char        *buf,
+              const char  *key,
+              const void  *value,
+              uint32_t     value_size,
+              char         type)
+{
+	uint32_t u;
+	size_t key_size = strlen(key), len = 0;
+
+	u = htonl(key_size);
+	memcpy(buf + len, &u, sizeof(u));
+	len += sizeof(u);
+	memcpy(buf + len, key, key_size);
+	len += key_size;
+	u = htonl(value_size);
+	memcpy(buf + len, &u, sizeof(u));
+	len += sizeof(u);
+	memcpy(buf + len, value, value_size);
+	len += value_size;
+	buf[len++] = type;
+
+	return len;
+}
+
+static int
+sealed_memfd(const char *data,
+             size_t      size,
+             bool        seal)
+{
+	int fd = memfd_create("test-data-set", MFD_CLOEXEC | MFD_ALLOW_SEALING);
+
+	CHECK(fd != -1);
+	CHECK(write(fd, data, size) == (ssize_t) size);
+	if (seal)
+		CHECK(fcntl(fd, F_ADD_SEALS, F_SEAL_SHRINK | F_SEAL_GROW
+		                             | F_SEAL_WRITE | F_SEAL_SEAL) == 0);
+
+	return fd;
+}
+
+/* Check that the store's data set fd holds exactly the given data */
+static void
+check_store_contents(store_t    *store,
+                     const char *data,
+                     size_t      size)
+{
+	struct stat st;
+	char *map;
+	int fd;
+
+	fd = store_create_config_fd(store);
+	CHECK(fd != -1);
+	if (fd == -1)
+		return;
+
+	CHECK(fstat(fd, &st) == 0 && (size_t) st.st_size == size);
+	if ((size_t) st.st_size == size) {
+		map = mmap(NULL, size, PROT_READ, MAP_PRIVATE, fd, 0);
+		CHECK(map != MAP_FAILED && memcmp(map, data, size) == 0);
+		munmap(map, size);
+	}
+
+	close(fd);
+}
+
+int
+main(void)
+{
+	store_t *store;
+	char data[256], bad[256];
+	size_t size, bad_size;
+	uint32_t number = htonl(7);
+
+	store = store_new();
+
+	size = append_record(data, "number", &number, sizeof(number),
+	                     LASH_TYPE_INTEGER);
+	size += append_record(data + size, "dir/string", "hello", 6,
+	                      LASH_TYPE_STRING);
+	size += append_record(data + size, "raw", "\1\2\3", 3, LASH_TYPE_RAW);
+
+	/* Only a sealed memfd is accepted */
+	CHECK(!store_set_configs_from_fd(store, sealed_memfd(data, size, false)));
+	CHECK(store->num_keys == 0);
+
+	CHECK(store_set_configs_from_fd(store, sealed_memfd(data, size, true)));
+	CHECK(store->num_keys == 3);
+	check_store_contents(store, data, size);
+
+	/* A corrupt data set leaves the store as it was, even if
+	   some of its records are fine */
+	bad_size = append_record(bad, "new", "x", 1, LASH_TYPE_RAW);
+	bad_size += append_record(bad + bad_size, "unterminated", "abc", 3,
+	                          LASH_TYPE_STRING);
+	CHECK(!store_set_configs_from_fd(store, sealed_memfd(bad, bad_size, true)));
+
+	bad_size = append_record(bad, "number", "x", 1, LASH_TYPE_RAW);
+	bad_size += append_record(bad + bad_size, "truncated", "abcd", 4,
+	                          LASH_TYPE_RAW);
+	CHECK(!store_set_configs_from_fd(store, sealed_memfd(bad, bad_size - 2, true)));
+
+	bad_size = append_record(bad, "bad type", "x", 1, 'Z');
+	CHECK(!store_set_configs_from_fd(store, sealed_memfd(bad, bad_size, true)));
+
+	CHECK(store->num_keys == 3);
+	check_store_contents(store, data, size);
+
+	store_destroy(store);
+
+	return TEST_RESULT();
+}
+
+#else /* HAVE_DATA_SET_FD */
+
+int
+main(void)
+{
+	return TEST_SKIPPED;
+}
+
+#endif /* HAVE_DATA_SET_FD */